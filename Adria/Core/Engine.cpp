@@ -7,6 +7,7 @@
 #include "Graphics/GfxDevice.h"
 #include "Rendering/Renderer.h"
 #include "Rendering/ModelImporter.h"
+#include "Rendering/SceneLoader.h"
 #include "Rendering/ShaderManager.h"
 #include "Utilities/Random.h"
 #include "Utilities/Timer.h"
@@ -21,14 +22,6 @@ using namespace DirectX;
 
 namespace adria
 {
-	struct SceneConfig
-	{
-		std::vector<ModelParameters> scene_models;
-		std::vector<LightParameters> scene_lights;
-		SkyboxParameters skybox_params;
-		CameraParameters camera_params;
-	};
-
 	namespace 
 	{
 		std::optional<SceneConfig> ParseSceneConfig(std::string const& scene_file)
@@ -202,6 +195,7 @@ namespace adria
 
 	Engine::Engine(EngineInit const& init) : vsync{ init.vsync }, scene_viewport_data{}
 	{
+		AdriaTimer init_timer;
 		g_TaskManager.Initialize();
 
 		gfx = std::make_unique<GfxDevice>(Window::Handle());
@@ -209,6 +203,7 @@ namespace adria
 		ShaderManager::Initialize(gfx.get());
 		renderer = std::make_unique<Renderer>(reg, gfx.get(), Window::Width(), Window::Height());
 		model_importer = std::make_unique<ModelImporter>(reg, gfx.get());
+		scene_loader = std::make_unique<SceneLoader>(*model_importer);
 
 		InputEvents& input_events = g_Input.GetInputEvents();
 
@@ -228,10 +223,13 @@ namespace adria
 
 		std::ignore = input_events.window_resized_event.AddMember(&Camera::OnResize, *camera);
 		std::ignore = input_events.scroll_mouse_event.AddMember(&Camera::Zoom, *camera);
+		ADRIA_LOG(INFO, "Engine initialized in %f s, %u scene models are loading in the background", init_timer.ElapsedInSeconds(),
+			scene_loader->GetProgress().models_total);
 	}
 
 	Engine::~Engine()
 	{
+		scene_loader = nullptr;
 		model_importer = nullptr;
 		renderer = nullptr;
 		ShaderManager::Destroy();
@@ -260,7 +258,10 @@ namespace adria
 
 	void Engine::Update(float dt)
 	{
+		scene_loader->Update();
+		g_TextureManager.Update();
 		camera->Tick(dt);
+		model_importer->StreamTerrainTiles(camera->Position());
 		renderer->SetSceneViewportData(scene_viewport_data);
 		renderer->NewFrame(camera.get());
 		renderer->Update(dt);
@@ -309,8 +310,6 @@ namespace adria
 
 	void Engine::InitializeScene(SceneConfig const& config)
 	{
-		model_importer->LoadSkybox(config.skybox_params);
-		for (auto&& model : config.scene_models) model_importer->ImportModel_GLTF(model);
-		for (auto&& light : config.scene_lights) model_importer->LoadLight(light);
+		scene_loader->LoadScene(config);
 	}
 }
\ No newline at end of file
@@ -14,6 +14,7 @@ namespace adria
 	class GfxDevice;
 	class Renderer;
 	class ModelImporter;
+	class SceneLoader;
 	class GUI;
 
 	struct EngineInit
@@ -48,6 +49,7 @@ namespace adria
 		std::unique_ptr<GfxDevice> gfx;
 		std::unique_ptr<Renderer> renderer;
 		std::unique_ptr<ModelImporter> model_importer;
+		std::unique_ptr<SceneLoader> scene_loader;
 
 		SceneViewport scene_viewport_data;
 		bool editor_active = true;
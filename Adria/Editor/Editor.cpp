@@ -3,10 +3,12 @@
 #include "Rendering/Renderer.h"
 #include "Graphics/GfxDevice.h"
 #include "Rendering/ModelImporter.h"
+#include "Rendering/SceneLoader.h"
 #include "Logging/Logger.h"
 #include "Utilities/FilesUtil.h"
 #include "Utilities/StringUtil.h"
 #include "Utilities/Random.h"
+#include "Utilities/HeightmapCache.h"
 
 using namespace DirectX;
 
@@ -306,7 +308,7 @@ namespace adria
 						if (!texture_path.empty()) texture_path.append("/");
 
 						params.textures_path = texture_path;
-						engine->model_importer->ImportModel_GLTF(params);
+						engine->scene_loader->LoadModel(params);
 						free(file_path);
 					}
 				}
@@ -348,6 +350,14 @@ namespace adria
                 ImGui::EndMenu();
             }
 
+			if (engine->scene_loader->IsLoading())
+			{
+				SceneLoadProgress const& progress = engine->scene_loader->GetProgress();
+				std::string overlay = "Loading models " + std::to_string(progress.models_created) + "/" + std::to_string(progress.models_total);
+				if (progress.environment_loading) overlay += ", environment";
+				ImGui::ProgressBar(progress.Fraction(), ImVec2(200.0f, 0.0f), overlay.c_str());
+			}
+
             ImGui::EndMainMenuBar();
         }
     }
@@ -463,6 +473,11 @@ namespace adria
 					ImGui::SliderInt("Raindrops", &hydraulic_erosion_desc.drops, 10000, 5000000);
 					ImGui::SliderFloat("Carrying capacity", &hydraulic_erosion_desc.carrying_capacity, 0.5f, 2.0f);
 					ImGui::SliderFloat("Deposition Speed", &hydraulic_erosion_desc.deposition_speed, 0.01f, 0.1f);
+					static constexpr uint32 min_erosion_seed = 0, max_erosion_seed = 1000000;
+					ImGui::SliderScalar("Erosion Seed", ImGuiDataType_U32, &hydraulic_erosion_desc.seed, &min_erosion_seed, &max_erosion_seed);
+					ImGui::Checkbox("Parallel Erosion", &hydraulic_erosion_desc.parallel);
+					static constexpr uint32 min_erosion_tile_size = 32, max_erosion_tile_size = 1024;
+					if (hydraulic_erosion_desc.parallel) ImGui::SliderScalar("Erosion Tile Size", ImGuiDataType_U32, &hydraulic_erosion_desc.tile_size, &min_erosion_tile_size, &max_erosion_tile_size);
 
 					ImGui::TreePop();
 					ImGui::Separator();
@@ -489,8 +504,6 @@ namespace adria
 
 				if (ImGui::Button("Generate Terrain"))
 				{
-					engine->reg.destroy<TerrainComponent>();
-
 					TerrainParameters params{};
 					terrain_params.tile_size_x = tile_size[0];
 					terrain_params.tile_size_z = tile_size[1];
@@ -501,10 +514,9 @@ namespace adria
 					terrain_params.split_to_chunks = split_to_chunks;
 					terrain_params.chunk_count_x = chunk_count[0];
 					terrain_params.chunk_count_z = chunk_count[1];
-					terrain_params.normal_type = ENormalCalculation::AreaWeight;
-					terrain_params.heightmap = std::make_unique<Heightmap>(noise_desc);
-                    if (thermal_erosion) terrain_params.heightmap->ApplyThermalErosion(thermal_erosion_desc);
-                    if (hydraulic_erosion) terrain_params.heightmap->ApplyHydraulicErosion(hydraulic_erosion_desc);
+					terrain_params.heightmap = HeightmapCache::GetOrGenerate(noise_desc,
+						thermal_erosion ? &thermal_erosion_desc : nullptr,
+						hydraulic_erosion ? &hydraulic_erosion_desc : nullptr);
 
 					params.terrain_grid = std::move(terrain_params);
                     params.layer_params = layer_params;
@@ -512,12 +524,52 @@ namespace adria
 					params.rock_texture = "Resources/Textures/Terrain/grass2.dds";
 					params.base_texture = "Resources/Textures/Terrain/terrain_grass.dds";
 					params.sand_texture = "Resources/Textures/Terrain/mud.jpg";
-					static const char* layer_texture_name = "layer.tga";
-					params.layer_texture = layer_texture_name;
 
 					engine->model_importer->LoadTerrain(params);
 				}
 
+				if (ImGui::TreeNode("Tiled Terrain"))
+				{
+					static char tiled_terrain_path[256] = "Resources/Terrain/terrain.atrn";
+					static int32 tile_resolution = 256;
+					static int32 streaming_budget_mb = 256;
+					ImGui::InputText("File", tiled_terrain_path, sizeof(tiled_terrain_path));
+					ImGui::SliderInt("Tile Resolution", &tile_resolution, 32, 1024);
+					ImGui::SliderInt("Memory Budget (MB)", &streaming_budget_mb, 16, 4096);
+					ImGui::SliderFloat("Streaming Radius", &TerrainComponent::tile_streaming_radius, 64.0f, 4096.0f);
+
+					if (ImGui::Button("Export Tiled Terrain"))
+					{
+						TerrainTileGeneratorDesc tile_desc{};
+						tile_desc.output_path = tiled_terrain_path;
+						tile_desc.tile_resolution = (uint32)tile_resolution;
+						tile_desc.sample_spacing_x = tile_size[0];
+						tile_desc.sample_spacing_z = tile_size[1];
+						TerrainTileGenerator::FromNoise(noise_desc,
+							thermal_erosion ? &thermal_erosion_desc : nullptr,
+							hydraulic_erosion ? &hydraulic_erosion_desc : nullptr, layer_params, tile_desc);
+					}
+					ImGui::SameLine();
+					if (ImGui::Button("Stream Tiled Terrain"))
+					{
+						TiledTerrainParameters params{};
+						params.path = tiled_terrain_path;
+						params.memory_budget = uint64(streaming_budget_mb) << 20;
+						params.texture_scale = Vector2(texture_scale[0], texture_scale[1]);
+						params.grass_texture = "Resources/Textures/Terrain/terrain_grass.dds";
+						params.rock_texture = "Resources/Textures/Terrain/grass2.dds";
+						params.base_texture = "Resources/Textures/Terrain/terrain_grass.dds";
+						params.sand_texture = "Resources/Textures/Terrain/mud.jpg";
+						engine->model_importer->LoadTiledTerrain(params);
+					}
+					if (TerrainComponent::tile_cache)
+					{
+						ImGui::Text("Resident Tiles: %llu, Memory: %.1f / %.1f MB", TerrainComponent::tile_cache->ResidentTileCount(),
+							TerrainComponent::tile_cache->MemoryUsage() / (1024.0f * 1024.0f), TerrainComponent::tile_cache->MemoryBudget() / (1024.0f * 1024.0f));
+					}
+					ImGui::TreePop();
+				}
+
 				ImGui::TreePop();
 				ImGui::Separator();
             }
@@ -538,6 +590,12 @@ namespace adria
 					ImGui::SliderFloat("Foliage Slope Start", &foliage_params.foliage_slope_start, 0.0f, 1.0f);
 					ImGui::SliderFloat("Foliage Height Start", &foliage_params.foliage_height_start, -50.0f, 50.0f);
 					ImGui::SliderFloat("Foliage Height End", &foliage_params.foliage_height_end, -100.0f, 1000.0f);
+					ImGui::InputScalar("Foliage Seed", ImGuiDataType_U32, &foliage_params.foliage_seed);
+
+					const char* layers[] = { "Anywhere", "Rock", "Sand", "Grass" };
+					static int current_foliage_layer = 3;
+					ImGui::Combo("Foliage Layer", &current_foliage_layer, layers, IM_ARRAYSIZE(layers));
+					foliage_params.foliage_layer = current_foliage_layer ? std::optional(TerrainLayer(current_foliage_layer - 1)) : std::nullopt;
 
 					const char* foliage_types[] = { "Single Quad", "Double Quad", "Triple Quad" };
 					static int current_foliage_type = 0;
@@ -574,6 +632,7 @@ namespace adria
 
 						foliage_params.mesh_texture_pair.second = foliage_textures[index()];
 						foliages.push_back(foliage_params);
+						++foliage_params.foliage_seed;
 					}
 
 					ImGui::TreePop();
@@ -620,6 +679,12 @@ namespace adria
 					ImGui::SliderFloat("Tree Slope Start", &tree_params.tree_slope_start, 0.0f, 1.0f);
 					ImGui::SliderFloat("Tree Height Start", &tree_params.tree_height_start, 10.0f, 200.0f);
 					ImGui::SliderFloat("Tree Height End", &tree_params.tree_height_end, 200.0f, 1000.0f);
+					ImGui::InputScalar("Tree Seed", ImGuiDataType_U32, &tree_params.tree_seed);
+
+					const char* layers[] = { "Anywhere", "Rock", "Sand", "Grass" };
+					static int current_tree_layer = 3;
+					ImGui::Combo("Tree Layer", &current_tree_layer, layers, IM_ARRAYSIZE(layers));
+					tree_params.tree_layer = current_tree_layer ? std::optional(TerrainLayer(current_tree_layer - 1)) : std::nullopt;
 
 					const char* tree_types[] = { "Tree01", "Tree02"};
 					static int current_tree_type = 0;
@@ -639,6 +704,7 @@ namespace adria
 					if (ImGui::Button("Add Trees"))
 					{
                         trees.push_back(tree_params);
+						++tree_params.tree_seed;
 					}
 
 					ImGui::TreePop();
@@ -672,8 +738,7 @@ namespace adria
 
 			if (ImGui::Button("Clear"))
 			{
-				engine->reg.destroy<TerrainComponent>();
-                TerrainComponent::terrain = nullptr;
+				engine->model_importer->ClearTerrain();
 			}
 			if (ImGui::TreeNodeEx("Terrain Settings", 0))
 			{
@@ -838,6 +903,8 @@ namespace adria
 			}
 			if (ImGui::Button("Clear Particle Emitters"))
 			{
+				auto emitters = engine->reg.view<Emitter>();
+				for (auto e : emitters) g_TextureManager.ReleaseTexture(emitters.get(e).particle_texture);
 				engine->reg.destroy<Emitter>();
 			}
         }
@@ -903,6 +970,13 @@ namespace adria
 			}
 			if (ImGui::Button("Clear Decals"))
 			{
+				auto decal_view = engine->reg.view<Decal>();
+				for (auto e : decal_view)
+				{
+					Decal const& decal = decal_view.get(e);
+					g_TextureManager.ReleaseTexture(decal.albedo_decal_texture);
+					g_TextureManager.ReleaseTexture(decal.normal_decal_texture);
+				}
 				engine->reg.destroy<Decal>();
 			}
 		}
@@ -1108,7 +1182,11 @@ namespace adria
 					ImGui::Image(g_TextureManager.GetTextureView(material->albedo_texture), ImVec2(48.0f, 48.0f));
 
 					ImGui::PushID(0);
-					if (ImGui::Button("Remove")) material->albedo_texture = INVALID_TEXTURE_HANDLE;
+					if (ImGui::Button("Remove"))
+					{
+						g_TextureManager.ReleaseTexture(material->albedo_texture);
+						material->albedo_texture = INVALID_TEXTURE_HANDLE;
+					}
 					if (ImGui::Button("Select"))
 					{
 						nfdchar_t* file_path = NULL;
@@ -1117,7 +1195,9 @@ namespace adria
 						if (result == NFD_OKAY)
 						{
 							std::wstring texture_path = ToWideString(file_path);
-							material->albedo_texture = g_TextureManager.LoadTexture(texture_path);
+							TextureHandle const previous_texture = material->albedo_texture;
+							material->albedo_texture = g_TextureManager.LoadTexture(texture_path, TextureUsage::Albedo);
+							g_TextureManager.ReleaseTexture(previous_texture);
 							free(file_path);
 						}
 					}
@@ -1127,7 +1207,11 @@ namespace adria
 					ImGui::Image(g_TextureManager.GetTextureView(material->metallic_roughness_texture), ImVec2(48.0f, 48.0f));
 
 					ImGui::PushID(1);
-					if (ImGui::Button("Remove")) material->metallic_roughness_texture = INVALID_TEXTURE_HANDLE;
+					if (ImGui::Button("Remove"))
+					{
+						g_TextureManager.ReleaseTexture(material->metallic_roughness_texture);
+						material->metallic_roughness_texture = INVALID_TEXTURE_HANDLE;
+					}
 					if (ImGui::Button("Select"))
 					{
 						nfdchar_t* file_path = NULL;
@@ -1136,7 +1220,9 @@ namespace adria
 						if (result == NFD_OKAY)
 						{
 							std::wstring texture_path = ToWideString(file_path);
-							material->metallic_roughness_texture = g_TextureManager.LoadTexture(texture_path);
+							TextureHandle const previous_texture = material->metallic_roughness_texture;
+							material->metallic_roughness_texture = g_TextureManager.LoadTexture(texture_path, TextureUsage::MetallicRoughness);
+							g_TextureManager.ReleaseTexture(previous_texture);
 							free(file_path);
 						}
 					}
@@ -1146,7 +1232,11 @@ namespace adria
 					ImGui::Image(g_TextureManager.GetTextureView(material->emissive_texture), ImVec2(48.0f, 48.0f));
 
 					ImGui::PushID(2);
-					if (ImGui::Button("Remove")) material->emissive_texture = INVALID_TEXTURE_HANDLE;
+					if (ImGui::Button("Remove"))
+					{
+						g_TextureManager.ReleaseTexture(material->emissive_texture);
+						material->emissive_texture = INVALID_TEXTURE_HANDLE;
+					}
 					if (ImGui::Button("Select"))
 					{
 						nfdchar_t* file_path = NULL;
@@ -1155,7 +1245,9 @@ namespace adria
 						if (result == NFD_OKAY)
 						{
 							std::wstring texture_path = ToWideString(file_path);
-							material->emissive_texture = g_TextureManager.LoadTexture(texture_path);
+							TextureHandle const previous_texture = material->emissive_texture;
+							material->emissive_texture = g_TextureManager.LoadTexture(texture_path, TextureUsage::Emissive);
+							g_TextureManager.ReleaseTexture(previous_texture);
 							free(file_path);
 						}
 					}
@@ -1336,6 +1428,37 @@ namespace adria
 					ImGui::Checkbox("Modify GBuffer Normals", &decal->modify_gbuffer_normals);
 				}
 
+				auto foliage = engine->reg.get_if<Foliage>(selected_entity);
+				if (foliage && foliage->cell_grid && ImGui::CollapsingHeader("Foliage"))
+				{
+					ImGui::Text("Cells: %llu", (uint64)foliage->cell_grid->cells.size());
+					ImGui::Text("Visible Instances: %u / %llu", foliage->camera_instance_count, (uint64)foliage->cell_grid->instances.size());
+					ImGui::Text("Shadow Instances: %u", foliage->shadow_instance_count);
+					ImGui::SliderFloat("Density Start", &foliage->lod.density_start, 0.0f, 1000.0f);
+					ImGui::SliderFloat("Density End", &foliage->lod.density_end, foliage->lod.density_start, 2000.0f);
+					ImGui::SliderFloat("Min Density", &foliage->lod.min_density, 0.0f, 1.0f);
+					ImGui::SliderFloat("Cull Distance", &foliage->lod.cull_distance, 0.0f, 5000.0f);
+				}
+
+				auto mesh_lod = engine->reg.get_if<MeshLOD>(selected_entity);
+				if (mesh_lod && ImGui::CollapsingHeader("Mesh LOD"))
+				{
+					ImGui::Text("Current Level: %u", mesh_lod->current_level);
+					for (uint32 lod = 0; lod < mesh_lod->level_count; ++lod)
+					{
+						ImGui::Text("LOD %u: %u triangles, error %.4f", lod, mesh_lod->levels[lod].index_count / 3, mesh_lod->levels[lod].error);
+					}
+				}
+
+				auto mesh_clusters = engine->reg.get_if<MeshClusters>(selected_entity);
+				if (mesh_clusters && ImGui::CollapsingHeader("Mesh Clusters"))
+				{
+					ImGui::Text("Meshlets: %llu", (uint64)mesh_clusters->meshlets.size());
+					ImGui::Text("Visible Meshlets: %llu", mesh_clusters->statistics.visible_meshlet_count);
+					ImGui::Text("Drawn Triangles: %llu / %llu", mesh_clusters->statistics.drawn_triangle_count, mesh_clusters->statistics.triangle_count);
+					ImGui::Text("Index Ranges: %llu", mesh_clusters->statistics.range_count);
+				}
+
 				if (AABB* aabb = engine->reg.get_if<AABB>(selected_entity))
 				{
 					aabb->draw_aabb = true;
@@ -1664,6 +1787,37 @@ namespace adria
                 ImGui::SliderFloat("Shadow Softness", &renderer_settings.shadow_softness, 0.01f, 5.0f);
                 ImGui::Checkbox("Transparent Shadows", &renderer_settings.shadow_transparent);
                 ImGui::Checkbox("IBL", &renderer_settings.ibl);
+                ImGui::Checkbox("Mesh LOD", &renderer_settings.mesh_lod);
+                if (renderer_settings.mesh_lod) ImGui::SliderFloat("Mesh LOD Error (pixels)", &renderer_settings.mesh_lod_error, 0.1f, 16.0f);
+                ImGui::Checkbox("Cluster Culling", &renderer_settings.cluster_culling);
+                if (renderer_settings.cluster_culling)
+                {
+                    MeshletCullStatistics const cluster_statistics = engine->renderer->GetClusterCullStatistics();
+                    float const culled_percentage = cluster_statistics.triangle_count == 0 ? 0.0f :
+                        100.0f * (1.0f - (float)cluster_statistics.drawn_triangle_count / cluster_statistics.triangle_count);
+                    ImGui::Text("Visible Meshlets: %llu / %llu", cluster_statistics.visible_meshlet_count, cluster_statistics.meshlet_count);
+                    ImGui::Text("Drawn Triangles: %llu / %llu (%.1f%% culled)", cluster_statistics.drawn_triangle_count, cluster_statistics.triangle_count, culled_percentage);
+                    ImGui::Text("Index Ranges: %llu", cluster_statistics.range_count);
+                }
+                ImGui::Checkbox("Mesh Instancing", &renderer_settings.mesh_instancing);
+                if (renderer_settings.mesh_instancing)
+                {
+                    MeshInstancingStatistics const instancing_statistics = engine->renderer->GetInstancingStatistics();
+                    ImGui::Text("Instanced Draws: %llu for %llu meshes", instancing_statistics.batch_count, instancing_statistics.item_count);
+                    ImGui::Text("Shared Draws: %llu, Largest: %llu instances", instancing_statistics.instanced_batch_count, instancing_statistics.max_batch_size);
+                }
+
+                {
+                    static int streaming_budget = (int)(g_TextureManager.GetStreamingBudget() >> 20);
+                    if (ImGui::SliderInt("Texture Streaming Budget (MB)", &streaming_budget, 32, 4096)) g_TextureManager.SetStreamingBudget((uint64)streaming_budget << 20);
+                    TextureStreamingStatistics const streaming_statistics = g_TextureManager.GetStreamingStatistics();
+                    float const megabyte = 1024.0f * 1024.0f;
+                    char budget_usage[64];
+                    sprintf_s(budget_usage, "%.1f / %.1f MB", streaming_statistics.resident_bytes / megabyte, streaming_statistics.budget / megabyte);
+                    ImGui::ProgressBar(streaming_statistics.budget ? (float)streaming_statistics.resident_bytes / streaming_statistics.budget : 0.0f, ImVec2(-1.0f, 0.0f), budget_usage);
+                    ImGui::Text("Streamed Textures: %u, Wanted: %.1f MB", streaming_statistics.texture_count, streaming_statistics.desired_bytes / megabyte);
+                    ImGui::Text("Loads: %u, Evictions: %u, Mip Bias: %u", streaming_statistics.load_count, streaming_statistics.eviction_count, streaming_statistics.mip_bias);
+                }
 
                 //random lights
                 {
@@ -19,12 +19,12 @@ namespace adria
 		std::strong_ordering operator<=>(GfxBufferDesc const& other) const = default;
 	};
 
-	static GfxBufferDesc VertexBufferDesc(uint64 vertex_count, uint32 stride)
+	static GfxBufferDesc VertexBufferDesc(uint64 vertex_count, uint32 stride, bool dynamic = false)
 	{
 		GfxBufferDesc desc{};
 		desc.bind_flags = GfxBindFlag::VertexBuffer;
-		desc.cpu_access = GfxCpuAccess::None;
-		desc.resource_usage = GfxResourceUsage::Immutable;
+		desc.cpu_access = dynamic ? GfxCpuAccess::Write : GfxCpuAccess::None;
+		desc.resource_usage = dynamic ? GfxResourceUsage::Dynamic : GfxResourceUsage::Immutable;
 		desc.size = vertex_count * stride;
 		desc.stride = stride;
 		desc.misc_flags = GfxBufferMiscFlag::None;
@@ -45,6 +45,7 @@ namespace adria
 		GfxShaderCompilerFlagBit_None = 0,
 		GfxShaderCompilerFlagBit_Debug = 1 << 0,
 		GfxShaderCompilerFlagBit_DisableOptimization = 1 << 1,
+		GfxShaderCompilerFlagBit_NoRetryPrompt = 1 << 2,		//fail right away instead of asking to fix the errors, for compiles off the main thread
 	};
 
 	struct GfxShaderDesc
@@ -94,6 +94,7 @@ namespace adria
 			std::unique_ptr<char[]> binary_data(new char[binary_size]);
 			archive.loadBinary(binary_data.get(), binary_size);
 			output.shader_bytecode.SetBytecode(binary_data.get(), binary_size);
+			output.from_cache = true;
 			return true;
 		}
 		bool SaveToCache(char const* cache_path, GfxShaderCompileOutput const& output)
@@ -207,6 +208,7 @@ namespace adria
 				{
 					char const* err_msg = reinterpret_cast<char const*>(error_blob->GetBufferPointer());
 					ADRIA_LOG(ERROR, "%s", err_msg);
+					if (input.flags & GfxShaderCompilerFlagBit_NoRetryPrompt) return false;
 					std::string msg = "Click OK after you have fixed the following errors: \n";
 					msg += err_msg;
 					int32 result = MessageBoxA(NULL, msg.c_str(), NULL, MB_OKCANCEL);
@@ -9,6 +9,7 @@ namespace adria
 		GfxShaderBytecode shader_bytecode;
 		std::vector<std::string> includes;
 		uint64 hash;
+		bool from_cache = false;
 	};
 	
 	struct GfxInputLayoutDesc;
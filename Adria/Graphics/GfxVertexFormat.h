@@ -48,5 +48,14 @@ namespace adria
 		Vector3 bitangent;
 	};
 
+	//CompleteVertex packed to 16 bytes, see VertexCompression
+	struct CompressedVertex
+	{
+		uint16 position[4];	//unorm, normalized to the bounds of the mesh, w is 0 or 1 for the sign of the bitangent
+		int8 normal[2];		//snorm, octahedral
+		int8 tangent[2];	//snorm, octahedral
+		uint16 uv[2];		//half
+	};
+
 }
 
@@ -4,7 +4,9 @@
 #include <iostream>
 
 #include "Core/Defines.h"
+#if defined(_WIN32)
 #include "Core/Windows.h"
+#endif
 
 namespace adria
 {
@@ -117,7 +119,11 @@ namespace adria
 	void OutputDebugStringLogger::Log(ELogLevel level, char const* entry, char const* file, uint32_t line)
 	{
 		std::string log = GetLogTime() + LineInfoToString(file, line) + LevelToString(level) + std::string(entry) + "\n";
+#if defined(_WIN32)
 		OutputDebugStringA(log.c_str());
+#else
+		std::cerr << log;
+#endif
 	}
 
 }
\ No newline at end of file
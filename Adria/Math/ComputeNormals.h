@@ -2,6 +2,9 @@
 #include <DirectXMath.h>
 #include <vector>
 #include <concepts>
+#include <execution>
+#include <numeric>
+#include "VertexAdjacency.h"
 #include "Core/CoreTypes.h"
 
 
@@ -166,7 +169,7 @@ namespace adria
         template<typename vertex_t, typename index_t> requires HasPositionAndNormal<vertex_t>&& std::integral<index_t>
         void ComputeNormalsWeightedByArea(
             std::vector<vertex_t>& vertices,
-            std::vector<index_t> indices,
+            std::vector<index_t> const& indices,
             bool cw = false) 
         {
             std::vector<XMVECTOR> normals(vertices.size());
@@ -246,11 +249,71 @@ namespace adria
         AreaWeight
     };
 
+    namespace impl
+    {
+        //same weights as the serial versions, the weighted face normal of every corner is computed first and then gathered per vertex
+        template<typename ExecutionPolicy, typename vertex_t, typename index_t> requires HasPositionAndNormal<vertex_t>&& std::integral<index_t>
+        void ComputeNormalsParallel(
+            ExecutionPolicy&& policy,
+            ENormalCalculation normal_type,
+            std::vector<vertex_t>& vertices,
+            std::vector<index_t> const& indices,
+            bool cw)
+        {
+            std::span<index_t const> index_span(indices);
+            VertexCorners const adjacency = BuildVertexCorners(index_span, vertices.size());
+
+            std::vector<uint32> faces(indices.size() / 3);
+            std::iota(std::begin(faces), std::end(faces), 0u);
+            std::vector<XMFLOAT3> corner_normals(faces.size() * 3);
+            std::for_each(policy, std::begin(faces), std::end(faces), [&](uint32 face)
+                {
+                    if (!IsValidFace(index_span, face, vertices.size())) return;
+
+                    XMVECTOR p0 = XMLoadFloat3(&vertices[indices[face * 3]].position);
+                    XMVECTOR p1 = XMLoadFloat3(&vertices[indices[face * 3 + 1]].position);
+                    XMVECTOR p2 = XMLoadFloat3(&vertices[indices[face * 3 + 2]].position);
+
+                    XMVECTOR u = XMVectorSubtract(p1, p0);
+                    XMVECTOR v = XMVectorSubtract(p2, p0);
+                    XMVECTOR faceNormal = XMVector3Normalize(XMVector3Cross(u, v));
+
+                    XMVECTOR w0 = XMVectorSplatOne(), w1 = XMVectorSplatOne(), w2 = XMVectorSplatOne();
+                    if (normal_type == ENormalCalculation::AngleWeight)
+                    {
+                        w0 = XMVectorACos(XMVectorClamp(XMVector3Dot(XMVector3Normalize(u), XMVector3Normalize(v)), g_XMNegativeOne, g_XMOne));
+                        w1 = XMVectorACos(XMVectorClamp(XMVector3Dot(XMVector3Normalize(XMVectorSubtract(p2, p1)), XMVector3Normalize(XMVectorSubtract(p0, p1))), g_XMNegativeOne, g_XMOne));
+                        w2 = XMVectorACos(XMVectorClamp(XMVector3Dot(XMVector3Normalize(XMVectorSubtract(p0, p2)), XMVector3Normalize(XMVectorSubtract(p1, p2))), g_XMNegativeOne, g_XMOne));
+                    }
+                    else if (normal_type == ENormalCalculation::AreaWeight)
+                    {
+                        w0 = XMVector3Length(XMVector3Cross(u, v));
+                        w1 = XMVector3Length(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p0, p1)));
+                        w2 = XMVector3Length(XMVector3Cross(XMVectorSubtract(p0, p2), XMVectorSubtract(p1, p2)));
+                    }
+                    XMStoreFloat3(&corner_normals[face * 3], XMVectorMultiply(faceNormal, w0));
+                    XMStoreFloat3(&corner_normals[face * 3 + 1], XMVectorMultiply(faceNormal, w1));
+                    XMStoreFloat3(&corner_normals[face * 3 + 2], XMVectorMultiply(faceNormal, w2));
+                });
+
+            std::vector<uint32> vertex_indices(vertices.size());
+            std::iota(std::begin(vertex_indices), std::end(vertex_indices), 0u);
+            std::for_each(policy, std::begin(vertex_indices), std::end(vertex_indices), [&](uint32 vertex)
+                {
+                    XMVECTOR n = XMVectorZero();
+                    for (uint32 corner : adjacency[vertex]) n = XMVectorAdd(n, XMLoadFloat3(&corner_normals[corner]));
+                    n = XMVector3Normalize(n);
+                    if (cw) n = XMVectorNegate(n);
+                    XMStoreFloat3(&vertices[vertex].normal, n);
+                });
+        }
+    }
+
     template<typename vertex_t, typename index_t> requires HasPositionAndNormal<vertex_t>&& std::integral<index_t>
     void ComputeNormals(
         ENormalCalculation normal_type,
         std::vector<vertex_t>& vertices,
-        std::vector<index_t> indices,
+        std::vector<index_t> const& indices,
         bool cw = false)
     {
         switch (normal_type)
@@ -269,6 +332,20 @@ namespace adria
             return;
         }
     }
+
+    //e.g. ComputeNormals(std::execution::par, ...), the serial overload above is the reference
+    template<typename ExecutionPolicy, typename vertex_t, typename index_t> 
+        requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>> && HasPositionAndNormal<vertex_t> && std::integral<index_t>
+    void ComputeNormals(
+        ExecutionPolicy&& policy,
+        ENormalCalculation normal_type,
+        std::vector<vertex_t>& vertices,
+        std::vector<index_t> const& indices,
+        bool cw = false)
+    {
+        if (normal_type == ENormalCalculation::None) return;
+        impl::ComputeNormalsParallel(std::forward<ExecutionPolicy>(policy), normal_type, vertices, indices, cw);
+    }
    
 }
 
@@ -1,11 +1,17 @@
 ﻿#pragma once
 #include <DirectXMath.h>
+#include <vector>
+#include <span>
+#include <concepts>
+#include <execution>
+#include <numeric>
+#include "VertexAdjacency.h"
 
 using namespace DirectX;
 
 namespace adria
 {
-	void ComputeTangentFrame(
+	inline void ComputeTangentFrame(
 		_In_reads_(nIndices) uint32_t const* indices, size_t nIndices,
 		_In_reads_(nVerts) XMFLOAT3 const* positions,
 		_In_reads_(nVerts) XMFLOAT3 const* normals,
@@ -14,10 +20,10 @@ namespace adria
 		_Out_writes_opt_(nVerts) XMFLOAT3* out_tangents,
 		_Out_writes_opt_(nVerts) XMFLOAT3* out_bitangents) noexcept
 	{
-		XMFLOAT3* tangents = new XMFLOAT3[nVerts]{}; //use unique_ptr<T[]>
-		XMFLOAT3* bitangents = new XMFLOAT3[nVerts]{};
+		std::vector<XMFLOAT3> tangents(nVerts);
+		std::vector<XMFLOAT3> bitangents(nVerts);
 		
-		for (uint32_t i = 0; i <= nIndices - 3; i += 3)
+		for (size_t i = 0; i + 3 <= nIndices; i += 3)
 		{
 			uint32_t i0 = indices[i + 0];
 			uint32_t i1 = indices[i + 1];
@@ -46,46 +52,130 @@ namespace adria
 			XMVECTOR _b = XMVectorScale(XMVectorSubtract(XMVectorScale(_e2, x1),
 				XMVectorScale(_e1, x2)), r);
 
-			XMVECTOR _tangent0 = XMLoadFloat3(tangents + i0);
-			XMVECTOR _tangent1 = XMLoadFloat3(tangents + i1);
-			XMVECTOR _tangent2 = XMLoadFloat3(tangents + i2);
-
-			_tangent0 = XMVectorAdd(_tangent0, _t);
-			_tangent1 = XMVectorAdd(_tangent1, _t);
-			_tangent2 = XMVectorAdd(_tangent2, _t);
-
-			XMVECTOR _bitangent0 = XMLoadFloat3(bitangents + i0);
-			XMVECTOR _bitangent1 = XMLoadFloat3(bitangents + i1);
-			XMVECTOR _bitangent2 = XMLoadFloat3(bitangents + i2);
-
-			_bitangent0 = XMVectorAdd(_bitangent0, _b);
-			_bitangent1 = XMVectorAdd(_bitangent1, _b);
-			_bitangent2 = XMVectorAdd(_bitangent2, _b);
-
-			XMStoreFloat3(tangents + i0, _tangent0);
-			XMStoreFloat3(tangents + i1, _tangent1);
-			XMStoreFloat3(tangents + i2, _tangent2);
-			XMStoreFloat3(bitangents + i0, _bitangent0);
-			XMStoreFloat3(bitangents + i1, _bitangent1);
-			XMStoreFloat3(bitangents + i2, _bitangent2);
+			for (uint32_t index : { i0, i1, i2 })
+			{
+				XMStoreFloat3(&tangents[index], XMVectorAdd(XMLoadFloat3(&tangents[index]), _t));
+				XMStoreFloat3(&bitangents[index], XMVectorAdd(XMLoadFloat3(&bitangents[index]), _b));
+			}
 		}
 
 		for (size_t i = 0; i < nVerts; ++i)
 		{
-			XMFLOAT3 const& n = normals[i];
-			XMFLOAT3 const& t = tangents[i];
-			XMFLOAT3 const& b = bitangents[i];
+			XMVECTOR n = XMLoadFloat3(&normals[i]);
+			XMVECTOR t = XMLoadFloat3(&tangents[i]);
+			XMVECTOR b = XMLoadFloat3(&bitangents[i]);
 
-			XMVECTOR _out_tangent = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&t), XMVector3Dot(XMLoadFloat3(&n), XMLoadFloat3(&t))));
+			//Gram-Schmidt
+			XMVECTOR _out_tangent = XMVector3Normalize(XMVectorSubtract(t, XMVectorMultiply(n, XMVector3Dot(n, t))));
 			XMStoreFloat3(out_tangents + i, _out_tangent);
 			// Calculate handedness
-			float tangent_w = (XMVectorGetX(XMVector3Dot(XMVector3Cross(XMLoadFloat3(&n), XMLoadFloat3(&t)), XMLoadFloat3(&b))) < 0.0F) ? -1.0F : 1.0F;
-			XMVECTOR _bitangent = XMVectorScale(XMVector3Cross(XMLoadFloat3(&n), XMLoadFloat3(out_tangents + i)), tangent_w);
-			XMStoreFloat3(out_bitangents + i, XMVector3Normalize(_bitangent));
+			float tangent_w = (XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), b)) < 0.0F) ? -1.0F : 1.0F;
+			XMVECTOR _bitangent = XMVectorScale(XMVector3Cross(n, _out_tangent), tangent_w);
+			if (out_bitangents) XMStoreFloat3(out_bitangents + i, XMVector3Normalize(_bitangent));
 		}
+	}
 
-		delete[] tangents;
-		delete[] bitangents;
+	template<typename V>
+	concept HasTangentFrame = requires (V v)
+	{
+		{v.position}  -> std::convertible_to<XMFLOAT3>;
+		{v.normal}    -> std::convertible_to<XMFLOAT3>;
+		{v.uv}        -> std::convertible_to<XMFLOAT2>;
+		{v.tangent}   -> std::convertible_to<XMFLOAT3>;
+		{v.bitangent} -> std::convertible_to<XMFLOAT3>;
+	};
+
+	namespace impl
+	{
+		//v without its component along n, normalized, zero if nothing is left
+		inline XMVECTOR XM_CALLCONV ProjectOnPlane(FXMVECTOR v, FXMVECTOR n)
+		{
+			XMVECTOR const projected = XMVectorSubtract(v, XMVectorMultiply(n, XMVector3Dot(n, v)));
+			XMVECTOR const length = XMVector3Length(projected);
+			return XMVectorSelect(XMVectorZero(), XMVectorDivide(projected, length), XMVectorGreater(length, XMVectorZero()));
+		}
 	}
-}
 
+	/* Tangent frames the way MikkTSpace builds them: the uv derivatives of every face are projected onto the tangent plane of each of
+	   its vertices, normalized and weighted by the corner angle before they are summed, and the bitangent only keeps its sign against
+	   cross(normal, tangent). Unlike MikkTSpace vertices are never split, a vertex shared by mirrored uvs gets the average frame.
+	   Faces are processed in parallel first, then every vertex gathers its corners, so no atomics are needed. */
+	template<typename ExecutionPolicy, typename vertex_t, typename index_t>
+		requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>> && HasTangentFrame<vertex_t> && std::integral<index_t>
+	void ComputeTangentFrame(ExecutionPolicy&& policy, std::vector<vertex_t>& vertices, std::vector<index_t> const& indices)
+	{
+		std::span<index_t const> index_span(indices);
+		VertexCorners const adjacency = BuildVertexCorners(index_span, vertices.size());
+
+		struct FaceFrame
+		{
+			XMFLOAT3 tangent;
+			XMFLOAT3 bitangent;
+			bool valid;
+		};
+		std::vector<uint32> faces(indices.size() / 3);
+		std::iota(std::begin(faces), std::end(faces), 0u);
+		std::vector<FaceFrame> face_frames(faces.size());
+		std::vector<float> corner_angles(faces.size() * 3);
+		std::for_each(policy, std::begin(faces), std::end(faces), [&](uint32 face)
+			{
+				FaceFrame& frame = face_frames[face];
+				frame.valid = false;
+				if (!IsValidFace(index_span, face, vertices.size())) return;
+
+				vertex_t const& v0 = vertices[indices[face * 3]];
+				vertex_t const& v1 = vertices[indices[face * 3 + 1]];
+				vertex_t const& v2 = vertices[indices[face * 3 + 2]];
+				XMVECTOR const p0 = XMLoadFloat3(&v0.position);
+				XMVECTOR const p1 = XMLoadFloat3(&v1.position);
+				XMVECTOR const p2 = XMLoadFloat3(&v2.position);
+				XMVECTOR const e1 = XMVectorSubtract(p1, p0);
+				XMVECTOR const e2 = XMVectorSubtract(p2, p0);
+				if (XMVector3Equal(XMVector3Cross(e1, e2), XMVectorZero())) return;
+
+				corner_angles[face * 3] = XMVectorGetX(XMVector3AngleBetweenVectors(e1, e2));
+				corner_angles[face * 3 + 1] = XMVectorGetX(XMVector3AngleBetweenVectors(XMVectorSubtract(p2, p1), XMVectorNegate(e1)));
+				corner_angles[face * 3 + 2] = XMVectorGetX(XMVector3AngleBetweenVectors(XMVectorNegate(e2), XMVectorSubtract(p1, p2)));
+
+				float const x1 = v1.uv.x - v0.uv.x, x2 = v2.uv.x - v0.uv.x;
+				float const y1 = v1.uv.y - v0.uv.y, y2 = v2.uv.y - v0.uv.y;
+				float const det = x1 * y2 - x2 * y1;
+				if (det == 0.0f) return;
+				float const r = 1.0f / det;
+
+				XMStoreFloat3(&frame.tangent, XMVectorScale(XMVectorSubtract(XMVectorScale(e1, y2), XMVectorScale(e2, y1)), r));
+				XMStoreFloat3(&frame.bitangent, XMVectorScale(XMVectorSubtract(XMVectorScale(e2, x1), XMVectorScale(e1, x2)), r));
+				frame.valid = true;
+			});
+
+		std::vector<uint32> vertex_indices(vertices.size());
+		std::iota(std::begin(vertex_indices), std::end(vertex_indices), 0u);
+		std::for_each(policy, std::begin(vertex_indices), std::end(vertex_indices), [&](uint32 vertex)
+			{
+				XMVECTOR n = XMLoadFloat3(&vertices[vertex].normal);
+				n = XMVector3Equal(n, XMVectorZero()) ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVector3Normalize(n);
+
+				XMVECTOR t = XMVectorZero();
+				XMVECTOR b = XMVectorZero();
+				for (uint32 corner : adjacency[vertex])
+				{
+					FaceFrame const& frame = face_frames[corner / 3];
+					if (!frame.valid) continue;
+					XMVECTOR const weight = XMVectorReplicate(corner_angles[corner]);
+					t = XMVectorMultiplyAdd(impl::ProjectOnPlane(XMLoadFloat3(&frame.tangent), n), weight, t);
+					b = XMVectorMultiplyAdd(impl::ProjectOnPlane(XMLoadFloat3(&frame.bitangent), n), weight, b);
+				}
+
+				t = impl::ProjectOnPlane(t, n);
+				if (XMVector3Equal(t, XMVectorZero()))
+				{
+					//no usable uvs around the vertex, any frame will do
+					XMVECTOR const axis = std::abs(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+					t = XMVector3Normalize(XMVector3Cross(n, axis));
+				}
+				float const sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), b)) < 0.0f ? -1.0f : 1.0f;
+				XMStoreFloat3(&vertices[vertex].tangent, t);
+				XMStoreFloat3(&vertices[vertex].bitangent, XMVectorScale(XMVector3Normalize(XMVector3Cross(n, t)), sign));
+			});
+	}
+}
@@ -1,5 +1,7 @@
 #pragma once
+#if defined(_WIN32)
 #define __d3d11_h__
+#endif
 #include "SimpleMath.h"
 
 namespace adria
@@ -0,0 +1,54 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	/* Octahedral normal encoding (Meyer et al. 2010): the unit sphere is projected onto an octahedron
+	   which is then unfolded onto the [-1,1]^2 square. Two snorm8 components are enough for terrain normals. */
+	inline Vector2 OctahedralEncode(Vector3 const& n)
+	{
+		float inv_l1 = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		float u = n.x * inv_l1;
+		float v = n.y * inv_l1;
+		if (n.z < 0.0f)
+		{
+			float folded_u = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			float folded_v = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+			u = folded_u;
+			v = folded_v;
+		}
+		return Vector2(u, v);
+	}
+
+	inline Vector3 OctahedralDecode(Vector2 const& e)
+	{
+		Vector3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+		float t = std::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		n.Normalize();
+		return n;
+	}
+
+	inline uint16 PackOctahedral16(Vector3 const& n)
+	{
+		Vector2 e = OctahedralEncode(n);
+		int32 u = (int32)std::round(std::clamp(e.x, -1.0f, 1.0f) * 127.0f);
+		int32 v = (int32)std::round(std::clamp(e.y, -1.0f, 1.0f) * 127.0f);
+		return (uint16)((uint8)(int8)u | ((uint16)(uint8)(int8)v << 8));
+	}
+
+	inline Vector3 UnpackOctahedral16(uint16 packed)
+	{
+		float u = std::max((float)(int8)(packed & 0xff) / 127.0f, -1.0f);
+		float v = std::max((float)(int8)(packed >> 8) / 127.0f, -1.0f);
+		return OctahedralDecode(Vector2(u, v));
+	}
+
+	inline uint16 QuantizeUnorm16(float value, float bias, float inv_scale)
+	{
+		return (uint16)std::clamp(std::round((value - bias) * inv_scale), 0.0f, 65535.0f);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <concepts>
+#include <numeric>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	/* Triangle corners (3 * face + corner) around every vertex, in face order. Lets per-vertex sums over faces run in parallel
+	   over the vertices with no atomics, and in the same order as a serial loop over the faces. */
+	struct VertexCorners
+	{
+		std::vector<uint32> offsets;	//vertex_count + 1 entries
+		std::vector<uint32> corners;
+
+		std::span<uint32 const> operator[](size_t vertex) const
+		{
+			return std::span<uint32 const>(corners).subspan(offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+		}
+	};
+
+	//faces with a restart or an out of range index are left out
+	template<std::integral index_t>
+	bool IsValidFace(std::span<index_t const> indices, size_t face, size_t vertex_count)
+	{
+		return (size_t)indices[3 * face] < vertex_count && (size_t)indices[3 * face + 1] < vertex_count && (size_t)indices[3 * face + 2] < vertex_count;
+	}
+
+	template<std::integral index_t>
+	VertexCorners BuildVertexCorners(std::span<index_t const> indices, size_t vertex_count)
+	{
+		size_t const face_count = indices.size() / 3;
+		VertexCorners adjacency{};
+		adjacency.offsets.assign(vertex_count + 1, 0);
+		for (size_t face = 0; face < face_count; ++face)
+		{
+			if (!IsValidFace(indices, face, vertex_count)) continue;
+			for (size_t corner = 0; corner < 3; ++corner) ++adjacency.offsets[(size_t)indices[3 * face + corner] + 1];
+		}
+		std::partial_sum(std::begin(adjacency.offsets), std::end(adjacency.offsets), std::begin(adjacency.offsets));
+
+		adjacency.corners.resize(adjacency.offsets.back());
+		std::vector<uint32> cursors(std::begin(adjacency.offsets), std::end(adjacency.offsets) - 1);
+		for (size_t face = 0; face < face_count; ++face)
+		{
+			if (!IsValidFace(indices, face, vertex_count)) continue;
+			for (size_t corner = 0; corner < 3; ++corner) adjacency.corners[cursors[(size_t)indices[3 * face + corner]]++] = (uint32)(3 * face + corner);
+		}
+		return adjacency;
+	}
+}
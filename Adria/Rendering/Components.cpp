@@ -26,5 +26,33 @@ namespace adria
 		}
 	}
 
+	void Mesh::Draw(GfxCommandContext* context, std::span<MeshIndexRange const> ranges) const
+	{
+		ADRIA_ASSERT(index_buffer);
+		context->SetTopology(topology);
+		context->SetVertexBuffer(vertex_buffer.get());
+		context->SetIndexBuffer(index_buffer.get());
+		if (instance_buffer) context->SetVertexBuffer(instance_buffer.get(), 1);
+		for (MeshIndexRange const& range : ranges)
+		{
+			context->DrawIndexed(range.index_count, instance_count, range.start_index, base_vertex_location, start_instance_location);
+		}
+	}
+
+	void Material::AcquireTextures() const
+	{
+		for (TextureHandle texture : { albedo_texture, normal_texture, metallic_roughness_texture, emissive_texture }) g_TextureManager.AcquireTexture(texture);
+	}
+
+	void Material::ReleaseTextures() const
+	{
+		for (TextureHandle texture : { albedo_texture, normal_texture, metallic_roughness_texture, emissive_texture }) g_TextureManager.ReleaseTexture(texture);
+	}
+
+	void TerrainComponent::ReleaseTextures() const
+	{
+		for (TextureHandle texture : { sand_texture, grass_texture, rock_texture, base_texture, layer_texture }) g_TextureManager.ReleaseTexture(texture);
+	}
+
 }
 
@@ -1,7 +1,15 @@
 #pragma once
 #include <memory>
+#include <array>
 #include "Enums.h"
 #include "Terrain.h"
+#include "TerrainQuadTree.h"
+#include "TerrainStreaming.h"
+#include "TerrainLayers.h"
+#include "FoliageCulling.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "VertexCompression.h"
 #include "TextureManager.h"
 #include "Core/CoreTypes.h"
 #include "Math/Constants.h"
@@ -51,8 +59,31 @@ namespace adria
 
 		GfxPrimitiveTopology topology = GfxPrimitiveTopology::TriangleList;
 
+		//CompressedVertex buffers, decoded in the vertex shader
+		bool compressed_vertices = false;
+		VertexQuantization quantization{};
+
 		void Draw(GfxCommandContext* context) const;
 		void Draw(GfxCommandContext* context, GfxPrimitiveTopology override_topology) const;
+		//indexed meshes only, draws the given index ranges instead of the whole mesh
+		void Draw(GfxCommandContext* context, std::span<MeshIndexRange const> ranges) const;
+	};
+
+	//index ranges of the simplified levels of a Mesh, the selected one is copied into the Mesh before drawing
+	struct COMPONENT MeshLOD
+	{
+		MeshLodLevel levels[MESH_LOD_MAX_LEVELS];
+		uint32 level_count = 1;
+		uint32 current_level = 0;
+	};
+
+	//meshlets of level 0 of a Mesh, culled against the camera every frame into the index ranges the gbuffer pass draws
+	struct COMPONENT MeshClusters
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshIndexRange> visible_ranges;
+		MeshletCullStatistics statistics{};
+		bool active = false;	//false when the whole mesh or a coarser level is drawn
 	};
 
 	struct COMPONENT Material
@@ -73,6 +104,10 @@ namespace adria
 
 		Vector3 diffuse = Vector3(1, 1, 1);
 		ShaderProgram shader = ShaderProgram::Unknown;
+
+		//texture references of a copy of the material, LoadTexture already takes one for the material it loads into
+		void AcquireTextures() const;
+		void ReleaseTextures() const;
 	};
 
 	struct COMPONENT Light
@@ -140,24 +175,49 @@ namespace adria
 	struct COMPONENT Skybox 
 	{
 		TextureHandle cubemap_texture = INVALID_TEXTURE_HANDLE;
+		TextureHandle specular_texture = INVALID_TEXTURE_HANDLE;	//image based lighting, only baked for .hdr environment maps
+		TextureHandle irradiance_texture = INVALID_TEXTURE_HANDLE;
 		bool active = false;
 	};
 
 	struct COMPONENT Ocean {};
 
-	struct COMPONENT Foliage {};
+	struct COMPONENT Foliage
+	{
+		std::shared_ptr<FoliageCellGrid const> cell_grid = nullptr;
+		FoliageLod lod{};
+		//largest extent of one scaled instance of the mesh, the errors of its MeshLOD levels are relative to it
+		float instance_extent = 0.0f;
+
+		//compacted every frame by the renderer, the camera and the shadow passes write their own buffer grouped by mesh lod level
+		std::shared_ptr<GfxBuffer> camera_instance_buffer = nullptr;
+		std::shared_ptr<GfxBuffer> shadow_instance_buffer = nullptr;
+		uint32 camera_instance_count = 0;
+		uint32 shadow_instance_count = 0;
+		std::array<uint32, MESH_LOD_MAX_LEVELS> camera_level_counts{};
+		std::array<uint32, MESH_LOD_MAX_LEVELS> shadow_level_counts{};
+	};
 
 	struct COMPONENT Deferred {};
 
 	struct COMPONENT TerrainComponent
 	{
 		inline static std::unique_ptr<Terrain> terrain;
+		inline static std::unique_ptr<TerrainQuadTree> quadtree;
+		inline static std::unique_ptr<TerrainTileCache> tile_cache;
+		inline static std::unique_ptr<TerrainLayerMap> layer_map;
+		//bumped whenever the terrain is loaded or cleared, the renderer recreates its terrain resources when it changes
+		inline static uint64 generation = 0;
+		inline static float tile_streaming_radius = 512.0f;
 		inline static Vector2 texture_scale;
 		TextureHandle sand_texture = INVALID_TEXTURE_HANDLE;
 		TextureHandle grass_texture = INVALID_TEXTURE_HANDLE;
 		TextureHandle rock_texture = INVALID_TEXTURE_HANDLE;
 		TextureHandle base_texture = INVALID_TEXTURE_HANDLE;
 		TextureHandle layer_texture = INVALID_TEXTURE_HANDLE;
+
+		//every chunk holds a copy, the references are taken once per terrain by LoadTexture
+		void ReleaseTextures() const;
 	};
 
 	struct COMPONENT Emitter
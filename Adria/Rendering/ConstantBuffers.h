@@ -59,6 +59,10 @@ namespace adria
 	{
 		Matrix model;
 		Matrix transposed_inverse_model;
+		Vector3 position_scale;		//compressed vertices only
+		float _padd0;
+		Vector3 position_offset;
+		float _padd1;
 	};
 
 	DECLSPEC_ALIGN(16) struct MaterialCBuffer
@@ -206,6 +210,13 @@ namespace adria
 	{
 		Vector2 texture_scale;
 		int ocean_active;
+		float patch_size;
+		Vector2 terrain_min;
+		Vector2 terrain_max;
+		Vector2 uv_scale;
+		Vector2 heightmap_size;
+		float height_scale;
+		float height_bias;
 	};
 
 	//Structured Buffers
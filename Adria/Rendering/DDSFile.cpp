@@ -0,0 +1,139 @@
+#include <cstring>
+#include "DDSFile.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr uint32 DDS_MAGIC = 0x20534444; //"DDS "
+		static constexpr uint32 DDS_FOURCC_DX10 = 0x30315844; //"DX10"
+		static constexpr uint32 DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000;
+		static constexpr uint32 DDPF_FOURCC = 0x4;
+		static constexpr uint32 DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+		static constexpr uint32 DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00;
+		static constexpr uint32 DDS_DIMENSION_TEXTURE2D = 3;
+		static constexpr uint32 DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+		static constexpr uint32 DDS_MAX_MIP_COUNT = 32;
+
+		//bytes per 4x4 block of block compressed formats, bytes per texel of the others
+		struct DDSFormatSize
+		{
+			uint32 bytes;
+			bool block_compressed;
+		};
+
+		std::optional<DDSFormatSize> GetFormatSize(uint32 dxgi_format)
+		{
+			switch (dxgi_format)
+			{
+			case 10: return DDSFormatSize{ .bytes = 8, .block_compressed = false };	//R16G16B16A16_FLOAT
+			case 34: return DDSFormatSize{ .bytes = 4, .block_compressed = false };	//R16G16_FLOAT
+			case 71: return DDSFormatSize{ .bytes = 8, .block_compressed = true };	//BC1_UNORM
+			case 77: return DDSFormatSize{ .bytes = 16, .block_compressed = true };	//BC3_UNORM
+			case 80: return DDSFormatSize{ .bytes = 8, .block_compressed = true };	//BC4_UNORM
+			case 83: return DDSFormatSize{ .bytes = 16, .block_compressed = true };	//BC5_UNORM
+			case 98: return DDSFormatSize{ .bytes = 16, .block_compressed = true };	//BC7_UNORM
+			default: return std::nullopt;
+			}
+		}
+
+		struct DDSPixelFormat
+		{
+			uint32 size;
+			uint32 flags;
+			uint32 fourcc;
+			uint32 rgb_bit_count;
+			uint32 masks[4];
+		};
+
+		struct DDSHeader
+		{
+			uint32 size;
+			uint32 flags;
+			uint32 height;
+			uint32 width;
+			uint32 pitch_or_linear_size;
+			uint32 depth;
+			uint32 mip_count;
+			uint32 reserved1[11];
+			DDSPixelFormat pixel_format;
+			uint32 caps[4];
+			uint32 reserved2;
+		};
+		static_assert(sizeof(DDSHeader) == 124);
+
+		struct DDSHeaderDX10
+		{
+			uint32 dxgi_format;
+			uint32 resource_dimension;
+			uint32 misc_flag;
+			uint32 array_size;
+			uint32 misc_flags2;
+		};
+		static_assert(sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10) == DDSFile::DATA_OFFSET);
+	}
+
+	namespace DDSFile
+	{
+		void WriteHeaders(DDSFileDesc const& desc, std::vector<uint8>& dds)
+		{
+			DDSHeader header{};
+			header.size = sizeof(DDSHeader);
+			header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+			header.height = desc.height;
+			header.width = desc.width;
+			header.mip_count = desc.mip_count;
+			header.pixel_format.size = sizeof(DDSPixelFormat);
+			header.pixel_format.flags = DDPF_FOURCC;
+			header.pixel_format.fourcc = DDS_FOURCC_DX10;
+			header.caps[0] = DDSCAPS_TEXTURE | (desc.mip_count > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0) | (desc.cubemap ? DDSCAPS_COMPLEX : 0);
+			header.caps[1] = desc.cubemap ? DDSCAPS2_CUBEMAP_ALLFACES : 0;
+
+			DDSHeaderDX10 header_dx10{};
+			header_dx10.dxgi_format = desc.dxgi_format;
+			header_dx10.resource_dimension = DDS_DIMENSION_TEXTURE2D;
+			header_dx10.misc_flag = desc.cubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+			header_dx10.array_size = 1;	//in cubes, not faces
+
+			size_t const offset = dds.size();
+			dds.resize(offset + DATA_OFFSET);
+			uint8* output = dds.data() + offset;
+			memcpy(output, &DDS_MAGIC, sizeof(DDS_MAGIC));
+			output += sizeof(DDS_MAGIC);
+			memcpy(output, &header, sizeof(header));
+			output += sizeof(header);
+			memcpy(output, &header_dx10, sizeof(header_dx10));
+		}
+
+		std::optional<DDSFileDesc> ReadHeaders(std::span<uint8 const> dds)
+		{
+			if (dds.size() < DATA_OFFSET) return std::nullopt;
+
+			uint32 magic;
+			DDSHeader header;
+			DDSHeaderDX10 header_dx10;
+			memcpy(&magic, dds.data(), sizeof(magic));
+			memcpy(&header, dds.data() + sizeof(DDS_MAGIC), sizeof(header));
+			memcpy(&header_dx10, dds.data() + sizeof(DDS_MAGIC) + sizeof(DDSHeader), sizeof(header_dx10));
+			if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || !(header.pixel_format.flags & DDPF_FOURCC) || header.pixel_format.fourcc != DDS_FOURCC_DX10) return std::nullopt;
+			if (header_dx10.resource_dimension != DDS_DIMENSION_TEXTURE2D || header_dx10.array_size != 1) return std::nullopt;
+
+			return DDSFileDesc{ .dxgi_format = header_dx10.dxgi_format, .width = header.width, .height = header.height,
+				.mip_count = std::max(header.mip_count, 1u), .cubemap = (header_dx10.misc_flag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0 };
+		}
+
+		std::optional<uint64> DataSize(DDSFileDesc const& desc)
+		{
+			std::optional<DDSFormatSize> const format_size = GetFormatSize(desc.dxgi_format);
+			if (!format_size || desc.mip_count > DDS_MAX_MIP_COUNT) return std::nullopt;
+
+			uint64 face_size = 0;
+			for (uint32 mip = 0; mip < desc.mip_count; ++mip)
+			{
+				uint64 const width = std::max(desc.width >> mip, 1u), height = std::max(desc.height >> mip, 1u);
+				face_size += format_size->block_compressed ? ((width + 3) / 4) * ((height + 3) / 4) * format_size->bytes : width * height * format_size->bytes;
+			}
+			return face_size * (desc.cubemap ? 6 : 1);
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <optional>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	//what the headers of a DDS file with a DX10 header describe, the only kind of DDS file written by the engine
+	struct DDSFileDesc
+	{
+		uint32 dxgi_format;
+		uint32 width;
+		uint32 height;
+		uint32 mip_count = 1;
+		bool cubemap = false;
+	};
+
+	//backend independent, so caches of DDS files can be written without a device
+	namespace DDSFile
+	{
+		inline constexpr uint64 DATA_OFFSET = 148;	//magic, header and DX10 header
+
+		/* Appends the headers to dds. The subresources follow them in D3D order: all the mips of the first face,
+		   then all the mips of the next one. */
+		void WriteHeaders(DDSFileDesc const& desc, std::vector<uint8>& dds);
+		//only understands 2D textures and cubemaps with a DX10 header, as WriteHeaders writes them
+		std::optional<DDSFileDesc> ReadHeaders(std::span<uint8 const> dds);
+		//size of the subresources following the headers, only known for the formats the engine writes
+		std::optional<uint64> DataSize(DDSFileDesc const& desc);
+	}
+}
@@ -34,6 +34,8 @@ namespace adria
 	DECLARE_TEXTURE_SLOT(ROCK, 2);
 	DECLARE_TEXTURE_SLOT(SAND, 3);
 	DECLARE_TEXTURE_SLOT(LAYER, 4);
+	DECLARE_TEXTURE_SLOT(TERRAIN_HEIGHT, 5);
+	DECLARE_TEXTURE_SLOT(TERRAIN_NORMAL, 6);
 
 	enum ShaderId : uint8
 	{
@@ -51,9 +53,13 @@ namespace adria
 		PS_Decal,
 		PS_DecalsModifyNormals,
 		VS_GBufferPBR,
+		VS_GBufferPBR_Compressed,
+		VS_GBufferPBR_Instanced,
+		VS_GBufferPBR_Compressed_Instanced,
 		PS_GBufferPBR,
 		PS_GBufferPBR_Mask,
 		VS_GBufferTerrain,
+		VS_GBufferTerrain_CDLOD,
 		PS_GBufferTerrain,
 		VS_FullscreenQuad,
 		PS_AmbientPBR,
@@ -88,6 +94,9 @@ namespace adria
 		PS_Shadow,
 		VS_ShadowTransparent,
 		PS_ShadowTransparent,
+		VS_ShadowFoliage,
+		VS_Shadow_Compressed,
+		VS_ShadowTransparent_Compressed,
 		PS_VolumetricLight_Directional,
 		PS_VolumetricLight_Spot,
 		PS_VolumetricLight_Point,
@@ -138,7 +147,14 @@ namespace adria
 		Billboard,
 		GBufferPBR,
 		GBufferPBR_Mask,
+		GBufferPBR_Compressed,
+		GBufferPBR_Mask_Compressed,
+		GBufferPBR_Instanced,
+		GBufferPBR_Mask_Instanced,
+		GBufferPBR_Compressed_Instanced,
+		GBufferPBR_Mask_Compressed_Instanced,
 		GBuffer_Terrain,
+		GBuffer_Terrain_CDLOD,
 		AmbientPBR,
 		AmbientPBR_AO,
 		AmbientPBR_IBL,
@@ -154,6 +170,9 @@ namespace adria
 		Add,
 		DepthMap,
 		DepthMap_Transparent,
+		DepthMap_Foliage,
+		DepthMap_Compressed,
+		DepthMap_Transparent_Compressed,
 		Volumetric_Directional,
 		Volumetric_DirectionalCascades,
 		Volumetric_Spot,
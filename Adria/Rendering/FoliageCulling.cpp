@@ -0,0 +1,163 @@
+#include <execution>
+#include <numeric>
+#include "FoliageCulling.h"
+#include "Utilities/Random.h"
+#include "Utilities/Timer.h"
+#include "Logging/Logger.h"
+
+namespace adria
+{
+	namespace
+	{
+		float DistanceToBox(Vector3 const& p, BoundingBox const& box)
+		{
+			Vector3 const center(box.Center);
+			Vector3 const extents(box.Extents);
+			Vector3 const d(std::max(std::abs(p.x - center.x) - extents.x, 0.0f),
+							std::max(std::abs(p.y - center.y) - extents.y, 0.0f),
+							std::max(std::abs(p.z - center.z) - extents.z, 0.0f));
+			return d.Length();
+		}
+	}
+
+	namespace FoliageCulling
+	{
+		FoliageCellGrid BuildCells(std::vector<ScatterInstance> const& instances, BoundingBox const& instance_bounds, float cell_size, uint32 seed)
+		{
+			ADRIA_ASSERT(cell_size > 0.0f);
+			FoliageCellGrid grid{};
+			grid.cell_size = cell_size;
+			if (instances.empty()) return grid;
+
+			Timer t;
+			Vector2 grid_min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+			Vector2 grid_max(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+			for (ScatterInstance const& instance : instances)
+			{
+				grid_min = Vector2::Min(grid_min, Vector2(instance.position.x, instance.position.z));
+				grid_max = Vector2::Max(grid_max, Vector2(instance.position.x, instance.position.z));
+			}
+			uint64 const cell_count_x = (uint64)((grid_max.x - grid_min.x) / cell_size) + 1;
+			uint64 const cell_count_z = (uint64)((grid_max.y - grid_min.y) / cell_size) + 1;
+			auto CellIndex = [&](ScatterInstance const& instance)
+			{
+				uint64 x = std::min<uint64>((uint64)((instance.position.x - grid_min.x) / cell_size), cell_count_x - 1);
+				uint64 z = std::min<uint64>((uint64)((instance.position.z - grid_min.y) / cell_size), cell_count_z - 1);
+				return z * cell_count_x + x;
+			};
+
+			//counting sort by cell, stable so the result only depends on the input order
+			std::vector<uint32> offsets(cell_count_x * cell_count_z + 1, 0);
+			for (ScatterInstance const& instance : instances) ++offsets[CellIndex(instance) + 1];
+			std::inclusive_scan(std::begin(offsets), std::end(offsets), std::begin(offsets));
+
+			grid.instances.resize(instances.size());
+			std::vector<uint32> cursors(std::begin(offsets), std::end(offsets) - 1);
+			for (ScatterInstance const& instance : instances) grid.instances[cursors[CellIndex(instance)]++] = instance;
+
+			//rotation around y can point the footprint in any direction, so it's replaced by its bounding circle
+			Vector3 const local_min = Vector3(instance_bounds.Center) - Vector3(instance_bounds.Extents);
+			Vector3 const local_max = Vector3(instance_bounds.Center) + Vector3(instance_bounds.Extents);
+			float const radius_x = std::max(std::abs(local_min.x), std::abs(local_max.x));
+			float const radius_z = std::max(std::abs(local_min.z), std::abs(local_max.z));
+			float const radius = std::sqrt(radius_x * radius_x + radius_z * radius_z);
+
+			std::vector<FoliageCell> cells(offsets.size() - 1);
+			std::for_each(std::execution::par, std::begin(cells), std::end(cells), [&](FoliageCell& cell)
+				{
+					uint64 const cell_index = &cell - cells.data();
+					cell.first_instance = offsets[cell_index];
+					cell.instance_count = offsets[cell_index + 1] - offsets[cell_index];
+					if (cell.instance_count == 0) return;
+
+					ScatterInstance* cell_instances = grid.instances.data() + cell.first_instance;
+					CounterRandomGenerator rng(seed, cell_index);
+					for (uint32 i = cell.instance_count - 1; i > 0; --i)
+					{
+						std::swap(cell_instances[i], cell_instances[rng.NextInRange(0, i)]);
+					}
+
+					Vector3 cell_min(std::numeric_limits<float>::max());
+					Vector3 cell_max(std::numeric_limits<float>::lowest());
+					for (uint32 i = 0; i < cell.instance_count; ++i)
+					{
+						cell_min = Vector3::Min(cell_min, cell_instances[i].position);
+						cell_max = Vector3::Max(cell_max, cell_instances[i].position);
+					}
+					cell_min += Vector3(-radius, local_min.y, -radius);
+					cell_max += Vector3(radius, local_max.y, radius);
+					BoundingBox::CreateFromPoints(cell.bounds, cell_min, cell_max);
+				});
+
+			grid.cells.reserve(cells.size());
+			std::copy_if(std::begin(cells), std::end(cells), std::back_inserter(grid.cells), [](FoliageCell const& cell) { return cell.instance_count > 0; });
+
+			ADRIA_LOG(INFO, "Binned %llu foliage instances into %llu cells (%.1f instances per cell) in %f s",
+				(unsigned long long)grid.instances.size(), (unsigned long long)grid.cells.size(), grid.instances.size() / (float)grid.cells.size(), t.ElapsedInSeconds());
+			return grid;
+		}
+
+		BoundingBox GridBounds(FoliageCellGrid const& grid)
+		{
+			if (grid.cells.empty()) return BoundingBox();
+			BoundingBox bounds = grid.cells[0].bounds;
+			for (FoliageCell const& cell : grid.cells) BoundingBox::CreateMerged(bounds, bounds, cell.bounds);
+			return bounds;
+		}
+
+		float CellDensity(FoliageLod const& lod, float distance)
+		{
+			if (distance <= lod.density_start) return 1.0f;
+			if (distance >= lod.density_end) return lod.min_density;
+			float const alpha = (distance - lod.density_start) / (lod.density_end - lod.density_start);
+			return 1.0f + alpha * (lod.min_density - 1.0f);
+		}
+
+		uint32 CullAndCompact(FoliageCellGrid const& grid, FoliageVisibilityTest const& is_visible,
+			Vector3 const& view_position, FoliageLod const& lod, std::span<float const> level_distances,
+			std::span<ScatterInstance> output, std::span<uint32> level_instance_counts)
+		{
+			uint32 const level_count = std::max<uint32>((uint32)level_distances.size(), 1);
+			ADRIA_ASSERT(output.size() >= grid.instances.size());
+			ADRIA_ASSERT(level_instance_counts.size() >= level_count);
+			uint64 const cell_count = grid.cells.size();
+
+			std::vector<uint32> counts(cell_count, 0);
+			std::vector<uint32> levels(cell_count, 0);
+			std::for_each(std::execution::par, std::begin(grid.cells), std::end(grid.cells), [&](FoliageCell const& cell)
+				{
+					uint64 const cell_index = &cell - grid.cells.data();
+					float const distance = DistanceToBox(view_position, cell.bounds);
+					if (distance > lod.cull_distance || !is_visible(cell.bounds)) return;
+					uint32 const count = (uint32)std::ceil(CellDensity(lod, distance) * cell.instance_count);
+					counts[cell_index] = std::min(count, cell.instance_count);
+
+					uint32 level = 0;
+					while (level + 1 < level_count && distance >= level_distances[level + 1]) ++level;
+					levels[cell_index] = level;
+				});
+
+			//cells of a level are written one after the other, so every level is one instance range
+			std::fill_n(std::begin(level_instance_counts), level_count, 0u);
+			for (uint64 i = 0; i < cell_count; ++i) level_instance_counts[levels[i]] += counts[i];
+			std::vector<uint32> level_offsets(level_count);
+			std::exclusive_scan(std::begin(level_instance_counts), std::begin(level_instance_counts) + level_count, std::begin(level_offsets), 0u);
+
+			std::vector<uint32> offsets(cell_count);
+			for (uint64 i = 0; i < cell_count; ++i)
+			{
+				offsets[i] = level_offsets[levels[i]];
+				level_offsets[levels[i]] += counts[i];
+			}
+
+			std::for_each(std::execution::par, std::begin(grid.cells), std::end(grid.cells), [&](FoliageCell const& cell)
+				{
+					uint64 const cell_index = &cell - grid.cells.data();
+					if (counts[cell_index] == 0) return;
+					auto first = std::begin(grid.instances) + cell.first_instance;
+					std::copy(first, first + counts[cell_index], std::begin(output) + offsets[cell_index]);
+				});
+			return level_offsets.back();
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <functional>
+#include "Scatter.h"
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	struct FoliageCell
+	{
+		BoundingBox bounds;
+		uint32 first_instance;
+		uint32 instance_count;
+	};
+
+	/* Scattered instances binned into square cells on the xz plane. Instances of a cell are stored contiguously
+	   and shuffled, so any prefix of a cell is a uniformly thinned subset of it, which is what the density LOD draws. */
+	struct FoliageCellGrid
+	{
+		std::vector<FoliageCell> cells;
+		std::vector<ScatterInstance> instances;
+		float cell_size = 0.0f;
+	};
+
+	struct FoliageLod
+	{
+		float density_start = 50.0f;	//full density up to this distance
+		float density_end = 200.0f;		//density reaches min_density at this distance
+		float min_density = 0.1f;
+		float cull_distance = 300.0f;	//cells farther away are not drawn
+	};
+
+	using FoliageVisibilityTest = std::function<bool(BoundingBox const&)>;
+
+	//backend independent, so the cells can be built and culled without a device
+	namespace FoliageCulling
+	{
+		//instance_bounds are the scaled bounds of a single instance around its position, before its rotation around y
+		FoliageCellGrid BuildCells(std::vector<ScatterInstance> const& instances, BoundingBox const& instance_bounds, float cell_size, uint32 seed);
+
+		BoundingBox GridBounds(FoliageCellGrid const& grid);
+
+		//fraction of a cell's instances drawn at the given distance from the viewer
+		float CellDensity(FoliageLod const& lod, float distance);
+
+		/* Culls the cells with is_visible and the lod distances and writes the selected instances of the visible cells
+		   into output, which has to hold grid.instances.size() elements. Returns the number of instances written.
+		   A cell draws mesh level l when its distance is at least level_distances[l] and below level_distances[l + 1],
+		   level_distances is ascending and starts with 0, empty when the mesh has a single level. Instances are grouped by level,
+		   level_instance_counts receives the size of each group. */
+		uint32 CullAndCompact(FoliageCellGrid const& grid, FoliageVisibilityTest const& is_visible,
+			Vector3 const& view_position, FoliageLod const& lod, std::span<float const> level_distances,
+			std::span<ScatterInstance> output, std::span<uint32> level_instance_counts);
+	}
+}
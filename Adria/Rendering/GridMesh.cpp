@@ -0,0 +1,85 @@
+#include <execution>
+#include <numeric>
+#include "GridMesh.h"
+#include "Math/BoundingVolumeHelpers.h"
+#include "Utilities/Heightmap.h"
+
+namespace adria
+{
+	namespace GridMeshBuilder
+	{
+		GridMesh Build(GridMeshDesc const& desc, Heightmap const* heightmap)
+		{
+			int64 const vertex_count_x = (int64)desc.tile_count_x + 1;
+			int64 const vertex_count_z = (int64)desc.tile_count_z + 1;
+			if (heightmap)
+			{
+				ADRIA_ASSERT(heightmap->Width() == (uint64)vertex_count_x);
+				ADRIA_ASSERT(heightmap->Depth() == (uint64)vertex_count_z);
+			}
+			auto HeightAt = [heightmap](int64 i, int64 j)
+			{
+				return heightmap ? heightmap->HeightAt(i, j) : 0.0f;
+			};
+
+			GridMesh mesh{};
+			mesh.vertices.resize(vertex_count_x * vertex_count_z);
+			std::vector<int64> rows(vertex_count_z);
+			std::iota(std::begin(rows), std::end(rows), 0);
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](int64 j)
+				{
+					int64 const j_prev = std::max<int64>(j - 1, 0);
+					int64 const j_next = std::min<int64>(j + 1, vertex_count_z - 1);
+					for (int64 i = 0; i < vertex_count_x; ++i)
+					{
+						int64 const i_prev = std::max<int64>(i - 1, 0);
+						int64 const i_next = std::min<int64>(i + 1, vertex_count_x - 1);
+
+						TexturedNormalVertex& vertex = mesh.vertices[j * vertex_count_x + i];
+						vertex.position = Vector3(i * desc.tile_size_x + desc.offset.x, HeightAt(i, j) + desc.offset.y, j * desc.tile_size_z + desc.offset.z);
+						vertex.uv = Vector2(i * 1.0f * desc.texture_scale_x / (desc.tile_count_x - 1), j * 1.0f * desc.texture_scale_z / (desc.tile_count_z - 1));
+
+						float dx = (HeightAt(i_next, j) - HeightAt(i_prev, j)) / ((i_next - i_prev) * desc.tile_size_x);
+						float dz = (HeightAt(i, j_next) - HeightAt(i, j_prev)) / ((j_next - j_prev) * desc.tile_size_z);
+						vertex.normal = Vector3(-dx, 1.0f, -dz);
+						vertex.normal.Normalize();
+					}
+				});
+
+			uint64 pool_vertex_count = 0;
+			for (uint64 j = 0; j < desc.tile_count_z; j += desc.chunk_tiles_z)
+			{
+				for (uint64 i = 0; i < desc.tile_count_x; i += desc.chunk_tiles_x)
+				{
+					GridChunk& chunk = mesh.chunks.emplace_back();
+					chunk.tiles_x = std::min(desc.chunk_tiles_x, desc.tile_count_x - i);
+					chunk.tiles_z = std::min(desc.chunk_tiles_z, desc.tile_count_z - j);
+					chunk.first_tile_x = i;
+					chunk.first_tile_z = j;
+					chunk.first_vertex = pool_vertex_count;
+					pool_vertex_count += (chunk.tiles_x + 1) * (chunk.tiles_z + 1);
+				}
+			}
+
+			bool const single_chunk = mesh.chunks.size() == 1;
+			if (!single_chunk) mesh.pooled_vertices.resize(pool_vertex_count);
+			std::vector<TexturedNormalVertex> const& chunk_vertices = mesh.ChunkVertices();
+			std::for_each(std::execution::par, std::begin(mesh.chunks), std::end(mesh.chunks), [&](GridChunk& chunk)
+				{
+					uint64 const chunk_vertex_count = (chunk.tiles_x + 1) * (chunk.tiles_z + 1);
+					if (!single_chunk)
+					{
+						TexturedNormalVertex* dst = mesh.pooled_vertices.data() + chunk.first_vertex;
+						for (uint64 k = 0; k <= chunk.tiles_z; ++k)
+						{
+							TexturedNormalVertex const* src = mesh.vertices.data() + (chunk.first_tile_z + k) * vertex_count_x + chunk.first_tile_x;
+							std::copy_n(src, chunk.tiles_x + 1, dst + k * (chunk.tiles_x + 1));
+						}
+					}
+					auto chunk_begin = chunk_vertices.begin() + chunk.first_vertex;
+					chunk.bounding_box = AABBFromRange(chunk_begin, chunk_begin + chunk_vertex_count);
+				});
+			return mesh;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <DirectXCollision.h>
+#include "Core/CoreTypes.h"
+#include "Graphics/GfxVertexFormat.h"
+
+namespace adria
+{
+	class Heightmap;
+
+	struct GridMeshDesc
+	{
+		uint64 tile_count_x;
+		uint64 tile_count_z;
+		float tile_size_x;
+		float tile_size_z;
+		float texture_scale_x;
+		float texture_scale_z;
+		uint64 chunk_tiles_x;		//tiles per side of a chunk, the chunks at the far borders get what is left
+		uint64 chunk_tiles_z;
+		Vector3 offset = Vector3(0.0f, 0.0f, 0.0f);
+	};
+
+	//its (tiles_x + 1) * (tiles_z + 1) vertices are contiguous in the chunk vertices, rows along x
+	struct GridChunk
+	{
+		uint64 tiles_x;
+		uint64 tiles_z;
+		uint64 first_tile_x;
+		uint64 first_tile_z;
+		uint64 first_vertex;
+		BoundingBox bounding_box;
+	};
+
+	struct GridMesh
+	{
+		std::vector<TexturedNormalVertex> vertices;			//(tile_count_x + 1) * (tile_count_z + 1), rows along x
+		std::vector<TexturedNormalVertex> pooled_vertices;	//the vertices of every chunk back to back, empty if there is a single chunk
+		std::vector<GridChunk> chunks;
+
+		//what the chunks are drawn from with a base vertex offset
+		std::vector<TexturedNormalVertex> const& ChunkVertices() const { return chunks.size() == 1 ? vertices : pooled_vertices; }
+	};
+
+	/* backend independent, builds the vertices of a grid on the CPU so they can be built without a device. Normals come from central
+	   differences of the height field, one sided at the borders. Every chunk gets its own vertices in one pooled vertex buffer so all
+	   chunks with the same tile counts share one index buffer, 16-bit whenever a chunk has at most 64k vertices. */
+	namespace GridMeshBuilder
+	{
+		//a flat grid without a heightmap, otherwise the heightmap has a sample per vertex
+		GridMesh Build(GridMeshDesc const& desc, Heightmap const* heightmap);
+
+		//two triangles per tile of a chunk, indices relative to its first vertex
+		template<typename Index>
+		void BuildChunkIndices(uint64 tiles_x, uint64 tiles_z, std::vector<Index>& indices)
+		{
+			indices.clear();
+			indices.reserve(tiles_x * tiles_z * 6);
+			for (uint64 k = 0; k < tiles_z; ++k)
+			{
+				for (uint64 m = 0; m < tiles_x; ++m)
+				{
+					Index i1 = static_cast<Index>(k * (tiles_x + 1) + m);
+					Index i2 = static_cast<Index>(i1 + 1);
+					Index i3 = static_cast<Index>((k + 1) * (tiles_x + 1) + m);
+					Index i4 = static_cast<Index>(i3 + 1);
+
+					indices.push_back(i1);
+					indices.push_back(i3);
+					indices.push_back(i2);
+
+					indices.push_back(i2);
+					indices.push_back(i3);
+					indices.push_back(i4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,526 @@
+#include <execution>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include "IBLBaking.h"
+#include "DDSFile.h"
+#include "Utilities/Timer.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr float PI = 3.14159265f;
+		static constexpr float TWO_PI = 2.0f * PI;
+		static constexpr uint32 DDS_FORMAT_R16G16B16A16_FLOAT = 10;
+		static constexpr uint32 DDS_FORMAT_R16G16_FLOAT = 34;
+		static constexpr uint32 IRRADIANCE_SH_MAGIC = 0x39485341; //"ASH9"
+		static constexpr uint32 IRRADIANCE_SH_VERSION = 1;
+		static constexpr uint32 IRRADIANCE_PROJECTION_SIZE = 64;
+
+		struct Direction
+		{
+			float x, y, z;
+		};
+
+		Direction Normalize(Direction const& d)
+		{
+			float const inv_length = 1.0f / std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+			return Direction{ d.x * inv_length, d.y * inv_length, d.z * inv_length };
+		}
+
+		Direction Cross(Direction const& a, Direction const& b)
+		{
+			return Direction{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		//u and v go from -1 to 1, v up. Same directions as GetSamplingVector in Equirect2cubeCS
+		Direction FaceDirection(uint32 face, float u, float v)
+		{
+			switch (face)
+			{
+			case 0: return Normalize(Direction{ 1.0f, v, -u });
+			case 1: return Normalize(Direction{ -1.0f, v, u });
+			case 2: return Normalize(Direction{ u, 1.0f, -v });
+			case 3: return Normalize(Direction{ u, -1.0f, v });
+			case 4: return Normalize(Direction{ u, v, 1.0f });
+			default: return Normalize(Direction{ -u, v, -1.0f });
+			}
+		}
+
+		float FaceCoordinate(uint32 texel, uint32 size)
+		{
+			return 2.0f * (texel + 0.5f) / size - 1.0f;
+		}
+
+		Direction TexelDirection(uint32 face, uint32 x, uint32 y, uint32 size)
+		{
+			return FaceDirection(face, FaceCoordinate(x, size), -FaceCoordinate(y, size));
+		}
+
+		//s and t go from 0 to 1 over the face, t down as in texture coordinates
+		void DirectionToFace(Direction const& d, uint32& face, float& s, float& t)
+		{
+			float const ax = std::abs(d.x), ay = std::abs(d.y), az = std::abs(d.z);
+			float u, v, major;
+			if (ax >= ay && ax >= az)
+			{
+				face = d.x > 0.0f ? 0 : 1;
+				major = ax;
+				u = d.x > 0.0f ? -d.z : d.z;
+				v = d.y;
+			}
+			else if (ay >= az)
+			{
+				face = d.y > 0.0f ? 2 : 3;
+				major = ay;
+				u = d.x;
+				v = d.y > 0.0f ? -d.z : d.z;
+			}
+			else
+			{
+				face = d.z > 0.0f ? 4 : 5;
+				major = az;
+				u = d.z > 0.0f ? d.x : -d.x;
+				v = d.y;
+			}
+			s = 0.5f * (u / major + 1.0f);
+			t = 0.5f * (1.0f - v / major);
+		}
+
+		//bilinear, clamped to the edges of the face
+		void SampleFace(std::vector<float> const& texels, uint32 size, float s, float t, float rgb[3])
+		{
+			float const x = std::clamp(s * size - 0.5f, 0.0f, size - 1.0f);
+			float const y = std::clamp(t * size - 0.5f, 0.0f, size - 1.0f);
+			uint32 const x0 = (uint32)x, y0 = (uint32)y;
+			uint32 const x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+			float const fx = x - x0, fy = y - y0;
+			float const* t00 = &texels[((size_t)y0 * size + x0) * 4];
+			float const* t10 = &texels[((size_t)y0 * size + x1) * 4];
+			float const* t01 = &texels[((size_t)y1 * size + x0) * 4];
+			float const* t11 = &texels[((size_t)y1 * size + x1) * 4];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				float const top = t00[c] + (t10[c] - t00[c]) * fx;
+				float const bottom = t01[c] + (t11[c] - t01[c]) * fx;
+				rgb[c] = top + (bottom - top) * fy;
+			}
+		}
+
+		//trilinear between the two mips around lod
+		void SampleCubemap(CubemapImage const& cubemap, Direction const& d, float lod, float rgb[3])
+		{
+			uint32 face;
+			float s, t;
+			DirectionToFace(d, face, s, t);
+
+			lod = std::clamp(lod, 0.0f, (float)(cubemap.mip_count - 1));
+			uint32 const mip = (uint32)lod, next_mip = std::min(mip + 1, cubemap.mip_count - 1);
+			float const blend = lod - mip;
+			SampleFace(cubemap.Texels(face, mip), cubemap.MipSize(mip), s, t, rgb);
+			if (blend > 0.0f && next_mip != mip)
+			{
+				float next_rgb[3];
+				SampleFace(cubemap.Texels(face, next_mip), cubemap.MipSize(next_mip), s, t, next_rgb);
+				for (uint32 c = 0; c < 3; ++c) rgb[c] += (next_rgb[c] - rgb[c]) * blend;
+			}
+		}
+
+		//bilinear, wrapping around horizontally. Same mapping as Equirect2cubeCS
+		void SampleEquirect(std::span<float const> equirect, uint32 width, uint32 height, Direction const& d, float rgb[3])
+		{
+			float const phi = std::atan2(d.z, d.x);
+			float const theta = std::acos(std::clamp(d.y, -1.0f, 1.0f));
+			float const x = phi / TWO_PI * width - 0.5f;
+			float const y = std::clamp(theta / PI * height - 0.5f, 0.0f, height - 1.0f);
+			float const floor_x = std::floor(x);
+			uint32 const x0 = (uint32)(((int64)floor_x % (int64)width + width) % width), x1 = (x0 + 1) % width;
+			uint32 const y0 = (uint32)y, y1 = std::min(y0 + 1, height - 1);
+			float const fx = x - floor_x, fy = y - y0;
+			float const* t00 = &equirect[((size_t)y0 * width + x0) * 4];
+			float const* t10 = &equirect[((size_t)y0 * width + x1) * 4];
+			float const* t01 = &equirect[((size_t)y1 * width + x0) * 4];
+			float const* t11 = &equirect[((size_t)y1 * width + x1) * 4];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				float const top = t00[c] + (t10[c] - t00[c]) * fx;
+				float const bottom = t01[c] + (t11[c] - t01[c]) * fx;
+				rgb[c] = top + (bottom - top) * fy;
+			}
+		}
+
+		CubemapImage AllocateCubemap(uint32 size, uint32 mip_count)
+		{
+			CubemapImage cubemap{};
+			cubemap.size = size;
+			cubemap.mip_count = mip_count;
+			cubemap.subresources.resize(6 * mip_count);
+			for (uint32 face = 0; face < 6; ++face)
+				for (uint32 mip = 0; mip < mip_count; ++mip) cubemap.Texels(face, mip).resize((size_t)cubemap.MipSize(mip) * cubemap.MipSize(mip) * 4);
+			return cubemap;
+		}
+
+		//calls row_fn(face, y, size) for every row of every face of a mip in parallel
+		template<typename F>
+		void ForEachFaceRow(uint32 size, F&& row_fn)
+		{
+			std::vector<uint32> rows(6 * size);
+			std::iota(std::begin(rows), std::end(rows), 0);
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint32 row) { row_fn(row / size, row % size); });
+		}
+
+		//box filtered, every mip from the one above it
+		void GenerateMips(CubemapImage& cubemap)
+		{
+			for (uint32 mip = 1; mip < cubemap.mip_count; ++mip)
+			{
+				uint32 const size = cubemap.MipSize(mip), source_size = cubemap.MipSize(mip - 1);
+				ForEachFaceRow(size, [&](uint32 face, uint32 y)
+					{
+						std::vector<float> const& source = cubemap.Texels(face, mip - 1);
+						float* output = &cubemap.Texels(face, mip)[(size_t)y * size * 4];
+						uint32 const y0 = std::min(y * 2, source_size - 1), y1 = std::min(y * 2 + 1, source_size - 1);
+						for (uint32 x = 0; x < size; ++x)
+						{
+							uint32 const x0 = std::min(x * 2, source_size - 1), x1 = std::min(x * 2 + 1, source_size - 1);
+							for (uint32 c = 0; c < 4; ++c)
+							{
+								output[x * 4 + c] = 0.25f * (source[((size_t)y0 * source_size + x0) * 4 + c] + source[((size_t)y0 * source_size + x1) * 4 + c] +
+									source[((size_t)y1 * source_size + x0) * 4 + c] + source[((size_t)y1 * source_size + x1) * 4 + c]);
+							}
+						}
+					});
+			}
+		}
+
+		uint32 FullMipCount(uint32 size)
+		{
+			uint32 mip_count = 1;
+			while (size >> mip_count) ++mip_count;
+			return mip_count;
+		}
+
+		float RadicalInverse(uint32 bits)
+		{
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			return float(bits) * 2.3283064365386963e-10f;
+		}
+
+		//half vector in tangent space, for the i-th point of a Hammersley set
+		Direction SampleGGX(uint32 i, uint32 sample_count, float roughness)
+		{
+			float const u1 = (float)i / sample_count, u2 = RadicalInverse(i);
+			float const alpha = roughness * roughness;
+			float const cos_theta = std::sqrt((1.0f - u2) / (1.0f + (alpha * alpha - 1.0f) * u2));
+			float const sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+			float const phi = TWO_PI * u1;
+			return Direction{ sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta };
+		}
+
+		float NdfGGX(float cos_lh, float roughness)
+		{
+			float const alpha = roughness * roughness;
+			float const alpha_sq = alpha * alpha;
+			float const denominator = cos_lh * cos_lh * (alpha_sq - 1.0f) + 1.0f;
+			return alpha_sq / (PI * denominator * denominator);
+		}
+
+		float SchlickG1(float cos_theta, float k)
+		{
+			return cos_theta / (cos_theta * (1.0f - k) + k);
+		}
+
+		void EvaluateSHBasis(Direction const& d, float basis[9])
+		{
+			basis[0] = 0.282095f;
+			basis[1] = 0.488603f * d.y;
+			basis[2] = 0.488603f * d.z;
+			basis[3] = 0.488603f * d.x;
+			basis[4] = 1.092548f * d.x * d.y;
+			basis[5] = 1.092548f * d.y * d.z;
+			basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+			basis[7] = 1.092548f * d.x * d.z;
+			basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+		}
+
+		uint16 FloatToHalf(float value)
+		{
+			uint32 bits;
+			memcpy(&bits, &value, sizeof(bits));
+			uint32 const sign = (bits >> 16) & 0x8000;
+			uint32 const float_exponent = (bits >> 23) & 0xFF;
+			uint32 mantissa = bits & 0x7FFFFF;
+			if (float_exponent == 0xFF) return (uint16)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+			int32 const exponent = (int32)float_exponent - 127 + 15;
+			if (exponent >= 31) return (uint16)(sign | 0x7BFF);	//clamped to the largest half rather than infinity, a bright sun shouldn't poison the mips
+			if (exponent <= 0)
+			{
+				if (exponent < -10) return (uint16)sign;
+				mantissa |= 0x800000;
+				uint32 const shift = (uint32)(14 - exponent);
+				uint32 half = mantissa >> shift;
+				if ((mantissa >> (shift - 1)) & 1) ++half;
+				return (uint16)(sign | half);
+			}
+			uint32 half = sign | ((uint32)exponent << 10) | (mantissa >> 13);
+			if (mantissa & 0x1000) ++half;
+			return (uint16)std::min(half, sign | 0x7BFF);
+		}
+	}
+
+	namespace IBLBaking
+	{
+		CubemapImage EquirectToCubemap(std::span<float const> equirect, uint32 width, uint32 height, uint32 size)
+		{
+			ADRIA_ASSERT(equirect.size() == (size_t)width * height * 4);
+			CubemapImage cubemap = AllocateCubemap(size, FullMipCount(size));
+			ForEachFaceRow(size, [&](uint32 face, uint32 y)
+				{
+					float* output = &cubemap.Texels(face, 0)[(size_t)y * size * 4];
+					for (uint32 x = 0; x < size; ++x)
+					{
+						SampleEquirect(equirect, width, height, TexelDirection(face, x, y, size), &output[x * 4]);
+						output[x * 4 + 3] = 1.0f;
+					}
+				});
+			GenerateMips(cubemap);
+			return cubemap;
+		}
+
+		CubemapImage PrefilterSpecular(CubemapImage const& environment, uint32 size, uint32 mip_count, uint32 sample_count)
+		{
+			struct SpecularSample
+			{
+				Direction direction;	//in tangent space, around +z
+				float weight;
+				float lod;
+			};
+
+			CubemapImage specular = AllocateCubemap(size, std::min(mip_count, FullMipCount(size)));
+			float const texel_solid_angle = 4.0f * PI / (6.0f * environment.size * environment.size);
+			std::vector<SpecularSample> samples;
+			for (uint32 mip = 0; mip < specular.mip_count; ++mip)
+			{
+				uint32 const mip_size = specular.MipSize(mip);
+				float const roughness = specular.mip_count > 1 ? (float)mip / (specular.mip_count - 1) : 0.0f;
+
+				//the view direction is the normal, so the samples are the same for every texel. Each one reads the mip whose texels
+				//cover about the solid angle it stands for, which keeps a few hundred samples free of fireflies
+				samples.clear();
+				if (roughness == 0.0f) samples.push_back(SpecularSample{ .direction = { 0.0f, 0.0f, 1.0f }, .weight = 1.0f, .lod = std::log2((float)environment.size / mip_size) });
+				else for (uint32 i = 0; i < sample_count; ++i)
+				{
+					Direction const lh = SampleGGX(i, sample_count, roughness);
+					Direction const li{ 2.0f * lh.z * lh.x, 2.0f * lh.z * lh.y, 2.0f * lh.z * lh.z - 1.0f };
+					if (li.z <= 0.0f) continue;
+					float const pdf = NdfGGX(lh.z, roughness) * 0.25f;
+					float const sample_solid_angle = 1.0f / (sample_count * pdf + 1e-4f);
+					samples.push_back(SpecularSample{ .direction = li, .weight = li.z, .lod = std::max(0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f, 0.0f) });
+				}
+				float const weight_sum = std::accumulate(std::begin(samples), std::end(samples), 0.0f, [](float sum, SpecularSample const& sample) { return sum + sample.weight; });
+
+				ForEachFaceRow(mip_size, [&](uint32 face, uint32 y)
+					{
+						float* output = &specular.Texels(face, mip)[(size_t)y * mip_size * 4];
+						for (uint32 x = 0; x < mip_size; ++x)
+						{
+							Direction const n = TexelDirection(face, x, y, mip_size);
+							Direction s = Cross(n, Direction{ 0.0f, 1.0f, 0.0f });
+							if (s.x * s.x + s.y * s.y + s.z * s.z < 1e-3f) s = Cross(n, Direction{ 1.0f, 0.0f, 0.0f });
+							s = Normalize(s);
+							Direction const t = Cross(n, s);
+
+							float color[3] = { 0.0f, 0.0f, 0.0f };
+							for (SpecularSample const& sample : samples)
+							{
+								Direction const& l = sample.direction;
+								Direction const li{ s.x * l.x + t.x * l.y + n.x * l.z, s.y * l.x + t.y * l.y + n.y * l.z, s.z * l.x + t.z * l.y + n.z * l.z };
+								float rgb[3];
+								SampleCubemap(environment, li, sample.lod, rgb);
+								for (uint32 c = 0; c < 3; ++c) color[c] += rgb[c] * sample.weight;
+							}
+							for (uint32 c = 0; c < 3; ++c) output[x * 4 + c] = color[c] / weight_sum;
+							output[x * 4 + 3] = 1.0f;
+						}
+					});
+			}
+			return specular;
+		}
+
+		IrradianceSH ProjectIrradiance(CubemapImage const& environment)
+		{
+			uint32 mip = 0;
+			while (mip + 1 < environment.mip_count && environment.MipSize(mip) > IRRADIANCE_PROJECTION_SIZE) ++mip;
+			uint32 const size = environment.MipSize(mip);
+
+			//every row sums into its own slot, so the rows are projected in parallel and reduced afterwards
+			std::vector<std::array<double, 28>> row_sums(6 * size);
+			ForEachFaceRow(size, [&](uint32 face, uint32 y)
+				{
+					std::array<double, 28>& sums = row_sums[face * size + y];
+					sums.fill(0.0);
+					std::vector<float> const& texels = environment.Texels(face, mip);
+					float const v = -FaceCoordinate(y, size);
+					for (uint32 x = 0; x < size; ++x)
+					{
+						float const u = FaceCoordinate(x, size);
+						float const solid_angle = 4.0f / ((float)size * size * std::pow(1.0f + u * u + v * v, 1.5f));
+						float basis[9];
+						EvaluateSHBasis(FaceDirection(face, u, v), basis);
+						float const* texel = &texels[((size_t)y * size + x) * 4];
+						for (uint32 i = 0; i < 9; ++i)
+							for (uint32 c = 0; c < 3; ++c) sums[i * 3 + c] += (double)texel[c] * basis[i] * solid_angle;
+						sums[27] += solid_angle;
+					}
+				});
+
+			std::array<double, 28> sums{};
+			for (auto const& row : row_sums)
+				for (uint32 i = 0; i < 28; ++i) sums[i] += row[i];
+
+			//the texel solid angles only add up to 4 pi approximately. Convolving with the cosine lobe scales every band
+			double const normalization = 4.0 * PI / sums[27];
+			double const band_factors[3] = { PI, 2.0 * PI / 3.0, PI / 4.0 };
+			IrradianceSH sh{};
+			for (uint32 i = 0; i < 9; ++i)
+			{
+				uint32 const band = i == 0 ? 0 : (i < 4 ? 1 : 2);
+				for (uint32 c = 0; c < 3; ++c) sh.coefficients[i][c] = (float)(sums[i * 3 + c] * normalization * band_factors[band]);
+			}
+			return sh;
+		}
+
+		CubemapImage EvaluateIrradiance(IrradianceSH const& sh, uint32 size)
+		{
+			CubemapImage irradiance = AllocateCubemap(size, 1);
+			ForEachFaceRow(size, [&](uint32 face, uint32 y)
+				{
+					float* output = &irradiance.Texels(face, 0)[(size_t)y * size * 4];
+					for (uint32 x = 0; x < size; ++x)
+					{
+						float basis[9];
+						EvaluateSHBasis(TexelDirection(face, x, y, size), basis);
+						for (uint32 c = 0; c < 3; ++c)
+						{
+							float value = 0.0f;
+							for (uint32 i = 0; i < 9; ++i) value += sh.coefficients[i][c] * basis[i];
+							output[x * 4 + c] = std::max(value, 0.0f) / PI;
+						}
+						output[x * 4 + 3] = 1.0f;
+					}
+				});
+			return irradiance;
+		}
+
+		std::vector<float> IntegrateSpecularBRDF(uint32 size, uint32 sample_count)
+		{
+			std::vector<float> lut((size_t)size * size * 2);
+			std::vector<uint32> rows(size);
+			std::iota(std::begin(rows), std::end(rows), 0);
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint32 y)
+				{
+					float const roughness = (y + 0.5f) / size;
+					float const k = roughness * roughness / 2.0f;
+					for (uint32 x = 0; x < size; ++x)
+					{
+						float const cos_lo = std::max((x + 0.5f) / size, 0.001f);
+						Direction const lo{ std::sqrt(1.0f - cos_lo * cos_lo), 0.0f, cos_lo };
+						float dfg1 = 0.0f, dfg2 = 0.0f;
+						for (uint32 i = 0; i < sample_count; ++i)
+						{
+							Direction const lh = SampleGGX(i, sample_count, roughness);
+							float const lo_dot_lh = lo.x * lh.x + lo.y * lh.y + lo.z * lh.z;
+							float const cos_li = 2.0f * lo_dot_lh * lh.z - lo.z;
+							if (cos_li <= 0.0f) continue;
+							float const cos_lo_lh = std::max(lo_dot_lh, 0.0f);
+							float const g = SchlickG1(cos_li, k) * SchlickG1(cos_lo, k);
+							float const gv = g * cos_lo_lh / (lh.z * cos_lo);
+							float const fc = std::pow(1.0f - cos_lo_lh, 5.0f);
+							dfg1 += (1.0f - fc) * gv;
+							dfg2 += fc * gv;
+						}
+						lut[((size_t)y * size + x) * 2 + 0] = dfg1 / sample_count;
+						lut[((size_t)y * size + x) * 2 + 1] = dfg2 / sample_count;
+					}
+				});
+			return lut;
+		}
+
+		IBLBakeResult Bake(std::span<float const> equirect, uint32 width, uint32 height, IBLBakeDesc const& desc)
+		{
+			Timer timer;
+			IBLBakeResult result{};
+			result.environment = EquirectToCubemap(equirect, width, height, desc.environment_size);
+			result.specular = PrefilterSpecular(result.environment, std::min(desc.specular_size, desc.environment_size), desc.specular_mip_count, desc.specular_sample_count);
+			result.irradiance = ProjectIrradiance(result.environment);
+			result.bake_time = timer.ElapsedInSeconds();
+			return result;
+		}
+
+		std::vector<uint8> WriteCubemapDDS(CubemapImage const& cubemap)
+		{
+			size_t texel_count = 0;
+			for (auto const& subresource : cubemap.subresources) texel_count += subresource.size();
+
+			std::vector<uint8> dds;
+			dds.reserve(DDSFile::DATA_OFFSET + texel_count * sizeof(uint16));
+			DDSFile::WriteHeaders(DDSFileDesc{ .dxgi_format = DDS_FORMAT_R16G16B16A16_FLOAT, .width = cubemap.size, .height = cubemap.size,
+				.mip_count = cubemap.mip_count, .cubemap = true }, dds);
+			dds.resize(DDSFile::DATA_OFFSET + texel_count * sizeof(uint16));
+			uint8* output = dds.data() + DDSFile::DATA_OFFSET;
+			for (auto const& subresource : cubemap.subresources)
+			{
+				for (float value : subresource)
+				{
+					uint16 const half = FloatToHalf(value);
+					memcpy(output, &half, sizeof(half));
+					output += sizeof(half);
+				}
+			}
+			return dds;
+		}
+
+		std::vector<uint8> WriteSpecularBRDFDDS(std::span<float const> lut, uint32 size)
+		{
+			ADRIA_ASSERT(lut.size() == (size_t)size * size * 2);
+			std::vector<uint8> dds;
+			dds.reserve(DDSFile::DATA_OFFSET + lut.size() * sizeof(uint16));
+			DDSFile::WriteHeaders(DDSFileDesc{ .dxgi_format = DDS_FORMAT_R16G16_FLOAT, .width = size, .height = size }, dds);
+			dds.resize(DDSFile::DATA_OFFSET + lut.size() * sizeof(uint16));
+			uint8* output = dds.data() + DDSFile::DATA_OFFSET;
+			for (float value : lut)
+			{
+				uint16 const half = FloatToHalf(value);
+				memcpy(output, &half, sizeof(half));
+				output += sizeof(half);
+			}
+			return dds;
+		}
+
+		std::vector<uint8> WriteIrradianceSH(IrradianceSH const& sh)
+		{
+			std::vector<uint8> data(2 * sizeof(uint32) + sizeof(sh.coefficients));
+			memcpy(data.data(), &IRRADIANCE_SH_MAGIC, sizeof(uint32));
+			memcpy(data.data() + sizeof(uint32), &IRRADIANCE_SH_VERSION, sizeof(uint32));
+			memcpy(data.data() + 2 * sizeof(uint32), sh.coefficients, sizeof(sh.coefficients));
+			return data;
+		}
+
+		std::optional<IrradianceSH> ReadIrradianceSH(std::span<uint8 const> data)
+		{
+			IrradianceSH sh{};
+			if (data.size() != 2 * sizeof(uint32) + sizeof(sh.coefficients)) return std::nullopt;
+			uint32 magic, version;
+			memcpy(&magic, data.data(), sizeof(uint32));
+			memcpy(&version, data.data() + sizeof(uint32), sizeof(uint32));
+			if (magic != IRRADIANCE_SH_MAGIC || version != IRRADIANCE_SH_VERSION) return std::nullopt;
+			memcpy(sh.coefficients, data.data() + 2 * sizeof(uint32), sizeof(sh.coefficients));
+			return sh;
+		}
+	}
+}
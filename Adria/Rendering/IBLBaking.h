@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <optional>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	//rgba float texels of the faces of a cubemap with all their mips, faces are in D3D order: +x, -x, +y, -y, +z, -z
+	struct CubemapImage
+	{
+		uint32 size = 0;		//of the faces of the top mip
+		uint32 mip_count = 0;
+		std::vector<std::vector<float>> subresources;	//indexed by face * mip_count + mip
+
+		uint32 MipSize(uint32 mip) const { return std::max(size >> mip, 1u); }
+		std::vector<float>& Texels(uint32 face, uint32 mip) { return subresources[face * mip_count + mip]; }
+		std::vector<float> const& Texels(uint32 face, uint32 mip) const { return subresources[face * mip_count + mip]; }
+	};
+
+	//irradiance of an environment as 9 spherical harmonics coefficients per color channel, already convolved with the cosine lobe
+	struct IrradianceSH
+	{
+		float coefficients[9][3]{};
+	};
+
+	struct IBLBakeDesc
+	{
+		uint32 environment_size = 1024;
+		uint32 specular_size = 256;
+		uint32 specular_mip_count = 5;		//the ambient shader samples at most MAX_REFLECTION_LOD = 4
+		uint32 specular_sample_count = 256;
+		uint32 irradiance_size = 32;
+		uint32 brdf_size = 256;
+		uint32 brdf_sample_count = 1024;
+	};
+
+	struct IBLBakeResult
+	{
+		CubemapImage environment;
+		CubemapImage specular;
+		IrradianceSH irradiance;
+		float bake_time = 0.0f;		//seconds
+	};
+
+	/* backend independent, so environment maps can be baked without a device, by a headless tool too.
+	   Matches the compute shaders in Resources/Shaders/Lighting: the cube face directions of Equirect2cubeCS, the GGX prefiltering
+	   of SpmapCS with roughness going linearly over the mips, the irradiance of IrmapCS divided by pi and the LUT of SpbrdfCS.
+	   Every face row is baked as a separate job with std::execution::par. */
+	namespace IBLBaking
+	{
+		//equirect is rgba float, with tightly packed rows. The cube gets its full mip chain
+		CubemapImage EquirectToCubemap(std::span<float const> equirect, uint32 width, uint32 height, uint32 size);
+		//mip m is prefiltered for roughness m / (mip_count - 1), sampling the mips of the environment that match the density of the samples
+		CubemapImage PrefilterSpecular(CubemapImage const& environment, uint32 size, uint32 mip_count, uint32 sample_count);
+		//projects the first mip of the environment no larger than 64 texels
+		IrradianceSH ProjectIrradiance(CubemapImage const& environment);
+		//irradiance divided by pi, as the ambient shader expects it
+		CubemapImage EvaluateIrradiance(IrradianceSH const& sh, uint32 size);
+		//rg float texels, scale and bias of F0 with cos(theta) of the view direction along x and roughness along y
+		std::vector<float> IntegrateSpecularBRDF(uint32 size, uint32 sample_count);
+
+		IBLBakeResult Bake(std::span<float const> equirect, uint32 width, uint32 height, IBLBakeDesc const& desc = {});
+
+		//half float DDS files, loadable by CreateDDSTextureFromMemory
+		std::vector<uint8> WriteCubemapDDS(CubemapImage const& cubemap);
+		std::vector<uint8> WriteSpecularBRDFDDS(std::span<float const> lut, uint32 size);
+		std::vector<uint8> WriteIrradianceSH(IrradianceSH const& sh);
+		std::optional<IrradianceSH> ReadIrradianceSH(std::span<uint8 const> data);
+	}
+}
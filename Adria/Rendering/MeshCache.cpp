@@ -0,0 +1,333 @@
+#include "MeshCache.h"
+#include "Utilities/FilesUtil.h"
+#include "Utilities/HashUtil.h"
+#include "Logging/Logger.h"
+#include "nlohmann/json.hpp"
+
+namespace adria
+{
+	namespace
+	{
+		inline static char const* mesh_cache_directory = "Resources/MeshCache/";
+		static constexpr uint32 MESH_CACHE_MAGIC = 0x48534d41; //"AMSH"
+		//bump when the file layout or the output of the importers changes
+		static constexpr uint32 MESH_CACHE_VERSION = 8;
+		static constexpr uint64 MESH_CACHE_ALIGNMENT = 16;
+
+		struct MeshCacheHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint64 key;
+			uint64 size;
+			uint32 vertex_stride;
+			uint32 padding;
+			uint64 vertex_count;
+			uint64 index_count;
+			uint64 submesh_count;
+			uint64 meshlet_count;
+			uint64 material_count;
+			uint64 node_count;
+			uint64 string_count;
+			uint64 vertex_offset;
+			uint64 index_offset;
+			uint64 submesh_offset;
+			uint64 meshlet_offset;
+			uint64 material_offset;
+			uint64 node_offset;
+			uint64 string_offset;	//uint64 offsets of null-terminated strings, relative to string_offset
+		};
+
+		constexpr uint64 Align(uint64 offset)
+		{
+			return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+		}
+
+		//count elements of element_size starting at offset fit in the file, written so that corrupted counts can't overflow
+		bool IsSectionValid(uint64 offset, uint64 count, uint64 element_size, uint64 file_size)
+		{
+			if (offset % MESH_CACHE_ALIGNMENT != 0 || offset > file_size) return false;
+			return element_size == 0 || count <= (file_size - offset) / element_size;
+		}
+
+		std::string DecodeUri(std::string const& uri)
+		{
+			std::string decoded;
+			for (size_t i = 0; i < uri.size(); ++i)
+			{
+				if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((uint8)uri[i + 1]) && isxdigit((uint8)uri[i + 2]))
+				{
+					decoded += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+					i += 2;
+				}
+				else decoded += uri[i];
+			}
+			return decoded;
+		}
+
+		//external buffers of a .gltf or a .glb, embedded data uris are part of the source already
+		std::vector<std::string> GLTFBufferUris(char const* source, uint64 source_size, bool binary)
+		{
+			static constexpr uint32 GLB_MAGIC = 0x46546c67; //"glTF"
+			char const* json_begin = source;
+			char const* json_end = source + source_size;
+			if (binary)
+			{
+				uint32 header[5];
+				if (source_size < sizeof(header)) return {};
+				memcpy(header, source, sizeof(header));
+				if (header[0] != GLB_MAGIC || header[3] > source_size - sizeof(header)) return {};
+				json_begin = source + sizeof(header);
+				json_end = json_begin + header[3];
+			}
+
+			nlohmann::json const gltf = nlohmann::json::parse(json_begin, json_end, nullptr, false);
+			if (gltf.is_discarded() || !gltf.contains("buffers") || !gltf["buffers"].is_array()) return {};
+			std::vector<std::string> uris;
+			for (auto const& buffer : gltf["buffers"])
+			{
+				if (!buffer.is_object() || !buffer.contains("uri") || !buffer["uri"].is_string()) continue;
+				std::string const uri = buffer["uri"].get<std::string>();
+				if (uri.rfind("data:", 0) != 0) uris.push_back(DecodeUri(uri));
+			}
+			return uris;
+		}
+
+		//mtllib lines of an .obj, named the way ObjLoader reads them
+		std::vector<std::string> ObjMaterialLibraries(char const* source, uint64 source_size)
+		{
+			std::vector<std::string> libraries;
+			char const* end = source + source_size;
+			for (char const* line = source; line < end;)
+			{
+				char const* line_end = static_cast<char const*>(memchr(line, '\n', end - line));
+				if (!line_end) line_end = end;
+				while (line < line_end && (*line == ' ' || *line == '\t')) ++line;
+				if (line_end - line > 7 && memcmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+				{
+					char const* name = line + 7;
+					char const* name_end = line_end;
+					while (name < name_end && isspace((uint8)*name)) ++name;
+					while (name_end > name && isspace((uint8)name_end[-1])) --name_end;
+					if (name != name_end) libraries.emplace_back(name, name_end);
+				}
+				line = line_end + 1;
+			}
+			return libraries;
+		}
+	}
+
+	bool MeshCacheFile::Open(std::string const& path, uint64 key)
+	{
+		if (!file.Open(path)) return false;
+		data = file.As<uint8 const>();
+		size = file.Size();
+		if (Validate(key)) return true;
+
+		file.Close();
+		data = nullptr;
+		size = 0;
+		return false;
+	}
+
+	bool MeshCacheFile::Open(std::vector<uint8>&& image, uint64 key)
+	{
+		memory = std::move(image);
+		data = memory.data();
+		size = memory.size();
+		return Validate(key);
+	}
+
+	bool MeshCacheFile::Validate(uint64 key)
+	{
+		if (size < sizeof(MeshCacheHeader)) return false;
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION || header->key != key || header->size != size) return false;
+
+		bool const sections_valid =
+			IsSectionValid(header->vertex_offset, header->vertex_count, header->vertex_stride, size) &&
+			IsSectionValid(header->index_offset, header->index_count, sizeof(uint32), size) &&
+			IsSectionValid(header->submesh_offset, header->submesh_count, sizeof(MeshCacheSubmesh), size) &&
+			IsSectionValid(header->meshlet_offset, header->meshlet_count, sizeof(Meshlet), size) &&
+			IsSectionValid(header->material_offset, header->material_count, sizeof(MeshCacheMaterial), size) &&
+			IsSectionValid(header->node_offset, header->node_count, sizeof(MeshCacheNode), size) &&
+			IsSectionValid(header->string_offset, header->string_count, sizeof(uint64), size);
+		if (!sections_valid) return false;
+
+		//every string starts inside the file and is terminated before its end
+		uint64 const* string_offsets = At<uint64>(header->string_offset);
+		uint64 const strings_size = size - header->string_offset;
+		for (uint64 i = 0; i < header->string_count; ++i)
+		{
+			if (string_offsets[i] >= strings_size) return false;
+			char const* string = At<char>(header->string_offset + string_offsets[i]);
+			if (!memchr(string, 0, strings_size - string_offsets[i])) return false;
+		}
+		return true;
+	}
+
+	uint32 MeshCacheFile::VertexStride() const
+	{
+		return At<MeshCacheHeader>(0)->vertex_stride;
+	}
+
+	uint64 MeshCacheFile::VertexCount() const
+	{
+		return At<MeshCacheHeader>(0)->vertex_count;
+	}
+
+	void const* MeshCacheFile::Vertices() const
+	{
+		return At<uint8>(At<MeshCacheHeader>(0)->vertex_offset);
+	}
+
+	uint64 MeshCacheFile::IndexCount() const
+	{
+		return At<MeshCacheHeader>(0)->index_count;
+	}
+
+	uint32 const* MeshCacheFile::Indices() const
+	{
+		return At<uint32>(At<MeshCacheHeader>(0)->index_offset);
+	}
+
+	std::span<MeshCacheSubmesh const> MeshCacheFile::Submeshes() const
+	{
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		return { At<MeshCacheSubmesh>(header->submesh_offset), header->submesh_count };
+	}
+
+	std::span<Meshlet const> MeshCacheFile::Meshlets() const
+	{
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		return { At<Meshlet>(header->meshlet_offset), header->meshlet_count };
+	}
+
+	std::span<MeshCacheMaterial const> MeshCacheFile::Materials() const
+	{
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		return { At<MeshCacheMaterial>(header->material_offset), header->material_count };
+	}
+
+	std::span<MeshCacheNode const> MeshCacheFile::Nodes() const
+	{
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		return { At<MeshCacheNode>(header->node_offset), header->node_count };
+	}
+
+	char const* MeshCacheFile::String(int32 index) const
+	{
+		MeshCacheHeader const* header = At<MeshCacheHeader>(0);
+		if (index < 0 || (uint64)index >= header->string_count) return nullptr;
+		return At<char>(header->string_offset + At<uint64>(header->string_offset)[index]);
+	}
+
+	namespace MeshCache
+	{
+		uint64 ComputeKey(std::string const& source_path)
+		{
+			size_t key = MESH_CACHE_VERSION;
+			MemoryMappedFile source;
+			if (!source.Open(source_path)) return key;
+			char const* source_data = source.As<char const>();
+			HashCombine(key, crc64(source_data, source.Size()));
+
+			std::string const extension = fs::path(source_path).extension().string();
+			std::vector<std::string> referenced_files;
+			if (extension == ".gltf" || extension == ".glb") referenced_files = GLTFBufferUris(source_data, source.Size(), extension == ".glb");
+			else if (extension == ".obj") referenced_files = ObjMaterialLibraries(source_data, source.Size());
+
+			fs::path const source_directory = fs::path(source_path).parent_path();
+			for (std::string const& referenced_file : referenced_files)
+			{
+				std::error_code ec;
+				fs::path const path = source_directory / referenced_file;
+				HashCombine(key, referenced_file);
+				HashCombine(key, (uint64)fs::file_size(path, ec));
+				HashCombine(key, (int64)fs::last_write_time(path, ec).time_since_epoch().count());
+			}
+			return key;
+		}
+
+		std::string GetCachePath(uint64 key)
+		{
+			char cache_path[256];
+			sprintf_s(cache_path, "%s%016llx.amesh", mesh_cache_directory, (unsigned long long)key);
+			return cache_path;
+		}
+
+		std::vector<uint8> Serialize(uint64 key, MeshCacheData const& data)
+		{
+			MeshCacheHeader header{};
+			header.magic = MESH_CACHE_MAGIC;
+			header.version = MESH_CACHE_VERSION;
+			header.key = key;
+			header.vertex_stride = data.vertex_stride;
+			header.vertex_count = data.vertex_stride ? data.vertices.size() / data.vertex_stride : 0;
+			header.index_count = data.indices.size();
+			header.submesh_count = data.submeshes.size();
+			header.meshlet_count = data.meshlets.size();
+			header.material_count = data.materials.size();
+			header.node_count = data.nodes.size();
+			header.string_count = data.strings.size();
+
+			header.vertex_offset = Align(sizeof(MeshCacheHeader));
+			header.index_offset = Align(header.vertex_offset + data.vertices.size());
+			header.submesh_offset = Align(header.index_offset + data.indices.size_bytes());
+			header.meshlet_offset = Align(header.submesh_offset + data.submeshes.size() * sizeof(MeshCacheSubmesh));
+			header.material_offset = Align(header.meshlet_offset + data.meshlets.size() * sizeof(Meshlet));
+			header.node_offset = Align(header.material_offset + data.materials.size() * sizeof(MeshCacheMaterial));
+			header.string_offset = Align(header.node_offset + data.nodes.size() * sizeof(MeshCacheNode));
+
+			std::vector<uint64> string_offsets(data.strings.size());
+			uint64 string_size = data.strings.size() * sizeof(uint64);
+			for (size_t i = 0; i < data.strings.size(); ++i)
+			{
+				string_offsets[i] = string_size;
+				string_size += data.strings[i].size() + 1;
+			}
+			header.size = header.string_offset + string_size;
+
+			std::vector<uint8> image(header.size, 0);
+			memcpy(image.data(), &header, sizeof(header));
+			memcpy(image.data() + header.vertex_offset, data.vertices.data(), data.vertices.size());
+			memcpy(image.data() + header.index_offset, data.indices.data(), data.indices.size_bytes());
+			memcpy(image.data() + header.submesh_offset, data.submeshes.data(), data.submeshes.size() * sizeof(MeshCacheSubmesh));
+			memcpy(image.data() + header.meshlet_offset, data.meshlets.data(), data.meshlets.size() * sizeof(Meshlet));
+			memcpy(image.data() + header.material_offset, data.materials.data(), data.materials.size() * sizeof(MeshCacheMaterial));
+			memcpy(image.data() + header.node_offset, data.nodes.data(), data.nodes.size() * sizeof(MeshCacheNode));
+			memcpy(image.data() + header.string_offset, string_offsets.data(), string_offsets.size() * sizeof(uint64));
+			for (size_t i = 0; i < data.strings.size(); ++i)
+			{
+				memcpy(image.data() + header.string_offset + string_offsets[i], data.strings[i].c_str(), data.strings[i].size() + 1);
+			}
+			return image;
+		}
+
+		bool Write(std::string const& path, std::vector<uint8> const& image)
+		{
+			std::error_code ec;
+			fs::create_directories(fs::path(path).parent_path(), ec);
+
+			std::string const temporary_path = GetTemporaryPath(path);
+			{
+				MemoryMappedFile file;
+				if (!file.Create(temporary_path, image.size()))
+				{
+					ADRIA_LOG(WARNING, "Failed to write mesh cache %s", path.c_str());
+					return false;
+				}
+				memcpy(file.Data(), image.data(), image.size());
+			}
+
+			fs::rename(temporary_path, path, ec);
+			if (ec)
+			{
+				ADRIA_LOG(WARNING, "Failed to write mesh cache %s: %s", path.c_str(), ec.message().c_str());
+				fs::remove(temporary_path, ec);
+				return false;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <span>
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "VertexCompression.h"
+#include "Core/CoreTypes.h"
+#include "Utilities/MemoryMappedFile.h"
+
+namespace adria
+{
+	inline constexpr int32 MESH_CACHE_NONE = -1;
+
+	struct MeshCacheSubmesh
+	{
+		BoundingBox bounds;		//local space
+		int32 mesh;				//source mesh, nodes reference meshes
+		int32 material;
+		uint32 topology;		//GfxPrimitiveTopology
+		uint32 start_index;
+		uint32 index_count;		//0 for non-indexed submeshes
+		uint32 base_vertex;
+		uint32 vertex_count;
+		VertexQuantization quantization;	//CompressedVertex streams only
+		uint32 lod_count;		//level 0 is start_index and index_count
+		MeshLodLevel lods[MESH_LOD_MAX_LEVELS];
+		uint32 first_meshlet;	//meshlets of level 0
+		uint32 meshlet_count;
+	};
+
+	struct MeshCacheMaterial
+	{
+		int32 albedo_texture = MESH_CACHE_NONE;	//indices into the string table
+		int32 normal_texture = MESH_CACHE_NONE;
+		int32 metallic_roughness_texture = MESH_CACHE_NONE;
+		int32 emissive_texture = MESH_CACHE_NONE;
+		float albedo_factor = 1.0f;
+		float metallic_factor = 1.0f;
+		float roughness_factor = 1.0f;
+		float emissive_factor = 1.0f;
+		float alpha_cutoff = 0.5f;
+		uint32 alpha_mode = 0;	//MaterialAlphaMode
+		uint32 double_sided = 0;
+	};
+
+	//nodes are stored parents first
+	struct MeshCacheNode
+	{
+		Matrix local_transform;
+		int32 parent;
+		int32 mesh;
+	};
+
+	struct MeshCacheData
+	{
+		uint32 vertex_stride = 0;
+		std::span<uint8 const> vertices;
+		std::span<uint32 const> indices;
+		std::vector<MeshCacheSubmesh> submeshes;
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshCacheMaterial> materials;
+		std::vector<MeshCacheNode> nodes;
+		std::vector<std::string> strings;
+	};
+
+	/* Read-only view of an .amesh file: a header followed by 16-byte aligned vertex and index streams in their
+	   final GPU layout, submesh, meshlet, material and node records and a string table. The file is memory mapped and
+	   the streams are handed directly to buffer creation. A view can also wrap a freshly serialized image. */
+	class MeshCacheFile
+	{
+	public:
+		MeshCacheFile() = default;
+		MeshCacheFile(MeshCacheFile const&) = delete;
+		MeshCacheFile& operator=(MeshCacheFile const&) = delete;
+
+		bool Open(std::string const& path, uint64 key);
+		bool Open(std::vector<uint8>&& image, uint64 key);
+
+		uint32 VertexStride() const;
+		uint64 VertexCount() const;
+		void const* Vertices() const;
+		uint64 IndexCount() const;
+		uint32 const* Indices() const;
+		std::span<MeshCacheSubmesh const> Submeshes() const;
+		std::span<Meshlet const> Meshlets() const;
+		std::span<MeshCacheMaterial const> Materials() const;
+		std::span<MeshCacheNode const> Nodes() const;
+		//nullptr for MESH_CACHE_NONE
+		char const* String(int32 index) const;
+
+	private:
+		MemoryMappedFile file;
+		std::vector<uint8> memory;
+		uint8 const* data = nullptr;
+		uint64 size = 0;
+
+	private:
+		bool Validate(uint64 key);
+		template<typename T>
+		T const* At(uint64 offset) const { return reinterpret_cast<T const*>(data + offset); }
+	};
+
+	namespace MeshCache
+	{
+		//hash of the source file and the importer version, the buffers of a gltf and the material libraries of an obj add their size and write time
+		uint64 ComputeKey(std::string const& source_path);
+		std::string GetCachePath(uint64 key);
+
+		std::vector<uint8> Serialize(uint64 key, MeshCacheData const& data);
+		bool Write(std::string const& path, std::vector<uint8> const& image);
+	}
+}
@@ -0,0 +1,115 @@
+#include <execution>
+#include <numeric>
+#include <unordered_map>
+#include "MeshInstancing.h"
+#include "Utilities/HashUtil.h"
+
+namespace adria
+{
+	namespace
+	{
+		MeshInstance MakeMeshInstance(Matrix const& world)
+		{
+			Matrix const inverse_world = world.Invert();
+			MeshInstance instance{};
+			instance.model[0] = Vector3(world._11, world._12, world._13);
+			instance.model[1] = Vector3(world._21, world._22, world._23);
+			instance.model[2] = Vector3(world._31, world._32, world._33);
+			instance.model[3] = Vector3(world._41, world._42, world._43);
+			instance.inverse_model[0] = Vector3(inverse_world._11, inverse_world._12, inverse_world._13);
+			instance.inverse_model[1] = Vector3(inverse_world._21, inverse_world._22, inverse_world._23);
+			instance.inverse_model[2] = Vector3(inverse_world._31, inverse_world._32, inverse_world._33);
+			return instance;
+		}
+
+		uint64 HashBatchKey(MeshBatchKey const& key)
+		{
+			size_t hash = 0;
+			HashCombine(hash, key.shader_program);
+			HashCombine(hash, key.double_sided);
+			HashCombine(hash, key.vertex_buffer);
+			HashCombine(hash, key.index_buffer);
+			HashCombine(hash, key.start_index);
+			HashCombine(hash, key.index_count);
+			HashCombine(hash, key.base_vertex);
+			for (uint64 texture : key.textures) HashCombine(hash, texture);
+			for (float factor : key.factors) HashCombine(hash, factor);
+			return hash;
+		}
+	}
+
+	namespace MeshInstancing
+	{
+		MeshInstancingStatistics Batch(std::span<MeshInstanceItem const> items, std::vector<MeshInstanceBatch>& batches, std::vector<MeshInstance>& instances)
+		{
+			batches.clear();
+			instances.resize(items.size());
+
+			//hashed in parallel, the serial pass only looks the hashes up. Consecutive items usually share their key, so the previous one is checked first
+			std::vector<uint64> item_hashes(items.size());
+			std::vector<uint32> indices(items.size());
+			std::iota(std::begin(indices), std::end(indices), 0);
+			std::for_each(std::execution::par, std::begin(indices), std::end(indices),
+				[&](uint32 item) { item_hashes[item] = HashBatchKey(items[item].key); });
+
+			std::unordered_map<uint64, uint32> hash_keys;
+			std::vector<uint32> key_items;	//first item of every distinct key
+			std::vector<uint32> item_keys(items.size());
+			for (uint32 i = 0; i < (uint32)items.size(); ++i)
+			{
+				MeshBatchKey const& key = items[i].key;
+				if (i > 0 && item_hashes[i] == item_hashes[i - 1] && key == items[i - 1].key)
+				{
+					item_keys[i] = item_keys[i - 1];
+					continue;
+				}
+				auto it = hash_keys.find(item_hashes[i]);
+				if (it != std::end(hash_keys) && items[key_items[it->second]].key == key)
+				{
+					item_keys[i] = it->second;
+					continue;
+				}
+				//a new key, or one whose hash collides with another key's
+				auto key_it = it == std::end(hash_keys) ? std::end(key_items) :
+					std::find_if(std::begin(key_items), std::end(key_items), [&](uint32 key_item) { return items[key_item].key == key; });
+				if (key_it != std::end(key_items))
+				{
+					item_keys[i] = (uint32)(key_it - std::begin(key_items));
+					continue;
+				}
+				if (it == std::end(hash_keys)) hash_keys.emplace(item_hashes[i], (uint32)key_items.size());
+				item_keys[i] = (uint32)key_items.size();
+				key_items.push_back(i);
+			}
+
+			//only the few distinct keys are sorted, the items are placed by a counting sort that keeps their order within a batch
+			std::vector<uint32> sorted_keys(key_items.size());
+			std::iota(std::begin(sorted_keys), std::end(sorted_keys), 0);
+			std::sort(std::begin(sorted_keys), std::end(sorted_keys), [&](uint32 a, uint32 b) { return items[key_items[a]].key < items[key_items[b]].key; });
+
+			std::vector<uint32> key_offsets(key_items.size(), 0);
+			for (uint32 key : item_keys) ++key_offsets[key];
+
+			MeshInstancingStatistics statistics{};
+			statistics.item_count = items.size();
+			statistics.batch_count = key_items.size();
+			uint32 first_instance = 0;
+			for (uint32 key : sorted_keys)
+			{
+				uint32 const instance_count = key_offsets[key];
+				batches.push_back(MeshInstanceBatch{ .key = items[key_items[key]].key, .first_instance = first_instance, .instance_count = instance_count, .payload = items[key_items[key]].payload });
+				if (instance_count > 1) ++statistics.instanced_batch_count;
+				statistics.max_batch_size = std::max<uint64>(statistics.max_batch_size, instance_count);
+				key_offsets[key] = first_instance;
+				first_instance += instance_count;
+			}
+
+			std::vector<uint32> instance_items(items.size());
+			for (uint32 i = 0; i < (uint32)items.size(); ++i) instance_items[key_offsets[item_keys[i]]++] = i;
+
+			std::for_each(std::execution::par, std::begin(indices), std::end(indices),
+				[&](uint32 instance) { instances[instance] = MakeMeshInstance(items[instance_items[instance]].world); });
+			return statistics;
+		}
+	}
+}
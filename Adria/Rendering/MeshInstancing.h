@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Enums.h"
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	//per instance data of the instanced gbuffer shaders, read as INSTANCE_MODEL0-3 and INSTANCE_INVERSE0-2
+	struct MeshInstance
+	{
+		Vector3 model[4];			//rows of the world matrix, its last column is always (0, 0, 0, 1)
+		Vector3 inverse_model[3];	//rows of the upper 3x3 of the inverse world matrix, normals are transformed with it
+	};
+
+	/* Everything the instances of one draw share: pipeline state, the index range of the mesh and the material.
+	   Buffers are only compared, never dereferenced. State comes first, so sorted batches change shaders as rarely as possible. */
+	struct MeshBatchKey
+	{
+		ShaderProgram shader_program = ShaderProgram::Unknown;
+		bool double_sided = false;
+		void const* vertex_buffer = nullptr;
+		void const* index_buffer = nullptr;
+		uint32 start_index = 0;
+		uint32 index_count = 0;
+		int32 base_vertex = 0;
+		uint64 textures[4]{};
+		float factors[5]{};
+
+		auto operator<=>(MeshBatchKey const&) const = default;
+	};
+
+	struct MeshInstanceItem
+	{
+		MeshBatchKey key;
+		Matrix world;
+		uint64 payload;		//passed through to the batch, the renderer stores the entity here
+	};
+
+	struct MeshInstanceBatch
+	{
+		MeshBatchKey key;
+		uint32 first_instance;
+		uint32 instance_count;
+		uint64 payload;		//of the first item of the batch, its mesh and material are drawn for all instances
+	};
+
+	struct MeshInstancingStatistics
+	{
+		uint64 item_count = 0;
+		uint64 batch_count = 0;
+		uint64 instanced_batch_count = 0;	//batches with more than one instance
+		uint64 max_batch_size = 0;
+	};
+
+	//backend independent, so the batches can be built without a device
+	namespace MeshInstancing
+	{
+		/* Groups items with equal keys into batches, in key order, and writes the instance data of every batch contiguously.
+		   Items keep their submission order within a batch. */
+		MeshInstancingStatistics Batch(std::span<MeshInstanceItem const> items, std::vector<MeshInstanceBatch>& batches, std::vector<MeshInstance>& instances);
+
+		/* Removes the batches of a single instance whose payload drawn_alone accepts and appends their payloads to singles, for items
+		   that are cheaper to draw on their own once it's known no other item shares their draw. Batches keep their order and the
+		   instance data of the removed ones stays where it is. Returns the number of batches removed. */
+		template<typename DrawnAlone>
+		uint64 ExtractSingles(std::vector<MeshInstanceBatch>& batches, DrawnAlone&& drawn_alone, std::vector<uint64>& singles)
+		{
+			uint64 const batch_count = batches.size();
+			std::erase_if(batches, [&](MeshInstanceBatch const& batch)
+				{
+					if (batch.instance_count != 1 || !drawn_alone(batch.payload)) return false;
+					singles.push_back(batch.payload);
+					return true;
+				});
+			return batch_count - batches.size();
+		}
+	}
+}
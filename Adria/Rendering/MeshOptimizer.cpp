@@ -0,0 +1,339 @@
+#include <numeric>
+#include <string_view>
+#include "MeshOptimizer.h"
+
+namespace adria
+{
+	namespace
+	{
+		//Forsyth's scoring, with his original constants
+		static constexpr uint32 FORSYTH_CACHE_SIZE = 32;
+		static constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+		static constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+		static constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+		static constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+		static constexpr uint32 INVALID_TRIANGLE = uint32(-1);
+
+		float ForsythVertexScore(int32 cache_position, uint32 remaining_triangles)
+		{
+			if (remaining_triangles == 0) return -1.0f;
+
+			float score = 0.0f;
+			if (cache_position >= 0)
+			{
+				if (cache_position < 3) score = FORSYTH_LAST_TRIANGLE_SCORE;
+				else
+				{
+					float const scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+					score = std::pow(1.0f - (cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+				}
+			}
+			score += FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)remaining_triangles, -FORSYTH_VALENCE_BOOST_POWER);
+			return score;
+		}
+
+		//FIFO cache simulated with insertion timestamps, a vertex is cached while fewer than cache_size vertices were inserted after it
+		class FifoCache
+		{
+		public:
+			FifoCache(uint64 vertex_count, uint32 cache_size) : timestamps(vertex_count, 0), cache_size(cache_size), timestamp(cache_size + 1) {}
+
+			bool Access(uint32 vertex)
+			{
+				if (timestamp - timestamps[vertex] <= cache_size) return true;
+				timestamps[vertex] = timestamp++;
+				return false;
+			}
+
+			void Flush()
+			{
+				timestamp += cache_size + 1;
+			}
+
+		private:
+			std::vector<uint64> timestamps;
+			uint64 cache_size;
+			uint64 timestamp;
+		};
+
+		struct TriangleCluster
+		{
+			uint64 first_triangle;
+			uint64 triangle_count;
+			float sort_key;
+		};
+	}
+
+	namespace MeshOptimizer
+	{
+		VertexCacheStatistics AnalyzeVertexCache(std::span<uint32 const> indices, uint64 vertex_count, uint32 cache_size)
+		{
+			VertexCacheStatistics statistics{};
+			statistics.triangle_count = indices.size() / 3;
+
+			FifoCache cache(vertex_count, cache_size);
+			std::vector<bool> referenced(vertex_count, false);
+			for (uint32 index : indices)
+			{
+				if (!cache.Access(index)) ++statistics.cache_misses;
+				if (!referenced[index])
+				{
+					referenced[index] = true;
+					++statistics.vertex_count;
+				}
+			}
+			return statistics;
+		}
+
+		uint64 GenerateVertexRemap(std::span<uint32> remap, std::span<uint32 const> indices, void const* vertices, uint64 vertex_count, uint32 stride)
+		{
+			ADRIA_ASSERT(remap.size() >= vertex_count);
+			std::fill(std::begin(remap), std::end(remap), MESH_OPTIMIZER_UNUSED);
+
+			uint8 const* vertex_data = static_cast<uint8 const*>(vertices);
+			auto VertexBytes = [&](uint32 vertex) { return std::string_view(reinterpret_cast<char const*>(vertex_data + (uint64)vertex * stride), stride); };
+
+			//open addressing, power of two capacity with at most 50% load
+			uint64 capacity = 16;
+			while (capacity < 2 * vertex_count) capacity *= 2;
+			std::vector<uint32> table(capacity, MESH_OPTIMIZER_UNUSED);
+			std::hash<std::string_view> hasher{};
+
+			uint32 unique_count = 0;
+			for (uint32 index : indices)
+			{
+				if (remap[index] != MESH_OPTIMIZER_UNUSED) continue;
+
+				std::string_view const bytes = VertexBytes(index);
+				uint64 slot = hasher(bytes) & (capacity - 1);
+				while (table[slot] != MESH_OPTIMIZER_UNUSED && VertexBytes(table[slot]) != bytes) slot = (slot + 1) & (capacity - 1);
+
+				if (table[slot] == MESH_OPTIMIZER_UNUSED)
+				{
+					table[slot] = index;
+					remap[index] = unique_count++;
+				}
+				else remap[index] = remap[table[slot]];
+			}
+			return unique_count;
+		}
+
+		void RemapVertices(void* destination, void const* vertices, uint64 vertex_count, uint32 stride, std::span<uint32 const> remap)
+		{
+			uint8* destination_data = static_cast<uint8*>(destination);
+			uint8 const* vertex_data = static_cast<uint8 const*>(vertices);
+			for (uint64 i = 0; i < vertex_count; ++i)
+			{
+				if (remap[i] == MESH_OPTIMIZER_UNUSED) continue;
+				memcpy(destination_data + (uint64)remap[i] * stride, vertex_data + i * stride, stride);
+			}
+		}
+
+		void RemapIndices(std::span<uint32> indices, std::span<uint32 const> remap)
+		{
+			for (uint32& index : indices) index = remap[index];
+		}
+
+		void OptimizeVertexCache(std::span<uint32> destination, std::span<uint32 const> indices, uint64 vertex_count)
+		{
+			ADRIA_ASSERT(destination.size() == indices.size() && indices.size() % 3 == 0);
+			uint64 const triangle_count = indices.size() / 3;
+			if (triangle_count == 0) return;
+
+			//per vertex list of the triangles that still have to be emitted
+			std::vector<uint32> remaining(vertex_count, 0);
+			for (uint32 index : indices) ++remaining[index];
+			std::vector<uint32> adjacency_offsets(vertex_count + 1, 0);
+			std::inclusive_scan(std::begin(remaining), std::end(remaining), std::begin(adjacency_offsets) + 1);
+			std::vector<uint32> adjacency(indices.size());
+			{
+				std::vector<uint32> cursors(std::begin(adjacency_offsets), std::end(adjacency_offsets) - 1);
+				for (uint64 i = 0; i < indices.size(); ++i) adjacency[cursors[indices[i]]++] = (uint32)(i / 3);
+			}
+
+			std::vector<int32> cache_positions(vertex_count, -1);
+			std::vector<float> vertex_scores(vertex_count);
+			for (uint64 v = 0; v < vertex_count; ++v) vertex_scores[v] = ForsythVertexScore(-1, remaining[v]);
+
+			std::vector<float> triangle_scores(triangle_count);
+			std::vector<bool> emitted(triangle_count, false);
+			uint32 best_triangle = 0;
+			for (uint64 t = 0; t < triangle_count; ++t)
+			{
+				triangle_scores[t] = vertex_scores[indices[t * 3 + 0]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+				if (triangle_scores[t] > triangle_scores[best_triangle]) best_triangle = (uint32)t;
+			}
+
+			std::vector<uint32> cache, new_cache;
+			cache.reserve(FORSYTH_CACHE_SIZE + 3);
+			new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+			uint64 input_cursor = 0;
+			for (uint64 output_triangle = 0; output_triangle < triangle_count; ++output_triangle)
+			{
+				if (best_triangle == INVALID_TRIANGLE)
+				{
+					while (emitted[input_cursor]) ++input_cursor;
+					best_triangle = (uint32)input_cursor;
+				}
+
+				uint32 const* triangle = &indices[best_triangle * 3ull];
+				std::copy(triangle, triangle + 3, &destination[output_triangle * 3]);
+				emitted[best_triangle] = true;
+
+				new_cache.clear();
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					uint32 const vertex = triangle[k];
+					uint32* first = &adjacency[adjacency_offsets[vertex]];
+					uint32* last = first + remaining[vertex];
+					*std::find(first, last, best_triangle) = *(last - 1);
+					--remaining[vertex];
+					if (std::find(std::begin(new_cache), std::end(new_cache), vertex) == std::end(new_cache)) new_cache.push_back(vertex);
+				}
+				for (uint32 vertex : cache)
+				{
+					if (std::find(std::begin(new_cache), std::end(new_cache), vertex) == std::end(new_cache)) new_cache.push_back(vertex);
+				}
+
+				//rescore everything that was or is in the cache, vertices pushed out of it lose their cache score
+				best_triangle = INVALID_TRIANGLE;
+				float best_score = -1.0f;
+				for (uint64 i = 0; i < new_cache.size(); ++i)
+				{
+					uint32 const vertex = new_cache[i];
+					cache_positions[vertex] = i < FORSYTH_CACHE_SIZE ? (int32)i : -1;
+					float const score = ForsythVertexScore(cache_positions[vertex], remaining[vertex]);
+					float const score_delta = score - vertex_scores[vertex];
+					vertex_scores[vertex] = score;
+
+					for (uint32 j = adjacency_offsets[vertex]; j < adjacency_offsets[vertex] + remaining[vertex]; ++j)
+					{
+						uint32 const adjacent_triangle = adjacency[j];
+						triangle_scores[adjacent_triangle] += score_delta;
+					}
+				}
+				for (uint64 i = 0; i < std::min<uint64>(new_cache.size(), FORSYTH_CACHE_SIZE); ++i)
+				{
+					uint32 const vertex = new_cache[i];
+					for (uint32 j = adjacency_offsets[vertex]; j < adjacency_offsets[vertex] + remaining[vertex]; ++j)
+					{
+						uint32 const adjacent_triangle = adjacency[j];
+						if (triangle_scores[adjacent_triangle] > best_score)
+						{
+							best_score = triangle_scores[adjacent_triangle];
+							best_triangle = adjacent_triangle;
+						}
+					}
+				}
+
+				if (new_cache.size() > FORSYTH_CACHE_SIZE) new_cache.resize(FORSYTH_CACHE_SIZE);
+				std::swap(cache, new_cache);
+			}
+		}
+
+		void OptimizeOverdraw(std::span<uint32> destination, std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			uint32 cache_size, float threshold)
+		{
+			ADRIA_ASSERT(destination.size() == indices.size() && indices.size() % 3 == 0);
+			uint64 const triangle_count = indices.size() / 3;
+			if (triangle_count == 0) return;
+
+			//hard boundaries where the cache restarts, a triangle that misses on all three vertices
+			std::vector<uint64> hard_boundaries;
+			{
+				FifoCache cache(vertex_count, cache_size);
+				for (uint64 t = 0; t < triangle_count; ++t)
+				{
+					uint32 misses = 0;
+					for (uint32 k = 0; k < 3; ++k) misses += !cache.Access(indices[t * 3 + k]);
+					if (t == 0 || misses == 3) hard_boundaries.push_back(t);
+				}
+				hard_boundaries.push_back(triangle_count);
+			}
+
+			//soft boundaries split a hard cluster as soon as the running ACMR is within threshold of the ACMR of the whole cluster
+			std::vector<TriangleCluster> clusters;
+			FifoCache cache(vertex_count, cache_size);
+			for (uint64 h = 0; h + 1 < hard_boundaries.size(); ++h)
+			{
+				uint64 const start = hard_boundaries[h], end = hard_boundaries[h + 1];
+				cache.Flush();
+				uint64 cluster_misses = 0;
+				for (uint64 t = start; t < end; ++t)
+				{
+					for (uint32 k = 0; k < 3; ++k) cluster_misses += !cache.Access(indices[t * 3 + k]);
+				}
+				float const target_acmr = threshold * cluster_misses / (float)(end - start);
+
+				cache.Flush();
+				uint64 cluster_start = start, running_misses = 0;
+				for (uint64 t = start; t < end; ++t)
+				{
+					for (uint32 k = 0; k < 3; ++k) running_misses += !cache.Access(indices[t * 3 + k]);
+					if (t + 1 == end || running_misses / (float)(t + 1 - cluster_start) <= target_acmr)
+					{
+						clusters.push_back(TriangleCluster{ cluster_start, t + 1 - cluster_start, 0.0f });
+						cluster_start = t + 1;
+						running_misses = 0;
+						cache.Flush();
+					}
+				}
+			}
+
+			auto Position = [&](uint32 vertex) -> Vector3 const& { return *reinterpret_cast<Vector3 const*>(reinterpret_cast<uint8 const*>(positions) + (uint64)vertex * stride); };
+
+			//area weighted centroids and normals
+			std::vector<Vector3> cluster_centroids(clusters.size());
+			std::vector<Vector3> cluster_normals(clusters.size());
+			Vector3 mesh_centroid{};
+			float mesh_area = 0.0f;
+			for (uint64 c = 0; c < clusters.size(); ++c)
+			{
+				Vector3 centroid{}, normal{};
+				float cluster_area = 0.0f;
+				for (uint64 t = clusters[c].first_triangle; t < clusters[c].first_triangle + clusters[c].triangle_count; ++t)
+				{
+					Vector3 const& p0 = Position(indices[t * 3 + 0]);
+					Vector3 const& p1 = Position(indices[t * 3 + 1]);
+					Vector3 const& p2 = Position(indices[t * 3 + 2]);
+					Vector3 const cross = (p1 - p0).Cross(p2 - p0);
+					float const area = cross.Length();
+					centroid += (p0 + p1 + p2) * (area / 3.0f);
+					normal += cross;
+					cluster_area += area;
+				}
+				mesh_centroid += centroid;
+				mesh_area += cluster_area;
+				cluster_centroids[c] = cluster_area > 0.0f ? centroid / cluster_area : centroid;
+				cluster_normals[c] = normal;
+				cluster_normals[c].Normalize();
+			}
+			if (mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+			for (uint64 c = 0; c < clusters.size(); ++c)
+			{
+				clusters[c].sort_key = (cluster_centroids[c] - mesh_centroid).Dot(cluster_normals[c]);
+			}
+			std::stable_sort(std::begin(clusters), std::end(clusters), [](TriangleCluster const& a, TriangleCluster const& b) { return a.sort_key > b.sort_key; });
+
+			uint64 output_index = 0;
+			for (TriangleCluster const& cluster : clusters)
+			{
+				auto first = std::begin(indices) + cluster.first_triangle * 3;
+				std::copy(first, first + cluster.triangle_count * 3, std::begin(destination) + output_index);
+				output_index += cluster.triangle_count * 3;
+			}
+		}
+
+		uint64 OptimizeVertexFetchRemap(std::span<uint32> remap, std::span<uint32 const> indices)
+		{
+			std::fill(std::begin(remap), std::end(remap), MESH_OPTIMIZER_UNUSED);
+			uint32 next_vertex = 0;
+			for (uint32 index : indices)
+			{
+				if (remap[index] == MESH_OPTIMIZER_UNUSED) remap[index] = next_vertex++;
+			}
+			return next_vertex;
+		}
+	}
+}
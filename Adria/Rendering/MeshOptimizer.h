@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <numeric>
+#include <type_traits>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	inline constexpr uint32 MESH_OPTIMIZER_UNUSED = uint32(-1);
+
+	//post-transform cache statistics of an index buffer, counted with a simulated FIFO cache
+	struct VertexCacheStatistics
+	{
+		uint64 triangle_count = 0;
+		uint64 vertex_count = 0;	//distinct vertices referenced by the indices
+		uint64 cache_misses = 0;
+
+		float ACMR() const { return triangle_count ? cache_misses / (float)triangle_count : 0.0f; } //average cache miss ratio, 0.5 - 3
+		float ATVR() const { return vertex_count ? cache_misses / (float)vertex_count : 0.0f; }	   //average transformed vertex ratio, 1 is optimal
+
+		VertexCacheStatistics& operator+=(VertexCacheStatistics const& other)
+		{
+			triangle_count += other.triangle_count;
+			vertex_count += other.vertex_count;
+			cache_misses += other.cache_misses;
+			return *this;
+		}
+	};
+
+	struct MeshOptimizationStatistics
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+		uint64 vertices_before = 0;
+		uint64 vertices_after = 0;
+
+		MeshOptimizationStatistics& operator+=(MeshOptimizationStatistics const& other)
+		{
+			before += other.before;
+			after += other.after;
+			vertices_before += other.vertices_before;
+			vertices_after += other.vertices_after;
+			return *this;
+		}
+	};
+
+	struct MeshOptimizerDesc
+	{
+		uint32 cache_size = 16;				//FIFO cache used for the analysis and the overdraw cluster boundaries
+		float overdraw_threshold = 1.05f;	//ACMR a cluster can lose to get split into smaller clusters for overdraw sorting
+	};
+
+	//backend and vertex format independent, works on triangle lists with 32 bit indices
+	namespace MeshOptimizer
+	{
+		VertexCacheStatistics AnalyzeVertexCache(std::span<uint32 const> indices, uint64 vertex_count, uint32 cache_size = 16);
+
+		/* Fills remap with the new index of each vertex, binary identical vertices share one, unreferenced vertices are
+		   MESH_OPTIMIZER_UNUSED. New indices follow the first use in the index buffer. Returns the unique vertex count. */
+		uint64 GenerateVertexRemap(std::span<uint32> remap, std::span<uint32 const> indices, void const* vertices, uint64 vertex_count, uint32 stride);
+		void RemapVertices(void* destination, void const* vertices, uint64 vertex_count, uint32 stride, std::span<uint32 const> remap);
+		void RemapIndices(std::span<uint32> indices, std::span<uint32 const> remap);
+
+		//Forsyth's linear-speed vertex cache optimization
+		void OptimizeVertexCache(std::span<uint32> destination, std::span<uint32 const> indices, uint64 vertex_count);
+
+		/* Splits vertex cache optimized indices into clusters where the cache restarts or where the cluster ACMR stays within
+		   threshold and sorts the clusters so outward facing ones, which tend to occlude the rest of the mesh, are drawn first. */
+		void OptimizeOverdraw(std::span<uint32> destination, std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			uint32 cache_size, float threshold);
+
+		//remap that orders vertices by their first use, returns the number of used vertices
+		uint64 OptimizeVertexFetchRemap(std::span<uint32> remap, std::span<uint32 const> indices);
+
+		/* Deduplicates vertices, then reorders triangles for the post-transform cache and overdraw and finally vertices for fetch locality.
+		   Empty indices are treated as a triangle soup, in which case the mesh becomes indexed. */
+		template<typename V> requires std::is_trivially_copyable_v<V>
+		MeshOptimizationStatistics OptimizeMesh(std::vector<V>& vertices, std::vector<uint32>& indices, MeshOptimizerDesc const& desc = {})
+		{
+			if (indices.empty())
+			{
+				indices.resize(vertices.size());
+				std::iota(std::begin(indices), std::end(indices), 0u);
+			}
+			ADRIA_ASSERT(indices.size() % 3 == 0);
+
+			MeshOptimizationStatistics statistics{};
+			statistics.vertices_before = vertices.size();
+			statistics.before = AnalyzeVertexCache(indices, vertices.size(), desc.cache_size);
+
+			std::vector<uint32> remap(vertices.size());
+			uint64 const unique_count = GenerateVertexRemap(remap, indices, vertices.data(), vertices.size(), sizeof(V));
+			std::vector<V> unique_vertices(unique_count);
+			RemapVertices(unique_vertices.data(), vertices.data(), vertices.size(), sizeof(V), remap);
+			RemapIndices(indices, remap);
+
+			std::vector<uint32> cache_ordered(indices.size());
+			OptimizeVertexCache(cache_ordered, indices, unique_count);
+			OptimizeOverdraw(indices, cache_ordered, unique_count ? &unique_vertices[0].position : nullptr, unique_count, sizeof(V),
+				desc.cache_size, desc.overdraw_threshold);
+
+			remap.resize(unique_count);
+			uint64 const used_count = OptimizeVertexFetchRemap(remap, indices);
+			vertices.resize(used_count);
+			RemapVertices(vertices.data(), unique_vertices.data(), unique_count, sizeof(V), remap);
+			RemapIndices(indices, remap);
+
+			statistics.vertices_after = vertices.size();
+			statistics.after = AnalyzeVertexCache(indices, vertices.size(), desc.cache_size);
+			return statistics;
+		}
+	}
+}
@@ -0,0 +1,307 @@
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr float BORDER_WEIGHT = 10.0f;
+		static constexpr uint32 INVALID_VERTEX = uint32(-1);
+
+		enum class VertexKind : uint8
+		{
+			Manifold,
+			Border,
+			Locked
+		};
+
+		//symmetric 4x4 matrix of the summed weighted squared plane distances and the summed weight
+		struct Quadric
+		{
+			float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+			float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+			float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+			float c = 0.0f;
+			float w = 0.0f;
+
+			static Quadric FromPlane(Vector3 const& n, float d, float weight)
+			{
+				Quadric q{};
+				q.a00 = n.x * n.x * weight;
+				q.a11 = n.y * n.y * weight;
+				q.a22 = n.z * n.z * weight;
+				q.a10 = n.y * n.x * weight;
+				q.a20 = n.z * n.x * weight;
+				q.a21 = n.z * n.y * weight;
+				q.b0 = n.x * d * weight;
+				q.b1 = n.y * d * weight;
+				q.b2 = n.z * d * weight;
+				q.c = d * d * weight;
+				q.w = weight;
+				return q;
+			}
+
+			Quadric& operator+=(Quadric const& q)
+			{
+				a00 += q.a00; a11 += q.a11; a22 += q.a22;
+				a10 += q.a10; a20 += q.a20; a21 += q.a21;
+				b0 += q.b0; b1 += q.b1; b2 += q.b2;
+				c += q.c;
+				w += q.w;
+				return *this;
+			}
+
+			//weighted mean of the squared distances to the planes, so it doesn't grow with the area the quadric has gathered
+			float Error(Vector3 const& p) const
+			{
+				float const rx = a00 * p.x + a10 * p.y + a20 * p.z;
+				float const ry = a10 * p.x + a11 * p.y + a21 * p.z;
+				float const rz = a20 * p.x + a21 * p.y + a22 * p.z;
+				float const r = rx * p.x + ry * p.y + rz * p.z + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return w > 0.0f ? std::abs(r) / w : 0.0f;
+			}
+		};
+
+		struct EdgeCollapse
+		{
+			uint32 source;
+			uint32 target;
+			float error;
+		};
+
+		uint64 EdgeKey(uint32 a, uint32 b)
+		{
+			return a < b ? ((uint64)a << 32) | b : ((uint64)b << 32) | a;
+		}
+	}
+
+	namespace MeshSimplifier
+	{
+		uint64 Simplify(std::span<uint32> destination, std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			uint64 target_index_count, float target_error, float* result_error)
+		{
+			ADRIA_ASSERT(indices.size() % 3 == 0 && destination.size() >= indices.size());
+			std::vector<uint32> result(std::begin(indices), std::end(indices));
+			float max_collapse_error = 0.0f;
+
+			if (result.size() > target_index_count && vertex_count > 0)
+			{
+				auto Position = [&](uint64 vertex) -> Vector3 const& { return *reinterpret_cast<Vector3 const*>(reinterpret_cast<uint8 const*>(positions) + vertex * stride); };
+
+				//vertices that share a position are welded, topology and quadrics work on the first of them
+				std::vector<uint32> position_ids(vertex_count);
+				std::vector<uint32> wedge_counts(vertex_count, 0);
+				{
+					std::unordered_map<std::string_view, uint32> welded;
+					welded.reserve(vertex_count);
+					for (uint64 v = 0; v < vertex_count; ++v)
+					{
+						auto [it, inserted] = welded.try_emplace(std::string_view(reinterpret_cast<char const*>(&Position(v)), sizeof(Vector3)), (uint32)v);
+						position_ids[v] = it->second;
+						++wedge_counts[it->second];
+					}
+				}
+				auto Pid = [&](uint32 vertex) { return position_ids[vertex]; };
+
+				//normalized to the largest extent so errors don't depend on the scale of the mesh
+				Vector3 bounds_min(std::numeric_limits<float>::max()), bounds_max(std::numeric_limits<float>::lowest());
+				for (uint64 v = 0; v < vertex_count; ++v)
+				{
+					bounds_min = Vector3::Min(bounds_min, Position(v));
+					bounds_max = Vector3::Max(bounds_max, Position(v));
+				}
+				float const extent = std::max({ bounds_max.x - bounds_min.x, bounds_max.y - bounds_min.y, bounds_max.z - bounds_min.z });
+				float const scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+				std::vector<Vector3> points(vertex_count);
+				for (uint64 v = 0; v < vertex_count; ++v) points[v] = (Position(v) - bounds_min) * scale;
+
+				std::unordered_map<uint64, uint32> edge_counts;
+				auto CountEdges = [&]()
+				{
+					edge_counts.clear();
+					for (uint64 i = 0; i < result.size(); i += 3)
+					{
+						for (uint32 k = 0; k < 3; ++k) ++edge_counts[EdgeKey(Pid(result[i + k]), Pid(result[i + (k + 1) % 3]))];
+					}
+				};
+				CountEdges();
+
+				std::vector<VertexKind> kinds(vertex_count, VertexKind::Manifold);
+				for (uint64 v = 0; v < vertex_count; ++v)
+				{
+					if (wedge_counts[v] > 1) kinds[v] = VertexKind::Locked;
+				}
+				for (auto const& [key, count] : edge_counts)
+				{
+					if (count == 2) continue;
+					VertexKind const kind = count == 1 ? VertexKind::Border : VertexKind::Locked;
+					for (uint32 pid : { (uint32)(key >> 32), (uint32)(key & 0xffffffff) }) kinds[pid] = std::max(kinds[pid], kind);
+				}
+
+				//area weighted triangle planes, border edges add a perpendicular plane that keeps the border in place
+				std::vector<Quadric> quadrics(vertex_count);
+				for (uint64 i = 0; i < result.size(); i += 3)
+				{
+					uint32 const pids[3] = { Pid(result[i + 0]), Pid(result[i + 1]), Pid(result[i + 2]) };
+					Vector3 normal = (points[pids[1]] - points[pids[0]]).Cross(points[pids[2]] - points[pids[0]]);
+					float const area = normal.Length();
+					if (area == 0.0f) continue;
+					normal /= area;
+
+					Quadric const plane = Quadric::FromPlane(normal, -normal.Dot(points[pids[0]]), area);
+					for (uint32 pid : pids) quadrics[pid] += plane;
+
+					for (uint32 k = 0; k < 3; ++k)
+					{
+						uint32 const p0 = pids[k], p1 = pids[(k + 1) % 3];
+						if (edge_counts[EdgeKey(p0, p1)] != 1) continue;
+						Vector3 const edge = points[p1] - points[p0];
+						Vector3 border_normal = edge.Cross(normal);
+						border_normal.Normalize();
+						Quadric const border = Quadric::FromPlane(border_normal, -border_normal.Dot(points[p0]), edge.LengthSquared() * BORDER_WEIGHT);
+						quadrics[p0] += border;
+						quadrics[p1] += border;
+					}
+				}
+
+				float const max_error_sq = target_error * target_error;
+				std::vector<uint32> collapse_targets(vertex_count, INVALID_VERTEX);
+				std::vector<bool> touched(vertex_count);
+				std::vector<uint32> adjacency_offsets(vertex_count + 1);
+				std::vector<uint32> adjacency;
+				std::vector<EdgeCollapse> collapses;
+
+				//moving source onto target must not flip any of the triangles around source that survive the collapse
+				auto Flips = [&](uint32 source_pid, uint32 target_pid)
+				{
+					for (uint32 j = adjacency_offsets[source_pid]; j < adjacency_offsets[source_pid + 1]; ++j)
+					{
+						uint32 const* triangle = &result[adjacency[j] * 3ull];
+						uint32 pids[3] = { Pid(triangle[0]), Pid(triangle[1]), Pid(triangle[2]) };
+						if (pids[0] == target_pid || pids[1] == target_pid || pids[2] == target_pid) continue;
+
+						Vector3 const before = (points[pids[1]] - points[pids[0]]).Cross(points[pids[2]] - points[pids[0]]);
+						for (uint32& pid : pids) if (pid == source_pid) pid = target_pid;
+						Vector3 const after = (points[pids[1]] - points[pids[0]]).Cross(points[pids[2]] - points[pids[0]]);
+						if (before.Dot(after) <= 0.0f) return true;
+					}
+					return false;
+				};
+
+				//each pass collapses the cheapest edges whose neighbourhoods don't overlap and then rebuilds the topology
+				while (result.size() > target_index_count)
+				{
+					std::fill(std::begin(adjacency_offsets), std::end(adjacency_offsets), 0);
+					for (uint32 index : result) ++adjacency_offsets[Pid(index) + 1];
+					std::inclusive_scan(std::begin(adjacency_offsets), std::end(adjacency_offsets), std::begin(adjacency_offsets));
+					adjacency.resize(result.size());
+					{
+						std::vector<uint32> cursors(std::begin(adjacency_offsets), std::end(adjacency_offsets) - 1);
+						for (uint64 i = 0; i < result.size(); ++i) adjacency[cursors[Pid(result[i])]++] = (uint32)(i / 3);
+					}
+
+					collapses.clear();
+					auto AddCollapse = [&](uint32 source, uint32 target)
+					{
+						uint32 const source_pid = Pid(source), target_pid = Pid(target);
+						if (source_pid == target_pid || kinds[source_pid] == VertexKind::Locked) return;
+						if (kinds[source_pid] == VertexKind::Border && edge_counts[EdgeKey(source_pid, target_pid)] != 1) return;
+						collapses.push_back(EdgeCollapse{ source, target, quadrics[source_pid].Error(points[target_pid]) });
+					};
+					for (uint64 i = 0; i < result.size(); i += 3)
+					{
+						for (uint32 k = 0; k < 3; ++k)
+						{
+							AddCollapse(result[i + k], result[i + (k + 1) % 3]);
+							AddCollapse(result[i + (k + 1) % 3], result[i + k]);
+						}
+					}
+					std::sort(std::begin(collapses), std::end(collapses), [](EdgeCollapse const& a, EdgeCollapse const& b) { return a.error < b.error; });
+
+					std::fill(std::begin(touched), std::end(touched), false);
+					uint64 const triangles_to_remove = (result.size() - target_index_count + 2) / 3;
+					uint64 removed_triangles = 0;
+					bool collapsed = false;
+					for (EdgeCollapse const& collapse : collapses)
+					{
+						if (collapse.error > max_error_sq) break;
+						uint32 const source_pid = Pid(collapse.source), target_pid = Pid(collapse.target);
+						if (touched[source_pid] || touched[target_pid] || Flips(source_pid, target_pid)) continue;
+
+						for (uint32 j = adjacency_offsets[source_pid]; j < adjacency_offsets[source_pid + 1]; ++j)
+						{
+							uint32 const* triangle = &result[adjacency[j] * 3ull];
+							bool removed = false;
+							for (uint32 k = 0; k < 3; ++k)
+							{
+								touched[Pid(triangle[k])] = true;
+								removed |= Pid(triangle[k]) == target_pid;
+							}
+							removed_triangles += removed;
+						}
+						collapse_targets[collapse.source] = collapse.target;
+						quadrics[target_pid] += quadrics[source_pid];
+						max_collapse_error = std::max(max_collapse_error, collapse.error);
+						collapsed = true;
+						if (removed_triangles >= triangles_to_remove) break;
+					}
+					if (!collapsed) break;
+
+					uint64 write = 0;
+					for (uint64 i = 0; i < result.size(); i += 3)
+					{
+						uint32 triangle[3];
+						for (uint32 k = 0; k < 3; ++k)
+						{
+							uint32 const index = result[i + k];
+							triangle[k] = collapse_targets[index] != INVALID_VERTEX ? collapse_targets[index] : index;
+						}
+						if (Pid(triangle[0]) == Pid(triangle[1]) || Pid(triangle[1]) == Pid(triangle[2]) || Pid(triangle[0]) == Pid(triangle[2])) continue;
+						std::copy(triangle, triangle + 3, &result[write]);
+						write += 3;
+					}
+					result.resize(write);
+					std::fill(std::begin(collapse_targets), std::end(collapse_targets), INVALID_VERTEX);
+					CountEdges();
+				}
+			}
+
+			std::copy(std::begin(result), std::end(result), std::begin(destination));
+			if (result_error) *result_error = std::sqrt(max_collapse_error);
+			return result.size();
+		}
+
+		uint32 GenerateLods(std::vector<uint32>& indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			std::span<MeshLodLevel> levels, MeshLodDesc const& desc)
+		{
+			ADRIA_ASSERT(!levels.empty());
+			levels[0] = MeshLodLevel{ 0, (uint32)indices.size(), 0.0f };
+			uint32 const max_levels = std::min<uint32>(desc.max_levels, (uint32)levels.size());
+
+			//every level is simplified from level 0, so its error is measured against the source mesh and not against the previous level
+			uint32 level_count = 1;
+			std::vector<uint32> const source(std::begin(indices), std::end(indices));
+			std::vector<uint32> simplified(source.size()), optimized;
+			while (level_count < max_levels)
+			{
+				MeshLodLevel const previous = levels[level_count - 1];
+				uint64 const target_index_count = (uint64)(previous.index_count * desc.reduction) / 3 * 3;
+				if (target_index_count < 3) break;
+
+				float error = 0.0f;
+				uint64 const index_count = Simplify(simplified, source, positions, vertex_count, stride, target_index_count, desc.max_error, &error);
+				if (index_count == 0 || index_count > previous.index_count * desc.min_reduction) break;
+
+				optimized.resize(index_count);
+				MeshOptimizer::OptimizeVertexCache(optimized, std::span<uint32 const>(simplified.data(), index_count), vertex_count);
+
+				levels[level_count++] = MeshLodLevel{ (uint32)indices.size(), (uint32)index_count, std::max(previous.error, error) };
+				indices.insert(std::end(indices), std::begin(optimized), std::end(optimized));
+			}
+			return level_count;
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	inline constexpr uint32 MESH_LOD_MAX_LEVELS = 5;
+
+	struct MeshLodLevel
+	{
+		uint32 start_index = 0;
+		uint32 index_count = 0;
+		float error = 0.0f;		//largest distance from the source surface, relative to the largest extent of the mesh
+	};
+
+	struct MeshLodDesc
+	{
+		uint32 max_levels = MESH_LOD_MAX_LEVELS;
+		float reduction = 0.5f;		//target index count of a level relative to the previous one
+		float max_error = 0.05f;	//largest error of any level, relative to the largest extent of the mesh
+		float min_reduction = 0.85f; //the chain stops once a level keeps more than this fraction of the previous one
+	};
+
+	//backend and vertex format independent, works on triangle lists with 32 bit indices
+	namespace MeshSimplifier
+	{
+		/* Quadric error metric edge collapses onto existing vertices, so every level can keep using the same vertex buffer.
+		   Positions shared by several vertices (attribute seams) stay in place and border vertices only collapse along the border.
+		   Stops at target_index_count or target_error, returns the index count written to destination and the error in result_error.
+		   Errors are the root of the area weighted mean squared distance to the planes merged into a vertex, relative to the largest extent. */
+		uint64 Simplify(std::span<uint32> destination, std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			uint64 target_index_count, float target_error, float* result_error = nullptr);
+
+		/* Appends simplified levels after indices, each one built from the previous level and ordered for the vertex cache.
+		   Fills levels starting with the source indices as level 0 and returns the level count. */
+		uint32 GenerateLods(std::vector<uint32>& indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			std::span<MeshLodLevel> levels, MeshLodDesc const& desc = {});
+	}
+}
@@ -0,0 +1,157 @@
+#include "Meshlets.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr float MIN_CONE_SPREAD = 0.1f; //smallest dot product between a face normal and the cone axis that still allows backface culling
+
+		struct MeshletTriangle
+		{
+			Vector3 p0;
+			Vector3 normal;
+		};
+
+		/* Bounding sphere and the normal cone of the triangles. The apex is placed so that every triangle plane is behind it,
+		   a meshlet is backfacing when the view direction to the apex lies within the cone. */
+		Meshlet MakeMeshlet(std::span<uint32 const> indices, uint64 start_index, uint32 vertex_count, Vector3 const* positions, uint32 stride)
+		{
+			auto Position = [&](uint32 vertex) -> Vector3 const& { return *reinterpret_cast<Vector3 const*>(reinterpret_cast<uint8 const*>(positions) + (uint64)vertex * stride); };
+
+			std::vector<Vector3> points(indices.size());
+			for (uint64 i = 0; i < indices.size(); ++i) points[i] = Position(indices[i]);
+			BoundingSphere sphere;
+			BoundingSphere::CreateFromPoints(sphere, points.size(), points.data(), sizeof(Vector3));
+
+			Meshlet meshlet{};
+			meshlet.center = sphere.Center;
+			meshlet.radius = sphere.Radius;
+			meshlet.cone_apex = meshlet.center;
+			meshlet.cone_axis = Vector3(0.0f, 1.0f, 0.0f);
+			meshlet.cone_cutoff = 1.0f;
+			meshlet.vertex_count = vertex_count;
+			meshlet.start_index = (uint32)start_index;
+			meshlet.index_count = (uint32)indices.size();
+
+			std::vector<MeshletTriangle> triangles;
+			triangles.reserve(indices.size() / 3);
+			Vector3 axis{};
+			for (uint64 i = 0; i < points.size(); i += 3)
+			{
+				Vector3 normal = (points[i + 1] - points[i]).Cross(points[i + 2] - points[i]);
+				float const length = normal.Length();
+				if (length == 0.0f) continue;
+				normal /= length;
+				triangles.push_back(MeshletTriangle{ points[i], normal });
+				axis += normal;
+			}
+			if (triangles.empty() || axis.Length() == 0.0f) return meshlet;
+			axis.Normalize();
+
+			float min_dot = 1.0f;
+			for (MeshletTriangle const& triangle : triangles) min_dot = std::min(min_dot, triangle.normal.Dot(axis));
+			if (min_dot <= MIN_CONE_SPREAD) return meshlet;
+
+			float max_t = 0.0f;
+			for (MeshletTriangle const& triangle : triangles)
+			{
+				float const t = (meshlet.center - triangle.p0).Dot(triangle.normal) / axis.Dot(triangle.normal);
+				max_t = std::max(max_t, t);
+			}
+			meshlet.cone_apex = meshlet.center - axis * max_t;
+			meshlet.cone_axis = axis;
+			meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+			return meshlet;
+		}
+	}
+
+	namespace Meshlets
+	{
+		std::vector<Meshlet> Build(std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride, uint32 max_vertices, uint32 max_triangles)
+		{
+			ADRIA_ASSERT(indices.size() % 3 == 0 && max_vertices >= 3 && max_triangles > 0);
+			std::vector<Meshlet> meshlets;
+
+			//vertices of the current meshlet are marked with its index
+			std::vector<uint32> vertex_marks(vertex_count, uint32(-1));
+			uint64 meshlet_start = 0;
+			uint32 meshlet_vertices = 0;
+			auto NewVertices = [&](uint64 i)
+			{
+				uint32 const mark = (uint32)meshlets.size();
+				uint32 const a = indices[i], b = indices[i + 1], c = indices[i + 2];
+				return (uint32)(vertex_marks[a] != mark) + (uint32)(vertex_marks[b] != mark && b != a) + (uint32)(vertex_marks[c] != mark && c != a && c != b);
+			};
+
+			for (uint64 i = 0; i < indices.size(); i += 3)
+			{
+				uint32 new_vertices = NewVertices(i);
+				if (meshlet_vertices + new_vertices > max_vertices || (i - meshlet_start) / 3 + 1 > max_triangles)
+				{
+					meshlets.push_back(MakeMeshlet(indices.subspan(meshlet_start, i - meshlet_start), meshlet_start, meshlet_vertices, positions, stride));
+					meshlet_start = i;
+					meshlet_vertices = 0;
+					new_vertices = NewVertices(i);
+				}
+				for (uint32 k = 0; k < 3; ++k) vertex_marks[indices[i + k]] = (uint32)meshlets.size();
+				meshlet_vertices += new_vertices;
+			}
+			if (meshlet_start < indices.size())
+			{
+				meshlets.push_back(MakeMeshlet(indices.subspan(meshlet_start), meshlet_start, meshlet_vertices, positions, stride));
+			}
+			return meshlets;
+		}
+
+		MeshletCullStatistics Cull(std::span<Meshlet const> meshlets, BoundingFrustum const& frustum, Vector3 const& view_position,
+			bool backface_culling, std::vector<MeshIndexRange>& ranges, uint32 max_ranges)
+		{
+			MeshletCullStatistics statistics{};
+			ranges.clear();
+			for (Meshlet const& meshlet : meshlets)
+			{
+				++statistics.meshlet_count;
+				statistics.triangle_count += meshlet.index_count / 3;
+				if (!frustum.Intersects(BoundingSphere(meshlet.center, meshlet.radius))) continue;
+				if (backface_culling && meshlet.cone_cutoff < 1.0f)
+				{
+					Vector3 view_direction = meshlet.cone_apex - view_position;
+					view_direction.Normalize();
+					if (view_direction.Dot(meshlet.cone_axis) >= meshlet.cone_cutoff) continue;
+				}
+
+				++statistics.visible_meshlet_count;
+				statistics.visible_triangle_count += meshlet.index_count / 3;
+				if (!ranges.empty() && ranges.back().start_index + ranges.back().index_count == meshlet.start_index) ranges.back().index_count += meshlet.index_count;
+				else ranges.push_back(MeshIndexRange{ meshlet.start_index, meshlet.index_count });
+			}
+
+			if (max_ranges > 0 && ranges.size() > max_ranges)
+			{
+				//gaps at least as large as the (max_ranges - 1)th largest one stay open, the rest are drawn through
+				std::vector<uint32> gaps(ranges.size() - 1);
+				for (uint64 i = 0; i + 1 < ranges.size(); ++i) gaps[i] = ranges[i + 1].start_index - (ranges[i].start_index + ranges[i].index_count);
+				std::vector<uint32> sorted_gaps(gaps);
+				uint64 const open_gaps = max_ranges - 1;
+				uint32 threshold = std::numeric_limits<uint32>::max();
+				if (open_gaps > 0)
+				{
+					std::nth_element(std::begin(sorted_gaps), std::end(sorted_gaps) - open_gaps, std::end(sorted_gaps));
+					threshold = *(std::end(sorted_gaps) - open_gaps);
+				}
+
+				uint64 last = 0;
+				for (uint64 i = 1; i < ranges.size(); ++i)
+				{
+					if (gaps[i - 1] < threshold) ranges[last].index_count = ranges[i].start_index + ranges[i].index_count - ranges[last].start_index;
+					else ranges[++last] = ranges[i];
+				}
+				ranges.resize(last + 1);
+			}
+
+			statistics.range_count = ranges.size();
+			for (MeshIndexRange const& range : ranges) statistics.drawn_triangle_count += range.index_count / 3;
+			return statistics;
+		}
+	}
+}
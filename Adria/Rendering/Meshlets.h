@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	inline constexpr uint32 MESHLET_MAX_VERTICES = 64;
+	inline constexpr uint32 MESHLET_MAX_TRIANGLES = 124;
+
+	//a contiguous range of triangles in the index buffer, in the space of the mesh
+	struct Meshlet
+	{
+		Vector3 center;
+		float radius;
+		Vector3 cone_apex;
+		float cone_cutoff;		//1 when the normals are too spread out for backface culling
+		Vector3 cone_axis;
+		uint32 vertex_count;
+		uint32 start_index;
+		uint32 index_count;
+	};
+
+	struct MeshIndexRange
+	{
+		uint32 start_index;
+		uint32 index_count;
+	};
+
+	struct MeshletCullStatistics
+	{
+		uint64 meshlet_count = 0;
+		uint64 visible_meshlet_count = 0;
+		uint64 triangle_count = 0;
+		uint64 visible_triangle_count = 0;
+		uint64 drawn_triangle_count = 0;	//visible triangles plus the culled ones inside merged ranges
+		uint64 range_count = 0;
+
+		MeshletCullStatistics& operator+=(MeshletCullStatistics const& other)
+		{
+			meshlet_count += other.meshlet_count;
+			visible_meshlet_count += other.visible_meshlet_count;
+			triangle_count += other.triangle_count;
+			visible_triangle_count += other.visible_triangle_count;
+			drawn_triangle_count += other.drawn_triangle_count;
+			range_count += other.range_count;
+			return *this;
+		}
+	};
+
+	//backend independent, so the meshlets can be built and culled without a device
+	namespace Meshlets
+	{
+		/* Splits a triangle list into meshlets in index buffer order, which after the vertex cache optimization keeps them compact.
+		   start_index of the meshlets is relative to indices. */
+		std::vector<Meshlet> Build(std::span<uint32 const> indices, Vector3 const* positions, uint64 vertex_count, uint32 stride,
+			uint32 max_vertices = MESHLET_MAX_VERTICES, uint32 max_triangles = MESHLET_MAX_TRIANGLES);
+
+		/* Culls meshlets against a frustum and, if backface_culling is set, with their normal cones, both in the space of the mesh.
+		   Visible meshlets are written to ranges, neighbouring ones merged into one range. Past max_ranges the ranges are also merged
+		   over the smallest gaps, which trades a few culled triangles for fewer draws. */
+		MeshletCullStatistics Cull(std::span<Meshlet const> meshlets, BoundingFrustum const& frustum, Vector3 const& view_position,
+			bool backface_culling, std::vector<MeshIndexRange>& ranges, uint32 max_ranges = 32);
+	}
+}
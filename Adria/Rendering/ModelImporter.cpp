@@ -1,4 +1,7 @@
 #include <unordered_map>
+#include <execution>
+#include <numeric>
+#include <mutex>
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_EXTERNAL_IMAGE
 #define TINYGLTF_NOEXCEPTION
@@ -9,18 +12,31 @@
 #include "tiny_obj_loader.h"
 
 #include "ModelImporter.h"
+#include "Scatter.h"
+#include "TerrainStreaming.h"
+#include "FoliageCulling.h"
+#include "GridMesh.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "MeshSimplifier.h"
+#include "VertexCompression.h"
 #include "TextureManager.h"
 #include "tecs/registry.h"
 #include "Graphics/GfxDevice.h"
 #include "Graphics/GfxVertexFormat.h"
 #include "Logging/Logger.h"
 #include "Math/BoundingVolumeHelpers.h"
+#include "Math/ComputeNormals.h"
 #include "Math/ComputeTangentFrame.h"
 #include "Utilities/FilesUtil.h"
 #include "Utilities/Random.h"
 #include "Utilities/Heightmap.h"
 #include "Utilities/Image.h"
 #include "Utilities/HashMap.h"
+#include "Utilities/HashUtil.h"
+#include "Utilities/HeightmapCache.h"
+#include "Utilities/Timer.h"
 #include "Utilities/StringUtil.h"
 
 using namespace DirectX;
@@ -28,331 +44,732 @@ namespace adria
 {
     namespace
     {
-		void GenerateTerrainLayerTexture(char const* texture_name, Terrain* terrain, TerrainTextureLayerParameters const& params)
+		/* Layer weights are classified per row with batched terrain queries and then smoothed by BlurTerrainLayerWeights.
+		   The result is cached next to the heightmap cache, keyed by the terrain content and the layer parameters. */
+		std::string WriteTerrainLayerTexture(size_t key, uint64 width, uint64 depth, std::function<void(uint64, std::span<uint32>)> const& classify_row)
 		{
+			std::string const texture_path = HeightmapCache::GetCachePath(key, ".layer.tga");
+			if (fs::exists(texture_path))
+			{
+				ADRIA_LOG(INFO, "Terrain layer texture %016llx found in cache", (unsigned long long)key);
+				return texture_path;
+			}
+
+			Timer t;
+			std::vector<uint64> rows(depth);
+			std::iota(std::begin(rows), std::end(rows), 0);
+
+			std::vector<uint32> weights(width * depth);
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint64 j)
+				{
+					classify_row(j, std::span<uint32>(weights.data() + j * width, width));
+				});
+			float const classification_time = t.MarkInSeconds();
+
+			std::vector<uint8> layer_data(width * depth * 4);
+			memcpy(layer_data.data(), weights.data(), layer_data.size());
+			BlurTerrainLayerWeights(layer_data, width, depth);
+			float const blur_time = t.MarkInSeconds();
+
+			std::error_code ec;
+			fs::create_directories(fs::path(texture_path).parent_path(), ec);
+			WriteImageTGA(texture_path.c_str(), layer_data, (int32)width, (int32)depth);
+			ADRIA_LOG(INFO, "Terrain layer texture %llux%llu generated: classification %f s, blur %f s, write %f s",
+				(unsigned long long)width, (unsigned long long)depth, classification_time, blur_time, t.MarkInSeconds());
+			return texture_path;
+		}
+
+		std::string GenerateTerrainLayerTexture(Terrain const* terrain, TerrainTextureLayerParameters const& params)
+		{
+			size_t key = terrain->ContentHash();
+			HashCombine(key, params.terrain_sand_start);
+			HashCombine(key, params.terrain_sand_end);
+			HashCombine(key, params.terrain_grass_start);
+			HashCombine(key, params.terrain_grass_end);
+			HashCombine(key, params.terrain_slope_grass_start);
+			HashCombine(key, params.terrain_slope_rocks_start);
+			HashCombine(key, params.terrain_rocks_start);
+			HashCombine(key, params.height_mix_zone);
+			HashCombine(key, params.slope_mix_zone);
+
 			auto [width, depth] = terrain->TileCounts();
 			auto [tile_size_x, tile_size_z] = terrain->TileSizes();
+			return WriteTerrainLayerTexture(key, width, depth, [&](uint64 j, std::span<uint32> weights)
+				{
+					std::vector<Vector2> positions(width);
+					std::vector<float> heights(width);
+					std::vector<Vector3> normals(width);
+					for (uint64 i = 0; i < width; ++i) positions[i] = Vector2(i * tile_size_x, j * tile_size_z);
+
+					terrain->HeightAtBatch(positions, heights);
+					terrain->NormalAtBatch(positions, normals);
+					for (uint64 i = 0; i < width; ++i) weights[i] = ComputeTerrainLayerWeights(heights[i], normals[i].y, params);
+				});
+		}
 
-			std::vector<BYTE> temp_layer_data(width * depth * 4);
-			std::vector<BYTE> layer_data(width * depth * 4);
-			for (uint64 j = 0; j < depth; ++j)
-			{
-				for (uint64 i = 0; i < width; ++i)
+		//finest mip of a tiled terrain that fits in a layer texture
+		uint32 TerrainLayerTextureMip(TerrainTileCache const& tile_cache)
+		{
+			static constexpr uint64 MAX_LAYER_TEXTURE_SIZE = 4096;
+
+			uint32 mip = 0;
+			while (mip + 1 < tile_cache.MipCount() && std::max(tile_cache.Mip(mip).width, tile_cache.Mip(mip).depth) > MAX_LAYER_TEXTURE_SIZE) ++mip;
+			return mip;
+		}
+
+		//the weights were classified when the tiles were generated, the texture takes them from the finest mip that fits in it
+		std::string GenerateTerrainLayerTexture(TerrainTileCache const& tile_cache)
+		{
+			uint32 const mip = TerrainLayerTextureMip(tile_cache);
+			TerrainTileMip const& layer_mip = tile_cache.Mip(mip);
+
+			size_t key = tile_cache.ContentHash();
+			HashCombine(key, mip);
+			//rows are only requested on a cache miss, the first one reads the whole mip
+			std::vector<uint32> mip_weights;
+			std::once_flag read_flag;
+			return WriteTerrainLayerTexture(key, layer_mip.width, layer_mip.depth, [&](uint64 j, std::span<uint32> weights)
 				{
-					float x = i * tile_size_x;
-					float z = j * tile_size_z;
+					std::call_once(read_flag, [&]() { mip_weights = tile_cache.ReadMipLayerWeights(mip); });
+					std::copy_n(mip_weights.data() + j * layer_mip.width, layer_mip.width, weights.data());
+				});
+		}
 
-					float height = terrain->HeightAt(x, z);
-					float normal_y = terrain->NormalAt(x, z).y;
+		//reads back the layer texture, texel_size is the distance between the terrain samples it was made from
+		std::unique_ptr<TerrainLayerMap> LoadTerrainLayerMap(std::string const& layer_texture, Vector2 const& texel_size)
+		{
+			Image image(layer_texture, 4);
+			if (!image.Data<uint32>()) return nullptr;
 
-					if (height > params.terrain_rocks_start)
-					{
-						float mix_multiplier = std::max(
-							(height - params.terrain_rocks_start) / params.height_mix_zone,
-							1.0f
-						);
-						float rock_slope_multiplier = std::clamp((normal_y - params.terrain_slope_rocks_start) / params.slope_mix_zone, 0.0f, 1.0f);
-						temp_layer_data[(j * width + i) * 4 + 0] = (BYTE) (BYTE_MAX * mix_multiplier * rock_slope_multiplier);
-					}
+			uint32 const* texels = image.Data<uint32>();
+			return std::make_unique<TerrainLayerMap>(std::vector<uint32>(texels, texels + uint64(image.Width()) * image.Height()),
+				image.Width(), image.Height(), texel_size);
+		}
 
-					if (height > params.terrain_sand_start && height <= params.terrain_sand_end)
-					{
-                        float mix_multiplier = std::min(
-                            (height-params.terrain_sand_start) / params.height_mix_zone,
-                            (params.terrain_sand_end - height) / params.height_mix_zone
-						);
-						temp_layer_data[(j * width + i) * 4 + 1] = (BYTE) (BYTE_MAX * mix_multiplier);
-					}
+		//scatter keeps a point with the probability of the weight of the layer below it
+		void SetLayerDensityMask(ScatterRules& rules, std::optional<TerrainLayer> layer)
+		{
+			TerrainLayerMap const* layer_map = TerrainComponent::layer_map.get();
+			if (!layer || !layer_map) return;
+			rules.density_mask = [layer_map, layer = *layer](Vector3 const& position, Vector3 const&)
+			{
+				return layer_map->Weight(layer, position.x, position.z);
+			};
+		}
 
-					if (height > params.terrain_grass_start && height <= params.terrain_grass_end)
-					{
-						float mix_multiplier = std::min(
-							(height - params.terrain_grass_start) / params.height_mix_zone,
-							(params.terrain_grass_end - height) / params.height_mix_zone
-						);
+		//poisson-disk scattering gives ~0.7 points per min_distance^2, so a cell holds ~400 instances
+		float FoliageCellSize(float min_distance)
+		{
+			return 24.0f * min_distance;
+		}
 
-						float grass_slope_multiplier = std::clamp((normal_y - params.terrain_slope_grass_start) / params.slope_mix_zone, 0.0f, 1.0f);
-                        temp_layer_data[(j * width + i) * 4 + 2] = (BYTE)(BYTE_MAX * mix_multiplier * grass_slope_multiplier);
-					}
+		void SetupFoliageInstances(tecs::registry& reg, GfxDevice* gfx, tecs::entity e, std::shared_ptr<FoliageCellGrid const> const& cell_grid,
+			FoliageLod const& lod, float instance_scale)
+		{
+			uint64 const instance_count = std::max<uint64>(cell_grid->instances.size(), 1);
+			auto& aabb = reg.get<AABB>(e);
+			Vector3 const extents(aabb.bounding_box.Extents);
+
+			Foliage foliage{};
+			foliage.cell_grid = cell_grid;
+			foliage.lod = lod;
+			foliage.instance_extent = 2.0f * std::max({ extents.x, extents.y, extents.z }) * instance_scale;
+			foliage.camera_instance_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(instance_count, sizeof(ScatterInstance), true));
+			foliage.shadow_instance_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(instance_count, sizeof(ScatterInstance), true));
+			reg.emplace<Foliage>(e, foliage);
+
+			auto& mesh_component = reg.get<Mesh>(e);
+			mesh_component.instance_buffer = foliage.camera_instance_buffer;
+			mesh_component.start_instance_location = 0;
+			mesh_component.instance_count = 0;
 
-					uint32 sum = temp_layer_data[(j * width + i) * 4 + 0]
-						+ temp_layer_data[(j * width + i) * 4 + 1] + temp_layer_data[(j * width + i) * 4 + 2] + 1;
+			aabb.bounding_box = FoliageCulling::GridBounds(*cell_grid);
+			aabb.skip_culling = false;
+			aabb.UpdateBuffer(gfx);
+		}
 
-					temp_layer_data[(j * width + i) * 4 + 0] = (BYTE)((temp_layer_data[(j * width + i) * 4 + 0] * 1.0f / sum) * BYTE_MAX);
-					temp_layer_data[(j * width + i) * 4 + 1] = (BYTE)((temp_layer_data[(j * width + i) * 4 + 1] * 1.0f / sum) * BYTE_MAX);
-					temp_layer_data[(j * width + i) * 4 + 2] = (BYTE)((temp_layer_data[(j * width + i) * 4 + 2] * 1.0f / sum) * BYTE_MAX);
-				}
+		struct GLTFPrimitive
+		{
+			uint64 mesh_index;
+			tinygltf::Primitive const* primitive;
+			std::vector<CompleteVertex> vertices;
+			std::vector<uint32> indices;
+			GfxPrimitiveTopology topology;
+			BoundingBox bounding_box;
+			MeshOptimizationStatistics optimization_statistics;
+			MeshLodLevel lods[MESH_LOD_MAX_LEVELS];
+			uint32 lod_count = 1;
+			std::vector<Meshlet> meshlets;
+			std::vector<CompressedVertex> compressed_vertices;
+			VertexQuantization quantization;
+			VertexCompressionError compression_error;
+		};
+
+		GfxPrimitiveTopology ConvertGLTFTopology(int mode)
+		{
+			switch (mode)
+			{
+			case TINYGLTF_MODE_POINTS:
+				return GfxPrimitiveTopology::PointList;
+			case TINYGLTF_MODE_LINE:
+				return GfxPrimitiveTopology::LineList;
+			case TINYGLTF_MODE_LINE_STRIP:
+				return GfxPrimitiveTopology::LineStrip;
+			case TINYGLTF_MODE_TRIANGLES:
+				return GfxPrimitiveTopology::TriangleList;
+			case TINYGLTF_MODE_TRIANGLE_STRIP:
+				return GfxPrimitiveTopology::TriangleStrip;
+			default:
+				ADRIA_ASSERT(false);
 			}
+			return GfxPrimitiveTopology::TriangleList;
+		}
 
-			layer_data = temp_layer_data;
+		unsigned char const* GetAccessorData(tinygltf::Model const& model, tinygltf::Accessor const& accessor, int& stride)
+		{
+			tinygltf::BufferView const& buffer_view = model.bufferViews[accessor.bufferView];
+			tinygltf::Buffer const& buffer = model.buffers[buffer_view.buffer];
+			stride = accessor.ByteStride(buffer_view);
+			return buffer.data.data() + accessor.byteOffset + buffer_view.byteOffset;
+		}
 
-			for (size_t j = 2; j < depth - 2; ++j)
+		//only reads the shared, immutable model, so primitives can be assembled concurrently
+		void LoadGLTFPrimitive(tinygltf::Model const& model, GLTFPrimitive& gltf_primitive, bool flip_normals)
+		{
+			tinygltf::Primitive const& primitive = *gltf_primitive.primitive;
+			gltf_primitive.topology = ConvertGLTFTopology(primitive.mode);
+
+			ADRIA_ASSERT(primitive.indices >= 0);
+			tinygltf::Accessor const& index_accessor = model.accessors[primitive.indices];
+			int index_stride = 0;
+			unsigned char const* index_data = GetAccessorData(model, index_accessor, index_stride);
+			std::vector<uint32>& indices = gltf_primitive.indices;
+			indices.resize(index_accessor.count);
+			if (index_stride == 1)
+			{
+				for (size_t i = 0; i < indices.size(); ++i) indices[i] = index_data[i];
+			}
+			else if (index_stride == 2)
+			{
+				for (size_t i = 0; i < indices.size(); ++i) indices[i] = reinterpret_cast<uint16 const*>(index_data)[i];
+			}
+			else if (index_stride == 4)
 			{
-				for (size_t i = 2; i < width - 2; ++i)
+				memcpy(indices.data(), index_data, indices.size() * sizeof(uint32));
+			}
+			else ADRIA_ASSERT(false);
+
+			auto position_attribute = primitive.attributes.find("POSITION");
+			ADRIA_ASSERT(position_attribute != primitive.attributes.end());
+			std::vector<CompleteVertex>& vertices = gltf_primitive.vertices;
+			vertices.resize(model.accessors[position_attribute->second].count);
+
+			bool has_normals = false;
+			bool has_uvs = false;
+			std::vector<float> tangent_handedness;
+			for (auto const& [attr_name, attr_data] : primitive.attributes)
+			{
+				tinygltf::Accessor const& accessor = model.accessors[attr_data];
+				int stride = 0;
+				unsigned char const* data = GetAccessorData(model, accessor, stride);
+				size_t const vertex_count = std::min<size_t>(accessor.count, vertices.size());
+
+				if (attr_name == "POSITION")
+				{
+					for (size_t i = 0; i < vertex_count; ++i) vertices[i].position = *reinterpret_cast<Vector3 const*>(data + i * stride);
+				}
+				else if (attr_name == "NORMAL")
 				{
-					int32 n1 = 0, n2 = 0, n3 = 0, n4 = 0;
-					for (int32 k = -2; k <= 2; ++k)
+					has_normals = true;
+					for (size_t i = 0; i < vertex_count; ++i)
 					{
-						for (int32 l = -2; l <= 2; ++l)
+						vertices[i].normal = *reinterpret_cast<Vector3 const*>(data + i * stride);
+						if (flip_normals) vertices[i].normal *= -1.0f;
+					}
+				}
+				else if (attr_name == "TANGENT")
+				{
+					tangent_handedness.resize(vertices.size(), 1.0f);
+					for (size_t i = 0; i < vertex_count; ++i)
+					{
+						Vector4 tangent = *reinterpret_cast<Vector4 const*>(data + i * stride);
+						vertices[i].tangent = Vector3(tangent.x, tangent.y, tangent.z);
+						tangent_handedness[i] = tangent.w;
+					}
+				}
+				else if (attr_name == "TEXCOORD_0")
+				{
+					has_uvs = true;
+					if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
+					{
+						for (size_t i = 0; i < vertex_count; ++i)
 						{
-							n1 += (int32)temp_layer_data[((j + k) * width + i + l) * 4 + 0];
-							n2 += (int32)temp_layer_data[((j + k) * width + i + l) * 4 + 1];
-							n3 += (int32)temp_layer_data[((j + k) * width + i + l) * 4 + 2];
+							Vector2 tex = *reinterpret_cast<Vector2 const*>(data + i * stride);
+							vertices[i].uv = Vector2(tex.x, 1.0f - tex.y);
 						}
 					}
-            
-					layer_data[(j * width + i) * 4 + 0] = (BYTE)(n1 / 25);
-					layer_data[(j * width + i) * 4 + 1] = (BYTE)(n2 / 25);
-					layer_data[(j * width + i) * 4 + 2] = (BYTE)(n3 / 25);
+					else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+					{
+						for (size_t i = 0; i < vertex_count; ++i)
+						{
+							uint8 const* tex = data + i * stride;
+							vertices[i].uv = Vector2(tex[0] / 255.0f, 1.0f - tex[1] / 255.0f);
+						}
+					}
+					else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+					{
+						for (size_t i = 0; i < vertex_count; ++i)
+						{
+							uint16 const* tex = reinterpret_cast<uint16 const*>(data + i * stride);
+							vertices[i].uv = Vector2(tex[0] / 65535.0f, 1.0f - tex[1] / 65535.0f);
+						}
+					}
+				}
+			}
+
+			if (!has_normals && gltf_primitive.topology == GfxPrimitiveTopology::TriangleList)
+			{
+				ComputeNormals(std::execution::par, ENormalCalculation::AreaWeight, vertices, indices);
+			}
+			if (!tangent_handedness.empty())
+			{
+				for (size_t i = 0; i < vertices.size(); ++i)
+				{
+					Vector3 bitangent = vertices[i].normal.Cross(vertices[i].tangent) * tangent_handedness[i];
+					bitangent.Normalize();
+					vertices[i].bitangent = bitangent;
 				}
 			}
+			else if (has_uvs && gltf_primitive.topology == GfxPrimitiveTopology::TriangleList)
+			{
+				ComputeTangentFrame(std::execution::par, vertices, indices);
+			}
 
-			WriteImageTGA(texture_name, layer_data, (int32)width, (int32)depth);
+			gltf_primitive.lods[0] = MeshLodLevel{ 0, (uint32)indices.size(), 0.0f };
+			if (gltf_primitive.topology == GfxPrimitiveTopology::TriangleList && !vertices.empty())
+			{
+				gltf_primitive.optimization_statistics = MeshOptimizer::OptimizeMesh(vertices, indices);
+				gltf_primitive.lod_count = MeshSimplifier::GenerateLods(indices, &vertices[0].position, vertices.size(), sizeof(CompleteVertex), gltf_primitive.lods);
+				gltf_primitive.meshlets = Meshlets::Build(std::span<uint32 const>(indices).first(gltf_primitive.lods[0].index_count),
+					&vertices[0].position, vertices.size(), sizeof(CompleteVertex));
+			}
+			gltf_primitive.bounding_box = vertices.empty() ? BoundingBox() : AABBFromRange(vertices.begin(), vertices.end());
+
+			//positions are quantized to the bounds of the primitive, the full precision vertices are not needed after this
+			gltf_primitive.quantization = VertexCompression::ComputeQuantization(gltf_primitive.bounding_box);
+			gltf_primitive.compressed_vertices.resize(vertices.size());
+			VertexCompression::Compress(vertices, gltf_primitive.quantization, gltf_primitive.compressed_vertices);
+			gltf_primitive.compression_error = VertexCompression::MeasureError(vertices, gltf_primitive.compressed_vertices, gltf_primitive.quantization);
+			std::vector<CompleteVertex>().swap(vertices);
 		}
-    }
 
-    using namespace tecs;
+		//texture uris are stored without the textures path, the same cache serves any textures directory
+		MeshCacheMaterial RecordGLTFMaterial(tinygltf::Model const& model, tinygltf::Material const& gltf_material, std::vector<std::string>& strings)
+		{
+			auto RecordMaterialTexture = [&](int texture_index)
+			{
+				tinygltf::Texture const& texture = model.textures[texture_index];
+				strings.push_back(model.images[texture.source].uri);
+				return (int32)strings.size() - 1;
+			};
 
-    std::vector<entity> ModelImporter::LoadGrid(GridParameters const& params, std::vector<TexturedNormalVertex>* vertices_out)
-    {
-        if (params.heightmap)
-        {
-            ADRIA_ASSERT(params.heightmap->Depth() == params.tile_count_z + 1);
-            ADRIA_ASSERT(params.heightmap->Width() == params.tile_count_x + 1);
-        }
+			MeshCacheMaterial material{};
+			tinygltf::PbrMetallicRoughness const& pbr_metallic_roughness = gltf_material.pbrMetallicRoughness;
+			if (pbr_metallic_roughness.baseColorTexture.index >= 0)
+			{
+				material.albedo_texture = RecordMaterialTexture(pbr_metallic_roughness.baseColorTexture.index);
+				material.albedo_factor = (float)pbr_metallic_roughness.baseColorFactor[0];
+			}
+			if (pbr_metallic_roughness.metallicRoughnessTexture.index >= 0)
+			{
+				material.metallic_roughness_texture = RecordMaterialTexture(pbr_metallic_roughness.metallicRoughnessTexture.index);
+				material.metallic_factor = (float)pbr_metallic_roughness.metallicFactor;
+				material.roughness_factor = (float)pbr_metallic_roughness.roughnessFactor;
+			}
+			if (gltf_material.normalTexture.index >= 0)
+			{
+				material.normal_texture = RecordMaterialTexture(gltf_material.normalTexture.index);
+			}
+			if (gltf_material.emissiveTexture.index >= 0)
+			{
+				material.emissive_texture = RecordMaterialTexture(gltf_material.emissiveTexture.index);
+				material.emissive_factor = (float)gltf_material.emissiveFactor[0];
+			}
+			material.alpha_cutoff = (float)gltf_material.alphaCutoff;
+			material.double_sided = gltf_material.doubleSided;
+			if (gltf_material.alphaMode == "BLEND") material.alpha_mode = (uint32)MaterialAlphaMode::Blend;
+			else if (gltf_material.alphaMode == "MASK") material.alpha_mode = (uint32)MaterialAlphaMode::Mask;
+			else material.alpha_mode = (uint32)MaterialAlphaMode::Opaque;
+			return material;
+		}
 
-        std::vector<entity> chunks;
-        std::vector<TexturedNormalVertex> vertices{};
-        for (uint64 j = 0; j <= params.tile_count_z; j++)
-        {
-            for (uint64 i = 0; i <= params.tile_count_x; i++)
-            {
-                TexturedNormalVertex vertex{};
+		//triangles drawn at each level by all submeshes together, submeshes with fewer levels stay at their coarsest one
+		void LogLodStatistics(std::string const& model_name, std::span<MeshCacheSubmesh const> submeshes)
+		{
+			uint64 triangle_counts[MESH_LOD_MAX_LEVELS]{};
+			float max_errors[MESH_LOD_MAX_LEVELS]{};
+			uint32 level_count = 1;
+			for (MeshCacheSubmesh const& submesh : submeshes) level_count = std::max(level_count, submesh.lod_count);
+			for (MeshCacheSubmesh const& submesh : submeshes)
+			{
+				for (uint32 lod = 0; lod < level_count; ++lod)
+				{
+					MeshLodLevel const& level = submesh.lods[std::min(lod, std::max(submesh.lod_count, 1u) - 1)];
+					triangle_counts[lod] += level.index_count / 3;
+					max_errors[lod] = std::max(max_errors[lod], level.error);
+				}
+			}
+			for (uint32 lod = 0; lod < level_count; ++lod)
+			{
+				ADRIA_LOG(INFO, "%s LOD %u: %llu triangles (%.1f%% of LOD 0), max error %.4f of the mesh extent", model_name.c_str(), lod,
+					(unsigned long long)triangle_counts[lod], 100.0 * triangle_counts[lod] / std::max<uint64>(triangle_counts[0], 1), max_errors[lod]);
+			}
+		}
 
-                float height = params.heightmap ? params.heightmap->HeightAt(i, j) : 0.0f;
+		//shared by freshly imported and cached models, the vertex and index streams are uploaded straight from the cache
+		std::vector<tecs::entity> CreateGLTFEntities(tecs::registry& reg, GfxDevice* gfx, MeshCacheFile const& cache, ModelParameters const& params, std::string const& model_name)
+		{
+			std::span<MeshCacheMaterial const> cached_materials = cache.Materials();
+			auto LoadMaterialTexture = [&](int32 texture, TextureUsage usage)
+			{
+				if (texture == MESH_CACHE_NONE) return INVALID_TEXTURE_HANDLE;
+				return g_TextureManager.LoadTexture(ToWideString(params.textures_path + cache.String(texture)), usage);
+			};
+			std::vector<Material> materials;
+			materials.reserve(cached_materials.size());
+			for (MeshCacheMaterial const& cached_material : cached_materials)
+			{
+				Material& material = materials.emplace_back();
+				material.albedo_texture = LoadMaterialTexture(cached_material.albedo_texture, TextureUsage::Albedo);
+				material.normal_texture = LoadMaterialTexture(cached_material.normal_texture, TextureUsage::Normal);
+				material.metallic_roughness_texture = LoadMaterialTexture(cached_material.metallic_roughness_texture, TextureUsage::MetallicRoughness);
+				material.emissive_texture = LoadMaterialTexture(cached_material.emissive_texture, TextureUsage::Emissive);
+				material.albedo_factor = cached_material.albedo_factor;
+				material.metallic_factor = cached_material.metallic_factor;
+				material.roughness_factor = cached_material.roughness_factor;
+				material.emissive_factor = cached_material.emissive_factor;
+				material.alpha_cutoff = cached_material.alpha_cutoff;
+				material.double_sided = cached_material.double_sided != 0;
+				material.alpha_mode = (MaterialAlphaMode)cached_material.alpha_mode;
+				material.shader = material.alpha_mode == MaterialAlphaMode::Opaque ? ShaderProgram::GBufferPBR : ShaderProgram::GBufferPBR_Mask;
+			}
 
-                vertex.position = Vector3(i * params.tile_size_x + params.grid_offset.x, 
-                    height + params.grid_offset.y, j * params.tile_size_z + params.grid_offset.z);
-                vertex.uv = Vector2(i * 1.0f * params.texture_scale_x / (params.tile_count_x - 1), j * 1.0f * params.texture_scale_z / (params.tile_count_z - 1));
-                vertex.normal = Vector3(0.0f, 1.0f, 0.0f);
-                vertices.push_back(vertex);
-            }
-        }
+			ADRIA_ASSERT(cache.VertexStride() == sizeof(CompressedVertex));
+			std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(cache.VertexCount(), cache.VertexStride()), cache.Vertices());
+			std::shared_ptr<GfxBuffer> ib = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(cache.IndexCount(), false), cache.Indices());
 
-        if (!params.split_to_chunks)
-        {
-            std::vector<uint32> indices{};
-            uint32 i1 = 0;
-            uint32 i2 = 1;
-            uint32 i3 = static_cast<uint32>(i1 + params.tile_count_x + 1);
-            uint32 i4 = static_cast<uint32>(i2 + params.tile_count_x + 1);
-            for (uint64 i = 0; i < params.tile_count_x * params.tile_count_z; ++i)
-            {
-                indices.push_back(i1);
-                indices.push_back(i3);
-                indices.push_back(i2);
-
-
-                indices.push_back(i2);
-                indices.push_back(i3);
-                indices.push_back(i4);
-
-                ++i1;
-                ++i2;
-                ++i3;
-                ++i4;
-
-                if (i1 % (params.tile_count_x + 1) == params.tile_count_x)
-                {
-                    ++i1;
-                    ++i2;
-                    ++i3;
-                    ++i4;
-                }
-            }
-            ComputeNormals(params.normal_type, vertices, indices);
+			//components of every submesh, copied into an entity for each node that references its mesh
+			struct SubmeshComponents
+			{
+				Material material;
+				Mesh mesh;
+				std::optional<MeshLOD> mesh_lod;
+				std::optional<MeshClusters> clusters;
+			};
+			std::span<MeshCacheSubmesh const> submeshes = cache.Submeshes();
+			std::vector<SubmeshComponents> submesh_components(submeshes.size());
+			std::vector<std::vector<size_t>> mesh_submeshes;
+			for (size_t i = 0; i < submeshes.size(); ++i)
+			{
+				MeshCacheSubmesh const& submesh = submeshes[i];
+				SubmeshComponents& components = submesh_components[i];
+				if (submesh.mesh >= (int32)mesh_submeshes.size()) mesh_submeshes.resize(submesh.mesh + 1);
+				mesh_submeshes[submesh.mesh].push_back(i);
+
+				if (submesh.material != MESH_CACHE_NONE) components.material = materials[submesh.material];
+				else components.material.shader = ShaderProgram::GBufferPBR;
+
+				Mesh& mesh_component = components.mesh;
+				mesh_component.vertex_buffer = vb;
+				mesh_component.index_buffer = ib;
+				mesh_component.indices_count = submesh.index_count;
+				mesh_component.start_index_location = submesh.start_index;
+				mesh_component.base_vertex_location = static_cast<int32>(submesh.base_vertex);
+				mesh_component.vertex_count = submesh.vertex_count;
+				mesh_component.topology = static_cast<GfxPrimitiveTopology>(submesh.topology);
+				mesh_component.compressed_vertices = true;
+				mesh_component.quantization = submesh.quantization;
+
+				if (submesh.lod_count > 1)
+				{
+					MeshLOD& mesh_lod = components.mesh_lod.emplace();
+					std::copy_n(submesh.lods, submesh.lod_count, mesh_lod.levels);
+					mesh_lod.level_count = submesh.lod_count;
+				}
+				if (submesh.meshlet_count > 1)
+				{
+					std::span<Meshlet const> meshlets = cache.Meshlets().subspan(submesh.first_meshlet, submesh.meshlet_count);
+					components.clusters.emplace().meshlets.assign(std::begin(meshlets), std::end(meshlets));
+				}
+			}
 
-            entity grid = reg.create();
-            Mesh mesh{};
-			mesh.vertex_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(vertices.size(), sizeof(TexturedNormalVertex)), vertices.data());
-			mesh.index_buffer = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), false), indices.data());
-            mesh.indices_count = (uint32)indices.size();
- 
-            reg.emplace<Mesh>(grid, mesh);
-            reg.emplace<Transform>(grid);
+			/* Parents are stored first, so their world transforms are ready when the children are reached. A mesh referenced
+			   by several nodes gets entities for each of them, sharing its buffers and material, the renderer instances them. */
+			std::span<MeshCacheNode const> nodes = cache.Nodes();
+			std::vector<Matrix> world_transforms(nodes.size());
+			std::vector<tecs::entity> entities{};
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				MeshCacheNode const& node = nodes[i];
+				world_transforms[i] = node.local_transform * (node.parent != MESH_CACHE_NONE ? world_transforms[node.parent] : params.model_matrix);
+				if (node.mesh == MESH_CACHE_NONE || node.mesh >= (int32)mesh_submeshes.size()) continue;
+
+				Matrix const& model = world_transforms[i];
+				for (size_t submesh_index : mesh_submeshes[node.mesh])
+				{
+					SubmeshComponents const& components = submesh_components[submesh_index];
+					tecs::entity e = reg.create();
+					entities.push_back(e);
+					components.material.AcquireTextures();
+					reg.emplace<Material>(e, components.material);
+					reg.emplace<Deferred>(e);
+					reg.emplace<Mesh>(e, components.mesh);
+					if (components.mesh_lod) reg.emplace<MeshLOD>(e, *components.mesh_lod);
+					if (components.clusters) reg.emplace<MeshClusters>(e, *components.clusters);
+
+					BoundingBox bounding_box = submeshes[submesh_index].bounds;
+					bounding_box.Transform(bounding_box, model);
 
-            BoundingBox bounding_box = AABBFromRange(vertices.begin(), vertices.end());
-			AABB aabb{};
-			aabb.bounding_box = bounding_box;
-			aabb.light_visible = true;
-			aabb.camera_visible = true;
-			aabb.UpdateBuffer(gfx);
-            reg.add<AABB>(grid, aabb);
-			chunks.push_back(grid);
-        }
-        else
-        {
-            std::vector<uint32> indices{};
-            for (size_t j = 0; j < params.tile_count_z; j += params.chunk_count_z)
-            {
-                for (size_t i = 0; i < params.tile_count_x; i += params.chunk_count_x)
-                {
-                    entity chunk = reg.create();
-                    uint32 const indices_count = static_cast<uint32>(params.chunk_count_z * params.chunk_count_x * 3 * 2);
-                    uint32 const indices_offset = static_cast<uint32>(indices.size());
-                    std::vector<TexturedNormalVertex> chunk_vertices_aabb{};
-                    for (size_t k = j; k < j + params.chunk_count_z; ++k)
-                    {
-                        for (size_t m = i; m < i + params.chunk_count_x; ++m)
-                        {
-                            uint32 i1 = static_cast<uint32>(k * (params.tile_count_x + 1) + m);
-                            uint32 i2 = static_cast<uint32>(i1 + 1);
-                            uint32 i3 = static_cast<uint32>((k + 1) * (params.tile_count_x + 1) + m);
-                            uint32 i4 = static_cast<uint32>(i3 + 1);
-
-                            indices.push_back(i1);
-                            indices.push_back(i3);
-                            indices.push_back(i2);
-
-                            indices.push_back(i2);
-                            indices.push_back(i3);
-                            indices.push_back(i4);
-
-                            chunk_vertices_aabb.push_back(vertices[i1]);
-                            chunk_vertices_aabb.push_back(vertices[i2]);
-                            chunk_vertices_aabb.push_back(vertices[i3]);
-                            chunk_vertices_aabb.push_back(vertices[i4]);
-                        }
-                    }
-                    Mesh mesh{};
-                    mesh.indices_count = indices_count;
-                    mesh.start_index_location = indices_offset;
-
-                    reg.emplace<Mesh>(chunk, mesh);
-                    reg.emplace<Transform>(chunk);
-                    
-					BoundingBox bounding_box = AABBFromRange(chunk_vertices_aabb.begin(), chunk_vertices_aabb.end());
 					AABB aabb{};
 					aabb.bounding_box = bounding_box;
 					aabb.light_visible = true;
 					aabb.camera_visible = true;
 					aabb.UpdateBuffer(gfx);
-					reg.add<AABB>(chunk, aabb);
-					chunks.push_back(chunk);
-                }
+					reg.add<AABB>(e, aabb);
+					reg.emplace<Transform>(e, model, model);
+				}
+			}
+
+			//the entities hold their own references, textures of materials no node uses are released here
+			for (Material const& material : materials) material.ReleaseTextures();
+
+			tecs::entity root = reg.create();
+			reg.emplace<Transform>(root);
+			reg.emplace<Tag>(root, model_name);
+			Relationship relationship;
+			relationship.children_count = (uint32)std::min<size_t>(entities.size(), Relationship::MAX_CHILDREN);
+			if (entities.size() > Relationship::MAX_CHILDREN)
+			{
+				ADRIA_LOG(WARNING, "%s has %llu mesh instances, only the first %llu are listed as children of the model", model_name.c_str(), (unsigned long long)entities.size(), (unsigned long long)Relationship::MAX_CHILDREN);
+			}
+			for (size_t i = 0; i < relationship.children_count; ++i)
+			{
+				relationship.children[i] = entities[i];
+			}
+			reg.add<Relationship>(root, relationship);
+
+			size_t i = 0;
+			for (tecs::entity e : entities)
+			{
+				reg.emplace<Tag>(e, model_name + " submesh" + std::to_string(i++));
+				reg.emplace<Relationship>(e, root);
+			}
+			return entities;
+		}
+    }
+
+    using namespace tecs;
+
+    std::vector<entity> ModelImporter::LoadGrid(GridParameters const& params, std::vector<TexturedNormalVertex>* vertices_out)
+    {
+        Timer t;
+        GridMeshDesc grid_desc{};
+        grid_desc.tile_count_x = params.tile_count_x;
+        grid_desc.tile_count_z = params.tile_count_z;
+        grid_desc.tile_size_x = params.tile_size_x;
+        grid_desc.tile_size_z = params.tile_size_z;
+        grid_desc.texture_scale_x = params.texture_scale_x;
+        grid_desc.texture_scale_z = params.texture_scale_z;
+        grid_desc.chunk_tiles_x = params.split_to_chunks ? params.chunk_count_x : params.tile_count_x;
+        grid_desc.chunk_tiles_z = params.split_to_chunks ? params.chunk_count_z : params.tile_count_z;
+        grid_desc.offset = params.grid_offset;
+        GridMesh grid_mesh = GridMeshBuilder::Build(grid_desc, params.heightmap.get());
+        std::vector<TexturedNormalVertex> const& chunk_vertices = grid_mesh.ChunkVertices();
+        float const build_time = t.MarkInSeconds();
+
+        struct GridTopology
+        {
+            std::shared_ptr<GfxBuffer> index_buffer;
+            uint32 indices_count;
+        };
+        HashMap<uint64, GridTopology> topologies;
+        uint64 gpu_memory = chunk_vertices.size() * sizeof(TexturedNormalVertex);
+        auto GetTopology = [&](uint64 tiles_x, uint64 tiles_z) -> GridTopology const&
+        {
+            uint64 const key = (tiles_x << 32) | tiles_z;
+            if (auto it = topologies.find(key); it != topologies.end()) return it->second;
+
+            GridTopology topology{};
+            topology.indices_count = static_cast<uint32>(tiles_x * tiles_z * 6);
+            if ((tiles_x + 1) * (tiles_z + 1) <= UINT16_MAX + 1)
+            {
+                std::vector<uint16> indices;
+                GridMeshBuilder::BuildChunkIndices(tiles_x, tiles_z, indices);
+                topology.index_buffer = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), true), indices.data());
+                gpu_memory += indices.size() * sizeof(uint16);
             }
-            ComputeNormals(params.normal_type, vertices, indices);
-			std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(vertices.size(), sizeof(TexturedNormalVertex)), vertices.data());
-			std::shared_ptr<GfxBuffer> ib = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), false), indices.data());
-            for (entity chunk : chunks)
+            else
             {
-                auto& mesh = reg.get<Mesh>(chunk);
-
-                mesh.vertex_buffer = vb;
-                mesh.index_buffer = ib;
+                std::vector<uint32> indices;
+                GridMeshBuilder::BuildChunkIndices(tiles_x, tiles_z, indices);
+                topology.index_buffer = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), false), indices.data());
+                gpu_memory += indices.size() * sizeof(uint32);
             }
+            return topologies[key] = topology;
+        };
+
+        std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(chunk_vertices.size(), sizeof(TexturedNormalVertex)), chunk_vertices.data());
+        std::vector<entity> chunks;
+        chunks.reserve(grid_mesh.chunks.size());
+        for (GridChunk const& grid_chunk : grid_mesh.chunks)
+        {
+            GridTopology const& topology = GetTopology(grid_chunk.tiles_x, grid_chunk.tiles_z);
+
+            entity chunk = reg.create();
+            Mesh mesh{};
+            mesh.vertex_buffer = vb;
+            mesh.index_buffer = topology.index_buffer;
+            mesh.indices_count = topology.indices_count;
+            mesh.start_index_location = 0;
+            mesh.base_vertex_location = static_cast<int32>(grid_chunk.first_vertex);
+
+            reg.emplace<Mesh>(chunk, mesh);
+            reg.emplace<Transform>(chunk);
+
+            AABB aabb{};
+            aabb.bounding_box = grid_chunk.bounding_box;
+            aabb.light_visible = true;
+            aabb.camera_visible = true;
+            aabb.UpdateBuffer(gfx);
+            reg.add<AABB>(chunk, aabb);
+            chunks.push_back(chunk);
         }
 
-        if (vertices_out) *vertices_out = vertices;
+        ADRIA_LOG(INFO, "Grid %llux%llu built: vertices and chunks %f s, buffers %f s, %llu chunks, %llu index topologies, %.2f MB GPU memory",
+            (unsigned long long)params.tile_count_x, (unsigned long long)params.tile_count_z, build_time, t.MarkInSeconds(),
+            (unsigned long long)chunks.size(), (unsigned long long)topologies.size(), gpu_memory / (1024.0 * 1024.0));
+
+        if (vertices_out) *vertices_out = std::move(grid_mesh.vertices);
         return chunks;
     }
 	std::vector<entity> ModelImporter::LoadObjMesh(std::string const& model_path, std::vector<std::string>* diffuse_textures_out)
 	{
-		tinyobj::ObjReaderConfig reader_config{};
-		tinyobj::ObjReader reader;
+		Timer t;
 		std::string model_name = GetFilename(model_path);
-		if (!reader.ParseFromFile(model_path, reader_config))
-		{
-            if (!reader.Error().empty())
-            {
-                ADRIA_LOG(ERROR, reader.Error().c_str());
-            }
-			return {};
-		}
-		if (!reader.Warning().empty())
+		uint64 const cache_key = MeshCache::ComputeKey(model_path);
+		std::string const cache_path = MeshCache::GetCachePath(cache_key);
+		MeshCacheFile cache;
+		bool const cache_hit = cache.Open(cache_path, cache_key);
+		if (!cache_hit)
 		{
-			ADRIA_LOG(WARNING, reader.Warning().c_str());
-		}
-		tinyobj::attrib_t const& attrib = reader.GetAttrib();
-		std::vector<tinyobj::shape_t> const& shapes = reader.GetShapes();
-        std::vector<tinyobj::material_t> const& materials = reader.GetMaterials();
-		std::vector<entity> entities{};
-        std::vector<std::string> diffuse_textures;
-		for (size_t s = 0; s < shapes.size(); s++)
-		{
-            std::vector<TexturedNormalVertex> vertices{};
-
-			entity e = reg.create();
-			entities.push_back(e);
-
-			size_t index_offset = 0;
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
+			Timer parse_timer;
+			ObjModel obj_model{};
+			if (!ObjLoader::Load(model_path, obj_model)) return {};
+			ADRIA_LOG(INFO, "OBJ Mesh %s parsed in %f s from %llu chunks: %llu triangle corners shared by %llu vertices", model_name.c_str(),
+				parse_timer.ElapsedInSeconds(), (unsigned long long)obj_model.chunk_count, (unsigned long long)obj_model.corner_count,
+				std::accumulate(std::begin(obj_model.shapes), std::end(obj_model.shapes), 0ull, [](unsigned long long sum, ObjShape const& shape) { return sum + shape.vertices.size(); }));
+
+			//shapes are indexed by (v, vt, vn) while parsing and optimized here, all of them share one vertex and one index buffer
+			std::vector<TexturedNormalVertex> vertices{};
+			std::vector<uint32> indices{};
+			MeshCacheData cache_data{};
+			MeshOptimizationStatistics optimization_statistics{};
+			for (size_t s = 0; s < obj_model.shapes.size(); s++)
 			{
-				size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-				for (size_t v = 0; v < fv; v++)
+				std::vector<TexturedNormalVertex>& shape_vertices = obj_model.shapes[s].vertices;
+				std::vector<uint32>& shape_indices = obj_model.shapes[s].indices;
+				optimization_statistics += MeshOptimizer::OptimizeMesh(shape_vertices, shape_indices);
+				MeshLodLevel lods[MESH_LOD_MAX_LEVELS];
+				lods[0] = MeshLodLevel{ 0, (uint32)shape_indices.size(), 0.0f };
+				uint32 const lod_count = shape_vertices.empty() ? 1 :
+					MeshSimplifier::GenerateLods(shape_indices, &shape_vertices[0].position, shape_vertices.size(), sizeof(TexturedNormalVertex), lods);
+
+				MeshCacheSubmesh& submesh = cache_data.submeshes.emplace_back();
+				submesh.bounds = shape_vertices.empty() ? BoundingBox() : AABBFromRange(shape_vertices.begin(), shape_vertices.end());
+				submesh.mesh = static_cast<int32>(s);
+				submesh.topology = static_cast<uint32>(GfxPrimitiveTopology::TriangleList);
+				submesh.start_index = static_cast<uint32>(indices.size());
+				submesh.index_count = lods[0].index_count;
+				submesh.base_vertex = static_cast<uint32>(vertices.size());
+				submesh.vertex_count = static_cast<uint32>(shape_vertices.size());
+				submesh.lod_count = lod_count;
+				submesh.first_meshlet = 0;
+				submesh.meshlet_count = 0;	//drawn instanced, culled per foliage cell
+				for (uint32 lod = 0; lod < lod_count; ++lod)
 				{
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-					TexturedNormalVertex vertex{};
-					tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-					tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
-					tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
-
-					vertex.position.x = vx;
-					vertex.position.y = vy;
-					vertex.position.z = vz;
-
-					// Check if `normal_index` is zero or positive. negative = no normal data
-					if (idx.normal_index >= 0)
-					{
-						tinyobj::real_t nx = attrib.normals[3 * size_t(idx.normal_index) + 0];
-						tinyobj::real_t ny = attrib.normals[3 * size_t(idx.normal_index) + 1];
-						tinyobj::real_t nz = attrib.normals[3 * size_t(idx.normal_index) + 2];
-
-						vertex.normal.x = nx;
-						vertex.normal.y = ny;
-						vertex.normal.z = nz;
-					}
-
-					// Check if `texcoord_index` is zero or positive. negative = no texcoord data
-					if (idx.texcoord_index >= 0)
-					{
-						tinyobj::real_t tx = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
-						tinyobj::real_t ty = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
-
-						vertex.uv.x = tx;
-						vertex.uv.y = ty;
-					}
-
-					vertices.push_back(vertex);
+					submesh.lods[lod] = lods[lod];
+					submesh.lods[lod].start_index += submesh.start_index;
 				}
+				vertices.insert(std::end(vertices), std::begin(shape_vertices), std::end(shape_vertices));
+				indices.insert(std::end(indices), std::begin(shape_indices), std::end(shape_indices));
 
-                index_offset += fv;
+				submesh.material = MESH_CACHE_NONE;
+				int32 const material_id = obj_model.shapes[s].material;
+				if (material_id >= 0)
+				{
+					MeshCacheMaterial& material = cache_data.materials.emplace_back();
+					cache_data.strings.push_back(obj_model.materials[material_id].diffuse_texture);
+					material.albedo_texture = static_cast<int32>(cache_data.strings.size()) - 1;
+					submesh.material = static_cast<int32>(cache_data.materials.size()) - 1;
+				}
 			}
+			cache_data.vertex_stride = sizeof(TexturedNormalVertex);
+			cache_data.vertices = std::span<uint8 const>(reinterpret_cast<uint8 const*>(vertices.data()), vertices.size() * sizeof(TexturedNormalVertex));
+			cache_data.indices = indices;
+			LogLodStatistics(model_name, cache_data.submeshes);
+			ADRIA_LOG(INFO, "OBJ Mesh %s optimized: vertices %llu -> %llu, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", model_name.c_str(),
+				(unsigned long long)optimization_statistics.vertices_before, (unsigned long long)optimization_statistics.vertices_after,
+				optimization_statistics.before.ACMR(), optimization_statistics.after.ACMR(), optimization_statistics.before.ATVR(), optimization_statistics.after.ATVR());
+
+			std::vector<uint8> cache_image = MeshCache::Serialize(cache_key, cache_data);
+			MeshCache::Write(cache_path, cache_image);
+			[[maybe_unused]] bool const cache_valid = cache.Open(std::move(cache_image), cache_key);
+			ADRIA_ASSERT(cache_valid);
+		}
+		float const load_time = t.MarkInSeconds();
 
-			std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(vertices.size(), sizeof(TexturedNormalVertex)), vertices.data());
+		std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(cache.VertexCount(), cache.VertexStride()), cache.Vertices());
+		std::shared_ptr<GfxBuffer> ib = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(cache.IndexCount(), false), cache.Indices());
+		std::span<MeshCacheSubmesh const> submeshes = cache.Submeshes();
+		std::span<MeshCacheMaterial const> cached_materials = cache.Materials();
+		std::vector<entity> entities{};
+		for (MeshCacheSubmesh const& submesh : submeshes)
+		{
+			entity e = reg.create();
+			entities.push_back(e);
 
 			Mesh mesh_component{};
-			mesh_component.base_vertex_location = 0;
-			mesh_component.vertex_count = static_cast<uint32>(vertices.size());
-            mesh_component.vertex_buffer = vb;
+			mesh_component.indices_count = submesh.index_count;
+			mesh_component.start_index_location = submesh.start_index;
+			mesh_component.base_vertex_location = static_cast<int32>(submesh.base_vertex);
+			mesh_component.vertex_count = submesh.vertex_count;
+			mesh_component.vertex_buffer = vb;
+			mesh_component.index_buffer = ib;
 			reg.emplace<Mesh>(e, mesh_component);
 
+			if (submesh.lod_count > 1)
+			{
+				MeshLOD mesh_lod{};
+				std::copy_n(submesh.lods, submesh.lod_count, mesh_lod.levels);
+				mesh_lod.level_count = submesh.lod_count;
+				reg.emplace<MeshLOD>(e, mesh_lod);
+			}
+
+			AABB aabb{};
+			aabb.bounding_box = submesh.bounds;
+			reg.emplace<AABB>(e, aabb);
+
 			reg.emplace<Tag>(e, model_name + " mesh" + std::to_string(as_integer(e)));
 
 			if (diffuse_textures_out)
 			{
-				ADRIA_ASSERT(shapes[s].mesh.material_ids.size() > 0);
-				int material_id = shapes[s].mesh.material_ids[0];
-				ADRIA_ASSERT(material_id >= 0);
-				tinyobj::material_t material = materials[material_id];
-				diffuse_textures_out->push_back(material.diffuse_texname);
+				ADRIA_ASSERT(submesh.material != MESH_CACHE_NONE);
+				diffuse_textures_out->push_back(cache.String(cached_materials[submesh.material].albedo_texture));
 			}
-
 		}
-        ADRIA_LOG(INFO, "OBJ Mesh %s successfully loaded!", model_path.c_str());
+		float const entity_time = t.PeekInSeconds();
+		ADRIA_LOG(INFO, "OBJ Mesh %s successfully loaded %s in %f s (load %f s, entities %f s)!", model_path.c_str(),
+			cache_hit ? "from mesh cache" : "and cached", load_time + entity_time, load_time, entity_time);
 		return entities;
 	}
 
@@ -360,13 +777,28 @@ namespace adria
 
 	std::vector<entity> ModelImporter::ImportModel_GLTF(ModelParameters const& params)
 	{
+		MeshCacheFile cache;
+		if (!ImportMeshCache_GLTF(params, cache)) return {};
+		return CreateEntities_GLTF(params, cache);
+	}
+
+	bool ModelImporter::ImportMeshCache_GLTF(ModelParameters const& params, MeshCacheFile& cache) const
+	{
+		Timer t;
+		std::string model_name = GetFilename(params.model_path);
+		uint64 const cache_key = MeshCache::ComputeKey(params.model_path);
+		std::string const cache_path = MeshCache::GetCachePath(cache_key);
+		if (cache.Open(cache_path, cache_key))
+		{
+			ADRIA_LOG(INFO, "GLTF Mesh %s mapped from %s in %f s!", params.model_path.c_str(), cache_path.c_str(), t.ElapsedInSeconds());
+			return true;
+		}
+
 		tinygltf::TinyGLTF loader;
 		tinygltf::Model model;
 		std::string err;
 		std::string warn;
 		bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, params.model_path);
-
-		std::string model_name = GetFilename(params.model_path);
 		if (!warn.empty())
 		{
 			ADRIA_LOG(WARNING, warn.c_str());
@@ -374,276 +806,122 @@ namespace adria
 		if (!err.empty())
 		{
 			ADRIA_LOG(ERROR, err.c_str());
-			return {};
+			return false;
 		}
 		if (!ret)
 		{
 			ADRIA_LOG(ERROR, "Failed to load model %s", model_name.c_str());
-			return {};
+			return false;
 		}
 
-		std::vector<CompleteVertex> vertices{};
-		std::vector<uint32> indices{};
-		std::vector<entity> entities{};
-		HashMap<std::string, std::vector<entity>> mesh_name_to_entities_map;
-		for (auto& mesh : model.meshes)
+		float const parse_time = t.MarkInSeconds();
+
+		std::vector<GLTFPrimitive> primitives;
+		for (uint64 mesh_index = 0; mesh_index < model.meshes.size(); ++mesh_index)
 		{
-			std::vector<entity>& mesh_entities = mesh_name_to_entities_map[mesh.name];
-			for (auto& primitive : mesh.primitives)
+			for (tinygltf::Primitive const& primitive : model.meshes[mesh_index].primitives)
 			{
-				ADRIA_ASSERT(primitive.indices >= 0);
-				tinygltf::Accessor const& index_accessor = model.accessors[primitive.indices];
-
-				entity e = reg.create();
-				entities.push_back(e);
-				mesh_entities.push_back(e);
-
-				Material material{};
-				tinygltf::Material gltf_material = model.materials[primitive.material];
-				tinygltf::PbrMetallicRoughness pbr_metallic_roughness = gltf_material.pbrMetallicRoughness;
-				if (pbr_metallic_roughness.baseColorTexture.index >= 0)
-				{
-					tinygltf::Texture const& base_texture = model.textures[pbr_metallic_roughness.baseColorTexture.index];
-					tinygltf::Image const& base_image = model.images[base_texture.source];
-					std::string texbase = params.textures_path + base_image.uri;
-					material.albedo_texture = g_TextureManager.LoadTexture(ToWideString(texbase));
-					material.albedo_factor = (float)pbr_metallic_roughness.baseColorFactor[0];
-				}
-				if (pbr_metallic_roughness.metallicRoughnessTexture.index >= 0)
-				{
-					tinygltf::Texture const& metallic_roughness_texture = model.textures[pbr_metallic_roughness.metallicRoughnessTexture.index];
-					tinygltf::Image const& metallic_roughness_image = model.images[metallic_roughness_texture.source];
-					std::string texmetallicroughness = params.textures_path + metallic_roughness_image.uri;
-					material.metallic_roughness_texture = g_TextureManager.LoadTexture(ToWideString(texmetallicroughness));
-					material.metallic_factor = (float)pbr_metallic_roughness.metallicFactor;
-					material.roughness_factor = (float)pbr_metallic_roughness.roughnessFactor;
-				}
-				if (gltf_material.normalTexture.index >= 0)
-				{
-					tinygltf::Texture const& normal_texture = model.textures[gltf_material.normalTexture.index];
-					tinygltf::Image const& normal_image = model.images[normal_texture.source];
-					std::string texnormal = params.textures_path + normal_image.uri;
-					material.normal_texture = g_TextureManager.LoadTexture(ToWideString(texnormal));
-				}
-				if (gltf_material.emissiveTexture.index >= 0)
-				{
-					tinygltf::Texture const& emissive_texture = model.textures[gltf_material.emissiveTexture.index];
-					tinygltf::Image const& emissive_image = model.images[emissive_texture.source];
-					std::string texemissive = params.textures_path + emissive_image.uri;
-					material.emissive_texture = g_TextureManager.LoadTexture(ToWideString(texemissive));
-					material.emissive_factor = (float)gltf_material.emissiveFactor[0];
-				}
-				material.shader = ShaderProgram::GBufferPBR;
-				material.alpha_cutoff = (float)gltf_material.alphaCutoff;
-				material.double_sided = gltf_material.doubleSided;
-				if (gltf_material.alphaMode == "OPAQUE")
-				{
-					material.alpha_mode = MaterialAlphaMode::Opaque;
-					material.shader = ShaderProgram::GBufferPBR;
-				}
-				else if (gltf_material.alphaMode == "BLEND")
-				{
-					material.alpha_mode = MaterialAlphaMode::Blend;
-					material.shader = ShaderProgram::GBufferPBR_Mask;
-				}
-				else if (gltf_material.alphaMode == "MASK")
-				{
-					material.alpha_mode = MaterialAlphaMode::Mask;
-					material.shader = ShaderProgram::GBufferPBR_Mask;
-				}
-
-				reg.emplace<Material>(e, material);
-				reg.emplace<Deferred>(e);
-
-				Mesh mesh_component{};
-				mesh_component.indices_count = static_cast<uint32>(index_accessor.count);
-				mesh_component.start_index_location = static_cast<uint32>(indices.size());
-				mesh_component.base_vertex_location = static_cast<uint32>(vertices.size());
-				switch (primitive.mode)
-				{
-				case TINYGLTF_MODE_POINTS:
-					mesh_component.topology = GfxPrimitiveTopology::PointList;
-					break;
-				case TINYGLTF_MODE_LINE:
-					mesh_component.topology = GfxPrimitiveTopology::LineList;
-					break;
-				case TINYGLTF_MODE_LINE_STRIP:
-					mesh_component.topology = GfxPrimitiveTopology::LineStrip;
-					break;
-				case TINYGLTF_MODE_TRIANGLES:
-					mesh_component.topology = GfxPrimitiveTopology::TriangleList;
-					break;
-				case TINYGLTF_MODE_TRIANGLE_STRIP:
-					mesh_component.topology = GfxPrimitiveTopology::TriangleStrip;
-					break;
-				default:
-					assert(false);
-				}
-
-				tinygltf::Accessor const& accessor = model.accessors[primitive.indices];
-				tinygltf::BufferView const& bufferView = model.bufferViews[accessor.bufferView];
-				tinygltf::Buffer const& buffer = model.buffers[bufferView.buffer];
-
-				int stride = accessor.ByteStride(bufferView);
-				uint32 vertex_offset = mesh_component.base_vertex_location;
-				uint32 index_count = mesh_component.indices_count;
-				uint32 index_offset = mesh_component.start_index_location;
-				indices.reserve(indices.size() + index_count);
-				unsigned char const* data = buffer.data.data() + accessor.byteOffset + bufferView.byteOffset;
-				if (stride == 1)
-				{
-					for (size_t i = 0; i < index_count; i += 3)
-					{
-						indices.push_back(data[i + 0]);
-						indices.push_back(data[i + 1]);
-						indices.push_back(data[i + 2]);
-					}
-				}
-				else if (stride == 2)
-				{
-					for (size_t i = 0; i < index_count; i += 3)
-					{
-						indices.push_back(((uint16*)data)[i + 0]);
-						indices.push_back(((uint16*)data)[i + 1]);
-						indices.push_back(((uint16*)data)[i + 2]);
-					}
-				}
-				else if (stride == 4)
-				{
-					for (size_t i = 0; i < index_count; i += 3)
-					{
-						indices.push_back(((uint32*)data)[i + 0]);
-						indices.push_back(((uint32*)data)[i + 1]);
-						indices.push_back(((uint32*)data)[i + 2]);
-					}
-				}
-				else ADRIA_ASSERT(false);
-
-				std::vector<Vector3> positions;
-				std::vector<Vector3> normals;
-				std::vector<Vector2> uvs;
-				std::vector<Vector3> tangents;
-				std::vector<float>    tangent_handness;
-				std::vector<Vector3>  bitangents;
-				for (auto& attr : primitive.attributes)
-				{
-					std::string const& attr_name = attr.first;
-					int attr_data = attr.second;
-
-					const tinygltf::Accessor& accessor = model.accessors[attr_data];
-					const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-					const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-
-					int stride = accessor.ByteStride(bufferView);
-					size_t vertex_count = accessor.count;
-					const unsigned char* data = buffer.data.data() + accessor.byteOffset + bufferView.byteOffset;
-
-					if (!attr_name.compare("POSITION"))
-					{
-						positions.reserve(vertex_count);
-						for (size_t i = 0; i < vertex_count; ++i)
-						{
-							positions.push_back(*(Vector3*)((size_t)data + i * stride));
-						}
-					}
-					else if (!attr_name.compare("NORMAL"))
-					{
-						normals.reserve(vertex_count);
-						for (size_t i = 0; i < vertex_count; ++i)
-						{
-							normals.push_back(*(Vector3*)((size_t)data + i * stride));
-							if (material.double_sided)
-							{
-								normals.back().x *= -1;
-								normals.back().y *= -1;
-								normals.back().z *= -1;
-							}
-						}
-					}
-					else if (!attr_name.compare("TANGENT"))
-					{
-						tangents.reserve(vertex_count);
-						for (size_t i = 0; i < vertex_count; ++i)
-						{
-							Vector4 tangent = *(Vector4*)((size_t)data + i * stride);
-							tangents.emplace_back(tangent.x, tangent.y, tangent.z);
-							tangent_handness.push_back(tangent.w);
-						}
-					}
-					else if (!attr_name.compare("TEXCOORD_0"))
-					{
-						uvs.reserve(vertex_count);
-						if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
-						{
-							for (size_t i = 0; i < vertex_count; ++i)
-							{
-								Vector2 tex = *(Vector2*)((size_t)data + i * stride);
-								tex.y = 1.0f - tex.y;
-								uvs.push_back(tex);
-							}
-						}
-						else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-						{
-							for (size_t i = 0; i < vertex_count; ++i)
-							{
-								uint8 const& s = *(uint8*)((size_t)data + i * stride + 0 * sizeof(uint8));
-								uint8 const& t = *(uint8*)((size_t)data + i * stride + 1 * sizeof(uint8));
-								uvs.push_back(Vector2(s / 255.0f, 1.0f - t / 255.0f));
-							}
-						}
-						else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-						{
-							for (size_t i = 0; i < vertex_count; ++i)
-							{
-								uint16 const& s = *(uint16*)((size_t)data + i * stride + 0 * sizeof(uint16));
-								uint16 const& t = *(uint16*)((size_t)data + i * stride + 1 * sizeof(uint16));
-								uvs.push_back(Vector2(s / 65535.0f, 1.0f - t / 65535.0f));
-							}
-						}
-					}
-				}
-				bool has_tangents = !tangents.empty();
-				ADRIA_ASSERT(tangent_handness.size() == tangents.size());
-				uint64 vertex_count = positions.size();
-				if (normals.size() != vertex_count) normals.resize(vertex_count);
-				if (uvs.size() != vertex_count) uvs.resize(vertex_count);
-				if (tangents.size() != vertex_count) tangents.resize(vertex_count);
-				if (bitangents.size() != vertex_count) bitangents.resize(vertex_count);
-
-				mesh_component.vertex_count = (uint32)vertex_count;
-				reg.emplace<Mesh>(e, mesh_component);
-				if (has_tangents)
-				{
-					for (uint64 i = 0; i < vertex_count; ++i)
-					{
-						Vector3 bitangent = normals[i].Cross(tangents[i]) * tangent_handness[i];
-						bitangent.Normalize();
-						bitangents[i] = bitangent;
-					}
-				}
-				else
-				{
-					//ComputeTangentFrame(indices.data() + index_offset - index_count, index_count,
-					//	positions.data(), normals.data(), uvs.data(), vertex_count,
-					//	tangents.data(), bitangents.data());
-				}
-
-				vertices.reserve(vertices.size() + vertex_count);
-				for (uint64 i = 0; i < vertex_count; ++i)
-				{
-					vertices.emplace_back(
-						positions[i],
-						uvs[i],
-						normals[i],
-						Vector3(tangents[i].x, tangents[i].y, tangents[i].z),
-						bitangents[i]
-					);
-				}
+				GLTFPrimitive& gltf_primitive = primitives.emplace_back();
+				gltf_primitive.mesh_index = mesh_index;
+				gltf_primitive.primitive = &primitive;
+			}
+		}
+		std::for_each(std::execution::par, std::begin(primitives), std::end(primitives), [&](GLTFPrimitive& gltf_primitive)
+			{
+				int const material_index = gltf_primitive.primitive->material;
+				bool const flip_normals = material_index >= 0 && model.materials[material_index].doubleSided;
+				LoadGLTFPrimitive(model, gltf_primitive, flip_normals);
+			});
+		float const primitive_time = t.MarkInSeconds();
+
+		//ordered merge: the buffers are laid out in primitive order and the entities are created in the same order as before
+		std::vector<uint64> vertex_offsets(primitives.size() + 1, 0);
+		std::vector<uint64> index_offsets(primitives.size() + 1, 0);
+		for (size_t i = 0; i < primitives.size(); ++i)
+		{
+			vertex_offsets[i + 1] = vertex_offsets[i] + primitives[i].compressed_vertices.size();
+			index_offsets[i + 1] = index_offsets[i] + primitives[i].indices.size();
+		}
+		std::vector<CompressedVertex> vertices(vertex_offsets.back());
+		std::vector<uint32> indices(index_offsets.back());
+		std::for_each(std::execution::par, std::begin(primitives), std::end(primitives), [&](GLTFPrimitive const& gltf_primitive)
+			{
+				size_t const i = &gltf_primitive - primitives.data();
+				std::copy(std::begin(gltf_primitive.compressed_vertices), std::end(gltf_primitive.compressed_vertices), std::begin(vertices) + vertex_offsets[i]);
+				std::copy(std::begin(gltf_primitive.indices), std::end(gltf_primitive.indices), std::begin(indices) + index_offsets[i]);
+			});
+		float const merge_time = t.MarkInSeconds();
+
+		MeshOptimizationStatistics optimization_statistics{};
+		for (GLTFPrimitive const& gltf_primitive : primitives) optimization_statistics += gltf_primitive.optimization_statistics;
+		ADRIA_LOG(INFO, "GLTF Mesh %s optimized: vertices %llu -> %llu, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", model_name.c_str(),
+			(unsigned long long)optimization_statistics.vertices_before, (unsigned long long)optimization_statistics.vertices_after,
+			optimization_statistics.before.ACMR(), optimization_statistics.after.ACMR(), optimization_statistics.before.ATVR(), optimization_statistics.after.ATVR());
+
+		VertexCompressionError compression_error{};
+		float position_error_bound = 0.0f;
+		for (GLTFPrimitive const& gltf_primitive : primitives)
+		{
+			compression_error += gltf_primitive.compression_error;
+			position_error_bound = std::max(position_error_bound, VertexCompression::PositionErrorBound(gltf_primitive.quantization));
+		}
+		//geometry memory with full precision vertices against the compressed ones, the 32 bit indices with their lod chains are the same in both
+		auto GeometryBytes = [](uint64 vertex_count, uint64 index_count, uint64 vertex_size) { return vertex_count * vertex_size + index_count * sizeof(uint32); };
+		for (size_t i = 0; i < primitives.size(); ++i)
+		{
+			uint64 const vertex_count = primitives[i].compressed_vertices.size(), index_count = primitives[i].indices.size();
+			ADRIA_LOG(DEBUG, "GLTF Mesh %s primitive %llu: %llu vertices, %llu indices, %.1f KB -> %.1f KB", model_name.c_str(), (unsigned long long)i,
+				(unsigned long long)vertex_count, (unsigned long long)index_count,
+				GeometryBytes(vertex_count, index_count, sizeof(CompleteVertex)) / 1024.0, GeometryBytes(vertex_count, index_count, sizeof(CompressedVertex)) / 1024.0);
+		}
+		uint64 const uncompressed_bytes = GeometryBytes(vertices.size(), indices.size(), sizeof(CompleteVertex));
+		uint64 const compressed_bytes = GeometryBytes(vertices.size(), indices.size(), sizeof(CompressedVertex));
+		ADRIA_LOG(INFO, "GLTF Mesh %s geometry compressed: %.2f MB -> %.2f MB (%.1f%% saved), vertices %.2f MB -> %.2f MB, indices %.2f MB", model_name.c_str(),
+			uncompressed_bytes / (1024.0 * 1024.0), compressed_bytes / (1024.0 * 1024.0), 100.0 * (1.0 - compressed_bytes / (double)std::max<uint64>(uncompressed_bytes, 1)),
+			vertices.size() * sizeof(CompleteVertex) / (1024.0 * 1024.0), vertices.size() * sizeof(CompressedVertex) / (1024.0 * 1024.0),
+			indices.size() * sizeof(uint32) / (1024.0 * 1024.0));
+		ADRIA_LOG(INFO, "GLTF Mesh %s compression error: position %.6f (bound %.6f), normal %.3f deg, tangent %.3f deg, bitangent %.3f deg, uv %.6f", model_name.c_str(),
+			compression_error.position, position_error_bound, compression_error.normal, compression_error.tangent, compression_error.bitangent, compression_error.uv);
+
+		MeshCacheData cache_data{};
+		cache_data.vertex_stride = sizeof(CompressedVertex);
+		cache_data.vertices = std::span<uint8 const>(reinterpret_cast<uint8 const*>(vertices.data()), vertices.size() * sizeof(CompressedVertex));
+		cache_data.indices = indices;
+		cache_data.submeshes.reserve(primitives.size());
+		for (size_t i = 0; i < primitives.size(); ++i)
+		{
+			GLTFPrimitive const& gltf_primitive = primitives[i];
+			MeshCacheSubmesh& submesh = cache_data.submeshes.emplace_back();
+			submesh.bounds = gltf_primitive.bounding_box;
+			submesh.mesh = static_cast<int32>(gltf_primitive.mesh_index);
+			submesh.material = gltf_primitive.primitive->material >= 0 ? gltf_primitive.primitive->material : MESH_CACHE_NONE;
+			submesh.topology = static_cast<uint32>(gltf_primitive.topology);
+			submesh.start_index = static_cast<uint32>(index_offsets[i]);
+			submesh.index_count = gltf_primitive.lods[0].index_count;
+			submesh.base_vertex = static_cast<uint32>(vertex_offsets[i]);
+			submesh.vertex_count = static_cast<uint32>(gltf_primitive.compressed_vertices.size());
+			submesh.quantization = gltf_primitive.quantization;
+			submesh.lod_count = gltf_primitive.lod_count;
+			for (uint32 lod = 0; lod < gltf_primitive.lod_count; ++lod)
+			{
+				submesh.lods[lod] = gltf_primitive.lods[lod];
+				submesh.lods[lod].start_index += submesh.start_index;
+			}
+			submesh.first_meshlet = static_cast<uint32>(cache_data.meshlets.size());
+			submesh.meshlet_count = static_cast<uint32>(gltf_primitive.meshlets.size());
+			for (Meshlet meshlet : gltf_primitive.meshlets)
+			{
+				meshlet.start_index += submesh.start_index;
+				cache_data.meshlets.push_back(meshlet);
 			}
 		}
+		LogLodStatistics(model_name, cache_data.submeshes);
+		ADRIA_LOG(INFO, "GLTF Mesh %s split into %llu meshlets", model_name.c_str(), (unsigned long long)cache_data.meshlets.size());
+		cache_data.materials.reserve(model.materials.size());
+		for (tinygltf::Material const& gltf_material : model.materials) cache_data.materials.push_back(RecordGLTFMaterial(model, gltf_material, cache_data.strings));
 
-		std::function<void(int, Matrix const&)> LoadNode;
-		LoadNode = [&](int node_index, Matrix const& parent_transform)
+		std::function<void(int, int32)> RecordNode;
+		RecordNode = [&](int node_index, int32 parent)
 			{
 				if (node_index < 0) return;
 				auto& node = model.nodes[node_index];
@@ -699,78 +977,65 @@ namespace adria
 				}
 				transforms.Update();
 
-				if (node.mesh >= 0)
-				{
-					auto const& mesh = model.meshes[node.mesh];
-					std::vector<entity> const& mesh_entities = mesh_name_to_entities_map[mesh.name];
-					for (entity e : mesh_entities)
-					{
-						Mesh const& mesh = reg.get<Mesh>(e);
-						Matrix model = transforms.world * parent_transform;
-						BoundingBox bounding_box = AABBFromRange(vertices.begin() + mesh.base_vertex_location, vertices.begin() + mesh.base_vertex_location + mesh.vertex_count);
-						bounding_box.Transform(bounding_box, model);
-
-						AABB aabb{};
-						aabb.bounding_box = bounding_box;
-						aabb.light_visible = true;
-						aabb.camera_visible = true;
-						aabb.UpdateBuffer(gfx);
-						reg.add<AABB>(e, aabb);
-						reg.emplace<Transform>(e, model, model);
-					}
-				}
-
-				for (int child : node.children) LoadNode(child, transforms.world * parent_transform);
+				int32 const cache_node = (int32)cache_data.nodes.size();
+				cache_data.nodes.push_back(MeshCacheNode{ transforms.world, parent, node.mesh >= 0 ? node.mesh : MESH_CACHE_NONE });
+				for (int child : node.children) RecordNode(child, cache_node);
 			};
 		tinygltf::Scene const& scene = model.scenes[std::max(0, model.defaultScene)];
 		for (size_t i = 0; i < scene.nodes.size(); ++i)
 		{
-			LoadNode(scene.nodes[i], params.model_matrix);
+			RecordNode(scene.nodes[i], MESH_CACHE_NONE);
 		}
 
-		std::shared_ptr<GfxBuffer> vb = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(vertices.size(), sizeof(CompleteVertex)), vertices.data());
-		std::shared_ptr<GfxBuffer> ib = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), false), indices.data());
-
-		entity root = reg.create();
-		reg.emplace<Transform>(root);
-		reg.emplace<Tag>(root, model_name);
-		Relationship relationship;
-		relationship.children_count = (uint32)entities.size();
-		ADRIA_ASSERT(relationship.children_count <= Relationship::MAX_CHILDREN);
-		for (size_t i = 0; i < relationship.children_count; ++i)
-		{
-			relationship.children[i] = entities[i];
-		}
-		reg.add<Relationship>(root, relationship);
+		std::vector<uint8> cache_image = MeshCache::Serialize(cache_key, cache_data);
+		MeshCache::Write(cache_path, cache_image);
+		[[maybe_unused]] bool const cache_valid = cache.Open(std::move(cache_image), cache_key);
+		ADRIA_ASSERT(cache_valid);
+		float const cache_time = t.MarkInSeconds();
+		ADRIA_LOG(INFO, "GLTF Mesh %s successfully imported in %f s (parse %f s, %llu primitives %f s, merge %f s, cache write %f s)!",
+			params.model_path.c_str(), parse_time + primitive_time + merge_time + cache_time,
+			parse_time, (unsigned long long)primitives.size(), primitive_time, merge_time, cache_time);
+		return true;
+	}
 
-		size_t i = 0;
-		for (entity e : entities)
-		{
-			auto& mesh = reg.get<Mesh>(e);
-			mesh.vertex_buffer = vb;
-			mesh.index_buffer = ib;
-			reg.emplace<Tag>(e, model_name + " submesh" + std::to_string(i++));
-			reg.emplace<Relationship>(e, root);
-		}
-		
-		ADRIA_LOG(INFO, "GLTF Mesh %s successfully loaded!", params.model_path.c_str());
+	std::vector<entity> ModelImporter::CreateEntities_GLTF(ModelParameters const& params, MeshCacheFile const& cache)
+	{
+		Timer t;
+		std::vector<entity> entities = CreateGLTFEntities(reg, gfx, cache, params, GetFilename(params.model_path));
+		ADRIA_LOG(INFO, "GLTF Mesh %s textures and entities created in %f s!", params.model_path.c_str(), t.ElapsedInSeconds());
 		return entities;
 	}
     entity ModelImporter::LoadSkybox(SkyboxParameters const& params)
+    {
+        entity skybox = CreateSkybox();
+
+        Skybox& sky = reg.get<Skybox>(skybox);
+        if (params.cubemap.has_value() && ToLower(GetExtension(ToString(params.cubemap.value()))) == ".hdr")
+            SetSkyboxEnvironment(skybox, g_TextureManager.LoadEnvironmentMap(params.cubemap.value()));
+        else if (params.cubemap.has_value()) sky.cubemap_texture = g_TextureManager.LoadCubeMap(params.cubemap.value());
+        else sky.cubemap_texture = g_TextureManager.LoadCubeMap(params.cubemap_textures);
+
+        return skybox;
+    }
+    entity ModelImporter::CreateSkybox()
     {
         entity skybox = reg.create();
 
         Skybox sky{};
         sky.active = true;
 
-        if (params.cubemap.has_value()) sky.cubemap_texture = g_TextureManager.LoadCubeMap(params.cubemap.value());
-        else sky.cubemap_texture = g_TextureManager.LoadCubeMap(params.cubemap_textures);
-
         reg.emplace<Skybox>(skybox, sky);
         reg.emplace<Tag>(skybox, "Skybox");
         
         return skybox;
     }
+    void ModelImporter::SetSkyboxEnvironment(entity skybox, EnvironmentMap const& environment_map)
+    {
+        Skybox& sky = reg.get<Skybox>(skybox);
+        sky.cubemap_texture = environment_map.environment;
+        sky.specular_texture = environment_map.specular;
+        sky.irradiance_texture = environment_map.irradiance;
+    }
     entity ModelImporter::LoadLight(LightParameters const& params)
     {
         entity light = reg.create();
@@ -926,6 +1191,8 @@ namespace adria
 	}
     std::vector<entity> ModelImporter::LoadTerrain(TerrainParameters& params)
 	{
+        ClearTerrain();
+
         std::vector<TexturedNormalVertex> vertices;
 		std::vector<entity> terrain_chunks = LoadGrid(params.terrain_grid, &vertices);
 
@@ -938,14 +1205,24 @@ namespace adria
         TerrainComponent::texture_scale = Vector2(params.terrain_grid.texture_scale_x,
             params.terrain_grid.texture_scale_z);
 
-        GenerateTerrainLayerTexture(params.layer_texture.c_str(), TerrainComponent::terrain.get(), params.layer_params);
+        if (params.terrain_grid.heightmap)
+        {
+            TerrainQuadTreeDesc quadtree_desc{};
+            quadtree_desc.tile_size_x = params.terrain_grid.tile_size_x;
+            quadtree_desc.tile_size_z = params.terrain_grid.tile_size_z;
+            quadtree_desc.offset = params.terrain_grid.grid_offset;
+            TerrainComponent::quadtree = std::make_unique<TerrainQuadTree>(*params.terrain_grid.heightmap, quadtree_desc);
+        }
+
+        std::string const layer_texture = GenerateTerrainLayerTexture(TerrainComponent::terrain.get(), params.layer_params);
+        TerrainComponent::layer_map = LoadTerrainLayerMap(layer_texture, Vector2(params.terrain_grid.tile_size_x, params.terrain_grid.tile_size_z));
 
-        TerrainComponent terrain_component{};
+        terrain_component = TerrainComponent{};
 		terrain_component.grass_texture = g_TextureManager.LoadTexture(params.grass_texture);
 		terrain_component.rock_texture = g_TextureManager.LoadTexture(params.rock_texture);
 		terrain_component.base_texture = g_TextureManager.LoadTexture(params.base_texture);
 		terrain_component.sand_texture = g_TextureManager.LoadTexture(params.sand_texture);
-        terrain_component.layer_texture = g_TextureManager.LoadTexture(params.layer_texture);
+        terrain_component.layer_texture = g_TextureManager.LoadTexture(layer_texture);
 
 		for (auto terrain_chunk : terrain_chunks)
 		{
@@ -955,20 +1232,139 @@ namespace adria
 
 		return terrain_chunks;
 	}
-	entity ModelImporter::LoadFoliage(FoliageParameters const& params)
+	bool ModelImporter::LoadTiledTerrain(TiledTerrainParameters const& params)
 	{
-		const float size = params.foliage_scale;
-		
-		struct FoliageInstance
+		auto tile_cache = std::make_unique<TerrainTileCache>(params.path, params.memory_budget);
+		if (!tile_cache->IsValid()) return false;
+
+		ClearTerrain();
+		TerrainComponent::terrain = std::make_unique<Terrain>(*tile_cache);
+		TerrainComponent::tile_cache = std::move(tile_cache);
+		TerrainComponent::texture_scale = params.texture_scale;
+
+		terrain_component = TerrainComponent{};
+		terrain_component.grass_texture = g_TextureManager.LoadTexture(params.grass_texture);
+		terrain_component.rock_texture = g_TextureManager.LoadTexture(params.rock_texture);
+		terrain_component.base_texture = g_TextureManager.LoadTexture(params.base_texture);
+		terrain_component.sand_texture = g_TextureManager.LoadTexture(params.sand_texture);
+		std::string const layer_texture = GenerateTerrainLayerTexture(*TerrainComponent::tile_cache);
+		terrain_component.layer_texture = g_TextureManager.LoadTexture(layer_texture);
+		TerrainTileFileHeader const& header = TerrainComponent::tile_cache->Header();
+		float const layer_texel_scale = float(1u << TerrainLayerTextureMip(*TerrainComponent::tile_cache));
+		TerrainComponent::layer_map = LoadTerrainLayerMap(layer_texture, Vector2(header.sample_spacing_x, header.sample_spacing_z) * layer_texel_scale);
+
+		//every tile has the same topology, samples past the edge of the terrain make degenerate triangles
+		uint64 const resolution = TerrainComponent::tile_cache->TileResolution();
+		auto BuildIndices = [resolution]<typename Index>(std::vector<Index>& indices)
 		{
-			Vector3 position;
-            float rotation_y;
+			indices.reserve(resolution * resolution * 6);
+			for (uint64 k = 0; k < resolution; ++k)
+			{
+				for (uint64 m = 0; m < resolution; ++m)
+				{
+					Index i1 = static_cast<Index>(k * (resolution + 1) + m);
+					Index i2 = static_cast<Index>(i1 + 1);
+					Index i3 = static_cast<Index>((k + 1) * (resolution + 1) + m);
+					Index i4 = static_cast<Index>(i3 + 1);
+
+					indices.push_back(i1);
+					indices.push_back(i3);
+					indices.push_back(i2);
+
+					indices.push_back(i2);
+					indices.push_back(i3);
+					indices.push_back(i4);
+				}
+			}
 		};
+		terrain_tile_indices_count = static_cast<uint32>(resolution * resolution * 6);
+		if ((resolution + 1) * (resolution + 1) <= UINT16_MAX + 1)
+		{
+			std::vector<uint16> indices;
+			BuildIndices(indices);
+			terrain_tile_index_buffer = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), true), indices.data());
+		}
+		else
+		{
+			std::vector<uint32> indices;
+			BuildIndices(indices);
+			terrain_tile_index_buffer = std::make_shared<GfxBuffer>(gfx, IndexBufferDesc(indices.size(), false), indices.data());
+		}
+		return true;
+	}
+	void ModelImporter::StreamTerrainTiles(Vector3 const& camera_position)
+	{
+		TerrainTileCache* tile_cache = TerrainComponent::tile_cache.get();
+		if (!tile_cache || !terrain_tile_index_buffer) return;
 
-		RealRandomGenerator<float> random_x(params.foliage_center.x - params.foliage_extents.x, params.foliage_center.x + params.foliage_extents.x);
-		RealRandomGenerator<float> random_z(params.foliage_center.y - params.foliage_extents.y, params.foliage_center.y + params.foliage_extents.y);
-        RealRandomGenerator<float> random_angle(0.0f, 2.0f * pi<float>);
+		tile_cache->Update(camera_position, TerrainComponent::tile_streaming_radius);
+		std::vector<TerrainTile const*> tiles;
+		tile_cache->SelectTiles(tiles);
 
+		HashMap<uint64, entity> selected_chunks;
+		selected_chunks.reserve(tiles.size());
+		std::vector<TexturedNormalVertex> vertices;
+		for (TerrainTile const* tile : tiles)
+		{
+			uint64 const key = TerrainTileCache::TileKey(tile->mip, tile->x, tile->z);
+			if (auto it = terrain_tile_chunks.find(key); it != terrain_tile_chunks.end())
+			{
+				selected_chunks[key] = it->second;
+				terrain_tile_chunks.erase(it);
+				continue;
+			}
+
+			tile_cache->BuildTileVertices(*tile, TerrainComponent::texture_scale, vertices);
+			entity chunk = reg.create();
+			Mesh mesh{};
+			mesh.vertex_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(vertices.size(), sizeof(TexturedNormalVertex)), vertices.data());
+			mesh.index_buffer = terrain_tile_index_buffer;
+			mesh.indices_count = terrain_tile_indices_count;
+			reg.emplace<Mesh>(chunk, mesh);
+			reg.emplace<Transform>(chunk);
+
+			AABB aabb{};
+			aabb.bounding_box = AABBFromRange(vertices.begin(), vertices.end());
+			aabb.light_visible = true;
+			aabb.camera_visible = true;
+			aabb.UpdateBuffer(gfx);
+			reg.add<AABB>(chunk, aabb);
+			reg.emplace<TerrainComponent>(chunk, terrain_component);
+			reg.emplace<Tag>(chunk, "Terrain Tile " + std::to_string(tile->mip) + " " + std::to_string(tile->x) + " " + std::to_string(tile->z));
+			selected_chunks[key] = chunk;
+		}
+
+		//what is left are the chunks of tiles that were refined, coarsened or evicted
+		DestroyTerrainTileChunks();
+		terrain_tile_chunks = std::move(selected_chunks);
+	}
+	void ModelImporter::ClearTerrain()
+	{
+		DestroyTerrainTileChunks();
+		reg.destroy<TerrainComponent>();
+		terrain_tile_index_buffer = nullptr;
+		terrain_tile_indices_count = 0;
+		terrain_component.ReleaseTextures();
+		terrain_component = TerrainComponent{};
+
+		TerrainComponent::terrain.reset();
+		TerrainComponent::quadtree.reset();
+		TerrainComponent::tile_cache.reset();
+		TerrainComponent::layer_map.reset();
+		++TerrainComponent::generation;
+	}
+	void ModelImporter::DestroyTerrainTileChunks()
+	{
+		for (auto const& [key, chunk] : terrain_tile_chunks)
+		{
+			if (reg.valid(chunk) && reg.has<TerrainComponent>(chunk)) reg.destroy(chunk);
+		}
+		terrain_tile_chunks.clear();
+	}
+	entity ModelImporter::LoadFoliage(FoliageParameters const& params)
+	{
+		const float size = params.foliage_scale;
+		
 		std::vector<entity> foliages;
 
 		switch (params.mesh_texture_pair.first)
@@ -989,64 +1385,40 @@ namespace adria
 		ADRIA_ASSERT(foliages.size() == 1);
 		entity foliage = foliages[0];
 
-		std::vector<FoliageInstance> instance_data{};
-		for (int32 i = 0; i < params.foliage_count; ++i)
-		{
-            static const uint32 MAX_ITERATIONS = 5;
-			Vector3 position{};
-			Vector3 normal{};
-			uint32 iteration = 0;
-			do
-			{
-                if (iteration > MAX_ITERATIONS) break;
-				position.x = random_x();
-				position.z = random_z();
-				position.y = TerrainComponent::terrain ? TerrainComponent::terrain->HeightAt(position.x, position.z) - 0.5f : -0.5f;
-				normal = TerrainComponent::terrain ? TerrainComponent::terrain->NormalAt(position.x, position.z) : Vector3(0.0f, 1.0f, 0.0f);
-
-				++iteration;
-			} while (position.y > params.foliage_height_end || position.y < params.foliage_height_start || normal.y < params.foliage_slope_start);
-
-			if(iteration < MAX_ITERATIONS) instance_data.emplace_back(position, random_angle());
-		}
-
-		auto& mesh_component = reg.get<Mesh>(foliage);
-		mesh_component.instance_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(instance_data.size(), sizeof(FoliageInstance)), instance_data.data());
-		mesh_component.start_instance_location = 0;
-		mesh_component.instance_count = (uint32)instance_data.size();
+		ScatterDesc scatter_desc{};
+		scatter_desc.center = params.foliage_center;
+		scatter_desc.extents = params.foliage_extents;
+		scatter_desc.min_distance = Scatter::MinDistanceForCount(params.foliage_extents, std::max(params.foliage_count, 1));
+		scatter_desc.height_offset = -0.5f;
+		scatter_desc.seed = params.foliage_seed;
+		scatter_desc.rules.height_start = params.foliage_height_start;
+		scatter_desc.rules.height_end = params.foliage_height_end;
+		scatter_desc.rules.slope_start = params.foliage_slope_start;
+		SetLayerDensityMask(scatter_desc.rules, params.foliage_layer);
+		std::vector<ScatterInstance> instance_data = Scatter::Generate(TerrainComponent::terrain.get(), scatter_desc);
+
+		BoundingBox instance_bounds = reg.get<AABB>(foliage).bounding_box;
+		instance_bounds.Transform(instance_bounds, size, Quaternion::Identity, Vector3::Zero);
+		auto cell_grid = std::make_shared<FoliageCellGrid const>(FoliageCulling::BuildCells(instance_data, instance_bounds, FoliageCellSize(scatter_desc.min_distance), params.foliage_seed));
+		SetupFoliageInstances(reg, gfx, foliage, cell_grid, params.foliage_lod, size);
 
 		Material material{};
 		material.albedo_texture = g_TextureManager.LoadTexture(params.mesh_texture_pair.second);
 		material.albedo_factor = 1.0f;
 		material.shader = ShaderProgram::GBuffer_Foliage;
 		reg.emplace<Material>(foliage, material);
-		reg.emplace<Foliage>(foliage);
 
 		Transform transform{};
 		transform.starting_transform = XMMatrixScaling(size, size, size);
 		transform.current_transform = transform.starting_transform;
 		reg.emplace<Transform>(foliage, transform);
 
-		AABB vis{};
-		vis.skip_culling = true;
-		reg.emplace<AABB>(foliage, vis);
-
 		return foliage;
 	}
     std::vector<entity> ModelImporter::LoadTrees(TreeParameters const& params)
 	{
 		const float size = params.tree_scale;
 
-		struct TreeInstance
-		{
-			Vector3 position;
-			float rotation_y;
-		};
-
-		RealRandomGenerator<float> random_x(params.tree_center.x - params.tree_extents.x, params.tree_center.x + params.tree_extents.x);
-		RealRandomGenerator<float> random_z(params.tree_center.y - params.tree_extents.y, params.tree_center.y + params.tree_extents.y);
-		RealRandomGenerator<float> random_angle(0.0f, 2.0f * pi<float>);
-
         std::vector<std::string> diffuse_textures{};
         std::vector<entity> trees;
 
@@ -1065,51 +1437,39 @@ namespace adria
 
         ADRIA_ASSERT(diffuse_textures.size() == trees.size());
 
-		std::vector<TreeInstance> instance_data{};
-		for (int32 i = 0; i < params.tree_count; ++i)
-		{
-			static const uint32 MAX_ITERATIONS = 5;
-			Vector3 position{};
-			Vector3 normal{};
-			uint32 iteration = 0;
-			do
-			{
-				if (iteration > MAX_ITERATIONS) break;
-				position.x = random_x();
-				position.z = random_z();
-				position.y = TerrainComponent::terrain ? TerrainComponent::terrain->HeightAt(position.x, position.z) - 0.5f : -0.5f;
-				normal = TerrainComponent::terrain ? TerrainComponent::terrain->NormalAt(position.x, position.z) : Vector3(0.0f, 1.0f, 0.0f);
-
-				++iteration;
-			} while (position.y > params.tree_height_end || position.y < params.tree_height_start || normal.y < params.tree_slope_start);
-
-			if (iteration < MAX_ITERATIONS) instance_data.emplace_back(position, random_angle());
-		}
+		ScatterDesc scatter_desc{};
+		scatter_desc.center = params.tree_center;
+		scatter_desc.extents = params.tree_extents;
+		scatter_desc.min_distance = Scatter::MinDistanceForCount(params.tree_extents, std::max(params.tree_count, 1));
+		scatter_desc.height_offset = -0.5f;
+		scatter_desc.seed = params.tree_seed;
+		scatter_desc.rules.height_start = params.tree_height_start;
+		scatter_desc.rules.height_end = params.tree_height_end;
+		scatter_desc.rules.slope_start = params.tree_slope_start;
+		SetLayerDensityMask(scatter_desc.rules, params.tree_layer);
+		std::vector<ScatterInstance> instance_data = Scatter::Generate(TerrainComponent::terrain.get(), scatter_desc);
+
+		//all parts of a tree share the cells, so they are bounded by the whole tree
+		BoundingBox instance_bounds = reg.get<AABB>(trees[0]).bounding_box;
+		for (auto tree : trees) BoundingBox::CreateMerged(instance_bounds, instance_bounds, reg.get<AABB>(tree).bounding_box);
+		instance_bounds.Transform(instance_bounds, size, Quaternion::Identity, Vector3::Zero);
+		auto cell_grid = std::make_shared<FoliageCellGrid const>(FoliageCulling::BuildCells(instance_data, instance_bounds, FoliageCellSize(scatter_desc.min_distance), params.tree_seed));
 
         for (size_t i = 0; i < trees.size(); ++i)
         {
             auto tree = trees[i];
-			auto& mesh_component = reg.get<Mesh>(tree);
+			SetupFoliageInstances(reg, gfx, tree, cell_grid, params.tree_lod, size);
 
-			mesh_component.instance_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(instance_data.size(), sizeof(TreeInstance)), instance_data.data());
-			mesh_component.start_instance_location = 0;
-			mesh_component.instance_count = (uint32)instance_data.size();
-			
 			Material material{};
 			material.albedo_texture = g_TextureManager.LoadTexture(texture_path + diffuse_textures[i]);
 			material.albedo_factor = 1.0f;
 			material.shader = ShaderProgram::GBuffer_Foliage;
 			reg.emplace<Material>(tree, material);
-			reg.emplace<Foliage>(tree);
 
 			Transform transform{};
 			transform.starting_transform = XMMatrixScaling(size, size, size);
 			transform.current_transform = transform.starting_transform;
 			reg.emplace<Transform>(tree, transform);
-
-			AABB vis{};
-			vis.skip_culling = true;
-			reg.emplace<AABB>(tree, vis);
         }
 
 		return trees;
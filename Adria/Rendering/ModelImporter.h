@@ -3,9 +3,11 @@
 #include <array>
 #include <vector>
 #include "Components.h"
+#include "MeshCache.h"
+#include "TerrainLayers.h"
 #include "Core/CoreTypes.h"
-#include "Math/ComputeNormals.h"
 #include "Utilities/Heightmap.h"
+#include "Utilities/HashMap.h"
 #include "tecs/entity.h"
 
 namespace adria
@@ -59,7 +61,6 @@ namespace adria
         uint64 chunk_count_x;
         uint64 chunk_count_z;
         bool split_to_chunks = false;
-        ENormalCalculation normal_type = ENormalCalculation::None;
         std::unique_ptr<Heightmap> heightmap = nullptr;
         Vector3 grid_offset = Vector3(0,0,0);
     };
@@ -77,6 +78,9 @@ namespace adria
         float foliage_height_start;
 		float foliage_height_end;
 		float foliage_slope_start;
+        uint32 foliage_seed = 1337;
+        std::optional<TerrainLayer> foliage_layer = TerrainLayer::Grass;	//density follows the weight of the layer, everywhere when empty
+        FoliageLod foliage_lod{};
     };
     struct TreeParameters
     {
@@ -88,19 +92,10 @@ namespace adria
         float tree_height_start;
 		float tree_height_end;
 		float tree_slope_start;
+        uint32 tree_seed = 7331;
+        std::optional<TerrainLayer> tree_layer = TerrainLayer::Grass;
+        FoliageLod tree_lod{ .density_start = 1000.0f, .density_end = 2000.0f, .min_density = 1.0f, .cull_distance = 2000.0f };
     };
-	struct TerrainTextureLayerParameters
-	{
-		float terrain_sand_start = -100.0f;
-		float terrain_sand_end = 0.0f;
-		float terrain_grass_start = 0.0f;
-		float terrain_grass_end = 300.0f;
-		float terrain_slope_grass_start = 0.92f;
-		float terrain_slope_rocks_start = 0.85f;
-		float terrain_rocks_start = 50.0f;
-        float height_mix_zone = 50.0f;
-        float slope_mix_zone = 0.025f;
-	};
 	struct TerrainParameters
 	{
 		GridParameters terrain_grid;
@@ -109,7 +104,16 @@ namespace adria
 		std::string base_texture;
 		std::string rock_texture;
 		std::string sand_texture;
-        std::string layer_texture;
+	};
+	struct TiledTerrainParameters
+	{
+		std::string path;
+		uint64 memory_budget = 256ull << 20;
+		Vector2 texture_scale = Vector2(200.0f, 200.0f);
+		std::string grass_texture;
+		std::string base_texture;
+		std::string rock_texture;
+		std::string sand_texture;
 	};
     struct EmitterParameters
     {
@@ -148,6 +152,7 @@ namespace adria
     }
     class TextureManager;
 	class GfxDevice;
+	struct EnvironmentMap;
 
 	class ModelImporter
 	{
@@ -157,11 +162,23 @@ namespace adria
         ModelImporter(tecs::registry& reg, GfxDevice* gfx);
 
         [[maybe_unused]] std::vector<tecs::entity> ImportModel_GLTF(ModelParameters const&);
+        //ImportModel_GLTF in two steps, the first one only reads and writes files and can run on any thread
+        [[nodiscard]] bool ImportMeshCache_GLTF(ModelParameters const&, MeshCacheFile& cache) const;
+        [[maybe_unused]] std::vector<tecs::entity> CreateEntities_GLTF(ModelParameters const&, MeshCacheFile const& cache);
 
         [[maybe_unused]] tecs::entity LoadSkybox(SkyboxParameters const&);
+        //LoadSkybox for an .hdr environment map in two steps, the sky draws black until its environment is set
+        [[nodiscard]] tecs::entity CreateSkybox();
+        void SetSkyboxEnvironment(tecs::entity skybox, EnvironmentMap const& environment_map);
         [[maybe_unused]] tecs::entity LoadLight(LightParameters const&);
         [[maybe_unused]] std::vector<tecs::entity> LoadOcean(OceanParameters const&);
 		[[maybe_unused]] std::vector<tecs::entity> LoadTerrain(TerrainParameters&);
+		/* Terrain streamed from a tiled terrain file. Its chunks are the tiles selected from the tile cache, created and
+		   destroyed by StreamTerrainTiles, and its height and normal queries go to the resident tiles. */
+		[[maybe_unused]] bool LoadTiledTerrain(TiledTerrainParameters const&);
+		void StreamTerrainTiles(Vector3 const& camera_position);
+		//destroys the terrain chunks, loaded or streamed, and releases the height field, the tile cache, the quadtree and the layer map
+		void ClearTerrain();
 		[[maybe_unused]] tecs::entity LoadFoliage(FoliageParameters const&);
         [[maybe_unused]] std::vector<tecs::entity> LoadTrees(TreeParameters const&);
         [[maybe_unused]] tecs::entity LoadEmitter(EmitterParameters const&);
@@ -171,10 +188,16 @@ namespace adria
         tecs::registry& reg;
 		GfxDevice* gfx;
 
+		HashMap<uint64, tecs::entity> terrain_tile_chunks;
+		TerrainComponent terrain_component{};	//textures of the loaded terrain, copied to its chunks
+		std::shared_ptr<GfxBuffer> terrain_tile_index_buffer;
+		uint32 terrain_tile_indices_count = 0;
+
     private:
 
         [[nodiscard]] std::vector<tecs::entity> LoadObjMesh(std::string const& model_path, std::vector<std::string>* diffuse_textures_out = nullptr);
         [[nodiscard]] std::vector<tecs::entity> LoadGrid(GridParameters const& args, std::vector<TexturedNormalVertex>* vertices = nullptr);
+        void DestroyTerrainTileChunks();
 	};
 }
 
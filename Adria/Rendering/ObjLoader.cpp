@@ -0,0 +1,420 @@
+#include <execution>
+#include <numeric>
+#include <charconv>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include "ObjLoader.h"
+#include "tiny_obj_loader.h"
+#include "Logging/Logger.h"
+#include "Utilities/MemoryMappedFile.h"
+#include "Utilities/FilesUtil.h"
+#include "Utilities/HashUtil.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr uint64 OBJ_CHUNKS_PER_THREAD = 4;
+
+		static constexpr uint8 OBJ_RELATIVE_POSITION = 1 << 0;
+		static constexpr uint8 OBJ_RELATIVE_TEXCOORD = 1 << 1;
+		static constexpr uint8 OBJ_RELATIVE_NORMAL = 1 << 2;
+
+		//zero based indices, negative obj indices are resolved against the chunk and marked relative until the chunks are merged
+		struct ObjCorner
+		{
+			int32 position = -1;
+			int32 texcoord = -1;
+			int32 normal = -1;
+			uint8 relative = 0;
+			bool has_texcoord = false;
+			bool has_normal = false;
+		};
+
+		//merged corner, -1 for a missing texcoord or normal
+		struct ObjTriplet
+		{
+			int32 position;
+			int32 texcoord;
+			int32 normal;
+
+			bool operator==(ObjTriplet const&) const = default;
+		};
+
+		struct ObjTripletHash
+		{
+			size_t operator()(ObjTriplet const& triplet) const
+			{
+				size_t seed = 0;
+				HashCombine(seed, triplet.position);
+				HashCombine(seed, triplet.texcoord);
+				HashCombine(seed, triplet.normal);
+				return seed;
+			}
+		};
+
+		enum class ObjEventType : uint8
+		{
+			Shape,
+			Material
+		};
+
+		//o, g and usemtl lines, they apply to the corners of the chunk from corner on
+		struct ObjEvent
+		{
+			ObjEventType type;
+			uint64 corner;
+			std::string name;
+		};
+
+		struct ObjChunk
+		{
+			std::vector<Vector3> positions;
+			std::vector<Vector2> texcoords;
+			std::vector<Vector3> normals;
+			std::vector<ObjCorner> corners;
+			std::vector<ObjEvent> events;
+			std::vector<std::string> material_libraries;
+			uint64 invalid_lines = 0;
+		};
+
+		struct ObjShapeRange
+		{
+			std::string name;
+			int32 material;
+			uint64 begin;	//corners
+			uint64 end;
+		};
+
+		bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		char const* SkipSpaces(char const* p, char const* end)
+		{
+			while (p != end && IsSpace(*p)) ++p;
+			return p;
+		}
+
+		bool ParseFloat(char const*& p, char const* end, float& value)
+		{
+			p = SkipSpaces(p, end);
+			if (p != end && *p == '+') ++p;
+			auto const [next, error] = std::from_chars(p, end, value);
+			if (error != std::errc()) return false;
+			p = next;
+			return true;
+		}
+
+		//obj indices are one based, negative ones count back from the last element read so far
+		bool ParseIndex(char const*& p, char const* end, uint64 count, int32& index, bool& relative)
+		{
+			int32 value = 0;
+			auto const [next, error] = std::from_chars(p, end, value);
+			if (error != std::errc() || value == 0) return false;
+			p = next;
+			relative = value < 0;
+			index = relative ? (int32)count + value : value - 1;
+			return true;
+		}
+
+		std::string ParseName(char const* p, char const* end)
+		{
+			p = SkipSpaces(p, end);
+			while (end != p && IsSpace(*(end - 1))) --end;
+			return std::string(p, end);
+		}
+
+		bool ParseFace(char const* p, char const* end, ObjChunk& chunk, std::vector<ObjCorner>& polygon)
+		{
+			polygon.clear();
+			while ((p = SkipSpaces(p, end)) != end)
+			{
+				ObjCorner corner{};
+				bool relative = false;
+				if (!ParseIndex(p, end, chunk.positions.size(), corner.position, relative)) return false;
+				if (relative) corner.relative |= OBJ_RELATIVE_POSITION;
+				if (p != end && *p == '/')
+				{
+					++p;
+					if (p != end && *p != '/')
+					{
+						if (!ParseIndex(p, end, chunk.texcoords.size(), corner.texcoord, relative)) return false;
+						if (relative) corner.relative |= OBJ_RELATIVE_TEXCOORD;
+						corner.has_texcoord = true;
+					}
+					if (p != end && *p == '/')
+					{
+						++p;
+						if (!ParseIndex(p, end, chunk.normals.size(), corner.normal, relative)) return false;
+						if (relative) corner.relative |= OBJ_RELATIVE_NORMAL;
+						corner.has_normal = true;
+					}
+				}
+				if (p != end && !IsSpace(*p)) return false;
+				polygon.push_back(corner);
+			}
+			if (polygon.size() < 3) return false;
+
+			for (uint64 i = 1; i + 1 < polygon.size(); ++i)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i]);
+				chunk.corners.push_back(polygon[i + 1]);
+			}
+			return true;
+		}
+
+		void ParseLine(char const* p, char const* end, ObjChunk& chunk, std::vector<ObjCorner>& polygon)
+		{
+			p = SkipSpaces(p, end);
+			char const* keyword_end = p;
+			while (keyword_end != end && !IsSpace(*keyword_end)) ++keyword_end;
+			std::string_view const keyword(p, keyword_end - p);
+			p = keyword_end;
+
+			bool valid = true;
+			if (keyword == "v")
+			{
+				Vector3& position = chunk.positions.emplace_back();
+				valid = ParseFloat(p, end, position.x) && ParseFloat(p, end, position.y) && ParseFloat(p, end, position.z);
+			}
+			else if (keyword == "vt")
+			{
+				Vector2& texcoord = chunk.texcoords.emplace_back();
+				valid = ParseFloat(p, end, texcoord.x);
+				if (valid) ParseFloat(p, end, texcoord.y);
+			}
+			else if (keyword == "vn")
+			{
+				Vector3& normal = chunk.normals.emplace_back();
+				valid = ParseFloat(p, end, normal.x) && ParseFloat(p, end, normal.y) && ParseFloat(p, end, normal.z);
+			}
+			else if (keyword == "f")
+			{
+				valid = ParseFace(p, end, chunk, polygon);
+			}
+			else if (keyword == "o" || keyword == "g")
+			{
+				chunk.events.push_back(ObjEvent{ ObjEventType::Shape, chunk.corners.size(), ParseName(p, end) });
+			}
+			else if (keyword == "usemtl")
+			{
+				chunk.events.push_back(ObjEvent{ ObjEventType::Material, chunk.corners.size(), ParseName(p, end) });
+			}
+			else if (keyword == "mtllib")
+			{
+				chunk.material_libraries.push_back(ParseName(p, end));
+			}
+			if (!valid) ++chunk.invalid_lines;
+		}
+
+		void ParseChunk(char const* begin, char const* end, ObjChunk& chunk)
+		{
+			std::vector<ObjCorner> polygon;
+			while (begin != end)
+			{
+				char const* line_end = static_cast<char const*>(memchr(begin, '\n', end - begin));
+				if (!line_end) line_end = end;
+				ParseLine(begin, line_end, chunk, polygon);
+				begin = line_end == end ? end : line_end + 1;
+			}
+		}
+
+		//byte ranges that start at the beginning of a line
+		std::vector<std::pair<uint64, uint64>> SplitIntoChunks(char const* data, uint64 size, uint64 min_chunk_size)
+		{
+			uint64 const thread_count = std::max(1u, std::thread::hardware_concurrency());
+			uint64 const chunk_count = std::clamp<uint64>(size / std::max<uint64>(min_chunk_size, 1), 1, thread_count * OBJ_CHUNKS_PER_THREAD);
+
+			std::vector<std::pair<uint64, uint64>> chunks;
+			uint64 begin = 0;
+			for (uint64 i = 1; i <= chunk_count; ++i)
+			{
+				uint64 end = size * i / chunk_count;
+				if (end < size)
+				{
+					void const* newline = memchr(data + end, '\n', size - end);
+					end = newline ? static_cast<char const*>(newline) - data + 1 : size;
+				}
+				if (end <= begin) continue;
+				chunks.emplace_back(begin, end);
+				begin = end;
+			}
+			return chunks;
+		}
+
+		void LoadMaterials(std::string const& obj_path, std::vector<std::string> const& libraries, std::vector<ObjMaterial>& materials,
+			std::map<std::string, int>& material_map)
+		{
+			std::string const directory = GetParentPath(obj_path);
+			std::vector<tinyobj::material_t> obj_materials;
+			for (std::string const& library : libraries)
+			{
+				std::string const library_path = directory.empty() ? library : directory + "/" + library;
+				std::ifstream stream(library_path);
+				if (!stream)
+				{
+					ADRIA_LOG(WARNING, "Material library %s not found", library_path.c_str());
+					continue;
+				}
+				std::string warning, error;
+				tinyobj::LoadMtl(&material_map, &obj_materials, &stream, &warning, &error);
+				if (!warning.empty()) ADRIA_LOG(WARNING, warning.c_str());
+				if (!error.empty()) ADRIA_LOG(ERROR, error.c_str());
+			}
+			for (tinyobj::material_t const& obj_material : obj_materials) materials.push_back(ObjMaterial{ obj_material.name, obj_material.diffuse_texname });
+		}
+	}
+
+	namespace ObjLoader
+	{
+		bool Load(std::string const& path, ObjModel& model, uint64 min_chunk_size)
+		{
+			MemoryMappedFile file;
+			if (!file.Open(path))
+			{
+				ADRIA_LOG(ERROR, "Could not open OBJ file %s", path.c_str());
+				return false;
+			}
+			char const* data = file.As<char const>();
+			std::vector<std::pair<uint64, uint64>> const chunk_ranges = SplitIntoChunks(data, file.Size(), min_chunk_size);
+
+			std::vector<ObjChunk> chunks(chunk_ranges.size());
+			std::vector<uint64> chunk_indices(chunks.size());
+			std::iota(std::begin(chunk_indices), std::end(chunk_indices), 0ull);
+			std::for_each(std::execution::par, std::begin(chunk_indices), std::end(chunk_indices), [&](uint64 c)
+				{
+					ParseChunk(data + chunk_ranges[c].first, data + chunk_ranges[c].second, chunks[c]);
+				});
+
+			//offsets of every chunk into the merged arrays, relative indices are resolved with them
+			std::vector<uint64> position_offsets(chunks.size() + 1, 0);
+			std::vector<uint64> texcoord_offsets(chunks.size() + 1, 0);
+			std::vector<uint64> normal_offsets(chunks.size() + 1, 0);
+			std::vector<uint64> corner_offsets(chunks.size() + 1, 0);
+			uint64 invalid_lines = 0;
+			std::vector<std::string> libraries;
+			for (uint64 c = 0; c < chunks.size(); ++c)
+			{
+				position_offsets[c + 1] = position_offsets[c] + chunks[c].positions.size();
+				texcoord_offsets[c + 1] = texcoord_offsets[c] + chunks[c].texcoords.size();
+				normal_offsets[c + 1] = normal_offsets[c] + chunks[c].normals.size();
+				corner_offsets[c + 1] = corner_offsets[c] + chunks[c].corners.size();
+				invalid_lines += chunks[c].invalid_lines;
+				for (std::string const& library : chunks[c].material_libraries)
+				{
+					if (std::find(std::begin(libraries), std::end(libraries), library) == std::end(libraries)) libraries.push_back(library);
+				}
+			}
+
+			std::vector<Vector3> positions(position_offsets.back());
+			std::vector<Vector2> texcoords(texcoord_offsets.back());
+			std::vector<Vector3> normals(normal_offsets.back());
+			std::vector<ObjTriplet> triplets(corner_offsets.back());
+			std::for_each(std::execution::par, std::begin(chunk_indices), std::end(chunk_indices), [&](uint64 c)
+				{
+					ObjChunk& chunk = chunks[c];
+					std::copy(std::begin(chunk.positions), std::end(chunk.positions), std::begin(positions) + position_offsets[c]);
+					std::copy(std::begin(chunk.texcoords), std::end(chunk.texcoords), std::begin(texcoords) + texcoord_offsets[c]);
+					std::copy(std::begin(chunk.normals), std::end(chunk.normals), std::begin(normals) + normal_offsets[c]);
+					for (uint64 i = 0; i < chunk.corners.size(); ++i)
+					{
+						ObjCorner const& corner = chunk.corners[i];
+						ObjTriplet& triplet = triplets[corner_offsets[c] + i];
+						triplet.position = corner.position + ((corner.relative & OBJ_RELATIVE_POSITION) ? (int32)position_offsets[c] : 0);
+						triplet.texcoord = !corner.has_texcoord ? -1 : corner.texcoord + ((corner.relative & OBJ_RELATIVE_TEXCOORD) ? (int32)texcoord_offsets[c] : 0);
+						triplet.normal = !corner.has_normal ? -1 : corner.normal + ((corner.relative & OBJ_RELATIVE_NORMAL) ? (int32)normal_offsets[c] : 0);
+					}
+					chunk.positions = {};
+					chunk.texcoords = {};
+					chunk.normals = {};
+					chunk.corners = {};
+				});
+
+			std::map<std::string, int> material_map;
+			LoadMaterials(path, libraries, model.materials, material_map);
+
+			std::vector<ObjShapeRange> ranges;
+			ObjShapeRange current{ "", -1, 0, 0 };
+			for (uint64 c = 0; c < chunks.size(); ++c)
+			{
+				for (ObjEvent const& event : chunks[c].events)
+				{
+					uint64 const corner = corner_offsets[c] + event.corner;
+					if (corner > current.begin)
+					{
+						current.end = corner;
+						ranges.push_back(current);
+						current.begin = corner;
+					}
+					if (event.type == ObjEventType::Shape) current.name = event.name;
+					else
+					{
+						auto it = material_map.find(event.name);
+						current.material = it != std::end(material_map) ? it->second : -1;
+						if (it == std::end(material_map)) ADRIA_LOG(WARNING, "OBJ material %s not found", event.name.c_str());
+					}
+				}
+			}
+			current.end = triplets.size();
+			if (current.end > current.begin) ranges.push_back(current);
+
+			//vertices are shared by identical (v, vt, vn) triplets within a shape
+			model.shapes.resize(ranges.size());
+			std::vector<uint64> invalid_triangles(ranges.size(), 0);
+			std::vector<uint64> shape_indices(ranges.size());
+			std::iota(std::begin(shape_indices), std::end(shape_indices), 0ull);
+			std::for_each(std::execution::par, std::begin(shape_indices), std::end(shape_indices), [&](uint64 s)
+				{
+					ObjShapeRange const& range = ranges[s];
+					ObjShape& shape = model.shapes[s];
+					shape.name = range.name;
+					shape.material = range.material;
+					shape.indices.reserve(range.end - range.begin);
+
+					std::unordered_map<ObjTriplet, uint32, ObjTripletHash> vertex_map;
+					vertex_map.reserve((range.end - range.begin) / 3);
+					for (uint64 i = range.begin; i < range.end; i += 3)
+					{
+						if ((uint64)triplets[i].position >= positions.size() || (uint64)triplets[i + 1].position >= positions.size() ||
+							(uint64)triplets[i + 2].position >= positions.size())
+						{
+							++invalid_triangles[s];
+							continue;
+						}
+						for (uint64 k = 0; k < 3; ++k)
+						{
+							ObjTriplet triplet = triplets[i + k];
+							if ((uint64)triplet.texcoord >= texcoords.size()) triplet.texcoord = -1;
+							if ((uint64)triplet.normal >= normals.size()) triplet.normal = -1;
+
+							auto [it, inserted] = vertex_map.try_emplace(triplet, (uint32)shape.vertices.size());
+							if (inserted)
+							{
+								TexturedNormalVertex& vertex = shape.vertices.emplace_back();
+								vertex.position = positions[triplet.position];
+								if (triplet.texcoord >= 0) vertex.uv = texcoords[triplet.texcoord];
+								if (triplet.normal >= 0) vertex.normal = normals[triplet.normal];
+							}
+							shape.indices.push_back(it->second);
+						}
+					}
+				});
+			std::erase_if(model.shapes, [](ObjShape const& shape) { return shape.indices.empty(); });
+
+			uint64 const skipped_triangles = std::accumulate(std::begin(invalid_triangles), std::end(invalid_triangles), 0ull);
+			if (invalid_lines > 0 || skipped_triangles > 0)
+			{
+				ADRIA_LOG(WARNING, "OBJ file %s: skipped %llu invalid lines and %llu triangles with out of range indices", path.c_str(),
+					(unsigned long long)invalid_lines, (unsigned long long)skipped_triangles);
+			}
+			model.corner_count = triplets.size();
+			model.chunk_count = chunks.size();
+			return true;
+		}
+	}
+}
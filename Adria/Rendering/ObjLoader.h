@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Core/CoreTypes.h"
+#include "Graphics/GfxVertexFormat.h"
+
+namespace adria
+{
+	inline constexpr uint64 OBJ_MIN_CHUNK_SIZE = 1 << 20;	//smaller files are parsed as a single chunk
+
+	//triangles of one object or group with a single material, vertices are shared by their (v, vt, vn) triplet
+	struct ObjShape
+	{
+		std::string name;
+		int32 material = -1;	//index into ObjModel::materials
+		std::vector<TexturedNormalVertex> vertices;
+		std::vector<uint32> indices;
+	};
+
+	struct ObjMaterial
+	{
+		std::string name;
+		std::string diffuse_texture;
+	};
+
+	struct ObjModel
+	{
+		std::vector<ObjShape> shapes;
+		std::vector<ObjMaterial> materials;
+		uint64 corner_count = 0;	//triangle corners, the vertex count of the model as a triangle soup
+		uint64 chunk_count = 0;
+	};
+
+	/* backend independent, parses a memory mapped .obj in line aligned chunks in parallel and merges them into indexed shapes.
+	   Reads v, vt, vn, f (polygons are triangulated as fans), o, g, usemtl and mtllib, everything else is skipped.
+	   Shapes are split on o, g and usemtl, material libraries are read with tinyobj. */
+	namespace ObjLoader
+	{
+		//files are split into chunks of at least min_chunk_size bytes, at most a few per thread
+		bool Load(std::string const& path, ObjModel& model, uint64 min_chunk_size = OBJ_MIN_CHUNK_SIZE);
+	}
+}
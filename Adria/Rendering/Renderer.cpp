@@ -275,6 +275,56 @@ namespace adria
 			return gauss;
 		}
 
+		/* Distance from which each level of the mesh lod is drawn for one foliage instance, the same limit SelectMeshLods applies to whole meshes:
+		   level l is allowed once its error projected from that distance stays below max_error. Returns the number of distances written,
+		   zero when the mesh has no levels. */
+		uint32 FoliageLevelDistances(MeshLOD const* mesh_lod, float instance_extent, float projection_scale, float max_error, std::span<float> distances)
+		{
+			if (!mesh_lod) return 0;
+			distances[0] = 0.0f;
+			for (uint32 level = 1; level < mesh_lod->level_count; ++level)
+			{
+				float const distance = mesh_lod->levels[level].error * instance_extent * projection_scale / max_error;
+				distances[level] = std::max(distance, distances[level - 1]);
+			}
+			return mesh_lod->level_count;
+		}
+
+		//compacts the visible instances straight into the mapped dynamic buffer
+		uint32 CullFoliageInstances(Foliage const& foliage, GfxBuffer& instance_buffer, FoliageVisibilityTest const& is_visible, Vector3 const& view_position,
+			std::span<float const> level_distances, std::span<uint32> level_counts)
+		{
+			std::fill(std::begin(level_counts), std::end(level_counts), 0u);
+			if (!foliage.cell_grid || foliage.cell_grid->instances.empty()) return 0;
+			ScatterInstance* instances = static_cast<ScatterInstance*>(instance_buffer.Map());
+			uint32 instance_count = FoliageCulling::CullAndCompact(*foliage.cell_grid, is_visible, view_position, foliage.lod, level_distances,
+				std::span<ScatterInstance>(instances, instance_buffer.GetCount()), level_counts);
+			instance_buffer.Unmap();
+			return instance_count;
+		}
+
+		//one draw per mesh lod level, the instances of a level follow the ones of the previous level in the instance buffer
+		void DrawFoliage(GfxCommandContext* context, Mesh mesh, MeshLOD const* mesh_lod, std::span<uint32 const> level_counts)
+		{
+			if (!mesh_lod)
+			{
+				mesh.Draw(context);
+				return;
+			}
+			uint32 first_instance = 0;
+			for (uint32 level = 0; level < mesh_lod->level_count; ++level)
+			{
+				if (level_counts[level] > 0)
+				{
+					mesh.start_index_location = mesh_lod->levels[level].start_index;
+					mesh.indices_count = mesh_lod->levels[level].index_count;
+					mesh.start_instance_location = first_instance;
+					mesh.instance_count = level_counts[level];
+					mesh.Draw(context);
+				}
+				first_instance += level_counts[level];
+			}
+		}
 	}
 
 	Renderer::Renderer(registry& reg, GfxDevice* gfx, uint32 width, uint32 height)
@@ -301,6 +351,9 @@ namespace adria
 		UpdateTerrainData();
 		UpdateVoxelData();
 		CameraFrustumCulling();
+		SelectTerrainNodes();
+		SelectMeshLods();
+		RequestTextureMips();
 		UpdateCBuffers(dt);
 		UpdateWeather(dt);
 		UpdateOcean(dt);
@@ -1137,7 +1190,18 @@ namespace adria
 	}
 	void Renderer::CreateIBLTextures()
 	{
-		//#TODO refactor IBL
+		//baked with the environment map of the skybox when it was loaded
+		auto skybox_view = reg.view<Skybox>();
+		for (auto e : skybox_view)
+		{
+			auto const& skybox = skybox_view.get(e);
+			if (!skybox.active || skybox.specular_texture == INVALID_TEXTURE_HANDLE) continue;
+			env_srv = g_TextureManager.GetTextureView(skybox.specular_texture);
+			irmap_srv = g_TextureManager.GetTextureView(skybox.irradiance_texture);
+			brdf_srv = g_TextureManager.GetTextureView(g_TextureManager.LoadSpecularBRDF());
+			ibl_textures_generated = true;
+			return;
+		}
 		ibl_textures_generated = false;
 	}
 
@@ -1154,8 +1218,10 @@ namespace adria
 			shadow_cbuffer->Bind(command_context, GfxShaderStage::VS, CBUFFER_SLOT_SHADOW);
 			weather_cbuffer->Bind(command_context, GfxShaderStage::VS, CBUFFER_SLOT_WEATHER);
 			voxel_cbuffer->Bind(command_context,  GfxShaderStage::VS, CBUFFER_SLOT_VOXEL);
+			terrain_cbuffer->Bind(command_context, GfxShaderStage::VS, CBUFFER_SLOT_TERRAIN);
 
 			command_context->SetSampler(GfxShaderStage::VS, 0, linear_wrap_sampler.get());
+			command_context->SetSampler(GfxShaderStage::VS, 3, linear_clamp_sampler.get());
 			
 			//TS/HS GLOBALS
 			frame_cbuffer->Bind(command_context, GfxShaderStage::DS, CBUFFER_SLOT_FRAME);
@@ -1457,10 +1523,64 @@ namespace adria
 	}
 	void Renderer::UpdateTerrainData()
 	{
+		if (terrain_generation != TerrainComponent::generation) CreateTerrainResources();
+
 		terrain_cbuf_data.texture_scale = TerrainComponent::texture_scale;
 		terrain_cbuf_data.ocean_active = reg.size<Ocean>() != 0;
 		terrain_cbuffer->Update(gfx->GetCommandContext(), terrain_cbuf_data);
 	}
+	void Renderer::CreateTerrainResources()
+	{
+		terrain_generation = TerrainComponent::generation;
+		Terrain const* cdlod_terrain = TerrainComponent::terrain.get();
+		terrain_heightmap.reset();
+		terrain_normalmap.reset();
+		terrain_instances.clear();
+		if (!cdlod_terrain || !TerrainComponent::quadtree) return;
+
+		auto [tile_count_x, tile_count_z] = cdlod_terrain->TileCounts();
+		auto [tile_size_x, tile_size_z] = cdlod_terrain->TileSizes();
+		uint32 const width = (uint32)(tile_count_x + 1);
+		uint32 const height = (uint32)(tile_count_z + 1);
+		if (width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+		{
+			ADRIA_LOG(WARNING, "Terrain with %ux%u samples doesn't fit in a texture, drawing its chunks instead of the CDLOD quadtree", width, height);
+			return;
+		}
+
+		GfxTextureDesc desc{};
+		desc.width = width;
+		desc.height = height;
+		desc.format = GfxFormat::R16_UNORM;
+		desc.bind_flags = GfxBindFlag::ShaderResource;
+
+		GfxTextureInitialData init_data{};
+		init_data.pSysMem = cdlod_terrain->Heights().data();
+		init_data.SysMemPitch = width * sizeof(uint16);
+		terrain_heightmap = std::make_unique<GfxTexture>(gfx, desc, &init_data);
+		terrain_heightmap->CreateSRV();
+
+		desc.format = GfxFormat::R8G8_SNORM;
+		init_data.pSysMem = cdlod_terrain->Normals().data();
+		terrain_normalmap = std::make_unique<GfxTexture>(gfx, desc, &init_data);
+		terrain_normalmap->CreateSRV();
+
+		TerrainQuadTreeDesc const& quadtree_desc = TerrainComponent::quadtree->Desc();
+		std::vector<Vector2> patch_vertices;
+		std::vector<uint16> patch_indices;
+		TerrainQuadTree::GeneratePatch(quadtree_desc.leaf_node_size, patch_vertices, patch_indices);
+		terrain_patch_vb = std::make_unique<GfxBuffer>(gfx, VertexBufferDesc(patch_vertices.size(), sizeof(Vector2)), patch_vertices.data());
+		terrain_patch_ib = std::make_unique<GfxBuffer>(gfx, IndexBufferDesc(patch_indices.size(), true), patch_indices.data());
+
+		//heights are unorm16 in the texture, the shader gets the scale of the whole range
+		terrain_cbuf_data.patch_size = (float)quadtree_desc.leaf_node_size;
+		terrain_cbuf_data.terrain_min = Vector2(quadtree_desc.offset.x, quadtree_desc.offset.z);
+		terrain_cbuf_data.terrain_max = terrain_cbuf_data.terrain_min + Vector2(tile_count_x * tile_size_x, tile_count_z * tile_size_z);
+		terrain_cbuf_data.uv_scale = TerrainComponent::texture_scale / Vector2(tile_size_x * (tile_count_x - 1), tile_size_z * (tile_count_z - 1));
+		terrain_cbuf_data.heightmap_size = Vector2((float)width, (float)height);
+		terrain_cbuf_data.height_scale = cdlod_terrain->HeightScale() * 65535.0f;
+		terrain_cbuf_data.height_bias = cdlod_terrain->HeightBias();
+	}
 	void Renderer::UpdateVoxelData()
 	{
 		float const f = 0.05f / renderer_settings.voxel_size;
@@ -1489,6 +1609,27 @@ namespace adria
 
 		voxel_cbuffer->Update(gfx->GetCommandContext(), voxel_cbuf_data);
 	}
+	void Renderer::SelectTerrainNodes()
+	{
+		terrain_instances.clear();
+		terrain_quadrant_instance_counts.fill(0);
+		if (!terrain_heightmap) return;
+
+		TerrainComponent::quadtree->Select(camera->Position(), camera->Frustum(), terrain_instances);
+		if (terrain_instances.empty()) return;
+
+		//grouped by quadrant, every group is drawn with the index range of its quadrant
+		std::sort(std::begin(terrain_instances), std::end(terrain_instances),
+			[](TerrainLODInstance const& lhs, TerrainLODInstance const& rhs) { return lhs.quadrant < rhs.quadrant; });
+		for (TerrainLODInstance const& instance : terrain_instances) ++terrain_quadrant_instance_counts[instance.quadrant];
+
+		if (!terrain_instance_buffer || terrain_instance_buffer->GetCount() < terrain_instances.size())
+		{
+			uint64 const capacity = std::max<uint64>(terrain_instances.size(), 2ull * (terrain_instance_buffer ? terrain_instance_buffer->GetCount() : 256));
+			terrain_instance_buffer = std::make_unique<GfxBuffer>(gfx, VertexBufferDesc(capacity, sizeof(TerrainLODInstance), true));
+		}
+		terrain_instance_buffer->Update(terrain_instances.data(), terrain_instances.size() * sizeof(TerrainLODInstance));
+	}
 	void Renderer::CameraFrustumCulling()
 	{
 		BoundingFrustum camera_frustum = camera->Frustum();
@@ -1499,6 +1640,111 @@ namespace adria
 			if (aabb.skip_culling) continue;
 			aabb.camera_visible = camera_frustum.Intersects(aabb.bounding_box) || reg.has<Light>(e); //dont cull lights for now
 		}
+
+		float const projection_scale = height / (2.0f * std::tan(camera->Fov() * 0.5f));
+		auto foliage_view = reg.view<Mesh, AABB, Foliage>();
+		for (auto e : foliage_view)
+		{
+			auto [mesh, aabb, foliage] = foliage_view.get<Mesh, AABB, Foliage>(e);
+			std::array<float, MESH_LOD_MAX_LEVELS> level_distances{};
+			uint32 const level_count = !renderer_settings.mesh_lod ? 0 : FoliageLevelDistances(reg.get_if<MeshLOD>(e), foliage.instance_extent,
+				projection_scale, renderer_settings.mesh_lod_error, level_distances);
+			foliage.camera_instance_count = !aabb.camera_visible ? 0 : CullFoliageInstances(foliage, *foliage.camera_instance_buffer,
+				[&camera_frustum](BoundingBox const& box) { return camera_frustum.Intersects(box); }, camera->Position(),
+				std::span<float const>(level_distances.data(), level_count), foliage.camera_level_counts);
+			mesh.instance_buffer = foliage.camera_instance_buffer;
+			mesh.instance_count = foliage.camera_instance_count;
+		}
+	}
+	void Renderer::SelectMeshLods()
+	{
+		//pixels covered by one unit at distance one
+		float const projection_scale = height / (2.0f * std::tan(camera->Fov() * 0.5f));
+		Vector3 const camera_position = camera->Position();
+
+		auto lod_view = reg.view<Mesh, AABB, MeshLOD>();
+		for (auto e : lod_view)
+		{
+			auto [mesh, aabb, mesh_lod] = lod_view.get<Mesh, AABB, MeshLOD>(e);
+			//instanced foliage picks a level per cell while it is culled, its bounds cover the whole scatter area
+			if (reg.has<Foliage>(e)) continue;
+			if (!aabb.camera_visible) continue;
+
+			/* a level error times the largest extent of the mesh is how far, in world units, the level strays from the source surface.
+			   Projected from the closest point of the bounds it is the error in pixels, the coarsest level that stays below the limit is drawn. */
+			Vector3 const extents(aabb.bounding_box.Extents);
+			float const extent = 2.0f * std::max({ extents.x, extents.y, extents.z });
+			float const distance = std::max(Vector3::Distance(camera_position, aabb.bounding_box.Center) - extents.Length(), camera->Near());
+			float const projected_extent = extent * projection_scale / distance;
+
+			uint32 level = 0;
+			if (renderer_settings.mesh_lod)
+			{
+				while (level + 1 < mesh_lod.level_count && mesh_lod.levels[level + 1].error * projected_extent <= renderer_settings.mesh_lod_error) ++level;
+			}
+			mesh_lod.current_level = level;
+			mesh.start_index_location = mesh_lod.levels[level].start_index;
+			mesh.indices_count = mesh_lod.levels[level].index_count;
+		}
+	}
+	void Renderer::RequestTextureMips()
+	{
+		float const projection_scale = height / (2.0f * std::tan(camera->Fov() * 0.5f));
+		Vector3 const camera_position = camera->Position();
+
+		auto material_view = reg.view<Material, AABB>();
+		for (auto e : material_view)
+		{
+			auto [material, aabb] = material_view.get<Material, AABB>(e);
+			if (!aabb.camera_visible) continue;
+
+			//textures are assumed to be stretched once over the largest extent of the mesh, textures that aren't requested become eviction candidates
+			Vector3 const extents(aabb.bounding_box.Extents);
+			float const extent = 2.0f * std::max({ extents.x, extents.y, extents.z });
+			float const distance = std::max(Vector3::Distance(camera_position, aabb.bounding_box.Center) - extents.Length(), camera->Near());
+			float const projected_extent = extent * projection_scale / distance;
+			for (TextureHandle texture : { material.albedo_texture, material.normal_texture, material.metallic_roughness_texture, material.emissive_texture })
+			{
+				g_TextureManager.RequestTexture(texture, projected_extent);
+			}
+		}
+	}
+	bool Renderer::CullMeshClusters(entity e, BoundingFrustum const& camera_frustum)
+	{
+		MeshClusters* clusters = reg.get_if<MeshClusters>(e);
+		if (!clusters) return false;
+
+		auto [mesh, transform, aabb] = reg.get<Mesh, Transform, AABB>(e);
+		//meshlets are built on the full detail level only
+		MeshLOD const* mesh_lod = reg.get_if<MeshLOD>(e);
+		clusters->active = renderer_settings.cluster_culling && aabb.camera_visible && mesh.index_buffer && (!mesh_lod || mesh_lod->current_level == 0);
+		if (!clusters->active) return false;
+
+		Matrix parent_transform = Matrix::Identity;
+		if (Relationship* relationship = reg.get_if<Relationship>(e))
+		{
+			if (auto* root_transform = reg.get_if<Transform>(relationship->parent)) parent_transform = root_transform->current_transform;
+		}
+		Matrix const model = transform.current_transform * parent_transform;
+
+		//the frustum can only be brought into mesh space under a uniform scale
+		Vector3 scale; Quaternion rotation; Vector3 translation;
+		if (!model.Decompose(scale, rotation, translation) ||
+			std::abs(scale.x - scale.y) > 1e-3f * scale.x || std::abs(scale.x - scale.z) > 1e-3f * scale.x)
+		{
+			clusters->active = false;
+			return false;
+		}
+		Matrix const inverse_model = model.Invert();
+		BoundingFrustum local_frustum;
+		camera_frustum.Transform(local_frustum, inverse_model);
+		Vector3 const local_camera_position = Vector3::Transform(camera->Position(), inverse_model);
+
+		Material const* material = reg.get_if<Material>(e);
+		bool const backface_culling = !material || !material->double_sided;
+		clusters->statistics = Meshlets::Cull(clusters->meshlets, local_frustum, local_camera_position, backface_culling, clusters->visible_ranges);
+		cluster_cull_statistics += clusters->statistics;
+		return true;
 	}
 	void Renderer::LightFrustumCulling(LightType type)
 	{
@@ -1522,6 +1768,22 @@ namespace adria
 				ADRIA_ASSERT(false);
 			}
 		}
+
+		FoliageVisibilityTest is_light_visible = type == LightType::Directional ?
+			FoliageVisibilityTest([this](BoundingBox const& box) { return light_bounding_box.Intersects(box); }) :
+			FoliageVisibilityTest([this](BoundingBox const& box) { return light_bounding_frustum.Intersects(box); });
+		float const projection_scale = height / (2.0f * std::tan(camera->Fov() * 0.5f));
+		auto foliage_view = reg.view<AABB, Foliage>();
+		for (auto e : foliage_view)
+		{
+			auto [aabb, foliage] = foliage_view.get<AABB, Foliage>(e);
+			//density and mesh lod follow the camera, so shadows match the foliage that is drawn
+			std::array<float, MESH_LOD_MAX_LEVELS> level_distances{};
+			uint32 const level_count = !renderer_settings.mesh_lod ? 0 : FoliageLevelDistances(reg.get_if<MeshLOD>(e), foliage.instance_extent,
+				projection_scale, renderer_settings.mesh_lod_error, level_distances);
+			foliage.shadow_instance_count = !aabb.light_visible ? 0 : CullFoliageInstances(foliage, *foliage.shadow_instance_buffer, is_light_visible, camera->Position(),
+				std::span<float const>(level_distances.data(), level_count), foliage.shadow_level_counts);
+		}
 	}
 
 	void Renderer::PassPicking()
@@ -1547,17 +1809,132 @@ namespace adria
 		};
 		std::map<BatchParams, std::vector<entity>> batched_entities;
 
+		auto DirectBatchParams = [](Mesh const& mesh, Material const& material)
+		{
+			bool const opaque = material.alpha_mode == MaterialAlphaMode::Opaque;
+			BatchParams params{};
+			params.double_sided = material.double_sided;
+			if (mesh.compressed_vertices) params.shader_program = opaque ? ShaderProgram::GBufferPBR_Compressed : ShaderProgram::GBufferPBR_Mask_Compressed;
+			else params.shader_program = opaque ? ShaderProgram::GBufferPBR : ShaderProgram::GBufferPBR_Mask;
+			return params;
+		};
+
+		/* Meshes repeated in the view are instanced and drawn whole. Cluster culling only pays off for meshes drawn on their own,
+		   so it's done once batching shows an entity has no instances to share its draw with */
+		cluster_cull_statistics = {};
+		BoundingFrustum const camera_frustum = camera->Frustum();
+		gbuffer_instance_items.clear();
 		auto gbuffer_view = reg.view<Mesh, Transform, Material, Deferred, AABB>();
 		for (auto e : gbuffer_view)
 		{
 			auto [mesh, transform, material, aabb] = gbuffer_view.get<Mesh, Transform, Material, AABB>(e);
 			if (!aabb.camera_visible) continue;
 
-			BatchParams params{};
-			params.double_sided = material.double_sided;
-			params.shader_program = material.alpha_mode == MaterialAlphaMode::Opaque ? ShaderProgram::GBufferPBR : ShaderProgram::GBufferPBR_Mask;
-			batched_entities[params].push_back(e);
+			bool const opaque = material.alpha_mode == MaterialAlphaMode::Opaque;
+			if (renderer_settings.mesh_instancing && mesh.index_buffer)
+			{
+				if (MeshClusters* clusters = reg.get_if<MeshClusters>(e)) clusters->active = false;
+
+				Matrix parent_transform = Matrix::Identity;
+				if (Relationship* relationship = reg.get_if<Relationship>(e))
+				{
+					if (auto* root_transform = reg.get_if<Transform>(relationship->parent)) parent_transform = root_transform->current_transform;
+				}
+
+				MeshInstanceItem& item = gbuffer_instance_items.emplace_back();
+				if (mesh.compressed_vertices) item.key.shader_program = opaque ? ShaderProgram::GBufferPBR_Compressed_Instanced : ShaderProgram::GBufferPBR_Mask_Compressed_Instanced;
+				else item.key.shader_program = opaque ? ShaderProgram::GBufferPBR_Instanced : ShaderProgram::GBufferPBR_Mask_Instanced;
+				item.key.double_sided = material.double_sided;
+				item.key.vertex_buffer = mesh.vertex_buffer.get();
+				item.key.index_buffer = mesh.index_buffer.get();
+				item.key.start_index = mesh.start_index_location;
+				item.key.index_count = mesh.indices_count;
+				item.key.base_vertex = mesh.base_vertex_location;
+				item.key.textures[0] = material.albedo_texture;
+				item.key.textures[1] = material.metallic_roughness_texture;
+				item.key.textures[2] = material.normal_texture;
+				item.key.textures[3] = material.emissive_texture;
+				item.key.factors[0] = material.albedo_factor;
+				item.key.factors[1] = material.metallic_factor;
+				item.key.factors[2] = material.roughness_factor;
+				item.key.factors[3] = material.emissive_factor;
+				item.key.factors[4] = material.alpha_cutoff;
+				item.world = transform.current_transform * parent_transform;
+				item.payload = as_integer(e);
+				continue;
+			}
+
+			CullMeshClusters(e, camera_frustum);
+			batched_entities[DirectBatchParams(mesh, material)].push_back(e);
+		}
+
+		instancing_statistics = MeshInstancing::Batch(gbuffer_instance_items, gbuffer_instance_batches, gbuffer_instances);
+		gbuffer_single_payloads.clear();
+		uint64 const culled_count = MeshInstancing::ExtractSingles(gbuffer_instance_batches, [&](uint64 payload) { return CullMeshClusters(entity(payload), camera_frustum); }, gbuffer_single_payloads);
+		instancing_statistics.item_count -= culled_count;
+		instancing_statistics.batch_count -= culled_count;
+		for (uint64 payload : gbuffer_single_payloads)
+		{
+			auto [mesh, material] = gbuffer_view.get<Mesh, Material>(entity(payload));
+			batched_entities[DirectBatchParams(mesh, material)].push_back(entity(payload));
 		}
+
+		if (!gbuffer_instances.empty())
+		{
+			if (!gbuffer_instance_buffer || gbuffer_instance_buffer->GetCount() < gbuffer_instances.size())
+			{
+				uint64 const capacity = std::max<uint64>(gbuffer_instances.size(), 2ull * (gbuffer_instance_buffer ? gbuffer_instance_buffer->GetCount() : 512));
+				gbuffer_instance_buffer = std::make_shared<GfxBuffer>(gfx, VertexBufferDesc(capacity, sizeof(MeshInstance), true));
+			}
+			gbuffer_instance_buffer->Update(gbuffer_instances.data(), gbuffer_instances.size() * sizeof(MeshInstance));
+		}
+
+		auto BindMaterial = [&](Material const& material)
+		{
+			material_cbuf_data.albedo_factor = material.albedo_factor;
+			material_cbuf_data.metallic_factor = material.metallic_factor;
+			material_cbuf_data.roughness_factor = material.roughness_factor;
+			material_cbuf_data.emissive_factor = material.emissive_factor;
+			material_cbuf_data.alpha_cutoff = material.alpha_cutoff;
+			material_cbuffer->Update(gfx->GetCommandContext(), material_cbuf_data);
+
+			if (material.albedo_texture != INVALID_TEXTURE_HANDLE)
+			{
+				auto view = g_TextureManager.GetTextureView(material.albedo_texture);
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
+			}
+
+			if (material.metallic_roughness_texture != INVALID_TEXTURE_HANDLE)
+			{
+				auto view = g_TextureManager.GetTextureView(material.metallic_roughness_texture);
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_ROUGHNESS_METALLIC, view);
+			}
+			else
+			{
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_ROUGHNESS_METALLIC, nullptr);
+			}
+
+			if (material.normal_texture != INVALID_TEXTURE_HANDLE)
+			{
+				auto view = g_TextureManager.GetTextureView(material.normal_texture);
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_NORMAL, view);
+
+			}
+			else
+			{
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_NORMAL, nullptr);
+			}
+
+			if (material.emissive_texture != INVALID_TEXTURE_HANDLE)
+			{
+				auto view = g_TextureManager.GetTextureView(material.emissive_texture);
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_EMISSIVE, view);
+			}
+			else
+			{
+				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_EMISSIVE, nullptr);
+			}
+		};
 		
 		command_context->BeginRenderPass(gbuffer_pass);
 		{
@@ -1577,71 +1954,48 @@ namespace adria
 					
 					object_cbuf_data.model = transform.current_transform * parent_transform;
 					object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert();
+					object_cbuf_data.position_scale = mesh.quantization.scale;
+					object_cbuf_data.position_offset = mesh.quantization.offset;
 					object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
+					BindMaterial(material);
 
-					material_cbuf_data.albedo_factor = material.albedo_factor;
-					material_cbuf_data.metallic_factor = material.metallic_factor;
-					material_cbuf_data.roughness_factor = material.roughness_factor;
-					material_cbuf_data.emissive_factor = material.emissive_factor;
-					material_cbuf_data.alpha_cutoff = material.alpha_cutoff;
-					material_cbuffer->Update(gfx->GetCommandContext(), material_cbuf_data);
-
-					static GfxShaderResourceRO const null_view = nullptr;
-
-					if (material.albedo_texture != INVALID_TEXTURE_HANDLE)
-					{
-						auto view = g_TextureManager.GetTextureView(material.albedo_texture);
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
-					}
-
-					if (material.metallic_roughness_texture != INVALID_TEXTURE_HANDLE)
-					{
-						auto view = g_TextureManager.GetTextureView(material.metallic_roughness_texture);
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_ROUGHNESS_METALLIC, view);
-					}
-					else
-					{
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_ROUGHNESS_METALLIC, nullptr);
-					}
-
-					if (material.normal_texture != INVALID_TEXTURE_HANDLE)
-					{
-						auto view = g_TextureManager.GetTextureView(material.normal_texture);
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_NORMAL, view);
-
-					}
-					else
-					{
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_NORMAL, nullptr);
-					}
-
-					if (material.emissive_texture != INVALID_TEXTURE_HANDLE)
-					{
-						auto view = g_TextureManager.GetTextureView(material.emissive_texture);
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_EMISSIVE, view);
-					}
-					else
-					{
-						command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_EMISSIVE, nullptr);
-					}
-
-					mesh.Draw(command_context);
+					MeshClusters const* clusters = reg.get_if<MeshClusters>(e);
+					if (clusters && clusters->active) mesh.Draw(command_context, clusters->visible_ranges);
+					else mesh.Draw(command_context);
 				}
 				if (params.double_sided) command_context->SetRasterizerState(nullptr);
 			}
-			
-			auto terrain_view = reg.view<Mesh, Transform, AABB, TerrainComponent>();
-			ShaderManager::GetShaderProgram(ShaderProgram::GBuffer_Terrain)->Bind(command_context);
-			for (auto e : terrain_view)
-			{
-				auto [mesh, transform, aabb, terrain] = terrain_view.get<Mesh, Transform, AABB, TerrainComponent>(e);
 
-				if (!aabb.camera_visible) continue;
+			//batches are sorted by their key, so the shader and rasterizer state only change between runs of batches
+			std::optional<BatchParams> bound_params;
+			for (MeshInstanceBatch const& batch : gbuffer_instance_batches)
+			{
+				BatchParams const params{ batch.key.shader_program, batch.key.double_sided };
+				if (params != bound_params)
+				{
+					ShaderManager::GetShaderProgram(params.shader_program)->Bind(command_context);
+					if (!bound_params || params.double_sided != bound_params->double_sided) command_context->SetRasterizerState(params.double_sided ? cull_none.get() : nullptr);
+					bound_params = params;
+				}
 
-				object_cbuf_data.model = transform.current_transform;
-				object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert().Transpose();
+				//every instance shares the mesh and material of the first one, the world matrices come from the instance buffer
+				auto [mesh, material] = gbuffer_view.get<Mesh, Material>(entity(batch.payload));
+				object_cbuf_data.position_scale = mesh.quantization.scale;
+				object_cbuf_data.position_offset = mesh.quantization.offset;
 				object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
+				BindMaterial(material);
 
+				Mesh instanced_mesh = mesh;
+				instanced_mesh.instance_buffer = gbuffer_instance_buffer;
+				instanced_mesh.instance_count = batch.instance_count;
+				instanced_mesh.start_instance_location = batch.first_instance;
+				instanced_mesh.Draw(command_context);
+			}
+			if (bound_params && bound_params->double_sided) command_context->SetRasterizerState(nullptr);
+			
+			auto terrain_view = reg.view<Mesh, Transform, AABB, TerrainComponent>();
+			auto BindTerrainTextures = [&](TerrainComponent const& terrain)
+			{
 				if (terrain.grass_texture != INVALID_TEXTURE_HANDLE)
 				{
 					auto view = g_TextureManager.GetTextureView(terrain.grass_texture);
@@ -1668,15 +2022,60 @@ namespace adria
 					auto view = g_TextureManager.GetTextureView(terrain.layer_texture);
 					command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_LAYER, view);
 				}
-				mesh.Draw(command_context);
+			};
+
+			if (terrain_heightmap)
+			{
+				//the chunks share their textures, the selected quadtree nodes replace their draws
+				if (!terrain_instances.empty() && terrain_view.begin() != terrain_view.end())
+				{
+					ShaderManager::GetShaderProgram(ShaderProgram::GBuffer_Terrain_CDLOD)->Bind(command_context);
+					BindTerrainTextures(terrain_view.get<TerrainComponent>(*terrain_view.begin()));
+					command_context->SetShaderResourceRO(GfxShaderStage::VS, TEXTURE_SLOT_TERRAIN_HEIGHT, terrain_heightmap->SRV());
+					command_context->SetShaderResourceRO(GfxShaderStage::VS, TEXTURE_SLOT_TERRAIN_NORMAL, terrain_normalmap->SRV());
+
+					command_context->SetTopology(GfxPrimitiveTopology::TriangleList);
+					command_context->SetVertexBuffer(terrain_patch_vb.get());
+					command_context->SetVertexBuffer(terrain_instance_buffer.get(), 1);
+					command_context->SetIndexBuffer(terrain_patch_ib.get());
+
+					uint32 const quadrant_index_count = terrain_patch_ib->GetCount() / 4;
+					uint32 first_instance = 0;
+					for (uint32 quadrant = 0; quadrant <= TerrainNodeQuadrant_All; ++quadrant)
+					{
+						uint32 const instance_count = terrain_quadrant_instance_counts[quadrant];
+						if (instance_count == 0) continue;
+						if (quadrant == TerrainNodeQuadrant_All) command_context->DrawIndexed(4 * quadrant_index_count, instance_count, 0, 0, first_instance);
+						else command_context->DrawIndexed(quadrant_index_count, instance_count, quadrant * quadrant_index_count, 0, first_instance);
+						first_instance += instance_count;
+					}
+					command_context->UnsetShaderResourcesRO(GfxShaderStage::VS, TEXTURE_SLOT_TERRAIN_HEIGHT, 2);
+				}
+			}
+			else
+			{
+				ShaderManager::GetShaderProgram(ShaderProgram::GBuffer_Terrain)->Bind(command_context);
+				for (auto e : terrain_view)
+				{
+					auto [mesh, transform, aabb, terrain] = terrain_view.get<Mesh, Transform, AABB, TerrainComponent>(e);
+
+					if (!aabb.camera_visible) continue;
+
+					object_cbuf_data.model = transform.current_transform;
+					object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert().Transpose();
+					object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
+
+					BindTerrainTextures(terrain);
+					mesh.Draw(command_context);
+				}
 			}
 
 			auto foliage_view = reg.view<Mesh, Transform, Material, AABB, Foliage>();
 			ShaderManager::GetShaderProgram(ShaderProgram::GBuffer_Foliage)->Bind(command_context);
 			for (auto e : foliage_view)
 			{
-				auto [mesh, transform, aabb, material] = foliage_view.get<Mesh, Transform, AABB, Material>(e);
-				if (!aabb.camera_visible) continue;
+				auto [mesh, transform, aabb, material, foliage] = foliage_view.get<Mesh, Transform, AABB, Material, Foliage>(e);
+				if (!aabb.camera_visible || mesh.instance_count == 0) continue;
 
 				object_cbuf_data.model = transform.current_transform;
 				object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert().Transpose();
@@ -1687,7 +2086,7 @@ namespace adria
 					auto view = g_TextureManager.GetTextureView(material.albedo_texture);
 					command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
 				}
-				mesh.Draw(command_context);
+				DrawFoliage(command_context, mesh, reg.get_if<MeshLOD>(e), foliage.camera_level_counts);
 			}
 		}
 		command_context->EndRenderPass();
@@ -2489,53 +2888,32 @@ namespace adria
 	{
 		GfxCommandContext* command_context = gfx->GetCommandContext();
 		auto shadow_view = reg.view<Mesh, Transform, AABB>();
-		if (!renderer_settings.shadow_transparent)
-		{
-			ShaderManager::GetShaderProgram(ShaderProgram::DepthMap)->Bind(command_context);
-			for (auto e : shadow_view)
-			{
-				auto& aabb = shadow_view.get<AABB>(e);
-				if (aabb.light_visible)
-				{
-					auto const& transform = shadow_view.get<Transform>(e);
-					auto const& mesh = shadow_view.get<Mesh>(e);
-
-					Matrix parent_transform = Matrix::Identity;
-					if (Relationship* relationship = reg.get_if<Relationship>(e))
-					{
-						if (auto* root_transform = reg.get_if<Transform>(relationship->parent)) parent_transform = root_transform->current_transform;
-					}
 
-					object_cbuf_data.model = transform.current_transform * parent_transform;
-					object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert();
-					object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
-					mesh.Draw(command_context);
-				}
-			}
-		}
-		else
+		//compressed vertices need their own input layout, so every program has a compressed twin and the casters are split by format
+		std::vector<entity> opaque, potentially_transparent, opaque_compressed, potentially_transparent_compressed;
+		for (auto e : shadow_view)
 		{
-			std::vector<entity> potentially_transparent, not_transparent;
-			for (auto e : shadow_view)
+			auto const& aabb = shadow_view.get<AABB>(e);
+			if (!aabb.light_visible || reg.has<Foliage>(e)) continue;
+
+			bool const compressed = shadow_view.get<Mesh>(e).compressed_vertices;
+			bool transparent = false;
+			if (renderer_settings.shadow_transparent)
 			{
-				auto const& aabb = shadow_view.get<AABB>(e);
-				if (aabb.light_visible)
-				{
-					if (auto* p_material = reg.get_if<Material>(e))
-					{
-						if (p_material->albedo_texture != INVALID_TEXTURE_HANDLE)
-							potentially_transparent.push_back(e);
-						else not_transparent.push_back(e);
-					}
-					else not_transparent.push_back(e);
-				}
+				if (auto* p_material = reg.get_if<Material>(e)) transparent = p_material->albedo_texture != INVALID_TEXTURE_HANDLE;
 			}
+			if (transparent) (compressed ? potentially_transparent_compressed : potentially_transparent).push_back(e);
+			else (compressed ? opaque_compressed : opaque).push_back(e);
+		}
 
-			ShaderManager::GetShaderProgram(ShaderProgram::DepthMap)->Bind(command_context);
-			for (auto e : not_transparent)
+		auto DrawShadowCasters = [&](ShaderProgram program, std::vector<entity> const& entities, bool transparent)
+		{
+			if (entities.empty()) return;
+			ShaderManager::GetShaderProgram(program)->Bind(command_context);
+			for (auto e : entities)
 			{
-				auto& transform = shadow_view.get<Transform>(e);
-				auto& mesh = shadow_view.get<Mesh>(e);
+				auto const& transform = shadow_view.get<Transform>(e);
+				auto const& mesh = shadow_view.get<Mesh>(e);
 
 				Matrix parent_transform = Matrix::Identity;
 				if (Relationship* relationship = reg.get_if<Relationship>(e))
@@ -2545,33 +2923,44 @@ namespace adria
 
 				object_cbuf_data.model = transform.current_transform * parent_transform;
 				object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert();
+				object_cbuf_data.position_scale = mesh.quantization.scale;
+				object_cbuf_data.position_offset = mesh.quantization.offset;
 				object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
+
+				if (transparent)
+				{
+					auto* material = reg.get_if<Material>(e);
+					ADRIA_ASSERT(material != nullptr);
+					ADRIA_ASSERT(material->albedo_texture != INVALID_TEXTURE_HANDLE);
+					auto view = g_TextureManager.GetTextureView(material->albedo_texture);
+					command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
+				}
 				mesh.Draw(command_context);
 			}
+		};
+		DrawShadowCasters(ShaderProgram::DepthMap, opaque, false);
+		DrawShadowCasters(ShaderProgram::DepthMap_Compressed, opaque_compressed, false);
+		DrawShadowCasters(ShaderProgram::DepthMap_Transparent, potentially_transparent, true);
+		DrawShadowCasters(ShaderProgram::DepthMap_Transparent_Compressed, potentially_transparent_compressed, true);
 
-			ShaderManager::GetShaderProgram(ShaderProgram::DepthMap_Transparent)->Bind(command_context);
-			for (auto e : potentially_transparent)
-			{
-				auto& transform = shadow_view.get<Transform>(e);
-				auto& mesh = shadow_view.get<Mesh>(e);
-				auto* material = reg.get_if<Material>(e);
-				ADRIA_ASSERT(material != nullptr);
-				ADRIA_ASSERT(material->albedo_texture != INVALID_TEXTURE_HANDLE);
+		auto foliage_view = reg.view<Mesh, Transform, Material, AABB, Foliage>();
+		ShaderManager::GetShaderProgram(ShaderProgram::DepthMap_Foliage)->Bind(command_context);
+		for (auto e : foliage_view)
+		{
+			auto [mesh, transform, material, aabb, foliage] = foliage_view.get<Mesh, Transform, Material, AABB, Foliage>(e);
+			if (!aabb.light_visible || foliage.shadow_instance_count == 0) continue;
 
-				Matrix parent_transform = Matrix::Identity;
-				if (Relationship* relationship = reg.get_if<Relationship>(e))
-				{
-					if (auto* root_transform = reg.get_if<Transform>(relationship->parent)) parent_transform = root_transform->current_transform;
-				}
+			object_cbuf_data.model = transform.current_transform;
+			object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert();
+			object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
 
-				object_cbuf_data.model = transform.current_transform * parent_transform;
-				object_cbuf_data.transposed_inverse_model = object_cbuf_data.model.Invert();
-				object_cbuffer->Update(gfx->GetCommandContext(), object_cbuf_data);
+			auto view = g_TextureManager.GetTextureView(material.albedo_texture);
+			command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
 
-				auto view = g_TextureManager.GetTextureView(material->albedo_texture);
-				command_context->SetShaderResourceRO(GfxShaderStage::PS, TEXTURE_SLOT_DIFFUSE, view);
-				mesh.Draw(command_context);
-			}
+			Mesh shadow_mesh = mesh;
+			shadow_mesh.instance_buffer = foliage.shadow_instance_buffer;
+			shadow_mesh.instance_count = foliage.shadow_instance_count;
+			DrawFoliage(command_context, shadow_mesh, reg.get_if<MeshLOD>(e), foliage.shadow_level_counts);
 		}
 	}
 
@@ -3,6 +3,9 @@
 #include <optional>
 #include "Picker.h"
 #include "ParticleRenderer.h"
+#include "Meshlets.h"
+#include "MeshInstancing.h"
+#include "TerrainQuadTree.h"
 #include "RendererSettings.h"
 #include "SceneViewport.h"
 #include "ConstantBuffers.h"
@@ -24,6 +27,7 @@ namespace adria
 
 	class Camera;
 	class Input;
+	class Terrain;
 	struct Light;
 	struct RenderState;
 
@@ -61,6 +65,8 @@ namespace adria
 		GfxTexture const* GetOffscreenTexture() const;
 		PickingData GetLastPickingData() const;
 		std::vector<Timestamp> GetProfilerResults();
+		MeshletCullStatistics GetClusterCullStatistics() const { return cluster_cull_statistics; }
+		MeshInstancingStatistics GetInstancingStatistics() const { return instancing_statistics; }
 
 	private:
 		uint32 width, height;
@@ -70,6 +76,8 @@ namespace adria
 		RendererSettings renderer_settings;
 		ParticleRenderer particle_renderer;
 		bool profiling_enabled = false;
+		MeshletCullStatistics cluster_cull_statistics{};
+		MeshInstancingStatistics instancing_statistics{};
 
 		SceneViewport current_scene_viewport;
 		bool pick_in_current_frame = false;
@@ -185,6 +193,23 @@ namespace adria
 		std::unique_ptr<GfxBuffer>	light_list = nullptr;
 		std::unique_ptr<GfxBuffer>	light_grid = nullptr;
 
+		//gbuffer instancing, rebuilt every frame
+		std::vector<MeshInstanceItem> gbuffer_instance_items;
+		std::vector<MeshInstanceBatch> gbuffer_instance_batches;
+		std::vector<uint64> gbuffer_single_payloads;
+		std::vector<MeshInstance> gbuffer_instances;
+		std::shared_ptr<GfxBuffer> gbuffer_instance_buffer = nullptr;
+
+		//cdlod terrain, the height field textures and the shared patch are created once per terrain, the nodes are selected every frame
+		uint64 terrain_generation = 0;
+		std::unique_ptr<GfxTexture> terrain_heightmap = nullptr;
+		std::unique_ptr<GfxTexture> terrain_normalmap = nullptr;
+		std::unique_ptr<GfxBuffer> terrain_patch_vb = nullptr;
+		std::unique_ptr<GfxBuffer> terrain_patch_ib = nullptr;
+		std::vector<TerrainLODInstance> terrain_instances;
+		std::array<uint32, TerrainNodeQuadrant_All + 1> terrain_quadrant_instance_counts{};
+		std::unique_ptr<GfxBuffer> terrain_instance_buffer = nullptr;
+
 		std::unique_ptr<GfxBuffer> cube_vb;
 		std::unique_ptr<GfxBuffer> cube_ib;
 		std::unique_ptr<GfxBuffer> aabb_wireframe_ib;
@@ -232,8 +257,14 @@ namespace adria
 		void UpdateParticles(float dt);
 		void UpdateLights();
 		void UpdateTerrainData();
+		void CreateTerrainResources();
 		void UpdateVoxelData();
 		void CameraFrustumCulling();
+		void SelectTerrainNodes();
+		void SelectMeshLods();
+		void RequestTextureMips();
+		//for an entity drawn on its own, returns whether its visible index ranges are drawn instead of the whole mesh
+		bool CullMeshClusters(tecs::entity e, BoundingFrustum const& camera_frustum);
 		void LightFrustumCulling(LightType type);
 		
 		void PassPicking();
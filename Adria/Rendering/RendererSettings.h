@@ -20,6 +20,11 @@ namespace adria
 		float shadow_softness = 1.0f;
 		bool shadow_transparent = false;
 		float split_lambda = 0.25f;
+		//mesh lod
+		bool mesh_lod = true;
+		float mesh_lod_error = 1.0f; //largest allowed simplification error on screen, in pixels
+		bool cluster_culling = true;
+		bool mesh_instancing = true;	//draws entities sharing a mesh and a material with one instanced draw
 		
 		AntiAliasing anti_aliasing = AntiAliasing_None;
 		
@@ -0,0 +1,213 @@
+#include <execution>
+#include <numeric>
+#include "Scatter.h"
+#include "Terrain.h"
+#include "Math/Constants.h"
+#include "Utilities/Random.h"
+#include "Utilities/Timer.h"
+#include "Logging/Logger.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr uint32 CANDIDATE_COUNT = 30;
+		static constexpr uint32 SEED_ATTEMPTS = 30;
+		static constexpr float BRIDSON_DENSITY = 0.7f; //points per min_distance^2 achieved by Bridson's algorithm, measured
+		static constexpr uint64 RULES_STREAM_OFFSET = 1ull << 32;
+
+		class ScatterGrid
+		{
+		public:
+			ScatterGrid(Vector2 const& origin, float cell_size, uint64 width, uint64 depth)
+				: origin(origin), cell_size(cell_size), width(width), depth(depth), cells(width * depth, Vector2(EMPTY, EMPTY))
+			{}
+
+			bool Fits(Vector2 const& p, float min_distance_sq) const
+			{
+				int64 cx = (int64)((p.x - origin.x) / cell_size);
+				int64 cz = (int64)((p.y - origin.y) / cell_size);
+				for (int64 z = std::max<int64>(cz - 2, 0); z <= std::min<int64>(cz + 2, depth - 1); ++z)
+				{
+					for (int64 x = std::max<int64>(cx - 2, 0); x <= std::min<int64>(cx + 2, width - 1); ++x)
+					{
+						Vector2 const& q = cells[z * width + x];
+						if (q.x == EMPTY) continue;
+						if (Vector2::DistanceSquared(p, q) < min_distance_sq) return false;
+					}
+				}
+				return true;
+			}
+
+			void Insert(Vector2 const& p)
+			{
+				uint64 cx = std::min<uint64>((uint64)((p.x - origin.x) / cell_size), width - 1);
+				uint64 cz = std::min<uint64>((uint64)((p.y - origin.y) / cell_size), depth - 1);
+				cells[cz * width + cx] = p;
+			}
+
+		private:
+			static constexpr float EMPTY = std::numeric_limits<float>::max();
+
+			Vector2 origin;
+			float cell_size;
+			uint64 width;
+			uint64 depth;
+			std::vector<Vector2> cells;
+		};
+
+		struct ScatterTile
+		{
+			uint64 index;
+			Vector2 min;
+			Vector2 max;
+			std::vector<Vector2> points;
+			std::vector<ScatterInstance> instances;
+		};
+
+		void FillTile(ScatterTile& tile, ScatterGrid& grid, float min_distance, uint32 seed)
+		{
+			CounterRandomGenerator rng(seed, tile.index);
+			float const min_distance_sq = min_distance * min_distance;
+			auto Inside = [&tile](Vector2 const& p) { return p.x >= tile.min.x && p.x < tile.max.x && p.y >= tile.min.y && p.y < tile.max.y; };
+
+			std::vector<Vector2> active;
+			for (uint32 attempt = 0; attempt < SEED_ATTEMPTS; ++attempt)
+			{
+				Vector2 seed_point(rng.NextFloat(tile.min.x, tile.max.x), rng.NextFloat(tile.min.y, tile.max.y));
+				if (!grid.Fits(seed_point, min_distance_sq)) continue;
+
+				grid.Insert(seed_point);
+				tile.points.push_back(seed_point);
+				active.push_back(seed_point);
+				while (!active.empty())
+				{
+					uint64 active_index = rng.NextInRange(0, active.size() - 1);
+					Vector2 const p = active[active_index];
+					bool found = false;
+					for (uint32 k = 0; k < CANDIDATE_COUNT; ++k)
+					{
+						float angle = rng.NextFloat(0.0f, 2.0f * pi<float>);
+						float radius = rng.NextFloat(min_distance, 2.0f * min_distance);
+						Vector2 q(p.x + radius * std::cos(angle), p.y + radius * std::sin(angle));
+						if (!Inside(q) || !grid.Fits(q, min_distance_sq)) continue;
+
+						grid.Insert(q);
+						tile.points.push_back(q);
+						active.push_back(q);
+						found = true;
+						break;
+					}
+					if (!found)
+					{
+						active[active_index] = active.back();
+						active.pop_back();
+					}
+				}
+			}
+		}
+
+		void ApplyRules(ScatterTile& tile, Terrain const* terrain, ScatterDesc const& desc)
+		{
+			uint64 const count = tile.points.size();
+			std::vector<float> heights(count, 0.0f);
+			std::vector<Vector3> normals(count, Vector3(0.0f, 1.0f, 0.0f));
+			if (terrain)
+			{
+				terrain->HeightAtBatch(tile.points, heights);
+				terrain->NormalAtBatch(tile.points, normals);
+			}
+
+			ScatterRules const& rules = desc.rules;
+			CounterRandomGenerator rng(desc.seed, RULES_STREAM_OFFSET + tile.index);
+			tile.instances.reserve(count);
+			for (uint64 i = 0; i < count; ++i)
+			{
+				float rotation = rng.NextFloat(0.0f, 2.0f * pi<float>);
+				float keep = rng.NextFloat(0.0f, 1.0f);
+
+				float height = heights[i] + desc.height_offset;
+				if (height > rules.height_end || height < rules.height_start || normals[i].y < rules.slope_start) continue;
+
+				Vector3 position(tile.points[i].x, height, tile.points[i].y);
+				if (rules.density_mask && keep >= rules.density_mask(position, normals[i])) continue;
+				tile.instances.emplace_back(position, rotation);
+			}
+		}
+	}
+
+	namespace Scatter
+	{
+		float MinDistanceForCount(Vector2 const& extents, uint64 count)
+		{
+			float const area = 4.0f * extents.x * extents.y;
+			return std::sqrt(BRIDSON_DENSITY * area / std::max<uint64>(count, 1));
+		}
+
+		std::vector<ScatterInstance> Generate(Terrain const* terrain, ScatterDesc const& desc)
+		{
+			ADRIA_ASSERT(desc.min_distance > 0.0f);
+			Timer t;
+
+			//one point per cell, tiles are aligned to cells and wide enough that only direct neighbours are read
+			float const min_distance = desc.min_distance;
+			float const cell_size = min_distance / std::sqrt(2.0f);
+			float const requested_tile_size = desc.tile_size > 0.0f ? desc.tile_size : 32.0f * min_distance;
+			uint64 const cells_per_tile = std::max<uint64>((uint64)std::ceil(std::max(requested_tile_size, 2.0f * min_distance) / cell_size), 3);
+			float const tile_size = cells_per_tile * cell_size;
+
+			Vector2 const origin = desc.center - desc.extents;
+			Vector2 const area_size = 2.0f * desc.extents;
+			uint64 const tile_count_x = std::max<uint64>((uint64)std::ceil(area_size.x / tile_size), 1);
+			uint64 const tile_count_z = std::max<uint64>((uint64)std::ceil(area_size.y / tile_size), 1);
+			ScatterGrid grid(origin, cell_size, tile_count_x * cells_per_tile, tile_count_z * cells_per_tile);
+
+			std::vector<ScatterTile> tiles(tile_count_x * tile_count_z);
+			std::vector<ScatterTile*> phases[4];
+			for (uint64 z = 0; z < tile_count_z; ++z)
+			{
+				for (uint64 x = 0; x < tile_count_x; ++x)
+				{
+					ScatterTile& tile = tiles[z * tile_count_x + x];
+					tile.index = z * tile_count_x + x;
+					tile.min = origin + Vector2(x * tile_size, z * tile_size);
+					tile.max = Vector2::Min(tile.min + Vector2(tile_size, tile_size), origin + area_size);
+					phases[(z & 1) * 2 + (x & 1)].push_back(&tile);
+				}
+			}
+
+			for (auto& phase : phases)
+			{
+				std::for_each(std::execution::par, std::begin(phase), std::end(phase), [&](ScatterTile* tile)
+					{
+						FillTile(*tile, grid, min_distance, desc.seed);
+					});
+			}
+			float const poisson_time = t.MarkInSeconds();
+
+			std::for_each(std::execution::par, std::begin(tiles), std::end(tiles), [&](ScatterTile& tile)
+				{
+					ApplyRules(tile, terrain, desc);
+				});
+
+			std::vector<uint64> offsets(tiles.size() + 1, 0);
+			uint64 generated_count = 0;
+			for (size_t i = 0; i < tiles.size(); ++i)
+			{
+				offsets[i + 1] = offsets[i] + tiles[i].instances.size();
+				generated_count += tiles[i].points.size();
+			}
+
+			std::vector<ScatterInstance> instances(offsets.back());
+			std::for_each(std::execution::par, std::begin(tiles), std::end(tiles), [&](ScatterTile const& tile)
+				{
+					std::copy(std::begin(tile.instances), std::end(tile.instances), std::begin(instances) + offsets[tile.index]);
+				});
+
+			ADRIA_LOG(INFO, "Scattered %llu instances (%llu points, %.3f points/m^2, %llu tiles) in %f s (poisson %f s, rules %f s)",
+				(unsigned long long)instances.size(), (unsigned long long)generated_count, generated_count / std::max(area_size.x * area_size.y, 1e-6f), (unsigned long long)tiles.size(),
+				t.ElapsedInSeconds(), poisson_time, t.MarkInSeconds());
+			return instances;
+		}
+	}
+}
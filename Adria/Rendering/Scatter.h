@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <limits>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	class Terrain;
+
+	//matches the per-instance layout of the foliage input layout
+	struct ScatterInstance
+	{
+		Vector3 position;
+		float rotation_y;
+	};
+
+	struct ScatterRules
+	{
+		float height_start = std::numeric_limits<float>::lowest();
+		float height_end = std::numeric_limits<float>::max();
+		float slope_start = 0.0f; //minimal normal.y
+		//optional mask (e.g. from terrain layer weights), returns the probability of keeping a point
+		std::function<float(Vector3 const& position, Vector3 const& normal)> density_mask = nullptr;
+	};
+
+	struct ScatterDesc
+	{
+		Vector2 center;
+		Vector2 extents;
+		float min_distance = 1.0f;
+		float height_offset = 0.0f;
+		uint32 seed = 1337;
+		float tile_size = 0.0f; //0 picks a tile size from min_distance
+		ScatterRules rules;
+	};
+
+	/* Blue-noise scattering on top of the terrain. The area is split into tiles that are filled with Poisson-disk points
+	   (Bridson's algorithm) against a shared spatial hash with one point per cell. Tiles are processed in four phases by parity
+	   so tiles generated at the same time never touch each other's cells; every tile has its own random stream,
+	   so the result doesn't depend on thread scheduling. */
+	namespace Scatter
+	{
+		//min distance that gives roughly count points over the area
+		float MinDistanceForCount(Vector2 const& extents, uint64 count);
+
+		std::vector<ScatterInstance> Generate(Terrain const* terrain, ScatterDesc const& desc);
+	}
+}
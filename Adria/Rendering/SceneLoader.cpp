@@ -0,0 +1,128 @@
+#include "SceneLoader.h"
+#include "Logging/Logger.h"
+#include "Utilities/StringUtil.h"
+#include "Utilities/FilesUtil.h"
+#include "Tasks/TaskManager.h"
+
+namespace adria
+{
+	SceneLoader::SceneLoader(ModelImporter& model_importer) : model_importer(model_importer)
+	{}
+
+	SceneLoader::~SceneLoader()
+	{
+		for (auto& pending_model : pending_models) pending_model->import.wait();
+		if (pending_environment) pending_environment->read.wait();
+	}
+
+	void SceneLoader::LoadScene(SceneConfig const& config)
+	{
+		if (!IsLoading()) load_timer.Mark();
+		first_frame = true;
+		for (auto&& model : config.scene_models) LoadModel(model);
+		LoadSkybox(config.skybox_params);
+		for (auto&& light : config.scene_lights) model_importer.LoadLight(light);
+	}
+
+	void SceneLoader::LoadModel(ModelParameters const& params)
+	{
+		if (!IsLoading()) load_timer.Mark();
+
+		PendingModel* pending_model = pending_models.emplace_back(std::make_unique<PendingModel>()).get();
+		pending_model->params = params;
+		std::shared_ptr<Task> import_task = g_TaskManager.CreateTask([this, pending_model]()
+			{
+				pending_model->imported = model_importer.ImportMeshCache_GLTF(pending_model->params, pending_model->cache);
+				++imported_count;
+			});
+		pending_model->import = g_TaskManager.SubmitTask(import_task);
+
+		++progress.models_total;
+		progress_event.Broadcast(progress);
+	}
+
+	void SceneLoader::LoadSkybox(SkyboxParameters const& params)
+	{
+		if (!params.cubemap.has_value() || ToLower(GetExtension(ToString(params.cubemap.value()))) != ".hdr")
+		{
+			model_importer.LoadSkybox(params);
+			return;
+		}
+		if (pending_environment)
+		{
+			ADRIA_LOG(WARNING, "Skybox %s is ignored, the environment map of the previous one is still loading", ToString(params.cubemap.value()).c_str());
+			return;
+		}
+		if (!IsLoading()) load_timer.Mark();
+
+		pending_environment = std::make_unique<PendingEnvironment>();
+		pending_environment->path = params.cubemap.value();
+		pending_environment->skybox = model_importer.CreateSkybox();
+		std::shared_ptr<Task> read_task = g_TaskManager.CreateTask([environment = pending_environment.get()]()
+			{
+				environment->baked = TextureManager::ReadEnvironmentMap(environment->path);
+			});
+		pending_environment->read = g_TaskManager.SubmitTask(read_task);
+
+		progress.environment_loading = true;
+		progress_event.Broadcast(progress);
+	}
+
+	void SceneLoader::Update(float time_budget)
+	{
+		if (first_frame)
+		{
+			ADRIA_LOG(INFO, "First frame %f s after the scene started loading", load_timer.PeekInSeconds());
+			first_frame = false;
+		}
+		if (pending_models.empty() && !pending_environment) return;
+
+		SceneLoadProgress const previous_progress = progress;
+		if (pending_environment && pending_environment->read.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			pending_environment->read.get();
+			std::string const path = ToString(pending_environment->path);
+			if (pending_environment->baked)
+			{
+				AdriaTimer timer;
+				EnvironmentMap const environment_map = g_TextureManager.CreateEnvironmentMap(pending_environment->path, *pending_environment->baked);
+				model_importer.SetSkyboxEnvironment(pending_environment->skybox, environment_map);
+				ADRIA_LOG(INFO, "Environment map %s created %f s after the scene started loading, textures took %f s", path.c_str(),
+					load_timer.PeekInSeconds(), timer.ElapsedInSeconds());
+			}
+			else ADRIA_LOG(WARNING, "Failed to load environment map %s, the sky stays black", path.c_str());
+			pending_environment = nullptr;
+			progress.environment_loading = false;
+		}
+
+		AdriaTimer timer;
+		bool created_any = false;
+		for (auto it = std::begin(pending_models); it != std::end(pending_models);)
+		{
+			if (created_any && timer.ElapsedInSeconds() * 1000.0f >= time_budget) break;
+
+			PendingModel& pending_model = **it;
+			if (pending_model.import.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+			pending_model.import.get();
+			if (pending_model.imported) model_importer.CreateEntities_GLTF(pending_model.params, pending_model.cache);
+			else ++progress.models_failed;
+			++progress.models_created;
+			created_any = true;
+			it = pending_models.erase(it);
+		}
+		progress.models_imported = imported_count.load();
+
+		if (progress == previous_progress) return;
+		progress_event.Broadcast(progress);
+		if (progress.Finished())
+		{
+			float const load_time = load_timer.PeekInSeconds();
+			ADRIA_LOG(INFO, "Scene loaded in %f s: %u models, %u failed", load_time, progress.models_total, progress.models_failed);
+			scene_loaded_event.Broadcast(load_time);
+		}
+	}
+}
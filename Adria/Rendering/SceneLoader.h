@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <future>
+#include <atomic>
+#include "Camera.h"
+#include "ModelImporter.h"
+#include "MeshCache.h"
+#include "TextureManager.h"
+#include "Events/Delegate.h"
+#include "Utilities/Timer.h"
+
+namespace adria
+{
+	struct SceneConfig
+	{
+		std::vector<ModelParameters> scene_models;
+		std::vector<LightParameters> scene_lights;
+		SkyboxParameters skybox_params;
+		CameraParameters camera_params;
+	};
+
+	struct SceneLoadProgress
+	{
+		uint32 models_total = 0;
+		uint32 models_imported = 0;	//imports done on the task threads, successful or not
+		uint32 models_created = 0;	//models done on the main thread, includes failed imports
+		uint32 models_failed = 0;
+		bool environment_loading = false;	//the environment map of the skybox is read or baked on the task threads
+
+		bool operator==(SceneLoadProgress const&) const = default;
+		bool Finished() const { return models_created == models_total && !environment_loading; }
+		float Fraction() const { return models_total ? (models_imported + models_created) / (2.0f * models_total) : 1.0f; }
+	};
+
+	class SceneLoader;
+	DECLARE_EVENT(SceneLoadProgressEvent, SceneLoader, SceneLoadProgress const&);
+	DECLARE_EVENT(SceneLoadedEvent, SceneLoader, float);
+
+	/* Imports the models of a scene on the task manager threads. Their entities are created on the main thread in Update, whole models
+	   at a time, so a model shows up only once its buffers and textures exist. The environment map of an .hdr skybox is read or
+	   baked on the task manager threads as well, the sky draws black until Update creates its textures. Other skyboxes and lights
+	   are cheap and created right away. */
+	class SceneLoader
+	{
+		static constexpr float DEFAULT_TIME_BUDGET = 4.0f;	//ms per frame spent creating entities, at least one model is created per frame
+
+		struct PendingModel
+		{
+			ModelParameters params;
+			MeshCacheFile cache;
+			bool imported = false;
+			std::future<void> import;
+		};
+
+		struct PendingEnvironment
+		{
+			std::wstring path;
+			tecs::entity skybox;
+			std::optional<BakedEnvironment> baked;
+			std::future<void> read;
+		};
+
+	public:
+		explicit SceneLoader(ModelImporter& model_importer);
+		SceneLoader(SceneLoader const&) = delete;
+		SceneLoader& operator=(SceneLoader const&) = delete;
+		~SceneLoader();
+
+		void LoadScene(SceneConfig const& config);
+		void LoadModel(ModelParameters const& params);
+		void LoadSkybox(SkyboxParameters const& params);
+
+		//sync point, call once per frame before the scene is updated
+		void Update(float time_budget = DEFAULT_TIME_BUDGET);
+
+		bool IsLoading() const { return !progress.Finished(); }
+		SceneLoadProgress const& GetProgress() const { return progress; }
+		SceneLoadProgressEvent& GetProgressEvent() { return progress_event; }
+		SceneLoadedEvent& GetSceneLoadedEvent() { return scene_loaded_event; }
+
+	private:
+		ModelImporter& model_importer;
+		std::vector<std::unique_ptr<PendingModel>> pending_models;
+		std::atomic<uint32> imported_count = 0;
+		std::unique_ptr<PendingEnvironment> pending_environment;
+		bool first_frame = false;
+		SceneLoadProgress progress{};
+		SceneLoadProgressEvent progress_event;
+		SceneLoadedEvent scene_loaded_event;
+		AdriaTimer load_timer;
+	};
+}
@@ -4,10 +4,12 @@
 #include <execution>
 #include <filesystem>
 #include "ShaderManager.h"
+#include "MeshInstancing.h"
 #include "Graphics/GfxShaderProgram.h"
 #include "Graphics/GfxShaderCompiler.h"
 #include "Graphics/GfxDevice.h"
 #include "Graphics/GfxInputLayout.h"
+#include "Graphics/GfxVertexFormat.h"
 #include "Logging/Logger.h"
 #include "Utilities/Timer.h"
 #include "Utilities/HashMap.h"
@@ -47,12 +49,19 @@ namespace adria
 			case VS_Sun:
 			case VS_Decal:
 			case VS_GBufferTerrain:
+			case VS_GBufferTerrain_CDLOD:
 			case VS_GBufferPBR:
+			case VS_GBufferPBR_Compressed:
+			case VS_GBufferPBR_Instanced:
+			case VS_GBufferPBR_Compressed_Instanced:
 			case VS_FullscreenQuad:
 			case VS_LensFlare:
 			case VS_Bokeh:
 			case VS_Shadow:
 			case VS_ShadowTransparent:
+			case VS_ShadowFoliage:
+			case VS_Shadow_Compressed:
+			case VS_ShadowTransparent_Compressed:
 			case VS_Ocean:
 			case VS_OceanLOD:
 			case VS_Foliage:
@@ -212,6 +221,9 @@ namespace adria
 				return "Postprocess/Fog.hlsl";
 			case VS_Shadow:
 			case VS_ShadowTransparent:
+			case VS_ShadowFoliage:
+			case VS_Shadow_Compressed:
+			case VS_ShadowTransparent_Compressed:
 			case PS_Shadow:
 			case PS_ShadowTransparent:
 				return "Misc/Shadow.hlsl";
@@ -256,10 +268,14 @@ namespace adria
 			case DS_OceanLOD:
 				return "Ocean/OceanLod.hlsl";
 			case VS_GBufferPBR:
+			case VS_GBufferPBR_Compressed:
+			case VS_GBufferPBR_Instanced:
+			case VS_GBufferPBR_Compressed_Instanced:
 			case PS_GBufferPBR:
 			case PS_GBufferPBR_Mask:
 				return "GBuffer/GBuffer.hlsl";
 			case VS_GBufferTerrain:
+			case VS_GBufferTerrain_CDLOD:
 			case PS_GBufferTerrain:
 				return "GBuffer/Terrain.hlsl";
 			case VS_Decal:
@@ -301,6 +317,9 @@ namespace adria
 			{
 			case VS_Shadow: 
 			case VS_ShadowTransparent:
+			case VS_ShadowFoliage:
+			case VS_Shadow_Compressed:
+			case VS_ShadowTransparent_Compressed:
 				return "ShadowVS";
 			case PS_Shadow: 
 			case PS_ShadowTransparent:
@@ -399,11 +418,15 @@ namespace adria
 			case PS_Texture:
 				return "TexturePS";
 			case VS_GBufferPBR:
+			case VS_GBufferPBR_Compressed:
+			case VS_GBufferPBR_Instanced:
+			case VS_GBufferPBR_Compressed_Instanced:
 				return "GBufferVS";
 			case PS_GBufferPBR:
 			case PS_GBufferPBR_Mask:
 				return "GBufferPS";
 			case VS_GBufferTerrain:
+			case VS_GBufferTerrain_CDLOD:
 				return "TerrainVS";
 			case PS_GBufferTerrain:
 				return "TerrainPS";
@@ -490,6 +513,19 @@ namespace adria
 			case VS_ShadowTransparent:
 			case PS_ShadowTransparent:
 				return { {"TRANSPARENT", "1"} };
+			case VS_ShadowFoliage:
+				return { {"TRANSPARENT", "1"}, {"FOLIAGE", "1"} };
+			case VS_Shadow_Compressed:
+			case VS_GBufferPBR_Compressed:
+				return { {"COMPRESSED_VERTICES", "1"} };
+			case VS_GBufferPBR_Instanced:
+				return { {"INSTANCED", "1"} };
+			case VS_GBufferPBR_Compressed_Instanced:
+				return { {"COMPRESSED_VERTICES", "1"}, {"INSTANCED", "1"} };
+			case VS_GBufferTerrain_CDLOD:
+				return { {"CDLOD", "1"} };
+			case VS_ShadowTransparent_Compressed:
+				return { {"TRANSPARENT", "1"}, {"COMPRESSED_VERTICES", "1"} };
 			case CS_BlurVertical:
 				return { { "VERTICAL", "1" } };
 			case PS_GBufferPBR_Mask:
@@ -499,7 +535,8 @@ namespace adria
 			}
 		}
 
-		void CompileShader(ShaderId shader, bool first_compile = false)
+		//only calls the compiler, so it can run on any thread as long as there is no retry prompt, which only the main thread may show
+		bool CompileShaderBytecode(ShaderId shader, GfxShaderCompileOutput& output, bool retry_prompt = true)
 		{
 			GfxShaderDesc input{ .entrypoint = GetEntryPoint(shader) };
 #if _DEBUG
@@ -507,15 +544,17 @@ namespace adria
 #else
 			input.flags = GfxShaderCompilerFlagBit_None;
 #endif
+			if (!retry_prompt) input.flags |= GfxShaderCompilerFlagBit_NoRetryPrompt;
 			input.source_file = "Resources/Shaders/" + GetShaderSource(shader);
 			input.stage = GetStage(shader);
 			input.macros = GetShaderMacros(shader);
+			return GfxShaderCompiler::CompileShader(input, output);
+		}
 
-			GfxShaderCompileOutput output{};
-			bool result = GfxShaderCompiler::CompileShader(input, output);
-			if (!result) return;
-
-			switch (input.stage)
+		//creates the shader on the device and puts it in the shader maps, on the main thread only
+		void CommitShader(ShaderId shader, GfxShaderCompileOutput const& output, bool first_compile)
+		{
+			switch (GetStage(shader))
 			{
 			case GfxShaderStage::VS:
 				if(first_compile) vs_shader_map[shader] = std::make_unique<GfxVertexShader>(device, output.shader_bytecode);
@@ -547,6 +586,52 @@ namespace adria
 			dependent_files_map[shader].clear();
 			dependent_files_map[shader].insert(output.includes.begin(), output.includes.end());
 		}
+		void CompileShader(ShaderId shader, bool first_compile = false)
+		{
+			GfxShaderCompileOutput output{};
+			if (!CompileShaderBytecode(shader, output)) return;
+			CommitShader(shader, output, first_compile);
+		}
+		//reflection only yields 32 bit formats, the packed formats of CompressedVertex have to be spelled out
+		GfxInputLayoutDesc const* GetInputLayoutDesc(ShaderId shader)
+		{
+			static GfxInputLayoutDesc const compressed_vertex_desc
+			{
+				.elements =
+				{
+					{ .semantic_name = "POSITION", .format = GfxFormat::R16G16B16A16_UNORM, .aligned_byte_offset = offsetof(CompressedVertex, position) },
+					{ .semantic_name = "NORMAL", .format = GfxFormat::R8G8B8A8_SNORM, .aligned_byte_offset = offsetof(CompressedVertex, normal) },
+					{ .semantic_name = "TEX", .format = GfxFormat::R16G16_FLOAT, .aligned_byte_offset = offsetof(CompressedVertex, uv) }
+				}
+			};
+			static GfxInputLayoutDesc const compressed_vertex_instanced_desc = []()
+			{
+				GfxInputLayoutDesc desc = compressed_vertex_desc;
+				for (uint32 row = 0; row < 4; ++row)
+				{
+					desc.elements.push_back({ .semantic_name = "INSTANCE_MODEL", .semantic_index = row, .format = GfxFormat::R32G32B32_FLOAT, .input_slot = 1,
+						.aligned_byte_offset = (uint32)(offsetof(MeshInstance, model) + row * sizeof(Vector3)), .input_slot_class = GfxInputClassification::PerInstanceData });
+				}
+				for (uint32 row = 0; row < 3; ++row)
+				{
+					desc.elements.push_back({ .semantic_name = "INSTANCE_INVERSE", .semantic_index = row, .format = GfxFormat::R32G32B32_FLOAT, .input_slot = 1,
+						.aligned_byte_offset = (uint32)(offsetof(MeshInstance, inverse_model) + row * sizeof(Vector3)), .input_slot_class = GfxInputClassification::PerInstanceData });
+				}
+				return desc;
+			}();
+			switch (shader)
+			{
+			case VS_GBufferPBR_Compressed:
+			case VS_Shadow_Compressed:
+			case VS_ShadowTransparent_Compressed:
+				return &compressed_vertex_desc;
+			case VS_GBufferPBR_Compressed_Instanced:
+				return &compressed_vertex_instanced_desc;
+			default:
+				return nullptr;
+			}
+		}
+
 		void CreateAllPrograms()
 		{
 			using UnderlyingType = std::underlying_type_t<ShaderId>;
@@ -555,7 +640,8 @@ namespace adria
 				ShaderId shader = (ShaderId)s;
 				if (GetStage(shader) != GfxShaderStage::VS) continue;
 				
-				input_layout_map[shader] = std::make_unique<GfxInputLayout>(device, vs_shader_map[shader]->GetBytecode());
+				if (GfxInputLayoutDesc const* desc = GetInputLayoutDesc(shader)) input_layout_map[shader] = std::make_unique<GfxInputLayout>(device, vs_shader_map[shader]->GetBytecode(), *desc);
+				else input_layout_map[shader] = std::make_unique<GfxInputLayout>(device, vs_shader_map[shader]->GetBytecode());
 			}
 
 			gfx_shader_program_map[ShaderProgram::Skybox].SetVertexShader(vs_shader_map[VS_Sky].get()).SetPixelShader(ps_shader_map[PS_Skybox].get()).SetInputLayout(input_layout_map[VS_Sky].get());
@@ -568,8 +654,15 @@ namespace adria
 			gfx_shader_program_map[ShaderProgram::Decals].SetVertexShader(vs_shader_map[VS_Decal].get()).SetPixelShader(ps_shader_map[PS_Decal].get()).SetInputLayout(input_layout_map[VS_Decal].get());
 			gfx_shader_program_map[ShaderProgram::Decals_ModifyNormals].SetVertexShader(vs_shader_map[VS_Decal].get()).SetPixelShader(ps_shader_map[PS_DecalsModifyNormals].get()).SetInputLayout(input_layout_map[VS_Decal].get());
 			gfx_shader_program_map[ShaderProgram::GBuffer_Terrain].SetVertexShader(vs_shader_map[VS_GBufferTerrain].get()).SetPixelShader(ps_shader_map[PS_GBufferTerrain].get()).SetInputLayout(input_layout_map[VS_GBufferTerrain].get());
+			gfx_shader_program_map[ShaderProgram::GBuffer_Terrain_CDLOD].SetVertexShader(vs_shader_map[VS_GBufferTerrain_CDLOD].get()).SetPixelShader(ps_shader_map[PS_GBufferTerrain].get()).SetInputLayout(input_layout_map[VS_GBufferTerrain_CDLOD].get());
 			gfx_shader_program_map[ShaderProgram::GBufferPBR].SetVertexShader(vs_shader_map[VS_GBufferPBR].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR].get()).SetInputLayout(input_layout_map[VS_GBufferPBR].get());
 			gfx_shader_program_map[ShaderProgram::GBufferPBR_Mask].SetVertexShader(vs_shader_map[VS_GBufferPBR].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR_Mask].get()).SetInputLayout(input_layout_map[VS_GBufferPBR].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Compressed].SetVertexShader(vs_shader_map[VS_GBufferPBR_Compressed].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Compressed].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Mask_Compressed].SetVertexShader(vs_shader_map[VS_GBufferPBR_Compressed].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR_Mask].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Compressed].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Instanced].SetVertexShader(vs_shader_map[VS_GBufferPBR_Instanced].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Instanced].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Mask_Instanced].SetVertexShader(vs_shader_map[VS_GBufferPBR_Instanced].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR_Mask].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Instanced].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Compressed_Instanced].SetVertexShader(vs_shader_map[VS_GBufferPBR_Compressed_Instanced].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Compressed_Instanced].get());
+			gfx_shader_program_map[ShaderProgram::GBufferPBR_Mask_Compressed_Instanced].SetVertexShader(vs_shader_map[VS_GBufferPBR_Compressed_Instanced].get()).SetPixelShader(ps_shader_map[PS_GBufferPBR_Mask].get()).SetInputLayout(input_layout_map[VS_GBufferPBR_Compressed_Instanced].get());
 			gfx_shader_program_map[ShaderProgram::AmbientPBR].SetVertexShader(vs_shader_map[VS_FullscreenQuad].get()).SetPixelShader(ps_shader_map[PS_AmbientPBR].get()).SetInputLayout(input_layout_map[VS_FullscreenQuad].get());
 			gfx_shader_program_map[ShaderProgram::AmbientPBR_AO].SetVertexShader(vs_shader_map[VS_FullscreenQuad].get()).SetPixelShader(ps_shader_map[PS_AmbientPBR_AO].get()).SetInputLayout(input_layout_map[VS_FullscreenQuad].get());
 			gfx_shader_program_map[ShaderProgram::AmbientPBR_IBL].SetVertexShader(vs_shader_map[VS_FullscreenQuad].get()).SetPixelShader(ps_shader_map[PS_AmbientPBR_IBL].get()).SetInputLayout(input_layout_map[VS_FullscreenQuad].get());
@@ -599,6 +692,9 @@ namespace adria
 
 			gfx_shader_program_map[ShaderProgram::DepthMap].SetVertexShader(vs_shader_map[VS_Shadow].get()).SetPixelShader(ps_shader_map[PS_Shadow].get()).SetInputLayout(input_layout_map[VS_Shadow].get());
 			gfx_shader_program_map[ShaderProgram::DepthMap_Transparent].SetVertexShader(vs_shader_map[VS_ShadowTransparent].get()).SetPixelShader(ps_shader_map[PS_ShadowTransparent].get()).SetInputLayout(input_layout_map[VS_ShadowTransparent].get());
+			gfx_shader_program_map[ShaderProgram::DepthMap_Foliage].SetVertexShader(vs_shader_map[VS_ShadowFoliage].get()).SetPixelShader(ps_shader_map[PS_ShadowTransparent].get()).SetInputLayout(input_layout_map[VS_ShadowFoliage].get());
+			gfx_shader_program_map[ShaderProgram::DepthMap_Compressed].SetVertexShader(vs_shader_map[VS_Shadow_Compressed].get()).SetPixelShader(ps_shader_map[PS_Shadow].get()).SetInputLayout(input_layout_map[VS_Shadow_Compressed].get());
+			gfx_shader_program_map[ShaderProgram::DepthMap_Transparent_Compressed].SetVertexShader(vs_shader_map[VS_ShadowTransparent_Compressed].get()).SetPixelShader(ps_shader_map[PS_ShadowTransparent].get()).SetInputLayout(input_layout_map[VS_ShadowTransparent_Compressed].get());
 
 			gfx_shader_program_map[ShaderProgram::Volumetric_Directional].SetVertexShader(vs_shader_map[VS_FullscreenQuad].get()).SetPixelShader(ps_shader_map[PS_VolumetricLight_Directional].get()).SetInputLayout(input_layout_map[VS_FullscreenQuad].get());
 			gfx_shader_program_map[ShaderProgram::Volumetric_DirectionalCascades].SetVertexShader(vs_shader_map[VS_FullscreenQuad].get()).SetPixelShader(ps_shader_map[PS_VolumetricLight_DirectionalWithCascades].get()).SetInputLayout(input_layout_map[VS_FullscreenQuad].get());
@@ -645,18 +741,39 @@ namespace adria
 			ADRIA_LOG(INFO, "Compiling all shaders...");
 			using UnderlyingType = std::underlying_type_t<ShaderId>;
 
+			//the compiler runs on worker threads, the device and the shader maps are only touched on this one once every shader is compiled
+			std::vector<GfxShaderCompileOutput> outputs(ShaderId_Count);
+			std::vector<uint8> results(ShaderId_Count, false);
+			std::vector<float> compile_times(ShaderId_Count, 0.0f);
 			std::vector<UnderlyingType> shaders(ShaderId_Count);
 			std::iota(std::begin(shaders), std::end(shaders), 0);
 			std::for_each(
-				std::execution::seq,
+				std::execution::par,
 				std::begin(shaders),
 				std::end(shaders),
-				[](UnderlyingType s)
+				[&](UnderlyingType s)
 				{
-					CompileShader((ShaderId)s, true);
+					Timer shader_timer;
+					results[s] = CompileShaderBytecode((ShaderId)s, outputs[s], false);
+					compile_times[s] = shader_timer.ElapsedInSeconds();
 				});
+
+			uint32 cached_count = 0;
+			for (UnderlyingType s : shaders)
+			{
+				//failed shaders are compiled again here, where the errors can be fixed and retried
+				if (!results[s]) results[s] = CompileShaderBytecode((ShaderId)s, outputs[s]);
+				if (!results[s])
+				{
+					ADRIA_LOG(ERROR, "Shader %s failed to compile!", GetShaderSource((ShaderId)s).c_str());
+					continue;
+				}
+				if (outputs[s].from_cache) ++cached_count;
+				ADRIA_LOG(DEBUG, "Shader %s %s in %f seconds", GetShaderSource((ShaderId)s).c_str(), outputs[s].from_cache ? "read from cache" : "compiled", compile_times[s]);
+				CommitShader((ShaderId)s, outputs[s], true);
+			}
 			CreateAllPrograms();
-			ADRIA_LOG(INFO, "Compilation done in %f seconds!", t.ElapsedInSeconds());
+			ADRIA_LOG(INFO, "Compilation of %u shaders (%u read from cache) done in %f seconds!", (uint32)ShaderId_Count, cached_count, t.ElapsedInSeconds());
 		}
 		void OnShaderFileChanged(std::string const& filename)
 		{
@@ -1,76 +1,255 @@
 #include "Terrain.h"
 #include <cmath>
+#include <execution>
+#include <numeric>
+#include "TerrainStreaming.h"
+#include "Math/Packing.h"
+#include "Utilities/HashUtil.h"
 
 using namespace DirectX;
 
 namespace adria
 {
 
-	Terrain::Terrain(std::vector<TexturedNormalVertex> const& terrain_vertices, float tx, float tz, uint64 xcount, uint64 zcount) : terrain_vertices(terrain_vertices), tile_size_x(tx), tile_size_z(tz),
-		tile_count_x(xcount), tile_count_z(zcount), offset()
-	{}
-
-	float Terrain::HeightAt(float x, float z) const
+	Terrain::Terrain(std::vector<TexturedNormalVertex> const& terrain_vertices, float tx, float tz, uint64 xcount, uint64 zcount) : heights(terrain_vertices.size()), normals(terrain_vertices.size()),
+		height_scale(0.0f), height_bias(0.0f), tile_size_x(tx), tile_size_z(tz), tile_count_x(xcount), tile_count_z(zcount), offset()
 	{
-		uint64 x_1 = (uint64)(x / tile_size_x);
-		uint64 x_2 = (uint64)((x + tile_size_x) / tile_size_x);
-
-		uint64 z_1 = (uint64)(z / tile_size_z);
-		uint64 z_2 = (uint64)((z + tile_size_z) / tile_size_z);
+		ADRIA_ASSERT(tile_count_x > 0 && tile_count_z > 0);
+		ADRIA_ASSERT(terrain_vertices.size() == (tile_count_x + 1) * (tile_count_z + 1));
 
-		uint64 index1 = GetIndex(x_1, z_1);
-		float h1 = CheckIndex(index1) ? terrain_vertices[index1].position.y : 0.0f;
+		auto [min_vertex, max_vertex] = std::minmax_element(std::execution::par_unseq, std::begin(terrain_vertices), std::end(terrain_vertices),
+			[](TexturedNormalVertex const& lhs, TexturedNormalVertex const& rhs) { return lhs.position.y < rhs.position.y; });
 
-		uint64 index2 = GetIndex(x_2, z_1);
-		float h2 = CheckIndex(index2) ? terrain_vertices[index2].position.y : 0.0f;
+		height_bias = min_vertex->position.y;
+		height_scale = (max_vertex->position.y - min_vertex->position.y) / 65535.0f;
+		float const inv_height_scale = height_scale > 0.0f ? 1.0f / height_scale : 0.0f;
 
-		float alpha_x = (x - x_1 * tile_size_x) / ((x_2 - x_1) * tile_size_x);
-		float h_interpolated1 = std::lerp(h1, h2, alpha_x);
+		std::transform(std::execution::par_unseq, std::begin(terrain_vertices), std::end(terrain_vertices), std::begin(heights),
+			[this, inv_height_scale](TexturedNormalVertex const& v) { return QuantizeUnorm16(v.position.y, height_bias, inv_height_scale); });
+		std::transform(std::execution::par_unseq, std::begin(terrain_vertices), std::end(terrain_vertices), std::begin(normals),
+			[](TexturedNormalVertex const& v) { return PackOctahedral16(v.normal); });
+	}
 
-		uint64 index3 = GetIndex(x_1, z_2);
-		float h3 = CheckIndex(index3) ? terrain_vertices[index3].position.y : 0.0f;
+	Terrain::Terrain(TerrainTileCache const& cache) : height_scale(cache.Header().height_scale), height_bias(cache.Header().height_bias),
+		tile_size_x(cache.Header().sample_spacing_x), tile_size_z(cache.Header().sample_spacing_z),
+		tile_count_x(cache.Header().width - 1), tile_count_z(cache.Header().depth - 1), offset(), tile_cache(&cache)
+	{
+		ADRIA_ASSERT(cache.IsValid());
+	}
 
-		uint64 index4 = GetIndex(x_2, z_2);
-		float h4 = CheckIndex(index4) ? terrain_vertices[index4].position.y : 0.0f;
+	float Terrain::HeightAt(float x, float z) const
+	{
+		if (tile_cache) return tile_cache->HeightAt(x, z);
 
-		float h_interpolated2 = std::lerp(h3, h4, alpha_x);
+		uint64 const row_pitch = tile_count_x + 1;
+		SampleLocation location = Locate(x, z);
 
-		float alpha_z = (z - z_1 * tile_size_z) / ((z_2 - z_1) * tile_size_z);
+		float h1 = heights[location.index];
+		float h2 = heights[location.index + 1];
+		float h3 = heights[location.index + row_pitch];
+		float h4 = heights[location.index + row_pitch + 1];
 
-		return std::lerp(h_interpolated1, h_interpolated2, alpha_z);
+		float h_interpolated1 = std::lerp(h1, h2, location.alpha_x);
+		float h_interpolated2 = std::lerp(h3, h4, location.alpha_x);
+		return DecodeHeight(std::lerp(h_interpolated1, h_interpolated2, location.alpha_z));
 	}
 
 	Vector3 Terrain::NormalAt(float x, float z) const
 	{
-		uint64 x_1 = (uint64)(x / tile_size_x);
-		uint64 x_2 = (uint64)((x + tile_size_x) / tile_size_x);
-
-		uint64 z_1 = (uint64)(z / tile_size_z);
-		uint64 z_2 = (uint64)((z + tile_size_z) / tile_size_z);
+		if (tile_cache) return tile_cache->NormalAt(x, z);
 
-		uint64 index1 = GetIndex(x_1, z_1);
-		Vector3 n1 = CheckIndex(index1) ? terrain_vertices[index1].normal : Vector3(0.0f, 1.0f, 0.0f);
+		uint64 const row_pitch = tile_count_x + 1;
+		SampleLocation location = Locate(x, z);
 
-		uint64 index2 = GetIndex(x_2, z_1);
-		Vector3 n2 = CheckIndex(index2) ? terrain_vertices[index2].normal : Vector3(0.0f, 1.0f, 0.0f);
+		Vector3 n1 = UnpackOctahedral16(normals[location.index]);
+		Vector3 n2 = UnpackOctahedral16(normals[location.index + 1]);
+		Vector3 n3 = UnpackOctahedral16(normals[location.index + row_pitch]);
+		Vector3 n4 = UnpackOctahedral16(normals[location.index + row_pitch + 1]);
 
-		float alpha_x = (x - x_1 * tile_size_x) / ((x_2 - x_1) * tile_size_x);
+		Vector3 n_interpolated1 = Vector3::Lerp(n1, n2, location.alpha_x);
+		Vector3 n_interpolated2 = Vector3::Lerp(n3, n4, location.alpha_x);
+		return Vector3::Lerp(n_interpolated1, n_interpolated2, location.alpha_z);
+	}
 
-		Vector3 n_interpolated1 = Vector3::Lerp(n1, n2, alpha_x);
+	void Terrain::HeightAtBatch(std::span<Vector2 const> xz, std::span<float> out_heights) const
+	{
+		ADRIA_ASSERT(xz.size() == out_heights.size());
+		if (tile_cache)
+		{
+			for (size_t i = 0; i < xz.size(); ++i) out_heights[i] = tile_cache->HeightAt(xz[i].x, xz[i].y);
+			return;
+		}
+
+		uint64 const row_pitch = tile_count_x + 1;
+		XMVECTOR const scale = XMVectorReplicate(height_scale);
+		XMVECTOR const bias = XMVectorReplicate(height_bias);
+
+		size_t const simd_count = xz.size() & ~size_t(3);
+		for (size_t i = 0; i < simd_count; i += 4)
+		{
+			uint64 indices[4];
+			XMVECTOR alpha_x, alpha_z;
+			Locate4(&xz[i], indices, alpha_x, alpha_z);
+
+			alignas(16) float h00[4], h10[4], h01[4], h11[4];
+			for (uint32 lane = 0; lane < 4; ++lane)
+			{
+				uint64 index = indices[lane];
+				h00[lane] = heights[index];
+				h10[lane] = heights[index + 1];
+				h01[lane] = heights[index + row_pitch];
+				h11[lane] = heights[index + row_pitch + 1];
+			}
+
+			XMVECTOR h0 = XMVectorLerpV(XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(h00)), XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(h10)), alpha_x);
+			XMVECTOR h1 = XMVectorLerpV(XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(h01)), XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(h11)), alpha_x);
+			XMVECTOR h = XMVectorMultiplyAdd(XMVectorLerpV(h0, h1, alpha_z), scale, bias);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&out_heights[i]), h);
+		}
+
+		for (size_t i = simd_count; i < xz.size(); ++i) out_heights[i] = HeightAt(xz[i].x, xz[i].y);
+	}
 
-		uint64 index3 = GetIndex(x_1, z_2);
-		Vector3 n3 = CheckIndex(index3) ? terrain_vertices[index3].normal : Vector3(0.0f, 1.0f, 0.0f);
+	void Terrain::NormalAtBatch(std::span<Vector2 const> xz, std::span<Vector3> out_normals) const
+	{
+		ADRIA_ASSERT(xz.size() == out_normals.size());
+		if (tile_cache)
+		{
+			for (size_t i = 0; i < xz.size(); ++i) out_normals[i] = tile_cache->NormalAt(xz[i].x, xz[i].y);
+			return;
+		}
+
+		uint64 const row_pitch = tile_count_x + 1;
+		XMVECTOR const inv_snorm = XMVectorReplicate(1.0f / 127.0f);
+		XMVECTOR const minus_one = XMVectorReplicate(-1.0f);
+		XMVECTOR const one = XMVectorReplicate(1.0f);
+
+		//UnpackOctahedral16 for the same corner of 4 samples, the normals come out in x, y and z lanes
+		auto DecodeNormals = [&](float const u[4], float const v[4], XMVECTOR n[3])
+			{
+				XMVECTOR x = XMVectorMax(XMVectorMultiply(XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(u)), inv_snorm), minus_one);
+				XMVECTOR y = XMVectorMax(XMVectorMultiply(XMLoadFloat4A(reinterpret_cast<XMFLOAT4A const*>(v)), inv_snorm), minus_one);
+				XMVECTOR z = XMVectorSubtract(XMVectorSubtract(one, XMVectorAbs(x)), XMVectorAbs(y));
+				XMVECTOR t = XMVectorMax(XMVectorNegate(z), XMVectorZero());
+				x = XMVectorAdd(x, XMVectorSelect(t, XMVectorNegate(t), XMVectorGreaterOrEqual(x, XMVectorZero())));
+				y = XMVectorAdd(y, XMVectorSelect(t, XMVectorNegate(t), XMVectorGreaterOrEqual(y, XMVectorZero())));
+				XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(x, x, XMVectorMultiplyAdd(y, y, XMVectorMultiply(z, z))));
+				n[0] = XMVectorDivide(x, length);
+				n[1] = XMVectorDivide(y, length);
+				n[2] = XMVectorDivide(z, length);
+			};
+
+		size_t const simd_count = xz.size() & ~size_t(3);
+		for (size_t i = 0; i < simd_count; i += 4)
+		{
+			uint64 indices[4];
+			XMVECTOR alpha_x, alpha_z;
+			Locate4(&xz[i], indices, alpha_x, alpha_z);
+
+			//the snorm8 pairs of the 4 corners of every sample
+			alignas(16) float u[4][4], v[4][4];
+			for (uint32 lane = 0; lane < 4; ++lane)
+			{
+				uint64 const corner_indices[4] = { indices[lane], indices[lane] + 1, indices[lane] + row_pitch, indices[lane] + row_pitch + 1 };
+				for (uint32 corner = 0; corner < 4; ++corner)
+				{
+					uint16 const packed = normals[corner_indices[corner]];
+					u[corner][lane] = (float)(int8)(packed & 0xff);
+					v[corner][lane] = (float)(int8)(packed >> 8);
+				}
+			}
+
+			XMVECTOR n00[3], n10[3], n01[3], n11[3];
+			DecodeNormals(u[0], v[0], n00);
+			DecodeNormals(u[1], v[1], n10);
+			DecodeNormals(u[2], v[2], n01);
+			DecodeNormals(u[3], v[3], n11);
+
+			alignas(16) float n[3][4];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				XMVECTOR n0 = XMVectorLerpV(n00[c], n10[c], alpha_x);
+				XMVECTOR n1 = XMVectorLerpV(n01[c], n11[c], alpha_x);
+				XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(n[c]), XMVectorLerpV(n0, n1, alpha_z));
+			}
+			for (uint32 lane = 0; lane < 4; ++lane) out_normals[i + lane] = Vector3(n[0][lane], n[1][lane], n[2][lane]);
+		}
+
+		for (size_t i = simd_count; i < xz.size(); ++i) out_normals[i] = NormalAt(xz[i].x, xz[i].y);
+	}
 
-		uint64 index4 = GetIndex(x_2, z_2);
-		Vector3 n4 = CheckIndex(index4) ? terrain_vertices[index4].normal : Vector3(0.0f, 1.0f, 0.0f);
+	uint64 Terrain::ContentHash() const
+	{
+		if (tile_cache) return tile_cache->ContentHash();
+
+		uint64 const row_pitch = tile_count_x + 1;
+		std::vector<uint64> rows(tile_count_z + 1);
+		std::iota(std::begin(rows), std::end(rows), 0);
+		std::vector<uint64> row_hashes(2 * rows.size());
+		std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint64 z)
+			{
+				row_hashes[2 * z + 0] = crc64(reinterpret_cast<char const*>(&heights[z * row_pitch]), row_pitch * sizeof(uint16));
+				row_hashes[2 * z + 1] = crc64(reinterpret_cast<char const*>(&normals[z * row_pitch]), row_pitch * sizeof(uint16));
+			});
+
+		size_t hash = crc64(reinterpret_cast<char const*>(row_hashes.data()), row_hashes.size() * sizeof(uint64));
+		HashCombine(hash, height_scale);
+		HashCombine(hash, height_bias);
+		HashCombine(hash, tile_size_x);
+		HashCombine(hash, tile_size_z);
+		HashCombine(hash, tile_count_x);
+		HashCombine(hash, tile_count_z);
+		return hash;
+	}
 
-		Vector3 n_interpolated2 = Vector3::Lerp(n3, n4, alpha_x);
+	uint64 Terrain::MemoryUsage() const
+	{
+		if (tile_cache) return tile_cache->MemoryUsage();
+		return heights.size() * sizeof(uint16) + normals.size() * sizeof(uint16);
+	}
 
-		float alpha_z = (z - z_1 * tile_size_z) / ((z_2 - z_1) * tile_size_z);
+	Terrain::SampleLocation Terrain::Locate(float x, float z) const
+	{
+		float fx = std::clamp(x / tile_size_x, 0.0f, (float)tile_count_x);
+		float fz = std::clamp(z / tile_size_z, 0.0f, (float)tile_count_z);
+		uint64 cell_x = std::min((uint64)fx, tile_count_x - 1);
+		uint64 cell_z = std::min((uint64)fz, tile_count_z - 1);
+
+		SampleLocation location{};
+		location.index = cell_x + cell_z * (tile_count_x + 1);
+		location.alpha_x = fx - cell_x;
+		location.alpha_z = fz - cell_z;
+		return location;
+	}
 
-		Vector3 normal = Vector3::Lerp(n_interpolated1, n_interpolated2, alpha_z);
-		return normal;
+	void Terrain::Locate4(Vector2 const* xz, uint64 indices[4], XMVECTOR& alpha_x, XMVECTOR& alpha_z) const
+	{
+		XMVECTOR const inv_tile_size_x = XMVectorReplicate(1.0f / tile_size_x);
+		XMVECTOR const inv_tile_size_z = XMVectorReplicate(1.0f / tile_size_z);
+		XMVECTOR const max_x = XMVectorReplicate((float)tile_count_x);
+		XMVECTOR const max_z = XMVectorReplicate((float)tile_count_z);
+		XMVECTOR const max_cell_x = XMVectorReplicate((float)(tile_count_x - 1));
+		XMVECTOR const max_cell_z = XMVectorReplicate((float)(tile_count_z - 1));
+
+		//xz is interleaved, deinterleave 4 samples into x and z lanes
+		XMVECTOR p01 = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&xz[0]));
+		XMVECTOR p23 = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&xz[2]));
+		XMVECTOR x = XMVectorPermute<0, 2, 4, 6>(p01, p23);
+		XMVECTOR z = XMVectorPermute<1, 3, 5, 7>(p01, p23);
+
+		XMVECTOR fx = XMVectorClamp(XMVectorMultiply(x, inv_tile_size_x), XMVectorZero(), max_x);
+		XMVECTOR fz = XMVectorClamp(XMVectorMultiply(z, inv_tile_size_z), XMVectorZero(), max_z);
+		XMVECTOR cell_x = XMVectorMin(XMVectorFloor(fx), max_cell_x);
+		XMVECTOR cell_z = XMVectorMin(XMVectorFloor(fz), max_cell_z);
+		alpha_x = XMVectorSubtract(fx, cell_x);
+		alpha_z = XMVectorSubtract(fz, cell_z);
+
+		alignas(16) uint32 ix[4];
+		alignas(16) uint32 iz[4];
+		XMStoreInt4A(ix, XMConvertVectorFloatToUInt(cell_x, 0));
+		XMStoreInt4A(iz, XMConvertVectorFloatToUInt(cell_z, 0));
+		uint64 const row_pitch = tile_count_x + 1;
+		for (uint32 lane = 0; lane < 4; ++lane) indices[lane] = iz[lane] * row_pitch + ix[lane];
 	}
 
 }
-
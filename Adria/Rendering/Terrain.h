@@ -1,21 +1,33 @@
 #pragma once
 #include <vector>
+#include <span>
 #include <DirectXMath.h>
 #include "Core/CoreTypes.h"
 #include "Graphics/GfxVertexFormat.h"
 
 namespace adria
 {
+	class TerrainTileCache;
+
+	/* Height field used for CPU queries: heights are stored as unorm16 with scale and bias and
+	   normals as 8-bit octahedral pairs, 4 bytes per sample instead of a full vertex copy. */
 	class Terrain
 	{
 	public:
 		Terrain(std::vector<TexturedNormalVertex> const& terrain_vertices, float tx, float tz, uint64 xcount, uint64 zcount);
+		/* Queries go to the finest resident tiles of the cache, so they get more accurate as tiles around the camera are streamed in.
+		   Such a terrain has no samples of its own, Heights() and Normals() are empty. The cache has to outlive the terrain. */
+		explicit Terrain(TerrainTileCache const& cache);
 
 		float HeightAt(float x, float z) const;
-		
+
 		Vector3 NormalAt(float x, float z) const;
 
-		std::pair<float, float> TileSizes() const 
+		void HeightAtBatch(std::span<Vector2 const> xz, std::span<float> heights) const;
+
+		void NormalAtBatch(std::span<Vector2 const> xz, std::span<Vector3> normals) const;
+
+		std::pair<float, float> TileSizes() const
 		{
 			return { tile_size_x, tile_size_z };
 		}
@@ -25,24 +37,60 @@ namespace adria
 			return { tile_count_x, tile_count_z };
 		}
 
+		//quantized samples in rows of TileCounts().first + 1, heights decode to HeightBias() + HeightScale() * h
+		std::span<uint16 const> Heights() const
+		{
+			return heights;
+		}
+
+		std::span<uint16 const> Normals() const
+		{
+			return normals;
+		}
+
+		float HeightScale() const
+		{
+			return height_scale;
+		}
+
+		float HeightBias() const
+		{
+			return height_bias;
+		}
+
+		//hash of the quantized height field and grid layout, used to key data derived from the terrain
+		uint64 ContentHash() const;
+
+		uint64 MemoryUsage() const;
+
 	private:
-		std::vector<TexturedNormalVertex> terrain_vertices;
+		std::vector<uint16> heights;
+		std::vector<uint16> normals;
+		float height_scale;
+		float height_bias;
 		float tile_size_x;
 		float tile_size_z;
 		uint64 tile_count_x;
 		uint64 tile_count_z;
 		Vector3 offset;
+		TerrainTileCache const* tile_cache = nullptr;
 
 	private:
 
-		uint64 GetIndex(uint64 x_, uint64 z_) const
+		struct SampleLocation
 		{
-			return x_ + z_ * (tile_count_x + 1);
-		}
+			uint64 index;
+			float alpha_x;
+			float alpha_z;
+		};
+
+		SampleLocation Locate(float x, float z) const;
+		//the same for 4 positions at once, the blend weights go in the lanes of alpha_x and alpha_z
+		void Locate4(Vector2 const* xz, uint64 indices[4], DirectX::XMVECTOR& alpha_x, DirectX::XMVECTOR& alpha_z) const;
 
-		bool CheckIndex(uint64 i) const
+		float DecodeHeight(float h) const
 		{
-			return i >= 0 && i < terrain_vertices.size();
+			return height_bias + height_scale * h;
 		}
 	};
-}
\ No newline at end of file
+}
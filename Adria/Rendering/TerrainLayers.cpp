@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+#include "TerrainLayers.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr int64 BLUR_RADIUS = TERRAIN_LAYER_BLUR_RADIUS;
+		static constexpr int64 BLUR_TAPS = 2 * BLUR_RADIUS + 1;
+		static constexpr uint64 COLUMN_STRIP_WIDTH = 64;
+	}
+
+	uint32 ComputeTerrainLayerWeights(float height, float normal_y, TerrainTextureLayerParameters const& params)
+	{
+		float rocks = 0.0f, sand = 0.0f, grass = 0.0f;
+		if (height > params.terrain_rocks_start)
+		{
+			float mix_multiplier = std::max(
+				(height - params.terrain_rocks_start) / params.height_mix_zone,
+				1.0f
+			);
+			float rock_slope_multiplier = std::clamp((normal_y - params.terrain_slope_rocks_start) / params.slope_mix_zone, 0.0f, 1.0f);
+			rocks = (uint8)(UINT8_MAX * mix_multiplier * rock_slope_multiplier);
+		}
+
+		if (height > params.terrain_sand_start && height <= params.terrain_sand_end)
+		{
+			float mix_multiplier = std::min(
+				(height - params.terrain_sand_start) / params.height_mix_zone,
+				(params.terrain_sand_end - height) / params.height_mix_zone
+			);
+			sand = (uint8)(UINT8_MAX * mix_multiplier);
+		}
+
+		if (height > params.terrain_grass_start && height <= params.terrain_grass_end)
+		{
+			float mix_multiplier = std::min(
+				(height - params.terrain_grass_start) / params.height_mix_zone,
+				(params.terrain_grass_end - height) / params.height_mix_zone
+			);
+
+			float grass_slope_multiplier = std::clamp((normal_y - params.terrain_slope_grass_start) / params.slope_mix_zone, 0.0f, 1.0f);
+			grass = (uint8)(UINT8_MAX * mix_multiplier * grass_slope_multiplier);
+		}
+
+		float sum = rocks + sand + grass + 1;
+		uint32 r = (uint8)((rocks / sum) * UINT8_MAX);
+		uint32 g = (uint8)((sand / sum) * UINT8_MAX);
+		uint32 b = (uint8)((grass / sum) * UINT8_MAX);
+		return r | (g << 8) | (b << 16);
+	}
+
+	void BlurTerrainLayerWeights(std::span<uint8> layer_texels, uint64 width, uint64 depth)
+	{
+		ADRIA_ASSERT(layer_texels.size() == width * depth * 4);
+		if (width <= 2 * BLUR_RADIUS || depth <= 2 * BLUR_RADIUS) return;
+
+		std::vector<uint64> rows(depth);
+		std::iota(std::begin(rows), std::end(rows), 0);
+
+		//horizontal pass: sums of 5 texels per channel, max 5 * 255 fits in uint16
+		std::vector<uint16> row_sums(width * depth * 3);
+		std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint64 j)
+			{
+				uint8 const* src = layer_texels.data() + j * width * 4;
+				uint16* dst = row_sums.data() + j * width * 3;
+				uint32 sum[3] = { 0, 0, 0 };
+				for (int64 i = 0; i < BLUR_TAPS - 1; ++i)
+				{
+					for (uint32 c = 0; c < 3; ++c) sum[c] += src[i * 4 + c];
+				}
+				for (int64 i = BLUR_RADIUS; i < (int64)width - BLUR_RADIUS; ++i)
+				{
+					for (uint32 c = 0; c < 3; ++c)
+					{
+						sum[c] += src[(i + BLUR_RADIUS) * 4 + c];
+						dst[i * 3 + c] = (uint16)sum[c];
+						sum[c] -= src[(i - BLUR_RADIUS) * 4 + c];
+					}
+				}
+			});
+
+		//vertical pass over strips of columns so it reads whole cache lines, writes the interior texels
+		std::vector<uint64> strips((width + COLUMN_STRIP_WIDTH - 1) / COLUMN_STRIP_WIDTH);
+		std::iota(std::begin(strips), std::end(strips), 0);
+		std::for_each(std::execution::par, std::begin(strips), std::end(strips), [&](uint64 strip)
+			{
+				uint64 const i_begin = std::max<uint64>(strip * COLUMN_STRIP_WIDTH, BLUR_RADIUS);
+				uint64 const i_end = std::min<uint64>((strip + 1) * COLUMN_STRIP_WIDTH, width - BLUR_RADIUS);
+				if (i_begin >= i_end) return;
+
+				uint64 const strip_width = i_end - i_begin;
+				std::vector<uint32> sums(strip_width * 3, 0);
+				for (int64 j = 0; j < BLUR_TAPS - 1; ++j)
+				{
+					uint16 const* src = row_sums.data() + (j * width + i_begin) * 3;
+					for (uint64 k = 0; k < strip_width * 3; ++k) sums[k] += src[k];
+				}
+				for (int64 j = BLUR_RADIUS; j < (int64)depth - BLUR_RADIUS; ++j)
+				{
+					uint16 const* add = row_sums.data() + ((j + BLUR_RADIUS) * width + i_begin) * 3;
+					uint16 const* sub = row_sums.data() + ((j - BLUR_RADIUS) * width + i_begin) * 3;
+					uint8* dst = layer_texels.data() + (j * width + i_begin) * 4;
+					for (uint64 k = 0; k < strip_width * 3; ++k) sums[k] += add[k];
+					for (uint64 i = 0; i < strip_width; ++i)
+					{
+						for (uint32 c = 0; c < 3; ++c) dst[i * 4 + c] = (uint8)(sums[i * 3 + c] / (BLUR_TAPS * BLUR_TAPS));
+					}
+					for (uint64 k = 0; k < strip_width * 3; ++k) sums[k] -= sub[k];
+				}
+			});
+	}
+
+	TerrainLayerMap::TerrainLayerMap(std::vector<uint32> layer_texels, uint32 map_width, uint32 map_depth, Vector2 const& map_texel_size)
+		: texels(std::move(layer_texels)), width(map_width), depth(map_depth), texel_size(map_texel_size)
+	{
+		ADRIA_ASSERT(width > 0 && depth > 0 && texels.size() == uint64(width) * depth);
+	}
+
+	float TerrainLayerMap::Weight(TerrainLayer layer, float x, float z) const
+	{
+		uint32 const shift = 8 * static_cast<uint32>(layer);
+		auto TexelWeight = [this, shift](uint32 i, uint32 j) { return float((texels[uint64(j) * width + i] >> shift) & 0xff); };
+
+		float const fx = std::clamp(x / texel_size.x, 0.0f, float(width - 1));
+		float const fz = std::clamp(z / texel_size.y, 0.0f, float(depth - 1));
+		uint32 const i = std::min((uint32)fx, width > 1 ? width - 2 : 0);
+		uint32 const j = std::min((uint32)fz, depth > 1 ? depth - 2 : 0);
+		uint32 const i_next = std::min(i + 1, width - 1);
+		uint32 const j_next = std::min(j + 1, depth - 1);
+		float const alpha_x = fx - i;
+		float const alpha_z = fz - j;
+
+		float const w1 = std::lerp(TexelWeight(i, j), TexelWeight(i_next, j), alpha_x);
+		float const w2 = std::lerp(TexelWeight(i, j_next), TexelWeight(i_next, j_next), alpha_x);
+		return std::lerp(w1, w2, alpha_z) / UINT8_MAX;
+	}
+}
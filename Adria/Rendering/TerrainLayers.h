@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	struct TerrainTextureLayerParameters
+	{
+		float terrain_sand_start = -100.0f;
+		float terrain_sand_end = 0.0f;
+		float terrain_grass_start = 0.0f;
+		float terrain_grass_end = 300.0f;
+		float terrain_slope_grass_start = 0.92f;
+		float terrain_slope_rocks_start = 0.85f;
+		float terrain_rocks_start = 50.0f;
+		float height_mix_zone = 50.0f;
+		float slope_mix_zone = 0.025f;
+	};
+	//channels of the layer texture, in the order ComputeTerrainLayerWeights packs them
+	enum class TerrainLayer : uint8
+	{
+		Rock,
+		Sand,
+		Grass
+	};
+
+	inline constexpr uint32 TERRAIN_LAYER_BLUR_RADIUS = 2;
+
+	//packs normalized rock/sand/grass weights into the rgb channels of a RGBA8 texel
+	uint32 ComputeTerrainLayerWeights(float height, float normal_y, TerrainTextureLayerParameters const& params);
+
+	/* Smooths the rgb channels of RGBA8 layer texels with a 5x5 box filter, in place. The filter is split into a horizontal and a
+	   vertical running-sum pass so the cost per texel doesn't depend on its size, rows and strips of columns go in parallel.
+	   Texels closer to the border than the filter radius are left unfiltered. */
+	void BlurTerrainLayerWeights(std::span<uint8> layer_texels, uint64 width, uint64 depth);
+
+	/* CPU copy of the terrain layer texture, so placement can follow the layers the terrain is shaded with.
+	   Texel (i, j) holds the weights of the terrain at (i * texel_size.x, j * texel_size.y). */
+	class TerrainLayerMap
+	{
+	public:
+		TerrainLayerMap(std::vector<uint32> layer_texels, uint32 map_width, uint32 map_depth, Vector2 const& map_texel_size);
+
+		//bilinearly filtered weight of the layer in [0, 1], positions outside the terrain are clamped to its border
+		float Weight(TerrainLayer layer, float x, float z) const;
+
+		uint32 Width() const { return width; }
+		uint32 Depth() const { return depth; }
+
+	private:
+		std::vector<uint32> texels;
+		uint32 width;
+		uint32 depth;
+		Vector2 texel_size;
+	};
+}
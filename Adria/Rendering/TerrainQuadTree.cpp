@@ -0,0 +1,229 @@
+#include <execution>
+#include <numeric>
+#include "TerrainQuadTree.h"
+#include "Utilities/Heightmap.h"
+
+using namespace DirectX;
+
+namespace adria
+{
+
+	TerrainQuadTree::TerrainQuadTree(Heightmap const& heightmap, TerrainQuadTreeDesc const& desc)
+		: TerrainQuadTree(heightmap.Width(), heightmap.Depth(), [&heightmap](uint64 x, uint64 z) { return heightmap.HeightAt(x, z); }, desc)
+	{}
+
+	TerrainQuadTree::TerrainQuadTree(uint64 width, uint64 depth, HeightSampler const& sampler, TerrainQuadTreeDesc const& desc)
+		: desc(desc), cell_count_x(width - 1), cell_count_z(depth - 1)
+	{
+		ADRIA_ASSERT(width > 1 && depth > 1);
+		ADRIA_ASSERT(desc.lod_count > 0 && desc.leaf_node_size > 0);
+		Build(sampler);
+
+		lod_ranges.resize(levels.size());
+		float range = desc.lod0_range;
+		for (size_t i = 0; i < lod_ranges.size(); ++i)
+		{
+			lod_ranges[i] = range;
+			range *= desc.lod_range_ratio;
+		}
+	}
+
+	void TerrainQuadTree::Build(HeightSampler const& sampler)
+	{
+		levels.resize(desc.lod_count);
+
+		LODLevel& leaves = levels[0];
+		leaves.node_size = desc.leaf_node_size;
+		leaves.node_count_x = (uint32)((cell_count_x + desc.leaf_node_size - 1) / desc.leaf_node_size);
+		leaves.node_count_z = (uint32)((cell_count_z + desc.leaf_node_size - 1) / desc.leaf_node_size);
+		leaves.nodes.resize(uint64(leaves.node_count_x) * leaves.node_count_z);
+
+		std::vector<uint32> leaf_rows(leaves.node_count_z);
+		std::iota(std::begin(leaf_rows), std::end(leaf_rows), 0);
+		std::for_each(std::execution::par, std::begin(leaf_rows), std::end(leaf_rows), [&](uint32 nz)
+			{
+				uint64 const z_begin = uint64(nz) * leaves.node_size;
+				uint64 const z_end = std::min(z_begin + leaves.node_size, cell_count_z);
+				for (uint32 nx = 0; nx < leaves.node_count_x; ++nx)
+				{
+					uint64 const x_begin = uint64(nx) * leaves.node_size;
+					uint64 const x_end = std::min(x_begin + leaves.node_size, cell_count_x);
+
+					NodeMinMax min_max{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+					for (uint64 z = z_begin; z <= z_end; ++z)
+					{
+						for (uint64 x = x_begin; x <= x_end; ++x)
+						{
+							float h = sampler(x, z);
+							min_max.min_height = std::min(min_max.min_height, h);
+							min_max.max_height = std::max(min_max.max_height, h);
+						}
+					}
+					leaves.nodes[uint64(nz) * leaves.node_count_x + nx] = min_max;
+				}
+			});
+
+		for (uint32 lod = 1; lod < desc.lod_count; ++lod)
+		{
+			LODLevel const& children = levels[lod - 1];
+			LODLevel& parents = levels[lod];
+			parents.node_size = children.node_size * 2;
+			parents.node_count_x = (children.node_count_x + 1) / 2;
+			parents.node_count_z = (children.node_count_z + 1) / 2;
+			parents.nodes.resize(uint64(parents.node_count_x) * parents.node_count_z);
+			for (uint32 nz = 0; nz < parents.node_count_z; ++nz)
+			{
+				for (uint32 nx = 0; nx < parents.node_count_x; ++nx)
+				{
+					NodeMinMax min_max{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+					for (uint32 q = 0; q < 4; ++q)
+					{
+						uint32 cx = nx * 2 + (q & 1);
+						uint32 cz = nz * 2 + (q >> 1);
+						if (cx >= children.node_count_x || cz >= children.node_count_z) continue;
+						NodeMinMax const& child = children.nodes[uint64(cz) * children.node_count_x + cx];
+						min_max.min_height = std::min(min_max.min_height, child.min_height);
+						min_max.max_height = std::max(min_max.max_height, child.max_height);
+					}
+					parents.nodes[uint64(nz) * parents.node_count_x + nx] = min_max;
+				}
+			}
+		}
+	}
+
+	void TerrainQuadTree::Select(Vector3 const& camera_position, BoundingFrustum const& frustum, std::vector<TerrainLODInstance>& instances) const
+	{
+		instances.clear();
+		uint32 const top_lod = LODCount() - 1;
+		LODLevel const& top_level = levels[top_lod];
+		for (uint32 z = 0; z < top_level.node_count_z; ++z)
+		{
+			for (uint32 x = 0; x < top_level.node_count_x; ++x)
+			{
+				//nodes beyond the range of the coarsest lod are still drawn with it
+				if (!SelectNode(top_lod, x, z, camera_position, frustum, false, instances) && frustum.Contains(NodeBounds(top_lod, x, z)) != DISJOINT)
+				{
+					AddInstance(top_lod, x, z, TerrainNodeQuadrant_All, instances);
+				}
+			}
+		}
+	}
+
+	BoundingBox TerrainQuadTree::NodeBounds(uint32 lod, uint32 x, uint32 z) const
+	{
+		LODLevel const& level = levels[lod];
+		NodeMinMax const& min_max = level.nodes[uint64(z) * level.node_count_x + x];
+
+		uint64 const x_begin = uint64(x) * level.node_size;
+		uint64 const x_end = std::min(x_begin + level.node_size, cell_count_x);
+		uint64 const z_begin = uint64(z) * level.node_size;
+		uint64 const z_end = std::min(z_begin + level.node_size, cell_count_z);
+
+		Vector3 min_corner(desc.offset.x + x_begin * desc.tile_size_x, desc.offset.y + min_max.min_height, desc.offset.z + z_begin * desc.tile_size_z);
+		Vector3 max_corner(desc.offset.x + x_end * desc.tile_size_x, desc.offset.y + min_max.max_height, desc.offset.z + z_end * desc.tile_size_z);
+
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, min_corner, max_corner);
+		return bounds;
+	}
+
+	uint64 TerrainQuadTree::MemoryUsage() const
+	{
+		uint64 memory = 0;
+		for (LODLevel const& level : levels) memory += level.nodes.size() * sizeof(NodeMinMax);
+		return memory;
+	}
+
+	void TerrainQuadTree::GeneratePatch(uint32 patch_size, std::vector<Vector2>& vertices, std::vector<uint16>& indices)
+	{
+		ADRIA_ASSERT(patch_size % 2 == 0 && (patch_size + 1) * (patch_size + 1) <= UINT16_MAX);
+		uint32 const vertex_count_x = patch_size + 1;
+
+		vertices.clear();
+		vertices.reserve(vertex_count_x * vertex_count_x);
+		for (uint32 z = 0; z <= patch_size; ++z)
+		{
+			for (uint32 x = 0; x <= patch_size; ++x)
+			{
+				vertices.emplace_back(x * 1.0f / patch_size, z * 1.0f / patch_size);
+			}
+		}
+
+		uint32 const half_size = patch_size / 2;
+		indices.clear();
+		indices.reserve(patch_size * patch_size * 6);
+		for (uint32 q = 0; q < 4; ++q)
+		{
+			uint32 const x_begin = (q & 1) * half_size;
+			uint32 const z_begin = (q >> 1) * half_size;
+			for (uint32 z = z_begin; z < z_begin + half_size; ++z)
+			{
+				for (uint32 x = x_begin; x < x_begin + half_size; ++x)
+				{
+					uint16 i1 = (uint16)(z * vertex_count_x + x);
+					uint16 i2 = (uint16)(i1 + 1);
+					uint16 i3 = (uint16)((z + 1) * vertex_count_x + x);
+					uint16 i4 = (uint16)(i3 + 1);
+
+					indices.push_back(i1);
+					indices.push_back(i3);
+					indices.push_back(i2);
+
+					indices.push_back(i2);
+					indices.push_back(i3);
+					indices.push_back(i4);
+				}
+			}
+		}
+	}
+
+	/* Returns false if the node is out of range of its lod, in which case the parent covers its area.
+	   Nodes that are culled still return true since their area is handled (by not drawing anything). */
+	bool TerrainQuadTree::SelectNode(uint32 lod, uint32 x, uint32 z, Vector3 const& camera_position, BoundingFrustum const& frustum, 
+		bool fully_inside, std::vector<TerrainLODInstance>& instances) const
+	{
+		BoundingBox const bounds = NodeBounds(lod, x, z);
+		if (!BoundingSphere(camera_position, lod_ranges[lod]).Intersects(bounds)) return false;
+
+		if (!fully_inside)
+		{
+			ContainmentType containment = frustum.Contains(bounds);
+			if (containment == DISJOINT) return true;
+			fully_inside = containment == CONTAINS;
+		}
+
+		if (lod == 0 || !BoundingSphere(camera_position, lod_ranges[lod - 1]).Intersects(bounds))
+		{
+			AddInstance(lod, x, z, TerrainNodeQuadrant_All, instances);
+			return true;
+		}
+
+		LODLevel const& children = levels[lod - 1];
+		for (uint32 q = 0; q < 4; ++q)
+		{
+			uint32 cx = x * 2 + (q & 1);
+			uint32 cz = z * 2 + (q >> 1);
+			if (cx >= children.node_count_x || cz >= children.node_count_z) continue;
+			if (!SelectNode(lod - 1, cx, cz, camera_position, frustum, fully_inside, instances))
+			{
+				AddInstance(lod, x, z, q, instances);
+			}
+		}
+		return true;
+	}
+
+	void TerrainQuadTree::AddInstance(uint32 lod, uint32 x, uint32 z, uint32 quadrant, std::vector<TerrainLODInstance>& instances) const
+	{
+		uint32 const node_size = levels[lod].node_size;
+		float const morph_end = lod_ranges[lod];
+		float const morph_begin = lod > 0 ? lod_ranges[lod - 1] : 0.0f;
+
+		TerrainLODInstance& instance = instances.emplace_back();
+		instance.offset = Vector2(desc.offset.x + uint64(x) * node_size * desc.tile_size_x, desc.offset.z + uint64(z) * node_size * desc.tile_size_z);
+		instance.scale = Vector2(node_size * desc.tile_size_x, node_size * desc.tile_size_z);
+		instance.lod = lod;
+		instance.quadrant = quadrant;
+		instance.morph_range = Vector2(morph_begin + (morph_end - morph_begin) * desc.morph_start_ratio, morph_end);
+	}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <DirectXCollision.h>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	class Heightmap;
+
+	struct TerrainQuadTreeDesc
+	{
+		uint32 leaf_node_size = 32;		//cells per side of a leaf node, also the resolution of the shared grid patch
+		uint32 lod_count = 6;
+		float tile_size_x = 1.0f;
+		float tile_size_z = 1.0f;
+		Vector3 offset = Vector3(0.0f, 0.0f, 0.0f);
+		float lod0_range = 64.0f;		//distance covered by the finest lod
+		float lod_range_ratio = 2.0f;
+		float morph_start_ratio = 0.66f;
+	};
+
+	enum TerrainNodeQuadrant : uint32
+	{
+		TerrainNodeQuadrant_00,
+		TerrainNodeQuadrant_10,
+		TerrainNodeQuadrant_01,
+		TerrainNodeQuadrant_11,
+		TerrainNodeQuadrant_All
+	};
+
+	//one draw of the shared grid patch, or of one quadrant of it
+	struct TerrainLODInstance
+	{
+		Vector2 offset;			//world space xz of the node's min corner
+		Vector2 scale;			//world space size of the node
+		uint32  lod;
+		uint32  quadrant;		//TerrainNodeQuadrant, selects the index range of the patch
+		Vector2 morph_range;	//distances at which morphing to the next lod starts and ends
+	};
+
+	/* Continuous distance-dependent LOD (CDLOD) quadtree. Nodes are stored implicitly, one min/max height grid
+	   per lod level, so a 16k x 16k terrain with 32x32 leaves needs around 3 MB. Nothing here depends on the
+	   graphics backend: the selection produces a flat list of instances of one shared grid patch. */
+	class TerrainQuadTree
+	{
+	public:
+		using HeightSampler = std::function<float(uint64 x, uint64 z)>;
+
+	public:
+		TerrainQuadTree(Heightmap const& heightmap, TerrainQuadTreeDesc const& desc);
+		TerrainQuadTree(uint64 width, uint64 depth, HeightSampler const& sampler, TerrainQuadTreeDesc const& desc);
+
+		void Select(Vector3 const& camera_position, BoundingFrustum const& frustum, std::vector<TerrainLODInstance>& instances) const;
+
+		TerrainQuadTreeDesc const& Desc() const { return desc; }
+		uint32 LODCount() const { return (uint32)levels.size(); }
+		float LODRange(uint32 lod) const { return lod_ranges[lod]; }
+		BoundingBox NodeBounds(uint32 lod, uint32 x, uint32 z) const;
+		uint64 MemoryUsage() const;
+
+		//patch indices are ordered by quadrant, quadrant q uses the range [q * indices.size() / 4, (q + 1) * indices.size() / 4)
+		static void GeneratePatch(uint32 patch_size, std::vector<Vector2>& vertices, std::vector<uint16>& indices);
+
+	private:
+		struct NodeMinMax
+		{
+			float min_height;
+			float max_height;
+		};
+		struct LODLevel
+		{
+			uint32 node_count_x;
+			uint32 node_count_z;
+			uint32 node_size;
+			std::vector<NodeMinMax> nodes;
+		};
+
+		TerrainQuadTreeDesc desc;
+		uint64 cell_count_x;
+		uint64 cell_count_z;
+		std::vector<LODLevel> levels; //levels[0] holds the leaves
+		std::vector<float> lod_ranges;
+
+	private:
+		void Build(HeightSampler const& sampler);
+		bool SelectNode(uint32 lod, uint32 x, uint32 z, Vector3 const& camera_position, BoundingFrustum const& frustum, 
+			bool fully_inside, std::vector<TerrainLODInstance>& instances) const;
+		void AddInstance(uint32 lod, uint32 x, uint32 z, uint32 quadrant, std::vector<TerrainLODInstance>& instances) const;
+	};
+}
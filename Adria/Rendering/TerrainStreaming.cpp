@@ -0,0 +1,528 @@
+#include <execution>
+#include <numeric>
+#include "TerrainStreaming.h"
+#include "TerrainLayers.h"
+#include "Math/Packing.h"
+#include "Tasks/TaskManager.h"
+#include "Utilities/Heightmap.h"
+#include "Utilities/HeightmapCache.h"
+#include "Utilities/HashUtil.h"
+#include "Graphics/GfxVertexFormat.h"
+#include "Utilities/FilesUtil.h"
+#include "Utilities/Timer.h"
+#include "Logging/Logger.h"
+
+namespace adria
+{
+	namespace
+	{
+		static constexpr uint32 TERRAIN_TILE_FILE_MAGIC = 0x4e525441; //"ATRN"
+		static constexpr uint32 TERRAIN_TILE_FILE_VERSION = 1;
+
+		uint64 TileSampleCount(uint32 tile_resolution)
+		{
+			return uint64(tile_resolution + 1) * (tile_resolution + 1);
+		}
+
+		uint64 TileRecordSize(uint32 tile_resolution)
+		{
+			return TileSampleCount(tile_resolution) * (2 * sizeof(uint16) + sizeof(uint32));
+		}
+
+		struct TileRecord
+		{
+			uint16* heights;
+			uint16* normals;
+			uint32* layers;
+		};
+
+		TileRecord GetTileRecord(MemoryMappedFile const& file, uint32 tile_resolution, uint64 tile_index)
+		{
+			uint64 const sample_count = TileSampleCount(tile_resolution);
+			uint64 const offset = sizeof(TerrainTileFileHeader) + tile_index * TileRecordSize(tile_resolution);
+
+			TileRecord record{};
+			record.heights = file.As<uint16>(offset);
+			record.normals = file.As<uint16>(offset + sample_count * sizeof(uint16));
+			record.layers = file.As<uint32>(offset + sample_count * 2 * sizeof(uint16));
+			return record;
+		}
+	}
+
+	std::vector<TerrainTileMip> ComputeTerrainTileMips(uint64 width, uint64 depth, uint32 tile_resolution)
+	{
+		std::vector<TerrainTileMip> mips;
+		uint64 first_tile = 0;
+		while (true)
+		{
+			TerrainTileMip mip{};
+			mip.width = width;
+			mip.depth = depth;
+			mip.tile_count_x = std::max<uint64>((width - 1 + tile_resolution - 1) / tile_resolution, 1);
+			mip.tile_count_z = std::max<uint64>((depth - 1 + tile_resolution - 1) / tile_resolution, 1);
+			mip.first_tile = first_tile;
+			mips.push_back(mip);
+
+			first_tile += mip.tile_count_x * mip.tile_count_z;
+			if (mip.tile_count_x == 1 && mip.tile_count_z == 1) break;
+
+			width = std::max<uint64>((width - 1) / 2 + 1, 2);
+			depth = std::max<uint64>((depth - 1) / 2 + 1, 2);
+		}
+		return mips;
+	}
+
+	namespace TerrainTileGenerator
+	{
+		bool Generate(uint64 width, uint64 depth, float min_height, float max_height, HeightSource const& source,
+			TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc)
+		{
+			ADRIA_ASSERT(width >= 2 && depth >= 2);
+			ADRIA_ASSERT(desc.tile_resolution >= 2);
+
+			Timer timer;
+			uint32 const resolution = desc.tile_resolution;
+			std::vector<TerrainTileMip> mips = ComputeTerrainTileMips(width, depth, resolution);
+			uint64 const tile_count = mips.back().first_tile + 1;
+
+			std::error_code ec;
+			fs::path output_directory = fs::path(desc.output_path).parent_path();
+			if (!output_directory.empty()) fs::create_directories(output_directory, ec);
+
+			MemoryMappedFile file;
+			if (!file.Create(desc.output_path, sizeof(TerrainTileFileHeader) + tile_count * TileRecordSize(resolution)))
+			{
+				ADRIA_LOG(ERROR, "Failed to create terrain tile file %s", desc.output_path.c_str());
+				return false;
+			}
+
+			float const height_bias = min_height;
+			float const height_scale = (max_height - min_height) / 65535.0f;
+			float const inv_height_scale = height_scale > 0.0f ? 1.0f / height_scale : 0.0f;
+
+			std::vector<uint64> tiles(tile_count);
+			std::iota(std::begin(tiles), std::end(tiles), 0);
+			std::for_each(std::execution::par, std::begin(tiles), std::end(tiles), [&](uint64 tile_index)
+				{
+					uint32 mip_level = 0;
+					while (mip_level + 1 < mips.size() && tile_index >= mips[mip_level + 1].first_tile) ++mip_level;
+					TerrainTileMip const& mip = mips[mip_level];
+					uint64 const tile_x = (tile_index - mip.first_tile) % mip.tile_count_x;
+					uint64 const tile_z = (tile_index - mip.first_tile) / mip.tile_count_x;
+
+					//heights with a one sample border so normals can use central differences at the tile edges
+					int64 const padded = resolution + 3;
+					std::vector<float> heights(padded * padded);
+					for (int64 j = 0; j < padded; ++j)
+					{
+						int64 mip_z = std::clamp<int64>((int64)(tile_z * resolution) + j - 1, 0, mip.depth - 1);
+						uint64 z = std::min<uint64>(uint64(mip_z) << mip_level, depth - 1);
+						for (int64 i = 0; i < padded; ++i)
+						{
+							int64 mip_x = std::clamp<int64>((int64)(tile_x * resolution) + i - 1, 0, mip.width - 1);
+							uint64 x = std::min<uint64>(uint64(mip_x) << mip_level, width - 1);
+							heights[j * padded + i] = std::clamp(source(x, z), min_height, max_height);
+						}
+					}
+
+					float const spacing_x = desc.sample_spacing_x * (1ull << mip_level);
+					float const spacing_z = desc.sample_spacing_z * (1ull << mip_level);
+					TileRecord record = GetTileRecord(file, resolution, tile_index);
+					for (int64 j = 0; j <= resolution; ++j)
+					{
+						for (int64 i = 0; i <= resolution; ++i)
+						{
+							float h = heights[(j + 1) * padded + (i + 1)];
+							float dx = (heights[(j + 1) * padded + (i + 2)] - heights[(j + 1) * padded + i]) / (2.0f * spacing_x);
+							float dz = (heights[(j + 2) * padded + (i + 1)] - heights[j * padded + (i + 1)]) / (2.0f * spacing_z);
+							Vector3 normal(-dx, 1.0f, -dz);
+							normal.Normalize();
+
+							uint64 sample = j * (resolution + 1) + i;
+							record.heights[sample] = QuantizeUnorm16(h, height_bias, inv_height_scale);
+							record.normals[sample] = PackOctahedral16(normal);
+							record.layers[sample] = ComputeTerrainLayerWeights(h, normal.y, layer_params);
+						}
+					}
+				});
+
+			TerrainTileFileHeader* header = file.As<TerrainTileFileHeader>();
+			header->magic = TERRAIN_TILE_FILE_MAGIC;
+			header->version = TERRAIN_TILE_FILE_VERSION;
+			header->tile_resolution = resolution;
+			header->mip_count = (uint32)mips.size();
+			header->width = width;
+			header->depth = depth;
+			header->sample_spacing_x = desc.sample_spacing_x;
+			header->sample_spacing_z = desc.sample_spacing_z;
+			header->height_scale = height_scale;
+			header->height_bias = height_bias;
+
+			ADRIA_LOG(INFO, "Generated terrain tile file %s (%llux%llu samples, %llu tiles, %u mips) in %f s", desc.output_path.c_str(),
+				(unsigned long long)width, (unsigned long long)depth, (unsigned long long)tile_count, header->mip_count, timer.ElapsedInSeconds());
+			return true;
+		}
+
+		bool FromHeightmap(Heightmap const& heightmap, TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc)
+		{
+			float const* heights = heightmap.Data();
+			auto [min_height, max_height] = std::minmax_element(std::execution::par_unseq, heights, heights + heightmap.Width() * heightmap.Depth());
+			return Generate(heightmap.Width(), heightmap.Depth(), *min_height, *max_height,
+				[&heightmap](uint64 x, uint64 z) { return heightmap.HeightAt(x, z); }, layer_params, desc);
+		}
+
+		bool FromNoise(NoiseDesc const& noise_desc, ThermalErosionDesc const* thermal_desc, HydraulicErosionDesc const* hydraulic_desc,
+			TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc)
+		{
+			//erosion needs the whole heightmap, the same cached one the terrain is loaded from
+			if (thermal_desc || hydraulic_desc)
+			{
+				std::unique_ptr<Heightmap> heightmap = HeightmapCache::GetOrGenerate(noise_desc, thermal_desc, hydraulic_desc);
+				return FromHeightmap(*heightmap, layer_params, desc);
+			}
+
+			HeightSource const noise = CreateNoiseHeightSource(noise_desc);
+			std::vector<uint64> rows(noise_desc.depth);
+			std::iota(std::begin(rows), std::end(rows), 0);
+			std::vector<std::pair<float, float>> row_min_max(rows.size());
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint64 z)
+				{
+					float row_min = std::numeric_limits<float>::max();
+					float row_max = std::numeric_limits<float>::lowest();
+					for (uint64 x = 0; x < noise_desc.width; ++x)
+					{
+						float h = noise(x, z);
+						row_min = std::min(row_min, h);
+						row_max = std::max(row_max, h);
+					}
+					row_min_max[z] = { row_min, row_max };
+				});
+
+			float min_height = std::numeric_limits<float>::max();
+			float max_height = std::numeric_limits<float>::lowest();
+			for (auto [row_min, row_max] : row_min_max)
+			{
+				min_height = std::min(min_height, row_min);
+				max_height = std::max(max_height, row_max);
+			}
+
+			//the same normalization to [-max_height, max_height] as Heightmap(NoiseDesc)
+			float const output_max_height = (float)noise_desc.max_height;
+			float const scale = max_height > min_height ? 2.0f * output_max_height / (max_height - min_height) : 0.0f;
+			return Generate(noise_desc.width, noise_desc.depth, -output_max_height, output_max_height,
+				[&](uint64 x, uint64 z) { return (noise(x, z) - min_height) * scale - output_max_height; }, layer_params, desc);
+		}
+	}
+
+	TerrainTileCache::TerrainTileCache(std::string const& path, uint64 memory_budget) : memory_budget(memory_budget)
+	{
+		if (!file.Open(path) || file.Size() < sizeof(TerrainTileFileHeader))
+		{
+			ADRIA_LOG(ERROR, "Failed to open terrain tile file %s", path.c_str());
+			return;
+		}
+
+		header = *file.As<TerrainTileFileHeader>();
+		if (header.magic != TERRAIN_TILE_FILE_MAGIC || header.version != TERRAIN_TILE_FILE_VERSION)
+		{
+			ADRIA_LOG(ERROR, "%s is not a valid terrain tile file", path.c_str());
+			return;
+		}
+
+		mips = ComputeTerrainTileMips(header.width, header.depth, header.tile_resolution);
+		record_size = TileRecordSize(header.tile_resolution);
+		if (mips.size() != header.mip_count || file.Size() != sizeof(TerrainTileFileHeader) + (mips.back().first_tile + 1) * record_size)
+		{
+			ADRIA_LOG(ERROR, "Terrain tile file %s has unexpected size", path.c_str());
+			return;
+		}
+
+		root = std::make_shared<TerrainTile>();
+		root->mip = header.mip_count - 1;
+		LoadTile(*root);
+		memory_usage = root->MemoryUsage();
+	}
+
+	TerrainTileCache::~TerrainTileCache()
+	{
+		for (auto& [key, pending] : pending_tiles) pending.loaded.wait();
+	}
+
+	void TerrainTileCache::Update(Vector3 const& camera_position, float lod0_radius)
+	{
+		if (!IsValid()) return;
+
+		++frame;
+		FinishPendingLoads();
+
+		for (uint32 mip_level = 0; mip_level + 1 < header.mip_count; ++mip_level)
+		{
+			TerrainTileMip const& mip = mips[mip_level];
+			float const radius = lod0_radius * (1ull << mip_level);
+			float const tile_size_x = TileWorldSizeX(mip_level);
+			float const tile_size_z = TileWorldSizeZ(mip_level);
+
+			int64 x_begin = std::max<int64>((int64)std::floor((camera_position.x - radius) / tile_size_x), 0);
+			int64 x_end = std::min<int64>((int64)std::floor((camera_position.x + radius) / tile_size_x), mip.tile_count_x - 1);
+			int64 z_begin = std::max<int64>((int64)std::floor((camera_position.z - radius) / tile_size_z), 0);
+			int64 z_end = std::min<int64>((int64)std::floor((camera_position.z + radius) / tile_size_z), mip.tile_count_z - 1);
+
+			for (int64 z = z_begin; z <= z_end; ++z)
+			{
+				for (int64 x = x_begin; x <= x_end; ++x)
+				{
+					float dx = std::max({ x * tile_size_x - camera_position.x, camera_position.x - (x + 1) * tile_size_x, 0.0f });
+					float dz = std::max({ z * tile_size_z - camera_position.z, camera_position.z - (z + 1) * tile_size_z, 0.0f });
+					if (dx * dx + dz * dz > radius * radius) continue;
+
+					//whole groups of siblings, a tile is only refined by SelectTiles when all of its children are resident
+					for (uint64 sibling_z = z & ~1ull; sibling_z <= std::min<uint64>(z | 1, mip.tile_count_z - 1); ++sibling_z)
+					{
+						for (uint64 sibling_x = x & ~1ull; sibling_x <= std::min<uint64>(x | 1, mip.tile_count_x - 1); ++sibling_x)
+						{
+							uint64 key = TileKey(mip_level, sibling_x, sibling_z);
+							if (auto it = resident_tiles.find(key); it != resident_tiles.end())
+							{
+								if (it->second.last_used_frame == frame) continue;
+								lru.splice(lru.begin(), lru, it->second.lru_position);
+								it->second.last_used_frame = frame;
+							}
+							else if (!pending_tiles.contains(key)) RequestTile(mip_level, sibling_x, sibling_z);
+						}
+					}
+				}
+			}
+		}
+
+		Evict();
+	}
+
+	void TerrainTileCache::WaitForPendingLoads()
+	{
+		for (auto& [key, pending] : pending_tiles) pending.loaded.wait();
+		FinishPendingLoads();
+	}
+
+	float TerrainTileCache::HeightAt(float x, float z) const
+	{
+		TileSample sample = Locate(x, z);
+		uint64 const row_pitch = header.tile_resolution + 1;
+		std::vector<uint16> const& heights = sample.tile->heights;
+
+		float h1 = std::lerp((float)heights[sample.index], (float)heights[sample.index + 1], sample.alpha_x);
+		float h2 = std::lerp((float)heights[sample.index + row_pitch], (float)heights[sample.index + row_pitch + 1], sample.alpha_x);
+		return DecodeHeight(std::lerp(h1, h2, sample.alpha_z));
+	}
+
+	Vector3 TerrainTileCache::NormalAt(float x, float z) const
+	{
+		TileSample sample = Locate(x, z);
+		uint64 const row_pitch = header.tile_resolution + 1;
+		std::vector<uint16> const& normals = sample.tile->normals;
+
+		Vector3 n1 = Vector3::Lerp(UnpackOctahedral16(normals[sample.index]), UnpackOctahedral16(normals[sample.index + 1]), sample.alpha_x);
+		Vector3 n2 = Vector3::Lerp(UnpackOctahedral16(normals[sample.index + row_pitch]), UnpackOctahedral16(normals[sample.index + row_pitch + 1]), sample.alpha_x);
+		return Vector3::Lerp(n1, n2, sample.alpha_z);
+	}
+
+	uint32 TerrainTileCache::LayerWeightsAt(float x, float z) const
+	{
+		TileSample sample = Locate(x, z);
+		uint64 const row_pitch = header.tile_resolution + 1;
+		uint64 index = sample.index + (sample.alpha_x >= 0.5f ? 1 : 0) + (sample.alpha_z >= 0.5f ? row_pitch : 0);
+		return sample.tile->layers[index];
+	}
+
+	TerrainTile const* TerrainTileCache::FindTile(uint32 mip, uint64 x, uint64 z) const
+	{
+		if (!IsValid()) return nullptr;
+		if (mip + 1 == header.mip_count) return root.get();
+
+		auto it = resident_tiles.find(TileKey(mip, x, z));
+		return it != resident_tiles.end() ? it->second.tile.get() : nullptr;
+	}
+
+	void TerrainTileCache::SelectTiles(std::vector<TerrainTile const*>& tiles) const
+	{
+		tiles.clear();
+		if (IsValid()) SelectTiles(header.mip_count - 1, 0, 0, tiles);
+	}
+
+	void TerrainTileCache::SelectTiles(uint32 mip, uint64 x, uint64 z, std::vector<TerrainTile const*>& tiles) const
+	{
+		TerrainTile const* tile = FindTile(mip, x, z);
+		ADRIA_ASSERT(tile);
+		if (mip > 0)
+		{
+			TerrainTileMip const& children = mips[mip - 1];
+			bool children_resident = true;
+			for (uint32 q = 0; q < 4 && children_resident; ++q)
+			{
+				uint64 cx = x * 2 + (q & 1);
+				uint64 cz = z * 2 + (q >> 1);
+				if (cx < children.tile_count_x && cz < children.tile_count_z) children_resident = FindTile(mip - 1, cx, cz) != nullptr;
+			}
+			if (children_resident)
+			{
+				for (uint32 q = 0; q < 4; ++q)
+				{
+					uint64 cx = x * 2 + (q & 1);
+					uint64 cz = z * 2 + (q >> 1);
+					if (cx < children.tile_count_x && cz < children.tile_count_z) SelectTiles(mip - 1, cx, cz, tiles);
+				}
+				return;
+			}
+		}
+		tiles.push_back(tile);
+	}
+
+	void TerrainTileCache::BuildTileVertices(TerrainTile const& tile, Vector2 const& texture_scale, std::vector<TexturedNormalVertex>& vertices) const
+	{
+		uint32 const resolution = header.tile_resolution;
+		TerrainTileMip const& mip = mips[tile.mip];
+		float const uv_scale_x = texture_scale.x / std::max<uint64>(header.width - 2, 1);
+		float const uv_scale_z = texture_scale.y / std::max<uint64>(header.depth - 2, 1);
+
+		vertices.resize(TileSampleCount(resolution));
+		for (uint64 j = 0; j <= resolution; ++j)
+		{
+			//samples past the edge of the terrain repeat the last one, as the generator wrote them, and collapse into degenerate triangles
+			uint64 const mip_z = std::min<uint64>(tile.z * resolution + j, mip.depth - 1);
+			uint64 const z = std::min<uint64>(mip_z << tile.mip, header.depth - 1);
+			for (uint64 i = 0; i <= resolution; ++i)
+			{
+				uint64 const mip_x = std::min<uint64>(tile.x * resolution + i, mip.width - 1);
+				uint64 const x = std::min<uint64>(mip_x << tile.mip, header.width - 1);
+				uint64 const sample = j * (resolution + 1) + i;
+
+				TexturedNormalVertex& vertex = vertices[sample];
+				vertex.position = Vector3(x * header.sample_spacing_x, DecodeHeight(tile.heights[sample]), z * header.sample_spacing_z);
+				vertex.uv = Vector2(x * uv_scale_x, z * uv_scale_z);
+				vertex.normal = UnpackOctahedral16(tile.normals[sample]);
+			}
+		}
+	}
+
+	uint64 TerrainTileCache::ContentHash() const
+	{
+		if (!IsValid()) return 0;
+		size_t hash = crc64(reinterpret_cast<char const*>(&header), sizeof(header));
+		HashCombine(hash, crc64(reinterpret_cast<char const*>(root->heights.data()), root->heights.size() * sizeof(uint16)));
+		HashCombine(hash, crc64(reinterpret_cast<char const*>(root->layers.data()), root->layers.size() * sizeof(uint32)));
+		return hash;
+	}
+
+	std::vector<uint32> TerrainTileCache::ReadMipLayerWeights(uint32 mip_level) const
+	{
+		ADRIA_ASSERT(IsValid() && mip_level < header.mip_count);
+		uint32 const resolution = header.tile_resolution;
+		TerrainTileMip const& mip = mips[mip_level];
+
+		std::vector<uint32> weights(mip.width * mip.depth);
+		std::vector<uint64> rows(mip.depth);
+		std::iota(std::begin(rows), std::end(rows), 0);
+		std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint64 z)
+			{
+				//the last sample of a tile is the first one of the next, the last tile keeps it
+				uint64 const tile_z = std::min<uint64>(z / resolution, mip.tile_count_z - 1);
+				uint64 const local_z = z - tile_z * resolution;
+				for (uint64 tile_x = 0; tile_x < mip.tile_count_x; ++tile_x)
+				{
+					TileRecord const record = GetTileRecord(file, resolution, mip.first_tile + tile_z * mip.tile_count_x + tile_x);
+					uint64 const first_x = tile_x * resolution;
+					uint64 const count = tile_x + 1 == mip.tile_count_x ? mip.width - first_x : resolution;
+					std::copy_n(record.layers + local_z * (resolution + 1), count, &weights[z * mip.width + first_x]);
+				}
+			});
+		return weights;
+	}
+
+	void TerrainTileCache::LoadTile(TerrainTile& tile) const
+	{
+		uint64 const sample_count = TileSampleCount(header.tile_resolution);
+		TerrainTileMip const& mip = mips[tile.mip];
+		TileRecord record = GetTileRecord(file, header.tile_resolution, mip.first_tile + tile.z * mip.tile_count_x + tile.x);
+
+		tile.heights.assign(record.heights, record.heights + sample_count);
+		tile.normals.assign(record.normals, record.normals + sample_count);
+		tile.layers.assign(record.layers, record.layers + sample_count);
+	}
+
+	void TerrainTileCache::RequestTile(uint32 mip, uint64 x, uint64 z)
+	{
+		std::shared_ptr<TerrainTile> tile = std::make_shared<TerrainTile>();
+		tile->mip = mip;
+		tile->x = x;
+		tile->z = z;
+
+		std::shared_ptr<Task> load_task = g_TaskManager.CreateTask([this, tile]() { LoadTile(*tile); });
+		PendingTile& pending = pending_tiles[TileKey(mip, x, z)];
+		pending.tile = tile;
+		pending.loaded = g_TaskManager.SubmitTask(load_task);
+	}
+
+	void TerrainTileCache::FinishPendingLoads()
+	{
+		for (auto it = pending_tiles.begin(); it != pending_tiles.end();)
+		{
+			if (it->second.loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+
+			lru.push_front(it->first);
+			ResidentTile& resident = resident_tiles[it->first];
+			resident.tile = std::move(it->second.tile);
+			resident.lru_position = lru.begin();
+			resident.last_used_frame = frame;
+			memory_usage += resident.tile->MemoryUsage();
+			it = pending_tiles.erase(it);
+		}
+	}
+
+	void TerrainTileCache::Evict()
+	{
+		while (memory_usage > memory_budget && !lru.empty())
+		{
+			auto it = resident_tiles.find(lru.back());
+			//every remaining tile was requested this frame, the budget is too small for the requested radius
+			if (it->second.last_used_frame == frame) break;
+
+			memory_usage -= it->second.tile->MemoryUsage();
+			resident_tiles.erase(it);
+			lru.pop_back();
+		}
+	}
+
+	TerrainTileCache::TileSample TerrainTileCache::Locate(float x, float z) const
+	{
+		ADRIA_ASSERT(IsValid());
+		uint32 const resolution = header.tile_resolution;
+		for (uint32 mip_level = 0; mip_level < header.mip_count; ++mip_level)
+		{
+			TerrainTileMip const& mip = mips[mip_level];
+			float fx = std::clamp(x / (header.sample_spacing_x * (1ull << mip_level)), 0.0f, (float)(mip.width - 1));
+			float fz = std::clamp(z / (header.sample_spacing_z * (1ull << mip_level)), 0.0f, (float)(mip.depth - 1));
+			uint64 tile_x = std::min<uint64>((uint64)fx / resolution, mip.tile_count_x - 1);
+			uint64 tile_z = std::min<uint64>((uint64)fz / resolution, mip.tile_count_z - 1);
+
+			TerrainTile const* tile = FindTile(mip_level, tile_x, tile_z);
+			if (!tile) continue;
+
+			float local_x = fx - tile_x * resolution;
+			float local_z = fz - tile_z * resolution;
+			uint64 cell_x = std::min<uint64>((uint64)local_x, resolution - 1);
+			uint64 cell_z = std::min<uint64>((uint64)local_z, resolution - 1);
+
+			TileSample sample{};
+			sample.tile = tile;
+			sample.index = cell_z * (resolution + 1) + cell_x;
+			sample.alpha_x = local_x - cell_x;
+			sample.alpha_z = local_z - cell_z;
+			return sample;
+		}
+		ADRIA_ASSERT(false && "Root tile should always be resident");
+		return TileSample{ root.get(), 0, 0.0f, 0.0f };
+	}
+}
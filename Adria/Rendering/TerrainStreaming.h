@@ -0,0 +1,179 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <list>
+#include <vector>
+#include <future>
+#include <functional>
+#include "Core/CoreTypes.h"
+#include "Utilities/MemoryMappedFile.h"
+#include "Utilities/HashMap.h"
+
+namespace adria
+{
+	struct NoiseDesc;
+	struct ThermalErosionDesc;
+	struct HydraulicErosionDesc;
+	class Heightmap;
+	struct TerrainTextureLayerParameters;
+	struct TexturedNormalVertex;
+
+	/* Tiled terrain file: a header followed by fixed-size tile records for every level of a mip pyramid.
+	   Mip m keeps every 2^m-th sample of mip 0, tiles cover tile_resolution quads and store tile_resolution + 1
+	   samples per edge, so a tile can be sampled and meshed without its neighbours. Each sample is a unorm16 height
+	   (scale and bias in the header), an octahedral 8:8 normal and RGBA8 layer weights. */
+	struct TerrainTileFileHeader
+	{
+		uint32 magic;
+		uint32 version;
+		uint32 tile_resolution;
+		uint32 mip_count;
+		uint64 width;
+		uint64 depth;
+		float sample_spacing_x;
+		float sample_spacing_z;
+		float height_scale;
+		float height_bias;
+	};
+
+	struct TerrainTileMip
+	{
+		uint64 width;
+		uint64 depth;
+		uint64 tile_count_x;
+		uint64 tile_count_z;
+		uint64 first_tile;
+	};
+	std::vector<TerrainTileMip> ComputeTerrainTileMips(uint64 width, uint64 depth, uint32 tile_resolution);
+
+	struct TerrainTile
+	{
+		uint32 mip;
+		uint64 x;
+		uint64 z;
+		std::vector<uint16> heights;
+		std::vector<uint16> normals;
+		std::vector<uint32> layers;
+
+		uint64 MemoryUsage() const
+		{
+			return heights.size() * sizeof(uint16) + normals.size() * sizeof(uint16) + layers.size() * sizeof(uint32);
+		}
+	};
+
+	struct TerrainTileGeneratorDesc
+	{
+		std::string output_path;
+		uint32 tile_resolution = 256;
+		float sample_spacing_x = 1.0f;
+		float sample_spacing_z = 1.0f;
+	};
+
+	//offline conversion to the tiled format, tiles are generated in parallel and written through a file mapping
+	namespace TerrainTileGenerator
+	{
+		using HeightSource = std::function<float(uint64 x, uint64 z)>;
+
+		//source has to be thread safe, heights outside [min_height, max_height] are clamped
+		bool Generate(uint64 width, uint64 depth, float min_height, float max_height, HeightSource const& source,
+			TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc);
+
+		bool FromHeightmap(Heightmap const& heightmap, TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc);
+		/* Exports the same height field as Heightmap(noise_desc) with the erosion applied. Without erosion the noise is evaluated
+		   per sample, normalized in a first pass over the samples, so the terrain never has to fit in memory. */
+		bool FromNoise(NoiseDesc const& noise_desc, ThermalErosionDesc const* thermal_desc, HydraulicErosionDesc const* hydraulic_desc,
+			TerrainTextureLayerParameters const& layer_params, TerrainTileGeneratorDesc const& desc);
+	}
+
+	/* Keeps the tiles around the camera resident within a memory budget. Tiles are requested by Update,
+	   read from the mapped file on the task manager threads and evicted in least recently used order.
+	   The single tile of the coarsest mip is always resident so queries never miss. */
+	class TerrainTileCache
+	{
+		struct ResidentTile
+		{
+			std::shared_ptr<TerrainTile> tile;
+			std::list<uint64>::iterator lru_position;
+			uint64 last_used_frame;
+		};
+
+		struct PendingTile
+		{
+			std::shared_ptr<TerrainTile> tile;
+			std::future<void> loaded;
+		};
+
+	public:
+		TerrainTileCache(std::string const& path, uint64 memory_budget);
+		TerrainTileCache(TerrainTileCache const&) = delete;
+		TerrainTileCache& operator=(TerrainTileCache const&) = delete;
+		~TerrainTileCache();
+
+		bool IsValid() const { return root != nullptr; }
+
+		//lod0_radius is the distance up to which mip 0 tiles are kept, mip m tiles are kept up to lod0_radius * 2^m
+		void Update(Vector3 const& camera_position, float lod0_radius);
+		void WaitForPendingLoads();
+
+		float HeightAt(float x, float z) const;
+		Vector3 NormalAt(float x, float z) const;
+		uint32 LayerWeightsAt(float x, float z) const;
+
+		TerrainTile const* FindTile(uint32 mip, uint64 x, uint64 z) const;
+		//the finest resident tiles that cover the terrain without overlapping, a tile is refined only when all its children are resident
+		void SelectTiles(std::vector<TerrainTile const*>& tiles) const;
+		//world space vertices of a tile, in the order of its samples. Uvs match the ones of ModelImporter::LoadGrid
+		void BuildTileVertices(TerrainTile const& tile, Vector2 const& texture_scale, std::vector<TexturedNormalVertex>& vertices) const;
+		//hash of the header and the coarsest mip, reading the whole file would defeat streaming it
+		uint64 ContentHash() const;
+		//layer weights of every sample of a mip, in rows of Mip(mip).width, read from the file without making its tiles resident
+		std::vector<uint32> ReadMipLayerWeights(uint32 mip) const;
+
+		static uint64 TileKey(uint32 mip, uint64 x, uint64 z)
+		{
+			return (uint64(mip) << 58) | (x << 29) | z;
+		}
+
+		TerrainTileFileHeader const& Header() const { return header; }
+		uint32 MipCount() const { return header.mip_count; }
+		TerrainTileMip const& Mip(uint32 mip) const { return mips[mip]; }
+		uint32 TileResolution() const { return header.tile_resolution; }
+		float TileWorldSizeX(uint32 mip) const { return header.tile_resolution * header.sample_spacing_x * (1ull << mip); }
+		float TileWorldSizeZ(uint32 mip) const { return header.tile_resolution * header.sample_spacing_z * (1ull << mip); }
+		float DecodeHeight(float h) const { return header.height_bias + header.height_scale * h; }
+
+		uint64 MemoryUsage() const { return memory_usage; }
+		uint64 MemoryBudget() const { return memory_budget; }
+		uint64 ResidentTileCount() const { return resident_tiles.size(); }
+
+	private:
+		MemoryMappedFile file;
+		TerrainTileFileHeader header{};
+		std::vector<TerrainTileMip> mips;
+		uint64 record_size = 0;
+		uint64 memory_budget;
+		uint64 memory_usage = 0;
+		uint64 frame = 0;
+
+		std::shared_ptr<TerrainTile> root;
+		HashMap<uint64, ResidentTile> resident_tiles;
+		HashMap<uint64, PendingTile> pending_tiles;
+		std::list<uint64> lru;
+
+	private:
+		void LoadTile(TerrainTile& tile) const;
+		void RequestTile(uint32 mip, uint64 x, uint64 z);
+		void FinishPendingLoads();
+		void Evict();
+		void SelectTiles(uint32 mip, uint64 x, uint64 z, std::vector<TerrainTile const*>& tiles) const;
+
+		struct TileSample
+		{
+			TerrainTile const* tile;
+			uint64 index;
+			float alpha_x;
+			float alpha_z;
+		};
+		TileSample Locate(float x, float z) const;
+	};
+}
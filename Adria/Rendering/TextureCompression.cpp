@@ -0,0 +1,759 @@
+#include <execution>
+#include <numeric>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include "TextureCompression.h"
+#include "DDSFile.h"
+#include "Utilities/Timer.h"
+
+namespace adria
+{
+	namespace
+	{
+		struct MipImage
+		{
+			uint32 width;
+			uint32 height;
+			std::vector<uint8> rgba;
+		};
+
+		std::array<float, 256> const& SrgbToLinearTable()
+		{
+			static std::array<float, 256> const table = []()
+			{
+				std::array<float, 256> table{};
+				for (uint32 i = 0; i < 256; ++i)
+				{
+					float const srgb = i / 255.0f;
+					table[i] = srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+				}
+				return table;
+			}();
+			return table;
+		}
+		uint8 LinearToSrgb(float linear)
+		{
+			float const srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+			return (uint8)std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f);
+		}
+
+		//2x2 box filter, odd sizes repeat their last row or column
+		MipImage Downsample(MipImage const& source, TextureUsage usage)
+		{
+			MipImage mip{};
+			mip.width = std::max(source.width / 2, 1u);
+			mip.height = std::max(source.height / 2, 1u);
+			mip.rgba.resize((size_t)mip.width * mip.height * 4);
+			std::array<float, 256> const& srgb_to_linear = SrgbToLinearTable();
+
+			std::vector<uint32> rows(mip.height);
+			std::iota(std::begin(rows), std::end(rows), 0);
+			std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint32 y)
+				{
+					uint32 const y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+					for (uint32 x = 0; x < mip.width; ++x)
+					{
+						uint32 const x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+						uint8 const* texels[4] =
+						{
+							&source.rgba[((size_t)y0 * source.width + x0) * 4], &source.rgba[((size_t)y0 * source.width + x1) * 4],
+							&source.rgba[((size_t)y1 * source.width + x0) * 4], &source.rgba[((size_t)y1 * source.width + x1) * 4]
+						};
+						uint8* texel = &mip.rgba[((size_t)y * mip.width + x) * 4];
+						texel[3] = (uint8)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+
+						switch (usage)
+						{
+						case TextureUsage::Albedo:
+						case TextureUsage::Emissive:
+							for (uint32 c = 0; c < 3; ++c)
+							{
+								float const linear = srgb_to_linear[texels[0][c]] + srgb_to_linear[texels[1][c]] + srgb_to_linear[texels[2][c]] + srgb_to_linear[texels[3][c]];
+								texel[c] = LinearToSrgb(linear * 0.25f);
+							}
+							break;
+						case TextureUsage::Normal:
+						{
+							float normal[3]{};
+							for (uint8 const* source_texel : texels)
+								for (uint32 c = 0; c < 3; ++c) normal[c] += source_texel[c] / 127.5f - 1.0f;
+							float const length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+							if (length < 1e-6f)
+							{
+								normal[0] = normal[1] = 0.0f;
+								normal[2] = 1.0f;
+							}
+							else for (float& n : normal) n /= length;
+							for (uint32 c = 0; c < 3; ++c) texel[c] = (uint8)std::clamp((normal[c] * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f);
+						}
+						break;
+						default:
+							for (uint32 c = 0; c < 3; ++c) texel[c] = (uint8)((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+						}
+					}
+				});
+			return mip;
+		}
+
+		//4x4 texels starting at (x, y), texels outside of the mip repeat its last row or column
+		void LoadBlock(MipImage const& mip, uint32 x, uint32 y, uint8 block[64])
+		{
+			for (uint32 j = 0; j < 4; ++j)
+			{
+				uint32 const row = std::min(y + j, mip.height - 1);
+				for (uint32 i = 0; i < 4; ++i)
+				{
+					uint32 const column = std::min(x + i, mip.width - 1);
+					memcpy(&block[(j * 4 + i) * 4], &mip.rgba[((size_t)row * mip.width + column) * 4], 4);
+				}
+			}
+		}
+
+		//direction of the largest spread of the points, found by power iteration on their covariance
+		template<uint32 N>
+		void PrincipalAxis(float const (&points)[16][N], float (&mean)[N], float (&axis)[N])
+		{
+			for (uint32 c = 0; c < N; ++c)
+			{
+				mean[c] = 0.0f;
+				for (uint32 i = 0; i < 16; ++i) mean[c] += points[i][c];
+				mean[c] /= 16.0f;
+			}
+			float covariance[N][N]{};
+			for (uint32 i = 0; i < 16; ++i)
+				for (uint32 a = 0; a < N; ++a)
+					for (uint32 b = 0; b < N; ++b) covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+			for (uint32 c = 0; c < N; ++c) axis[c] = covariance[c][c];
+			for (uint32 iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[N]{};
+				float length = 0.0f;
+				for (uint32 a = 0; a < N; ++a)
+				{
+					for (uint32 b = 0; b < N; ++b) next[a] += covariance[a][b] * axis[b];
+					length = std::max(length, std::abs(next[a]));
+				}
+				if (length < 1e-6f) break;
+				for (uint32 c = 0; c < N; ++c) axis[c] = next[c] / length;
+			}
+			float length = 0.0f;
+			for (uint32 c = 0; c < N; ++c) length += axis[c] * axis[c];
+			length = std::sqrt(length);
+			for (uint32 c = 0; c < N; ++c) axis[c] = length > 1e-6f ? axis[c] / length : 0.0f;
+		}
+
+		//endpoints at the extremes of the projections of the points on their principal axis
+		template<uint32 N>
+		void FitEndpoints(float const (&points)[16][N], float (&endpoint0)[N], float (&endpoint1)[N])
+		{
+			float mean[N], axis[N];
+			PrincipalAxis(points, mean, axis);
+			float min_t = 0.0f, max_t = 0.0f;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				float t = 0.0f;
+				for (uint32 c = 0; c < N; ++c) t += (points[i][c] - mean[c]) * axis[c];
+				min_t = std::min(min_t, t);
+				max_t = std::max(max_t, t);
+			}
+			for (uint32 c = 0; c < N; ++c)
+			{
+				endpoint0[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+				endpoint1[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+			}
+		}
+
+		/* Endpoints that minimize the squared error of the points for fixed interpolation weights of the first endpoint.
+		   Returns false if the weights don't determine them, e.g. when every point uses the same one. */
+		template<uint32 N>
+		bool SolveEndpoints(float const (&points)[16][N], float const (&weights)[16], float (&endpoint0)[N], float (&endpoint1)[N])
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[N]{}, bx[N]{};
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				float const a = weights[i], b = 1.0f - weights[i];
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (uint32 c = 0; c < N; ++c)
+				{
+					ax[c] += a * points[i][c];
+					bx[c] += b * points[i][c];
+				}
+			}
+			float const determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f) return false;
+			for (uint32 c = 0; c < N; ++c)
+			{
+				endpoint0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+				endpoint1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		uint16 PackColor565(float const (&color)[3])
+		{
+			uint32 const r = (uint32)(color[0] * 31.0f / 255.0f + 0.5f);
+			uint32 const g = (uint32)(color[1] * 63.0f / 255.0f + 0.5f);
+			uint32 const b = (uint32)(color[2] * 31.0f / 255.0f + 0.5f);
+			return (uint16)((r << 11) | (g << 5) | b);
+		}
+		void UnpackColor565(uint16 packed, uint8* color)
+		{
+			uint32 const r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+			color[0] = (uint8)((r << 3) | (r >> 2));
+			color[1] = (uint8)((g << 2) | (g >> 4));
+			color[2] = (uint8)((b << 3) | (b >> 2));
+		}
+
+		//4 color palette of a BC1 color block, the order of the endpoints only flips the indices
+		float FitBC1Indices(float const (&colors)[16][3], uint16 color0, uint16 color1, uint32& indices)
+		{
+			uint8 endpoints[2][3];
+			UnpackColor565(color0, endpoints[0]);
+			UnpackColor565(color1, endpoints[1]);
+			float palette[4][3];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				palette[0][c] = endpoints[0][c];
+				palette[1][c] = endpoints[1][c];
+				palette[2][c] = (2.0f * endpoints[0][c] + endpoints[1][c]) / 3.0f;
+				palette[3][c] = (endpoints[0][c] + 2.0f * endpoints[1][c]) / 3.0f;
+			}
+			indices = 0;
+			float total_error = 0.0f;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				uint32 best_index = 0;
+				float best_error = FLT_MAX;
+				for (uint32 p = 0; p < 4; ++p)
+				{
+					float error = 0.0f;
+					for (uint32 c = 0; c < 3; ++c) error += (colors[i][c] - palette[p][c]) * (colors[i][c] - palette[p][c]);
+					if (error < best_error)
+					{
+						best_error = error;
+						best_index = p;
+					}
+				}
+				indices |= best_index << (2 * i);
+				total_error += best_error;
+			}
+			return total_error;
+		}
+
+		//color block of BC1, BC2 and BC3, always in the 4 color mode so it decodes the same in all of them
+		void EncodeColorBlock(uint8 const block[64], uint8* output)
+		{
+			float colors[16][3];
+			for (uint32 i = 0; i < 16; ++i)
+				for (uint32 c = 0; c < 3; ++c) colors[i][c] = block[i * 4 + c];
+
+			float endpoint0[3], endpoint1[3];
+			FitEndpoints(colors, endpoint0, endpoint1);
+			uint16 color0 = PackColor565(endpoint0), color1 = PackColor565(endpoint1);
+			uint32 indices = 0;
+			float error = FitBC1Indices(colors, color0, color1, indices);
+
+			static constexpr float BC1_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+			for (uint32 iteration = 0; iteration < 2 && error > 0.0f; ++iteration)
+			{
+				float weights[16];
+				for (uint32 i = 0; i < 16; ++i) weights[i] = BC1_WEIGHTS[(indices >> (2 * i)) & 3];
+				if (!SolveEndpoints(colors, weights, endpoint0, endpoint1)) break;
+
+				uint16 const refined_color0 = PackColor565(endpoint0), refined_color1 = PackColor565(endpoint1);
+				uint32 refined_indices = 0;
+				float const refined_error = FitBC1Indices(colors, refined_color0, refined_color1, refined_indices);
+				if (refined_error >= error) break;
+				color0 = refined_color0;
+				color1 = refined_color1;
+				indices = refined_indices;
+				error = refined_error;
+			}
+
+			//color0 > color1 selects the 4 color mode, equal endpoints would select the 3 color mode with black as its last entry
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+				indices ^= 0x55555555;
+			}
+			else if (color0 == color1) indices = 0;
+			memcpy(output, &color0, 2);
+			memcpy(output + 2, &color1, 2);
+			memcpy(output + 4, &indices, 4);
+		}
+
+		//single channel block of BC3 alpha, BC4 and BC5, in the mode with 8 interpolated values
+		void EncodeChannelBlock(uint8 const block[64], uint32 channel, uint8* output)
+		{
+			uint8 min_value = 255, max_value = 0;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				min_value = std::min(min_value, block[i * 4 + channel]);
+				max_value = std::max(max_value, block[i * 4 + channel]);
+			}
+			output[0] = max_value;
+			output[1] = min_value;
+
+			uint64 indices = 0;
+			if (max_value > min_value)
+			{
+				float const scale = 7.0f / (max_value - min_value);
+				for (uint32 i = 0; i < 16; ++i)
+				{
+					//position between the endpoints, 0 is max_value and 7 is min_value. The interpolated values have indices 2 to 7
+					uint32 const step = (uint32)((max_value - block[i * 4 + channel]) * scale + 0.5f);
+					uint64 const index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+					indices |= index << (3 * i);
+				}
+			}
+			memcpy(output + 2, &indices, 6);
+		}
+
+		void DecodeChannelBlock(uint8 const* block, uint32 channel, uint8 rgba[64])
+		{
+			uint32 const value0 = block[0], value1 = block[1];
+			uint8 values[8] = { (uint8)value0, (uint8)value1 };
+			if (value0 > value1)
+			{
+				for (uint32 i = 1; i < 7; ++i) values[i + 1] = (uint8)(((7 - i) * value0 + i * value1 + 3) / 7);
+			}
+			else
+			{
+				for (uint32 i = 1; i < 5; ++i) values[i + 1] = (uint8)(((5 - i) * value0 + i * value1 + 2) / 5);
+				values[6] = 0;
+				values[7] = 255;
+			}
+			uint64 indices = 0;
+			memcpy(&indices, block + 2, 6);
+			for (uint32 i = 0; i < 16; ++i) rgba[i * 4 + channel] = values[(indices >> (3 * i)) & 7];
+		}
+
+		void DecodeColorBlock(uint8 const* block, bool four_colors, uint8 rgba[64])
+		{
+			uint16 color0, color1;
+			uint32 indices;
+			memcpy(&color0, block, 2);
+			memcpy(&color1, block + 2, 2);
+			memcpy(&indices, block + 4, 4);
+
+			uint8 palette[4][4];
+			UnpackColor565(color0, palette[0]);
+			UnpackColor565(color1, palette[1]);
+			palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				if (four_colors || color0 > color1)
+				{
+					palette[2][c] = (uint8)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+					palette[3][c] = (uint8)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+				}
+				else
+				{
+					palette[2][c] = (uint8)((palette[0][c] + palette[1][c] + 1) / 2);
+					palette[3][c] = 0;
+				}
+			}
+			if (!four_colors && color0 <= color1) palette[3][3] = 0;
+			for (uint32 i = 0; i < 16; ++i) memcpy(&rgba[i * 4], palette[(indices >> (2 * i)) & 3], 4);
+		}
+
+		/* BC7 blocks are written in mode 6 only: one subset, rgba endpoints of 7 bits plus a shared lowest bit per endpoint
+		   and 4 bit indices. That keeps all 4 channels correlated on one line, which suits smooth material maps well. */
+		static constexpr uint32 BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct BC7Endpoint
+		{
+			uint8 quantized[4];		//7 bits per channel
+			uint8 p_bit;
+			uint8 Value(uint32 c) const { return (uint8)((quantized[c] << 1) | p_bit); }
+		};
+
+		BC7Endpoint QuantizeBC7Endpoint(float const (&endpoint)[4])
+		{
+			BC7Endpoint best{};
+			float best_error = FLT_MAX;
+			for (uint8 p_bit = 0; p_bit < 2; ++p_bit)
+			{
+				BC7Endpoint candidate{};
+				candidate.p_bit = p_bit;
+				float error = 0.0f;
+				for (uint32 c = 0; c < 4; ++c)
+				{
+					candidate.quantized[c] = (uint8)std::clamp((int32)std::lround((endpoint[c] - p_bit) * 0.5f), 0, 127);
+					float const difference = candidate.Value(c) - endpoint[c];
+					error += difference * difference;
+				}
+				if (error < best_error)
+				{
+					best_error = error;
+					best = candidate;
+				}
+			}
+			return best;
+		}
+
+		float FitBC7Indices(float const (&texels)[16][4], BC7Endpoint const& endpoint0, BC7Endpoint const& endpoint1, uint8 (&indices)[16])
+		{
+			float palette[16][4];
+			for (uint32 p = 0; p < 16; ++p)
+				for (uint32 c = 0; c < 4; ++c) palette[p][c] = (float)(((64 - BC7_WEIGHTS[p]) * endpoint0.Value(c) + BC7_WEIGHTS[p] * endpoint1.Value(c) + 32) >> 6);
+
+			float total_error = 0.0f;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				float best_error = FLT_MAX;
+				for (uint8 p = 0; p < 16; ++p)
+				{
+					float error = 0.0f;
+					for (uint32 c = 0; c < 4; ++c) error += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+					if (error < best_error)
+					{
+						best_error = error;
+						indices[i] = p;
+					}
+				}
+				total_error += best_error;
+			}
+			return total_error;
+		}
+
+		class BlockBitWriter
+		{
+		public:
+			explicit BlockBitWriter(uint8* output) : output(output) { memset(output, 0, 16); }
+			void Write(uint32 value, uint32 bit_count)
+			{
+				for (uint32 i = 0; i < bit_count; ++i, ++bit)
+					if ((value >> i) & 1) output[bit >> 3] |= (uint8)(1 << (bit & 7));
+			}
+		private:
+			uint8* output;
+			uint32 bit = 0;
+		};
+
+		class BlockBitReader
+		{
+		public:
+			explicit BlockBitReader(uint8 const* input) : input(input) {}
+			uint32 Read(uint32 bit_count)
+			{
+				uint32 value = 0;
+				for (uint32 i = 0; i < bit_count; ++i, ++bit) value |= (uint32)((input[bit >> 3] >> (bit & 7)) & 1) << i;
+				return value;
+			}
+		private:
+			uint8 const* input;
+			uint32 bit = 0;
+		};
+
+		void EncodeBC7Block(uint8 const block[64], uint8* output)
+		{
+			float texels[16][4];
+			for (uint32 i = 0; i < 16; ++i)
+				for (uint32 c = 0; c < 4; ++c) texels[i][c] = block[i * 4 + c];
+
+			float endpoints[2][4];
+			FitEndpoints(texels, endpoints[0], endpoints[1]);
+			BC7Endpoint endpoint0 = QuantizeBC7Endpoint(endpoints[0]), endpoint1 = QuantizeBC7Endpoint(endpoints[1]);
+			uint8 indices[16];
+			float error = FitBC7Indices(texels, endpoint0, endpoint1, indices);
+
+			for (uint32 iteration = 0; iteration < 2 && error > 0.0f; ++iteration)
+			{
+				float weights[16];
+				for (uint32 i = 0; i < 16; ++i) weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+				if (!SolveEndpoints(texels, weights, endpoints[0], endpoints[1])) break;
+
+				BC7Endpoint const refined_endpoint0 = QuantizeBC7Endpoint(endpoints[0]), refined_endpoint1 = QuantizeBC7Endpoint(endpoints[1]);
+				uint8 refined_indices[16];
+				float const refined_error = FitBC7Indices(texels, refined_endpoint0, refined_endpoint1, refined_indices);
+				if (refined_error >= error) break;
+				endpoint0 = refined_endpoint0;
+				endpoint1 = refined_endpoint1;
+				memcpy(indices, refined_indices, sizeof(indices));
+				error = refined_error;
+			}
+
+			//the highest bit of the first index is implied zero
+			if (indices[0] & 8)
+			{
+				std::swap(endpoint0, endpoint1);
+				for (uint8& index : indices) index = 15 - index;
+			}
+
+			BlockBitWriter writer(output);
+			writer.Write(1 << 6, 7);
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				writer.Write(endpoint0.quantized[c], 7);
+				writer.Write(endpoint1.quantized[c], 7);
+			}
+			writer.Write(endpoint0.p_bit, 1);
+			writer.Write(endpoint1.p_bit, 1);
+			writer.Write(indices[0], 3);
+			for (uint32 i = 1; i < 16; ++i) writer.Write(indices[i], 4);
+		}
+
+		//decodes the mode 6 blocks the encoder writes, blocks of other modes decode to black
+		void DecodeBC7Block(uint8 const* block, uint8 rgba[64])
+		{
+			memset(rgba, 0, 64);
+			BlockBitReader reader(block);
+			if (reader.Read(7) != (1 << 6)) return;
+
+			uint32 quantized[2][4];
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				quantized[0][c] = reader.Read(7);
+				quantized[1][c] = reader.Read(7);
+			}
+			uint32 const p_bits[2] = { reader.Read(1), reader.Read(1) };
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				uint32 const weight = BC7_WEIGHTS[reader.Read(i == 0 ? 3 : 4)];
+				for (uint32 c = 0; c < 4; ++c)
+				{
+					uint32 const value0 = (quantized[0][c] << 1) | p_bits[0], value1 = (quantized[1][c] << 1) | p_bits[1];
+					rgba[i * 4 + c] = (uint8)(((64 - weight) * value0 + weight * value1 + 32) >> 6);
+				}
+			}
+		}
+
+		void EncodeBlock(BCFormat format, uint8 const block[64], uint8* output)
+		{
+			switch (format)
+			{
+			case BCFormat::BC1:
+				EncodeColorBlock(block, output);
+				break;
+			case BCFormat::BC3:
+				EncodeChannelBlock(block, 3, output);
+				EncodeColorBlock(block, output + 8);
+				break;
+			case BCFormat::BC4:
+				EncodeChannelBlock(block, 0, output);
+				break;
+			case BCFormat::BC5:
+				EncodeChannelBlock(block, 0, output);
+				EncodeChannelBlock(block, 1, output + 8);
+				break;
+			case BCFormat::BC7:
+				EncodeBC7Block(block, output);
+				break;
+			}
+		}
+
+		uint32 ComparedChannels(BCFormat format)
+		{
+			switch (format)
+			{
+			case BCFormat::BC1: return 3;
+			case BCFormat::BC4: return 1;
+			case BCFormat::BC5: return 2;
+			default: return 4;
+			}
+		}
+
+		float ComputePSNR(MipImage const& source, CompressedMip const& mip, BCFormat format)
+		{
+			uint32 const block_size = TextureCompression::BlockSize(format);
+			uint32 const blocks_x = (mip.width + 3) / 4, blocks_y = (mip.height + 3) / 4;
+			uint32 const channels = ComparedChannels(format);
+
+			std::vector<double> row_errors(blocks_y, 0.0);
+			std::vector<uint32> block_rows(blocks_y);
+			std::iota(std::begin(block_rows), std::end(block_rows), 0);
+			std::for_each(std::execution::par, std::begin(block_rows), std::end(block_rows), [&](uint32 block_y)
+				{
+					for (uint32 block_x = 0; block_x < blocks_x; ++block_x)
+					{
+						uint8 decoded[64];
+						TextureCompression::DecodeBlock(format, &mip.blocks[((size_t)block_y * blocks_x + block_x) * block_size], decoded);
+						for (uint32 j = 0; j < 4 && block_y * 4 + j < mip.height; ++j)
+							for (uint32 i = 0; i < 4 && block_x * 4 + i < mip.width; ++i)
+							{
+								uint8 const* texel = &source.rgba[((size_t)(block_y * 4 + j) * source.width + block_x * 4 + i) * 4];
+								for (uint32 c = 0; c < channels; ++c)
+								{
+									double const difference = (double)texel[c] - decoded[(j * 4 + i) * 4 + c];
+									row_errors[block_y] += difference * difference;
+								}
+							}
+					}
+				});
+			double const mse = std::accumulate(std::begin(row_errors), std::end(row_errors), 0.0) / ((double)mip.width * mip.height * channels);
+			return mse > 0.0 ? (float)(10.0 * std::log10(255.0 * 255.0 / mse)) : 99.0f;
+		}
+	}
+
+	namespace TextureCompression
+	{
+		bool CanCompress(uint32 width, uint32 height)
+		{
+			return width > 0 && height > 0 && width % 4 == 0 && height % 4 == 0;
+		}
+
+		BCFormat SelectFormat(std::span<uint8 const> rgba, TextureUsage usage)
+		{
+			switch (usage)
+			{
+			case TextureUsage::Albedo:
+				for (size_t i = 3; i < rgba.size(); i += 4) if (rgba[i] != 255) return BCFormat::BC3;
+				return BCFormat::BC1;
+			case TextureUsage::Emissive:
+				return BCFormat::BC1;
+			case TextureUsage::Normal:
+				return BCFormat::BC5;
+			default:
+				return BCFormat::BC7;
+			}
+		}
+
+		CompressedTexture Compress(std::span<uint8 const> rgba, uint32 width, uint32 height, TextureUsage usage)
+		{
+			ADRIA_ASSERT(usage != TextureUsage::Generic && CanCompress(width, height));
+			ADRIA_ASSERT(rgba.size() == (size_t)width * height * 4);
+			Timer timer;
+
+			CompressedTexture texture{};
+			texture.format = SelectFormat(rgba, usage);
+			uint32 const block_size = BlockSize(texture.format);
+
+			MipImage source{ .width = width, .height = height, .rgba = std::vector<uint8>(std::begin(rgba), std::end(rgba)) };
+			MipImage mip_image{};
+			for (MipImage const* level = &source;;)
+			{
+				CompressedMip& mip = texture.mips.emplace_back();
+				mip.width = level->width;
+				mip.height = level->height;
+				uint32 const blocks_x = (level->width + 3) / 4, blocks_y = (level->height + 3) / 4;
+				mip.blocks.resize((size_t)blocks_x * blocks_y * block_size);
+
+				std::vector<uint32> block_rows(blocks_y);
+				std::iota(std::begin(block_rows), std::end(block_rows), 0);
+				std::for_each(std::execution::par, std::begin(block_rows), std::end(block_rows), [&](uint32 block_y)
+					{
+						uint8 block[64];
+						for (uint32 block_x = 0; block_x < blocks_x; ++block_x)
+						{
+							LoadBlock(*level, block_x * 4, block_y * 4, block);
+							EncodeBlock(texture.format, block, &mip.blocks[((size_t)block_y * blocks_x + block_x) * block_size]);
+						}
+					});
+
+				if (level->width == 1 && level->height == 1) break;
+				mip_image = Downsample(*level, usage);
+				level = &mip_image;
+			}
+			texture.encode_time = timer.ElapsedInSeconds();
+			texture.psnr = ComputePSNR(source, texture.mips[0], texture.format);
+			return texture;
+		}
+
+		uint32 BlockSize(BCFormat format)
+		{
+			return format == BCFormat::BC1 || format == BCFormat::BC4 ? 8 : 16;
+		}
+
+		uint32 RowPitch(BCFormat format, uint32 width)
+		{
+			return std::max((width + 3) / 4, 1u) * BlockSize(format);
+		}
+
+		char const* FormatName(BCFormat format)
+		{
+			switch (format)
+			{
+			case BCFormat::BC1: return "BC1";
+			case BCFormat::BC3: return "BC3";
+			case BCFormat::BC4: return "BC4";
+			case BCFormat::BC5: return "BC5";
+			case BCFormat::BC7: return "BC7";
+			}
+			return "Unknown";
+		}
+
+		void DecodeBlock(BCFormat format, uint8 const* block, uint8 rgba[64])
+		{
+			switch (format)
+			{
+			case BCFormat::BC1:
+				DecodeColorBlock(block, false, rgba);
+				break;
+			case BCFormat::BC3:
+				DecodeColorBlock(block + 8, true, rgba);
+				DecodeChannelBlock(block, 3, rgba);
+				break;
+			case BCFormat::BC4:
+			case BCFormat::BC5:
+				for (uint32 i = 0; i < 16; ++i)
+				{
+					rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+					rgba[i * 4 + 3] = 255;
+				}
+				DecodeChannelBlock(block, 0, rgba);
+				if (format == BCFormat::BC5) DecodeChannelBlock(block + 8, 1, rgba);
+				break;
+			case BCFormat::BC7:
+				DecodeBC7Block(block, rgba);
+				break;
+			}
+		}
+
+		std::vector<uint8> WriteDDS(CompressedTexture const& texture)
+		{
+			ADRIA_ASSERT(!texture.mips.empty());
+			size_t size = DDSFile::DATA_OFFSET;
+			for (CompressedMip const& mip : texture.mips) size += mip.blocks.size();
+
+			std::vector<uint8> dds;
+			dds.reserve(size);
+			DDSFile::WriteHeaders(DDSFileDesc{ .dxgi_format = (uint32)texture.format, .width = texture.mips[0].width, .height = texture.mips[0].height,
+				.mip_count = (uint32)texture.mips.size() }, dds);
+			for (CompressedMip const& mip : texture.mips) dds.insert(std::end(dds), std::begin(mip.blocks), std::end(mip.blocks));
+			return dds;
+		}
+
+		std::optional<DDSLayout> ReadDDSLayout(std::span<uint8 const> dds)
+		{
+			std::optional<DDSFileDesc> desc = DDSFile::ReadHeaders(dds);
+			if (!desc || desc->cubemap) return std::nullopt;
+
+			BCFormat const format = (BCFormat)desc->dxgi_format;
+			switch (format)
+			{
+			case BCFormat::BC1:
+			case BCFormat::BC3:
+			case BCFormat::BC4:
+			case BCFormat::BC5:
+			case BCFormat::BC7:
+				break;
+			default:
+				return std::nullopt;
+			}
+
+			DDSLayout layout{};
+			layout.format = format;
+			layout.width = desc->width;
+			layout.height = desc->height;
+			layout.mip_count = desc->mip_count;
+			if (layout.mip_count > DDS_MAX_MIPS) return std::nullopt;
+			uint64 offset = DDSFile::DATA_OFFSET;
+			for (uint32 mip = 0; mip < layout.mip_count; ++mip)
+			{
+				uint32 const mip_height = std::max(layout.height >> mip, 1u);
+				layout.mip_offsets[mip] = offset;
+				layout.mip_sizes[mip] = (uint64)RowPitch(format, std::max(layout.width >> mip, 1u)) * std::max((mip_height + 3) / 4, 1u);
+				offset += layout.mip_sizes[mip];
+			}
+			if (offset > dds.size()) return std::nullopt;
+			return layout;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <optional>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	//what a texture holds decides its block format and how its mips are filtered
+	enum class TextureUsage : uint8
+	{
+		Generic,			//loaded as it is, uncompressed
+		Albedo,				//BC1, BC3 if any texel is translucent. Mips are averaged in linear space
+		Emissive,			//BC1, mips are averaged in linear space
+		Normal,				//BC5, only x and y are kept and z is reconstructed in the shader. Mips are renormalized
+		MetallicRoughness	//BC7, roughness and metallic need more precision than the 5:6:5 endpoints of BC1
+	};
+
+	//values are the matching DXGI_FORMAT, so they can be written into a DDS header as they are
+	enum class BCFormat : uint32
+	{
+		BC1 = 71,
+		BC3 = 77,
+		BC4 = 80,
+		BC5 = 83,
+		BC7 = 98
+	};
+
+	inline constexpr uint32 DDS_MAX_MIPS = 16;
+
+	//where the mips of a block compressed DDS file are, offsets are from the start of the file
+	struct DDSLayout
+	{
+		BCFormat format;
+		uint32 width;
+		uint32 height;
+		uint32 mip_count;
+		uint64 mip_offsets[DDS_MAX_MIPS];
+		uint64 mip_sizes[DDS_MAX_MIPS];
+	};
+
+	struct CompressedMip
+	{
+		uint32 width;
+		uint32 height;
+		std::vector<uint8> blocks;
+	};
+
+	struct CompressedTexture
+	{
+		BCFormat format = BCFormat::BC1;
+		std::vector<CompressedMip> mips;
+		float psnr = 0.0f;			//dB, of the top mip against the source over the channels the format keeps
+		float encode_time = 0.0f;	//seconds spent generating mips and encoding blocks
+	};
+
+	//backend independent, so textures can be compressed and their cache written without a device
+	namespace TextureCompression
+	{
+		//the top mip of a block compressed texture must have a size that is a multiple of 4
+		bool CanCompress(uint32 width, uint32 height);
+
+		BCFormat SelectFormat(std::span<uint8 const> rgba, TextureUsage usage);
+
+		/* Generates the full mip chain of rgba8 pixels with tightly packed rows and block compresses every mip,
+		   with the rows of blocks encoded in parallel. */
+		CompressedTexture Compress(std::span<uint8 const> rgba, uint32 width, uint32 height, TextureUsage usage);
+
+		uint32 BlockSize(BCFormat format);
+		uint32 RowPitch(BCFormat format, uint32 width);
+		char const* FormatName(BCFormat format);
+		void DecodeBlock(BCFormat format, uint8 const* block, uint8 rgba[64]);
+
+		//DDS file with a DX10 header, loadable by CreateDDSTextureFromMemory
+		std::vector<uint8> WriteDDS(CompressedTexture const& texture);
+		//only understands 2D textures with a DX10 header and one of the formats above, as WriteDDS writes them
+		std::optional<DDSLayout> ReadDDSLayout(std::span<uint8 const> dds);
+	}
+}
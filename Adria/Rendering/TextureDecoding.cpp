@@ -0,0 +1,241 @@
+#include <cstring>
+#include "TextureDecoding.h"
+#include "DDSFile.h"
+#include "Utilities/FilesUtil.h"
+#include "Utilities/HashUtil.h"
+#include "Utilities/MemoryMappedFile.h"
+#include "Tasks/TaskManager.h"
+#include "Logging/Logger.h"
+
+namespace adria
+{
+	namespace
+	{
+		inline static char const* texture_cache_directory = "Resources/TextureCache/";
+		//bump when the output of the texture compression changes
+		static constexpr uint32 TEXTURE_CACHE_VERSION = 1;
+
+		//the source file is hashed rather than its path and time, so copies and moved files share their cache entry
+		//generic textures aren't compressed and have no cache entry
+		std::optional<uint64> GetCacheKey(std::string const& path, TextureUsage usage)
+		{
+			if (usage == TextureUsage::Generic) return std::nullopt;
+			MemoryMappedFile source;
+			if (!source.Open(path)) return std::nullopt;
+			size_t key = crc64(source.As<char>(), source.Size());
+			HashCombine(key, usage);
+			HashCombine(key, TEXTURE_CACHE_VERSION);
+			return key;
+		}
+
+		std::string GetCachePath(uint64 key)
+		{
+			char cache_path[256];
+			sprintf_s(cache_path, "%s%016llx.dds", texture_cache_directory, (unsigned long long)key);
+			return cache_path;
+		}
+	}
+
+	namespace TextureDecoding
+	{
+		DecodedTexture Decode(std::string const& path, TextureUsage usage, bool mipmaps)
+		{
+			DecodedTexture decoded{};
+			decoded.path = path;
+			decoded.mipmaps = mipmaps;
+			std::optional<uint64> const cache_key = GetCacheKey(path, usage);
+			if (cache_key)
+			{
+				decoded.dds = ReadCachedTexture(GetCachePath(*cache_key));
+				if (!decoded.dds.empty()) decoded.cache_path = GetCachePath(*cache_key);
+			}
+
+			if (decoded.dds.empty())
+			{
+				decoded.image = std::make_unique<Image>(path, 4);
+				Image const& image = *decoded.image;
+				if (cache_key && image.Data<void>() != nullptr && !image.IsHDR() && TextureCompression::CanCompress(image.Width(), image.Height()))
+				{
+					CompressedTexture const compressed = TextureCompression::Compress(std::span(image.Data<uint8>(), (size_t)image.Pitch() * image.Height()), image.Width(), image.Height(), usage);
+					ADRIA_LOG(INFO, "Compressed %s (%ux%u) to %s with %u mips: PSNR %.2f dB, %.1f MB/s", path.c_str(), image.Width(), image.Height(),
+						TextureCompression::FormatName(compressed.format), (uint32)compressed.mips.size(), compressed.psnr,
+						(double)image.Pitch() * image.Height() / (1024.0 * 1024.0) / std::max(compressed.encode_time, 1e-6f));
+					decoded.dds = TextureCompression::WriteDDS(compressed);
+					if (WriteCacheFile(GetCachePath(*cache_key), decoded.dds)) decoded.cache_path = GetCachePath(*cache_key);
+					decoded.image.reset();
+				}
+				else if (cache_key && image.Data<void>() != nullptr)
+				{
+					ADRIA_LOG(INFO, "Texture %s (%ux%u) can't be block compressed, it's loaded uncompressed", path.c_str(), image.Width(), image.Height());
+				}
+			}
+
+			if (!decoded.dds.empty()) decoded.content_key = ContentKey(decoded.dds, usage);
+			else if (decoded.image->Data<void>() != nullptr) decoded.content_key = ContentKey(*decoded.image, mipmaps);
+			return decoded;
+		}
+
+		uint64 ContentKey(Image const& image, bool mipmaps)
+		{
+			size_t content_key = crc64(image.Data<char>(), (size_t)image.Pitch() * image.Height());
+			HashCombine(content_key, image.Width());
+			HashCombine(content_key, image.Height());
+			HashCombine(content_key, image.IsHDR());
+			HashCombine(content_key, mipmaps);
+			return content_key;
+		}
+
+		uint64 ContentKey(std::span<uint8 const> dds, TextureUsage usage)
+		{
+			size_t content_key = crc64(reinterpret_cast<char const*>(dds.data()), dds.size());
+			HashCombine(content_key, usage);
+			return content_key;
+		}
+
+		std::vector<uint8> ReadCacheFile(std::string const& path)
+		{
+			MemoryMappedFile file;
+			if (!file.Open(path) || file.Size() == 0) return {};
+			return std::vector<uint8>(file.As<uint8>(), file.As<uint8>() + file.Size());
+		}
+
+		std::vector<uint8> ReadCachedTexture(std::string const& path)
+		{
+			std::vector<uint8> dds = ReadCacheFile(path);
+			std::optional<DDSFileDesc> const desc = DDSFile::ReadHeaders(dds);
+			if (!desc) return {};
+			std::optional<uint64> const data_size = DDSFile::DataSize(*desc);
+			if (!data_size || DDSFile::DATA_OFFSET + *data_size != dds.size()) return {};
+			return dds;
+		}
+
+		bool WriteCacheFile(std::string const& path, std::vector<uint8> const& data)
+		{
+			std::error_code ec;
+			fs::create_directories(fs::path(path).parent_path(), ec);
+
+			std::string const temporary_path = GetTemporaryPath(path);
+			{
+				MemoryMappedFile file;
+				if (!file.Create(temporary_path, data.size()))
+				{
+					ADRIA_LOG(WARNING, "Failed to write cache file %s", path.c_str());
+					return false;
+				}
+				memcpy(file.Data(), data.data(), data.size());
+			}
+
+			fs::rename(temporary_path, path, ec);
+			if (ec)
+			{
+				ADRIA_LOG(WARNING, "Failed to write cache file %s: %s", path.c_str(), ec.message().c_str());
+				fs::remove(temporary_path, ec);
+				return false;
+			}
+			return true;
+		}
+	}
+
+	void TextureDecodeQueue::Submit(uint64 id, std::string const& path, TextureUsage usage, bool mipmaps)
+	{
+		++pending_count;
+		std::shared_ptr<Task> decode_task = g_TaskManager.CreateTask([this, id, path, usage, mipmaps]()
+			{
+				DecodedTexture decoded = TextureDecoding::Decode(path, usage, mipmaps);
+				decoded.id = id;
+				std::lock_guard lock(decoded_mutex);
+				decoded_textures.push_back(std::move(decoded));
+			});
+		decode_tasks.push_back(g_TaskManager.SubmitTask(decode_task));
+	}
+
+	uint32 TextureDecodeQueue::Drain(uint64 upload_budget, std::function<uint64(DecodedTexture&)> const& create)
+	{
+		std::erase_if(decode_tasks, [](std::future<void> const& decode_task) { return decode_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+
+		std::vector<DecodedTexture> ready_textures;
+		{
+			std::lock_guard lock(decoded_mutex);
+			if (decoded_textures.empty()) return 0;
+			std::swap(ready_textures, decoded_textures);
+		}
+
+		uint64 uploaded_bytes = 0;
+		size_t created = 0;
+		for (; created < ready_textures.size() && (created == 0 || uploaded_bytes < upload_budget); ++created)
+		{
+			--pending_count;
+			uploaded_bytes += create(ready_textures[created]);
+		}
+
+		if (created < ready_textures.size())
+		{
+			std::lock_guard lock(decoded_mutex);
+			decoded_textures.insert(std::begin(decoded_textures), std::make_move_iterator(std::begin(ready_textures) + created), std::make_move_iterator(std::end(ready_textures)));
+		}
+		return (uint32)created;
+	}
+
+	void TextureDecodeQueue::Clear()
+	{
+		for (auto& decode_task : decode_tasks) decode_task.wait();
+		decode_tasks.clear();
+		decoded_textures.clear();
+		pending_count = 0;
+	}
+
+	void TextureSharing::AddHandle(uint64 handle)
+	{
+		HandleEntry entry{};
+		entry.ref_count = 1;
+		handles[handle] = entry;
+	}
+
+	void TextureSharing::Acquire(uint64 handle)
+	{
+		if (auto it = handles.find(handle); it != handles.end()) ++it->second.ref_count;
+	}
+
+	bool TextureSharing::Release(uint64 handle, std::optional<uint64>& released_content)
+	{
+		released_content = std::nullopt;
+		auto it = handles.find(handle);
+		if (it == handles.end()) return false;
+		HandleEntry& entry = it->second;
+		ADRIA_ASSERT(entry.ref_count > 0);
+		if (--entry.ref_count > 0) return false;
+
+		if (entry.content_key)
+		{
+			auto content = content_handle_counts.find(*entry.content_key);
+			ADRIA_ASSERT(content != content_handle_counts.end());
+			if (--content->second == 0)
+			{
+				released_content = *entry.content_key;
+				content_handle_counts.erase(content);
+			}
+		}
+		handles.erase(it);
+		return true;
+	}
+
+	bool TextureSharing::Share(uint64 handle, uint64 content_key)
+	{
+		HandleEntry& entry = handles.at(handle);
+		ADRIA_ASSERT(!entry.content_key);
+		entry.content_key = content_key;
+		return content_handle_counts[content_key]++ == 0;
+	}
+
+	std::optional<uint64> TextureSharing::ContentKey(uint64 handle) const
+	{
+		auto it = handles.find(handle);
+		return it != handles.end() ? it->second.content_key : std::nullopt;
+	}
+
+	uint32 TextureSharing::ContentHandleCount(uint64 content_key) const
+	{
+		auto it = content_handle_counts.find(content_key);
+		return it != content_handle_counts.end() ? it->second : 0;
+	}
+}
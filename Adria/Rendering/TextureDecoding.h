@@ -0,0 +1,114 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <span>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include "Utilities/Image.h"
+#include "TextureCompression.h"
+
+namespace adria
+{
+	//a file decoded on a worker thread, waiting to be created on the device
+	struct DecodedTexture
+	{
+		uint64 id = 0;			//what the file was submitted with
+		std::string path;
+		std::unique_ptr<Image> image;
+		std::vector<uint8> dds;	//block compressed texture with all its mips, if set there is no image
+		std::string cache_path;	//set if the dds is in the texture cache, its mips are streamed from there
+		bool mipmaps = true;
+		uint64 content_key = 0;	//hash of the pixels, the size, the format and the mip setting, or of the dds
+
+		bool IsValid() const { return !dds.empty() || (image && image->Data<void>() != nullptr); }
+	};
+
+	//backend independent, so files can be decoded and deduplicated without a device
+	namespace TextureDecoding
+	{
+		/* Images loaded with a usage other than Generic are block compressed on first load and the DDS is written to a cache keyed by
+		   a hash of the source file, later loads read it from there and skip decoding altogether. */
+		DecodedTexture Decode(std::string const& path, TextureUsage usage, bool mipmaps);
+
+		//identical pixels loaded with the same settings get the same key whatever file they come from, the key textures are shared by
+		uint64 ContentKey(Image const& image, bool mipmaps);
+		uint64 ContentKey(std::span<uint8 const> dds, TextureUsage usage);
+
+		std::vector<uint8> ReadCacheFile(std::string const& path);
+		//empty if the file isn't a dds written by the engine or is shorter or longer than its headers say
+		std::vector<uint8> ReadCachedTexture(std::string const& path);
+		bool WriteCacheFile(std::string const& path, std::vector<uint8> const& data);
+	}
+
+	/* Decodes files on the task manager threads. Decoded textures wait in a queue until the thread that owns the device drains it,
+	   once per frame and within a budget, so neither the workers nor the frame ever wait on each other. */
+	class TextureDecodeQueue
+	{
+	public:
+		TextureDecodeQueue() = default;
+		TextureDecodeQueue(TextureDecodeQueue const&) = delete;
+		TextureDecodeQueue& operator=(TextureDecodeQueue const&) = delete;
+		~TextureDecodeQueue() { Clear(); }
+
+		void Submit(uint64 id, std::string const& path, TextureUsage usage, bool mipmaps);
+		/* Hands the decoded textures to create in the order they were decoded, until the bytes create returns add up to upload_budget.
+		   At least one texture is handed per call if any is decoded. Returns the number of textures handed. */
+		uint32 Drain(uint64 upload_budget, std::function<uint64(DecodedTexture&)> const& create);
+		//waits for the decodes in flight and drops everything that wasn't drained
+		void Clear();
+
+		//submitted and not drained yet
+		uint32 PendingCount() const { return pending_count; }
+
+	private:
+		std::vector<std::future<void>> decode_tasks;
+		std::mutex decoded_mutex;
+		std::vector<DecodedTexture> decoded_textures;
+		uint32 pending_count = 0;
+	};
+
+	/* References on texture handles and on the decoded images they share. Handles whose images have the same content key share one
+	   of them, the image is released with the last handle using it and a handle with the last reference on it. */
+	class TextureSharing
+	{
+		struct HandleEntry
+		{
+			uint32 ref_count = 0;
+			std::optional<uint64> content_key;	//set once its image is decoded
+		};
+
+	public:
+		//a new handle holding one reference
+		void AddHandle(uint64 handle);
+		//unknown handles are ignored
+		void Acquire(uint64 handle);
+		/* Returns true if that was the last reference and the handle is gone. released_content is then set to the content key of its
+		   image if no other handle uses it anymore. */
+		bool Release(uint64 handle, std::optional<uint64>& released_content);
+		//returns true if no handle used the image yet, it has to be created
+		bool Share(uint64 handle, uint64 content_key);
+
+		bool Contains(uint64 handle) const { return handles.contains(handle); }
+		std::optional<uint64> ContentKey(uint64 handle) const;
+		uint32 HandleCount() const { return (uint32)handles.size(); }
+		uint32 ContentCount() const { return (uint32)content_handle_counts.size(); }
+		uint32 ContentHandleCount(uint64 content_key) const;
+
+		template<typename F>
+		void ForEachHandle(uint64 content_key, F&& f) const
+		{
+			for (auto const& [handle, entry] : handles)
+			{
+				if (entry.content_key == content_key) f(handle);
+			}
+		}
+
+	private:
+		std::unordered_map<uint64, HandleEntry> handles;
+		std::unordered_map<uint64, uint32> content_handle_counts;
+	};
+}
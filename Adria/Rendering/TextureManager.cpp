@@ -2,10 +2,14 @@
 #include "TextureManager.h"
 #include "DDSTextureLoader.h"
 #include "WICTextureLoader.h"
-#include "Graphics/GfxShaderCompiler.h"
 #include "Utilities/StringUtil.h"
 #include "Utilities/Image.h"
 #include "Utilities/FilesUtil.h"
+#include "Utilities/Timer.h"
+#include "Utilities/HashUtil.h"
+#include "Utilities/MemoryMappedFile.h"
+#include "Tasks/TaskManager.h"
+#include "Logging/Logger.h"
 
 using namespace DirectX;
 
@@ -66,6 +70,74 @@ namespace adria
 			while ((width | height) >> levels) ++levels;
 			return levels;
 		}
+
+		inline static char const* ibl_cache_directory = "Resources/IBLCache/";
+		//bump when the output of the ibl baking changes
+		static constexpr uint32 IBL_CACHE_VERSION = 1;
+
+		std::string GetIBLCachePath(uint64 key, char const* suffix)
+		{
+			char cache_path[256];
+			sprintf_s(cache_path, "%s%016llx%s", ibl_cache_directory, (unsigned long long)key, suffix);
+			return cache_path;
+		}
+
+		//read from the ibl cache, keyed by a hash of the equirect file and the bake sizes, or baked from it on the cpu and written to the cache
+		std::optional<BakedEnvironment> ReadOrBakeEnvironment(std::string const& path)
+		{
+			MemoryMappedFile source;
+			if (!source.Open(path)) return std::nullopt;
+			IBLBakeDesc const desc{};
+			size_t key = crc64(source.As<char>(), source.Size());
+			HashCombine(key, IBL_CACHE_VERSION);
+			HashCombine(key, desc.environment_size);
+			HashCombine(key, desc.specular_size);
+			HashCombine(key, desc.specular_mip_count);
+			HashCombine(key, desc.specular_sample_count);
+
+			std::string const environment_path = GetIBLCachePath(key, "_environment.dds");
+			std::string const specular_path = GetIBLCachePath(key, "_specular.dds");
+			std::string const irradiance_path = GetIBLCachePath(key, "_irradiance.sh");
+			BakedEnvironment baked{};
+			baked.environment_dds = TextureDecoding::ReadCachedTexture(environment_path);
+			baked.specular_dds = TextureDecoding::ReadCachedTexture(specular_path);
+			std::optional<IrradianceSH> irradiance = IBLBaking::ReadIrradianceSH(TextureDecoding::ReadCacheFile(irradiance_path));
+			if (!baked.environment_dds.empty() && !baked.specular_dds.empty() && irradiance)
+			{
+				baked.irradiance = *irradiance;
+				return baked;
+			}
+
+			Image equirect(path, 4);
+			if (equirect.Data<void>() == nullptr || !equirect.IsHDR()) return std::nullopt;
+			IBLBakeResult const result = IBLBaking::Bake(std::span(equirect.Data<float>(), (size_t)equirect.Width() * equirect.Height() * 4), equirect.Width(), equirect.Height(), desc);
+			ADRIA_LOG(INFO, "Baked environment %s (%ux%u) in %.2f s", path.c_str(), equirect.Width(), equirect.Height(), result.bake_time);
+
+			baked.environment_dds = IBLBaking::WriteCubemapDDS(result.environment);
+			baked.specular_dds = IBLBaking::WriteCubemapDDS(result.specular);
+			baked.irradiance = result.irradiance;
+			TextureDecoding::WriteCacheFile(environment_path, baked.environment_dds);
+			TextureDecoding::WriteCacheFile(specular_path, baked.specular_dds);
+			TextureDecoding::WriteCacheFile(irradiance_path, IBLBaking::WriteIrradianceSH(baked.irradiance));
+			return baked;
+		}
+
+		//doesn't depend on the environment, baked once and shared by all of them
+		std::vector<uint8> ReadOrBakeSpecularBRDF()
+		{
+			IBLBakeDesc const desc{};
+			size_t key = 0;
+			HashCombine(key, IBL_CACHE_VERSION);
+			HashCombine(key, desc.brdf_size);
+			HashCombine(key, desc.brdf_sample_count);
+			std::string const brdf_path = GetIBLCachePath(key, "_brdf.dds");
+
+			std::vector<uint8> dds = TextureDecoding::ReadCachedTexture(brdf_path);
+			if (!dds.empty()) return dds;
+			dds = IBLBaking::WriteSpecularBRDFDDS(IBLBaking::IntegrateSpecularBRDF(desc.brdf_size, desc.brdf_sample_count), desc.brdf_size);
+			TextureDecoding::WriteCacheFile(brdf_path, dds);
+			return dds;
+		}
 	}
 
 
@@ -73,160 +145,207 @@ void TextureManager::Initialize(GfxDevice* _gfx)
 {
 	gfx = _gfx;
 	mipmaps = true;
+
+	uint32 const black = 0xff000000;
+	D3D11_TEXTURE2D_DESC desc{};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	D3D11_SUBRESOURCE_DATA data{ .pSysMem = &black, .SysMemPitch = sizeof(black) };
+
+	ArcPtr<ID3D11Texture2D> fallback_texture = nullptr;
+	GFX_CHECK_HR(gfx->GetDevice()->CreateTexture2D(&desc, &data, fallback_texture.GetAddressOf()));
+	GFX_CHECK_HR(gfx->GetDevice()->CreateShaderResourceView(fallback_texture.Get(), nullptr, fallback_view.GetAddressOf()));
 }
 
 void TextureManager::Destroy()
 {
+	decode_queue.Clear();
+	for (auto& mip_load_task : mip_load_tasks) mip_load_task.wait();
+	mip_load_tasks.clear();
+	streamed_mips.clear();
 	gfx = nullptr;
 }
 
-TextureHandle TextureManager::LoadTexture(std::wstring const& name)
+TextureHandle TextureManager::LoadTexture(std::wstring const& name, TextureUsage usage)
 {
-	TextureFormat format = GetTextureFormat(name);
+	if (auto it = loaded_textures.find(name); it != loaded_textures.end())
+	{
+		AcquireTexture(it->second);
+		return it->second;
+	}
 
+	TextureHandle tex_handle = INVALID_TEXTURE_HANDLE;
+	TextureFormat format = GetTextureFormat(name);
 	switch (format)
 	{
 	case TextureFormat::DDS:
-		return LoadDDSTexture(name);
+		tex_handle = LoadDDSTexture(name);
+		break;
+	case TextureFormat::TIFF:
+	case TextureFormat::ICO:
+		tex_handle = LoadWICTexture(name);
+		break;
 	case TextureFormat::BMP:
 	case TextureFormat::PNG:
 	case TextureFormat::JPG:
-	case TextureFormat::TIFF:
 	case TextureFormat::GIF:
-	case TextureFormat::ICO:
-		return LoadWICTexture(name);
 	case TextureFormat::TGA:
 	case TextureFormat::HDR:
 	case TextureFormat::PIC:
-		return LoadTexture_HDR_TGA_PIC(ToString(name));
+		tex_handle = LoadTextureAsync(name, usage);
+		break;
 	case TextureFormat::NotSupported:
 	default:
 		ADRIA_ASSERT(false && "Unsupported Texture Format!");
 	}
 
-	return INVALID_TEXTURE_HANDLE;
+	if (tex_handle != INVALID_TEXTURE_HANDLE)
+	{
+		texture_names[tex_handle] = name;
+		texture_sharing.AddHandle(tex_handle);
+	}
+	return tex_handle;
+}
+
+TextureHandle TextureManager::LoadTexture(std::string const& name, TextureUsage usage)
+{
+	return LoadTexture(ToWideString(name), usage);
 }
 
-TextureHandle TextureManager::LoadTexture(std::string const& name)
+void TextureManager::AcquireTexture(TextureHandle tex_handle)
 {
-	return LoadTexture(ToWideString(name));
+	texture_sharing.Acquire(tex_handle);
+}
+
+void TextureManager::ReleaseTexture(TextureHandle tex_handle)
+{
+	std::optional<uint64> released_content;
+	if (!texture_sharing.Release(tex_handle, released_content)) return;
+
+	if (released_content)
+	{
+		auto shared = shared_textures.find(*released_content);
+		ADRIA_ASSERT(shared != shared_textures.end());
+		if (shared->second.streamed_index != INVALID_STREAMED_INDEX) RemoveStreamedTexture(shared->second.streamed_index);
+		shared_textures.erase(shared);
+	}
+	auto name = texture_names.find(tex_handle);
+	loaded_textures.erase(name->second);
+	texture_names.erase(name);
+	texture_map.erase(tex_handle);
+}
+
+TextureMemoryStatistics TextureManager::GetMemoryStatistics() const
+{
+	TextureMemoryStatistics statistics{};
+	statistics.texture_count = texture_sharing.HandleCount();
+	statistics.resource_count = (uint32)shared_textures.size();
+	for (auto const& [content_key, shared] : shared_textures)
+	{
+		statistics.resident_bytes += shared.bytes;
+		statistics.deduplicated_bytes += (texture_sharing.ContentHandleCount(content_key) - 1) * shared.bytes;
+	}
+	return statistics;
+}
+
+void TextureManager::RequestTexture(TextureHandle tex_handle, float screen_size)
+{
+	std::optional<uint64> const content_key = texture_sharing.ContentKey(tex_handle);
+	if (!content_key) return;
+	auto shared = shared_textures.find(*content_key);
+	if (shared == shared_textures.end() || shared->second.streamed_index == INVALID_STREAMED_INDEX) return;
+
+	StreamedTexture& streamed = streamed_textures[shared->second.streamed_index];
+	DDSLayout const& layout = streamed_resources[shared->second.streamed_index].layout;
+	uint32 const desired_mip = TextureStreaming::DesiredMip(layout.width, layout.height, layout.mip_count, screen_size);
+	streamed.desired_mip = streamed.last_used_frame == streaming_frame ? std::min(streamed.desired_mip, desired_mip) : desired_mip;
+	streamed.last_used_frame = streaming_frame;
+}
+
+void TextureManager::Update(uint64 upload_budget)
+{
+	std::erase_if(mip_load_tasks, [](std::future<void> const& mip_load_task) { return mip_load_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+	UpdateStreaming();
+
+	//device context isn't thread safe, textures are created and their mips generated here
+	AdriaTimer timer;
+	uint64 uploaded_bytes = 0;
+	uint32 const created = decode_queue.Drain(upload_budget, [this, &uploaded_bytes](DecodedTexture& decoded) -> uint64
+		{
+			if (!texture_sharing.Contains(decoded.id)) return 0;	//released before it was decoded
+			if (!decoded.IsValid())
+			{
+				ADRIA_LOG(WARNING, "Texture %s could not be decoded, it keeps the fallback texture", decoded.path.c_str());
+				return 0;
+			}
+
+			uint64 bytes = 0;
+			bool const inserted = texture_sharing.Share(decoded.id, decoded.content_key);
+			auto shared = shared_textures.try_emplace(decoded.content_key).first;
+			std::optional<DDSLayout> const layout = inserted && !decoded.cache_path.empty() ? TextureCompression::ReadDDSLayout(decoded.dds) : std::nullopt;
+			if (inserted && layout)
+			{
+				CreateStreamedTexture(shared->second, decoded.content_key, decoded.cache_path, decoded.dds, *layout);
+				bytes = shared->second.bytes;
+			}
+			else if (inserted && !decoded.dds.empty())
+			{
+				HRESULT hr = CreateDDSTextureFromMemory(gfx->GetDevice(), decoded.dds.data(), decoded.dds.size(), nullptr, shared->second.view.GetAddressOf());
+				GFX_CHECK_HR(hr);
+				shared->second.bytes = decoded.dds.size();
+				bytes = decoded.dds.size();
+			}
+			else if (inserted)
+			{
+				bytes = (uint64)decoded.image->Pitch() * decoded.image->Height();
+				shared->second.view = CreateTexture(*decoded.image, decoded.mipmaps);
+				shared->second.bytes = decoded.mipmaps ? bytes * 4 / 3 : bytes;
+			}
+			texture_map[decoded.id] = shared->second.view;
+			uploaded_bytes += bytes;
+			return bytes;
+		});
+	if (created == 0) return;
+	upload_time += timer.ElapsedInSeconds();
+	streamed_count += created;
+	streamed_bytes += uploaded_bytes;
+
+	if (decode_queue.PendingCount() == 0)
+	{
+		TextureMemoryStatistics const memory_statistics = GetMemoryStatistics();
+		ADRIA_LOG(INFO, "Loaded %u textures (%.1f MB uploaded) in the background in %f s, %f s spent creating them on the main thread",
+			streamed_count, streamed_bytes / (1024.0 * 1024.0), streaming_timer.ElapsedInSeconds(), upload_time);
+		ADRIA_LOG(INFO, "%u texture handles share %u decoded images, %.1f MB resident, %.1f MB saved by content deduplication",
+			memory_statistics.texture_count, memory_statistics.resource_count,
+			memory_statistics.resident_bytes / (1024.0 * 1024.0), memory_statistics.deduplicated_bytes / (1024.0 * 1024.0));
+		streamed_count = 0;
+		streamed_bytes = 0;
+		upload_time = 0.0f;
+	}
 }
 
 TextureHandle TextureManager::LoadCubeMap(std::wstring const& name)
 {
 	TextureFormat format = GetTextureFormat(name);
 	ADRIA_ASSERT(format == TextureFormat::DDS || format == TextureFormat::HDR && "Cubemap in one file has to be .dds or .hdr format");
+	if (format == TextureFormat::HDR) return LoadEnvironmentMap(name).environment;
 
 	ID3D11Device* device = gfx->GetDevice();
-	ID3D11DeviceContext* context = gfx->GetContext();
 	if (auto it = loaded_textures.find(name); it == loaded_textures.end())
 	{
 		++handle;
-		if (format == TextureFormat::DDS)
-		{
-
-			ArcPtr<ID3D11ShaderResourceView> cubemap_srv;
-			HRESULT hr = CreateDDSTextureFromFileEx(device, name.c_str(), 0,
-				D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, D3D11_RESOURCE_MISC_TEXTURECUBE, false, nullptr, cubemap_srv.GetAddressOf());
+		ArcPtr<ID3D11ShaderResourceView> cubemap_srv;
+		HRESULT hr = CreateDDSTextureFromFileEx(device, name.c_str(), 0,
+			D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, D3D11_RESOURCE_MISC_TEXTURECUBE, false, nullptr, cubemap_srv.GetAddressOf());
 
-			loaded_textures.insert({ name, handle });
-			texture_map.insert({ handle, cubemap_srv });
-
-		}
-		else //HDR
-		{
-			Image equirect_hdr_image(ToString(name));
-			ArcPtr<ID3D11Texture2D> cubemap_tex = nullptr;
-			D3D11_TEXTURE2D_DESC desc{};
-			desc.Width = 1024;
-			desc.Height = 1024;
-			desc.MipLevels = 0;
-			desc.ArraySize = 6;
-			desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-			desc.SampleDesc.Count = 1;
-			desc.Usage = D3D11_USAGE_DEFAULT;
-			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_RENDER_TARGET;
-			desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS;
-
-			GFX_CHECK_HR(device->CreateTexture2D(&desc, nullptr, cubemap_tex.GetAddressOf()));
-
-			ArcPtr<ID3D11ShaderResourceView> cubemap_srv = nullptr;
-			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-			srvDesc.Format = desc.Format;
-			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-			srvDesc.TextureCube.MostDetailedMip = 0;
-			srvDesc.TextureCube.MipLevels = -1;
-			GFX_CHECK_HR(device->CreateShaderResourceView(cubemap_tex.Get(), &srvDesc, cubemap_srv.GetAddressOf()));
-
-			ArcPtr<ID3D11UnorderedAccessView> cubemap_uav = nullptr;
-			D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
-			uavDesc.Format = desc.Format;
-			uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2DARRAY;
-			uavDesc.Texture2DArray.MipSlice = 0;
-			uavDesc.Texture2DArray.FirstArraySlice = 0;
-			uavDesc.Texture2DArray.ArraySize = desc.ArraySize;
-
-			GFX_CHECK_HR(device->CreateUnorderedAccessView(cubemap_tex.Get(), &uavDesc, cubemap_uav.GetAddressOf()));
-			ArcPtr<ID3D11ComputeShader> equirect_to_cube{};
-
-			GfxShaderBlob blob{};
-			GfxShaderDesc input{};
-			input.source_file = "Resources\\Shaders\\Deferred\\Equirect2cubeCS.hlsl";
-			input.stage = GfxShaderStage::CS;
-			input.entrypoint = "cs_main";
-			GfxShaderCompileOutput output{};
-			GfxShaderCompiler::CompileShader(input, output);
-			device->CreateComputeShader(output.shader_bytecode.GetPointer(), output.shader_bytecode.GetLength(), nullptr, equirect_to_cube.GetAddressOf());
-
-			D3D11_SAMPLER_DESC samp_desc{};
-			samp_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-			samp_desc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-			samp_desc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-			samp_desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-			samp_desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-			samp_desc.MinLOD = 0;
-			samp_desc.MaxLOD = D3D11_FLOAT32_MAX;
-			ArcPtr<ID3D11SamplerState> linear_wrap_sampler;
-			GFX_CHECK_HR(device->CreateSamplerState(&samp_desc, linear_wrap_sampler.GetAddressOf()));
-			context->CSSetSamplers(0, 1, linear_wrap_sampler.GetAddressOf());
-
-			ArcPtr<ID3D11Texture2D> equirect_tex = nullptr;
-
-			D3D11_TEXTURE2D_DESC equirect_desc = {};
-			equirect_desc.Width = equirect_hdr_image.Width();
-			equirect_desc.Height = equirect_hdr_image.Height();
-			equirect_desc.MipLevels = 1;
-			equirect_desc.ArraySize = 1;
-			equirect_desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-			equirect_desc.SampleDesc.Count = 1;
-			equirect_desc.Usage = D3D11_USAGE_DEFAULT;
-			equirect_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-
-			GFX_CHECK_HR(device->CreateTexture2D(&equirect_desc, nullptr, equirect_tex.GetAddressOf()));
-
-			ArcPtr<ID3D11ShaderResourceView> equirect_srv = nullptr;
-			D3D11_SHADER_RESOURCE_VIEW_DESC equirect_srv_desc = {};
-			equirect_srv_desc.Format = equirect_desc.Format;
-			equirect_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			equirect_srv_desc.Texture2D.MostDetailedMip = 0;
-			equirect_srv_desc.Texture2D.MipLevels = -1;
-			GFX_CHECK_HR(device->CreateShaderResourceView(equirect_tex.Get(), &equirect_srv_desc, equirect_srv.GetAddressOf()));
-
-			context->UpdateSubresource(equirect_tex.Get(), 0, nullptr, equirect_hdr_image.Data<void>(), equirect_hdr_image.Pitch(), 0);
-			context->CSSetShaderResources(0, 1, equirect_srv.GetAddressOf());
-			context->CSSetUnorderedAccessViews(0, 1, cubemap_uav.GetAddressOf(), nullptr);
-			context->CSSetShader(equirect_to_cube.Get(), nullptr, 0);
-			context->Dispatch(desc.Width / 32, desc.Height / 32, 6);
-
-			ID3D11UnorderedAccessView* nullUAV[] = { nullptr };
-			context->CSSetUnorderedAccessViews(0, 1, nullUAV, nullptr);
-
-			context->GenerateMips(cubemap_srv.Get());
-
-			loaded_textures.insert({ name, handle });
-			texture_map.insert({ handle, cubemap_srv });
-
-		}
+		loaded_textures.insert({ name, handle });
+		texture_map.insert({ handle, cubemap_srv });
 		return handle;
 	}
 	else return it->second;
@@ -295,6 +414,55 @@ TextureHandle TextureManager::LoadCubeMap(std::array<std::string, 6> const& cube
 	return handle;
 }
 
+EnvironmentMap TextureManager::LoadEnvironmentMap(std::wstring const& name)
+{
+	ADRIA_ASSERT(GetTextureFormat(name) == TextureFormat::HDR && "Environment map has to be an equirect .hdr file");
+	if (loaded_textures.contains(name)) return CreateEnvironmentMap(name, BakedEnvironment{});
+
+	std::optional<BakedEnvironment> baked = ReadEnvironmentMap(name);
+	if (!baked)
+	{
+		ADRIA_LOG(WARNING, "Failed to load environment map %s", ToString(name).c_str());
+		return EnvironmentMap{};
+	}
+	return CreateEnvironmentMap(name, *baked);
+}
+
+std::optional<BakedEnvironment> TextureManager::ReadEnvironmentMap(std::wstring const& name)
+{
+	ADRIA_ASSERT(GetTextureFormat(name) == TextureFormat::HDR && "Environment map has to be an equirect .hdr file");
+	return ReadOrBakeEnvironment(ToString(name));
+}
+
+EnvironmentMap TextureManager::CreateEnvironmentMap(std::wstring const& name, BakedEnvironment const& baked)
+{
+	std::wstring const specular_name = name + L"#specular";
+	std::wstring const irradiance_name = name + L"#irradiance";
+	if (auto it = loaded_textures.find(name); it != loaded_textures.end())
+		return EnvironmentMap{ .environment = it->second, .specular = loaded_textures[specular_name], .irradiance = loaded_textures[irradiance_name] };
+
+	EnvironmentMap environment_map{};
+	environment_map.environment = CreateBakedTexture(name, baked.environment_dds);
+	environment_map.specular = CreateBakedTexture(specular_name, baked.specular_dds);
+	//evaluating the coefficients takes less than reading a cubemap would, so only they are cached
+	CubemapImage const irradiance = IBLBaking::EvaluateIrradiance(baked.irradiance, IBLBakeDesc{}.irradiance_size);
+	environment_map.irradiance = CreateBakedTexture(irradiance_name, IBLBaking::WriteCubemapDDS(irradiance));
+	return environment_map;
+}
+
+TextureHandle TextureManager::LoadSpecularBRDF()
+{
+	std::wstring const brdf_name = L"#specular_brdf";
+	if (auto it = loaded_textures.find(brdf_name); it != loaded_textures.end()) return it->second;
+	return CreateBakedTexture(brdf_name, ReadOrBakeSpecularBRDF());
+}
+
+bool TextureManager::BakeEnvironmentMap(std::wstring const& name)
+{
+	ReadOrBakeSpecularBRDF();
+	return ReadOrBakeEnvironment(ToString(name)).has_value();
+}
+
 GfxShaderResourceRO TextureManager::GetTextureView(TextureHandle tex_handle) const
 {
 	if (auto it = texture_map.find(tex_handle); it != texture_map.end()) return it->second.Get();
@@ -364,57 +532,197 @@ TextureHandle TextureManager::LoadWICTexture(std::wstring const& name)
 	else return it->second;
 }
 
-TextureHandle TextureManager::LoadTexture_HDR_TGA_PIC(std::string const& name)
+TextureHandle TextureManager::LoadTextureAsync(std::wstring const& name, TextureUsage usage)
+{
+	if (auto it = loaded_textures.find(name); it != loaded_textures.end()) return it->second;
+
+	++handle;
+	loaded_textures.insert({ name, handle });
+	texture_map.insert({ handle, fallback_view });
+	if (decode_queue.PendingCount() == 0) streaming_timer.Mark();
+	decode_queue.Submit(handle, ToString(name), usage, mipmaps);
+	return handle;
+}
+
+GfxArcShaderResourceRO TextureManager::CreateTexture(Image const& img, bool mipmaps)
 {
 	ID3D11Device* device = gfx->GetDevice();
 	ID3D11DeviceContext* context = gfx->GetContext();
 
-	std::wstring wide_name = ToWideString(name);
-	if (auto it = loaded_textures.find(wide_name); it == loaded_textures.end())
+	D3D11_TEXTURE2D_DESC desc{};
+	desc.Width = img.Width();
+	desc.Height = img.Height();
+	desc.MipLevels = mipmaps ? 0 : 1;
+	desc.ArraySize = 1;
+	desc.Format = img.IsHDR() ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	if (mipmaps)
 	{
-		++handle;
-		Image img(name, 4);
-		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = img.Width();
-		desc.Height = img.Height();
-		desc.MipLevels = mipmaps ? 0 : 1;
-		desc.ArraySize = 1;
-		desc.Format = img.IsHDR() ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
-		desc.SampleDesc.Count = 1;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		if (mipmaps)
-		{
-			desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
-			desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
-		}
+		desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	}
 
-		ArcPtr<ID3D11Texture2D> tex_ptr = nullptr;
+	ArcPtr<ID3D11Texture2D> tex_ptr = nullptr;
 
-		HRESULT hr = device->CreateTexture2D(&desc, nullptr, tex_ptr.GetAddressOf());
-		GFX_CHECK_HR(hr);
+	HRESULT hr = device->CreateTexture2D(&desc, nullptr, tex_ptr.GetAddressOf());
+	GFX_CHECK_HR(hr);
 
-		D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc{};
-		srv_desc.Format = desc.Format;
-		srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srv_desc.Texture2D.MostDetailedMip = 0;
-		srv_desc.Texture2D.MipLevels = -1;
+	D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc{};
+	srv_desc.Format = desc.Format;
+	srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srv_desc.Texture2D.MostDetailedMip = 0;
+	srv_desc.Texture2D.MipLevels = -1;
 
-		ArcPtr<ID3D11ShaderResourceView> view_ptr = nullptr;
-		hr = device->CreateShaderResourceView(tex_ptr.Get(), &srv_desc, view_ptr.GetAddressOf());
-		GFX_CHECK_HR(hr);
-		context->UpdateSubresource(tex_ptr.Get(), 0, nullptr, img.Data<void>(), img.Pitch(), 0);
-		if (mipmaps)
+	ArcPtr<ID3D11ShaderResourceView> view_ptr = nullptr;
+	hr = device->CreateShaderResourceView(tex_ptr.Get(), &srv_desc, view_ptr.GetAddressOf());
+	GFX_CHECK_HR(hr);
+	context->UpdateSubresource(tex_ptr.Get(), 0, nullptr, img.Data<void>(), img.Pitch(), 0);
+	if (mipmaps)
+	{
+		context->GenerateMips(view_ptr.Get());
+	}
+	return view_ptr;
+}
+
+TextureHandle TextureManager::CreateBakedTexture(std::wstring const& name, std::vector<uint8> const& dds)
+{
+	GfxArcShaderResourceRO view;
+	HRESULT hr = CreateDDSTextureFromMemory(gfx->GetDevice(), dds.data(), dds.size(), nullptr, view.GetAddressOf());
+	GFX_CHECK_HR(hr);
+
+	++handle;
+	loaded_textures.insert({ name, handle });
+	texture_map.insert({ handle, view });
+	return handle;
+}
+
+void TextureManager::CreateStreamedTexture(SharedTexture& shared, uint64 content_key, std::string const& cache_path, std::vector<uint8> const& dds, DDSLayout const& layout)
+{
+	ADRIA_ASSERT(layout.mip_count <= STREAMING_MAX_MIPS);
+	StreamedTexture streamed{};
+	streamed.mip_count = layout.mip_count;
+	streamed.tail_mip = TextureStreaming::TailMip(layout.width, layout.height, layout.mip_count);
+	streamed.resident_mip = layout.mip_count;
+	for (uint32 mip = 0; mip < layout.mip_count; ++mip) streamed.mip_bytes[mip] = layout.mip_sizes[mip];
+
+	shared.streamed_index = (uint32)streamed_textures.size();
+	streamed_textures.push_back(streamed);
+	streamed_resources.push_back(StreamedResource{ .content_key = content_key, .cache_path = cache_path, .layout = layout, .texture = nullptr });
+	SetResidentMips(shared.streamed_index, streamed.tail_mip, dds.data() + layout.mip_offsets[streamed.tail_mip]);
+}
+
+void TextureManager::RemoveStreamedTexture(uint32 streamed_index)
+{
+	uint32 const last_index = (uint32)streamed_textures.size() - 1;
+	if (streamed_index != last_index)
+	{
+		streamed_textures[streamed_index] = streamed_textures[last_index];
+		streamed_resources[streamed_index] = std::move(streamed_resources[last_index]);
+		shared_textures[streamed_resources[streamed_index].content_key].streamed_index = streamed_index;
+	}
+	streamed_textures.pop_back();
+	streamed_resources.pop_back();
+}
+
+void TextureManager::SetResidentMips(uint32 streamed_index, uint32 top_mip, uint8 const* mip_data)
+{
+	ID3D11Device* device = gfx->GetDevice();
+	ID3D11DeviceContext* context = gfx->GetContext();
+	StreamedTexture& streamed = streamed_textures[streamed_index];
+	StreamedResource& resource = streamed_resources[streamed_index];
+	DDSLayout const& layout = resource.layout;
+
+	D3D11_TEXTURE2D_DESC desc{};
+	desc.Width = std::max(layout.width >> top_mip, 1u);
+	desc.Height = std::max(layout.height >> top_mip, 1u);
+	desc.MipLevels = layout.mip_count - top_mip;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)layout.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	ArcPtr<ID3D11Texture2D> texture = nullptr;
+	HRESULT hr = device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf());
+	GFX_CHECK_HR(hr);
+
+	//mips that are already resident are copied on the gpu, evictions don't touch the cache at all
+	uint32 const first_copied_mip = resource.texture ? std::max(streamed.resident_mip, top_mip) : layout.mip_count;
+	for (uint32 mip = top_mip; mip < first_copied_mip; ++mip)
+	{
+		uint8 const* data = mip_data + (layout.mip_offsets[mip] - layout.mip_offsets[top_mip]);
+		context->UpdateSubresource(texture.Get(), mip - top_mip, nullptr, data, TextureCompression::RowPitch(layout.format, std::max(layout.width >> mip, 1u)), 0);
+	}
+	for (uint32 mip = first_copied_mip; mip < layout.mip_count; ++mip)
+	{
+		context->CopySubresourceRegion(texture.Get(), mip - top_mip, 0, 0, 0, resource.texture.Get(), mip - streamed.resident_mip, nullptr);
+	}
+
+	GfxArcShaderResourceRO view = nullptr;
+	hr = device->CreateShaderResourceView(texture.Get(), nullptr, view.GetAddressOf());
+	GFX_CHECK_HR(hr);
+
+	resource.texture = texture;
+	streamed.resident_mip = top_mip;
+	SharedTexture& shared = shared_textures[resource.content_key];
+	shared.view = view;
+	shared.bytes = TextureStreaming::ResidentBytes(streamed, top_mip);
+	texture_sharing.ForEachHandle(resource.content_key, [this, &view](TextureHandle tex_handle) { texture_map[tex_handle] = view; });
+}
+
+void TextureManager::UpdateStreaming()
+{
+	std::vector<StreamedMips> loaded_mips;
+	{
+		std::lock_guard lock(mips_mutex);
+		std::swap(loaded_mips, streamed_mips);
+	}
+	for (StreamedMips const& mips : loaded_mips)
+	{
+		auto shared = shared_textures.find(mips.content_key);
+		if (shared == shared_textures.end() || shared->second.streamed_index == INVALID_STREAMED_INDEX) continue;	//released while its mips were read
+		uint32 const streamed_index = shared->second.streamed_index;
+		StreamedTexture& streamed = streamed_textures[streamed_index];
+		if (!streamed.loading || streamed.resident_mip != mips.end_mip) continue;
+
+		streamed.loading = false;
+		if (mips.data.empty())
 		{
-			context->GenerateMips(view_ptr.Get());
+			ADRIA_LOG(WARNING, "Mips of %s could not be read from the texture cache", streamed_resources[streamed_index].cache_path.c_str());
+			continue;
 		}
-		loaded_textures.insert({ wide_name, handle });
-		texture_map.insert({ handle, view_ptr });
-
-		return handle;
+		SetResidentMips(streamed_index, mips.top_mip, mips.data.data());
 	}
-	else return it->second;
 
+	std::vector<ResidencyChange> changes;
+	streaming_statistics = TextureStreaming::UpdateResidency(streamed_textures, streaming_budget, streaming_frame, STREAMING_MAX_LOADS, changes);
+	++streaming_frame;
+	for (ResidencyChange const& change : changes)
+	{
+		StreamedTexture& streamed = streamed_textures[change.texture];
+		if (change.target_mip > streamed.resident_mip)
+		{
+			SetResidentMips(change.texture, change.target_mip, nullptr);
+			continue;
+		}
+
+		streamed.loading = true;
+		StreamedResource const& resource = streamed_resources[change.texture];
+		StreamedMips mips{ .content_key = resource.content_key, .top_mip = change.target_mip, .end_mip = streamed.resident_mip };
+		std::shared_ptr<Task> load_task = g_TaskManager.CreateTask([this, cache_path = resource.cache_path, layout = resource.layout, mips = std::move(mips)]() mutable
+			{
+				MemoryMappedFile file;
+				if (file.Open(cache_path) && file.Size() >= layout.mip_offsets[mips.end_mip])
+				{
+					mips.data.assign(file.As<uint8>() + layout.mip_offsets[mips.top_mip], file.As<uint8>() + layout.mip_offsets[mips.end_mip]);
+				}
+				std::lock_guard lock(mips_mutex);
+				streamed_mips.push_back(std::move(mips));
+			});
+		mip_load_tasks.push_back(g_TaskManager.SubmitTask(load_task));
+	}
+}
 
 }
-}
\ No newline at end of file
@@ -1,31 +1,129 @@
 #pragma once
 #include <string>
 #include <array>
+#include <span>
 #include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <optional>
 #include "Graphics/GfxDevice.h"
 #include "Graphics/GfxView.h"
 #include "Utilities/Singleton.h"
+#include "Utilities/Timer.h"
+#include "Utilities/Image.h"
+#include "TextureCompression.h"
+#include "TextureDecoding.h"
+#include "TextureStreaming.h"
+#include "IBLBaking.h"
 
 namespace adria
 {
 	using TextureHandle = uint64;
 	inline constexpr TextureHandle const INVALID_TEXTURE_HANDLE = uint64(-1);
 
+	struct TextureMemoryStatistics
+	{
+		uint64 resident_bytes = 0;		//decoded images on the gpu, mips included
+		uint64 deduplicated_bytes = 0;	//what identical images loaded under other names would have taken on top of that
+		uint32 texture_count = 0;		//live handles
+		uint32 resource_count = 0;		//distinct decoded images
+	};
+
+	//what image based lighting needs from an environment, all cubemaps
+	struct EnvironmentMap
+	{
+		TextureHandle environment = INVALID_TEXTURE_HANDLE;
+		TextureHandle specular = INVALID_TEXTURE_HANDLE;	//prefiltered for roughness going linearly from 0 to 1 over its mips
+		TextureHandle irradiance = INVALID_TEXTURE_HANDLE;
+	};
+
+	//an environment map as read from the ibl cache or baked, before its textures are created
+	struct BakedEnvironment
+	{
+		std::vector<uint8> environment_dds;
+		std::vector<uint8> specular_dds;
+		IrradianceSH irradiance;
+	};
+
+	/* Images that stb decodes are loaded in the background: LoadTexture returns a handle bound to a 1x1 black texture right away,
+	   the file is decoded on the task manager threads and Update creates the texture and swaps it in behind the same handle.
+	   DDS, TIFF and ICO files are still loaded synchronously.
+	   Images loaded with a usage other than Generic are block compressed with a format that suits the usage on first load. The DDS
+	   is written to a cache keyed by a hash of the source file, later loads read it from there and skip decoding altogether.
+	   Decoded images are shared by content, so identical pixels loaded under different names are uploaded once. Every LoadTexture
+	   takes a reference on the handle, ReleaseTexture drops it and frees the texture once no handle uses it anymore. The terrain, decals
+	   and emitters release theirs when they are cleared, the materials of imported models hold theirs for the lifetime of the scene.
+	   Textures in the cache are streamed: only their mip tail is created on load, the renderer requests the mips it needs every frame
+	   and Update reads them from the cache in the background or evicts them, under a budget for all streamed textures.
+	   Environment maps in .hdr files are converted to cubemaps and their image based lighting is baked on the cpu on first load,
+	   the results are written to a cache keyed by a hash of the file so later loads only read them. */
 	class TextureManager : public Singleton<TextureManager>
 	{
 		friend class Singleton<TextureManager>;
+		static constexpr uint64 DEFAULT_UPLOAD_BUDGET = 16ull << 20;	//bytes of decoded images uploaded per frame, at least one texture is created per frame
+		static constexpr uint64 DEFAULT_STREAMING_BUDGET = 256ull << 20;
+		static constexpr uint32 STREAMING_MAX_LOADS = 4;	//mip loads started per frame
+		static constexpr uint32 INVALID_STREAMED_INDEX = uint32(-1);
+
+		struct SharedTexture
+		{
+			GfxArcShaderResourceRO view;
+			uint64 bytes = 0;
+			uint32 streamed_index = INVALID_STREAMED_INDEX;
+		};
+
+		struct StreamedResource
+		{
+			uint64 content_key;
+			std::string cache_path;
+			DDSLayout layout;
+			ArcPtr<ID3D11Texture2D> texture;	//holds the mips from the resident one on
+		};
+
+		struct StreamedMips
+		{
+			uint64 content_key;
+			uint32 top_mip;
+			uint32 end_mip;				//most detailed mip resident when the load started
+			std::vector<uint8> data;	//mips from top_mip up to end_mip as laid out in the dds, empty if the cache couldn't be read
+		};
 
 	public:
 		void Initialize(GfxDevice* gfx);
 		void Destroy();
 
-		ADRIA_NODISCARD TextureHandle LoadTexture(std::wstring const& name);
-		ADRIA_NODISCARD TextureHandle LoadTexture(std::string const& name);
+		ADRIA_NODISCARD TextureHandle LoadTexture(std::wstring const& name, TextureUsage usage = TextureUsage::Generic);
+		ADRIA_NODISCARD TextureHandle LoadTexture(std::string const& name, TextureUsage usage = TextureUsage::Generic);
 		ADRIA_NODISCARD TextureHandle LoadCubeMap(std::wstring const& name);
 		ADRIA_NODISCARD TextureHandle LoadCubeMap(std::array<std::string, 6> const& cubemap_textures);
+		//equirect .hdr files only
+		ADRIA_NODISCARD EnvironmentMap LoadEnvironmentMap(std::wstring const& name);
+		//LoadEnvironmentMap in two steps, the first one only reads and writes files and can run on any thread
+		ADRIA_NODISCARD static std::optional<BakedEnvironment> ReadEnvironmentMap(std::wstring const& name);
+		ADRIA_NODISCARD EnvironmentMap CreateEnvironmentMap(std::wstring const& name, BakedEnvironment const& baked);
+		ADRIA_NODISCARD TextureHandle LoadSpecularBRDF();
+		//fills the cache without touching the device, so it can be called before Initialize to bake environment maps ahead
+		bool BakeEnvironmentMap(std::wstring const& name);
+
+		//references taken by LoadTexture or copies of a handle, unknown handles are ignored
+		void AcquireTexture(TextureHandle tex_handle);
+		void ReleaseTexture(TextureHandle tex_handle);
 
 		GfxShaderResourceRO GetTextureView(TextureHandle tex_handle) const;
 		void SetMipMaps(bool mipmaps);
+		TextureMemoryStatistics GetMemoryStatistics() const;
+
+		//screen_size is the number of pixels the texture is stretched over, call every frame for the textures that are drawn
+		void RequestTexture(TextureHandle tex_handle, float screen_size);
+		void SetStreamingBudget(uint64 budget) { streaming_budget = budget; }
+		uint64 GetStreamingBudget() const { return streaming_budget; }
+		TextureStreamingStatistics const& GetStreamingStatistics() const { return streaming_statistics; }
+
+		//sync point, call once per frame on the thread that owns the device context
+		void Update(uint64 upload_budget = DEFAULT_UPLOAD_BUDGET);
+		bool IsLoading() const { return decode_queue.PendingCount() > 0; }
 
 	private:
 		GfxDevice* gfx;
@@ -33,6 +131,25 @@ namespace adria
 		TextureHandle handle = INVALID_TEXTURE_HANDLE;
 		std::unordered_map<TextureHandle, GfxArcShaderResourceRO> texture_map{};
 		std::unordered_map<std::wstring, TextureHandle> loaded_textures{};
+		std::unordered_map<TextureHandle, std::wstring> texture_names{};
+		TextureSharing texture_sharing;			//textures loaded synchronously hold a reference but share no image
+		std::unordered_map<uint64, SharedTexture> shared_textures{};
+
+		GfxArcShaderResourceRO fallback_view = nullptr;
+		TextureDecodeQueue decode_queue;
+		uint32 streamed_count = 0;
+		uint64 streamed_bytes = 0;
+		float upload_time = 0.0f;
+		AdriaTimer streaming_timer;
+
+		uint64 streaming_budget = DEFAULT_STREAMING_BUDGET;
+		uint64 streaming_frame = 1;
+		std::vector<StreamedTexture> streamed_textures;
+		std::vector<StreamedResource> streamed_resources;	//same order as streamed_textures
+		std::vector<std::future<void>> mip_load_tasks;
+		std::mutex mips_mutex;
+		std::vector<StreamedMips> streamed_mips;			//guarded by mips_mutex
+		TextureStreamingStatistics streaming_statistics{};
 
 	private:
 		TextureManager() = default;
@@ -42,7 +159,15 @@ namespace adria
 
 		TextureHandle LoadDDSTexture(std::wstring const& name);
 		TextureHandle LoadWICTexture(std::wstring const& name);
-		TextureHandle LoadTexture_HDR_TGA_PIC(std::string const& name);
+		TextureHandle LoadTextureAsync(std::wstring const& name, TextureUsage usage);
+		GfxArcShaderResourceRO CreateTexture(Image const& img, bool mipmaps);
+		TextureHandle CreateBakedTexture(std::wstring const& name, std::vector<uint8> const& dds);
+
+		void CreateStreamedTexture(SharedTexture& shared, uint64 content_key, std::string const& cache_path, std::vector<uint8> const& dds, DDSLayout const& layout);
+		void RemoveStreamedTexture(uint32 streamed_index);
+		//recreates the texture with the mips from top_mip on, those that aren't resident yet are read from mip_data
+		void SetResidentMips(uint32 streamed_index, uint32 top_mip, uint8 const* mip_data);
+		void UpdateStreaming();
 	};
 	#define g_TextureManager TextureManager::Get()
 }
\ No newline at end of file
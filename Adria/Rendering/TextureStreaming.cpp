@@ -0,0 +1,114 @@
+#include <cmath>
+#include "TextureStreaming.h"
+
+namespace adria
+{
+	namespace TextureStreaming
+	{
+		uint32 TailMip(uint32 width, uint32 height, uint32 mip_count)
+		{
+			uint32 tail_mip = 0;
+			while (tail_mip + 1 < mip_count && std::max(width >> tail_mip, height >> tail_mip) > TAIL_SIZE)
+			{
+				uint32 const next_width = std::max(width >> (tail_mip + 1), 1u), next_height = std::max(height >> (tail_mip + 1), 1u);
+				if (next_width % 4 != 0 || next_height % 4 != 0) break;
+				++tail_mip;
+			}
+			return tail_mip;
+		}
+
+		uint32 DesiredMip(uint32 width, uint32 height, uint32 mip_count, float screen_size)
+		{
+			float const texels_per_pixel = std::max(width, height) / std::max(screen_size, 1.0f);
+			if (texels_per_pixel <= 1.0f) return 0;
+			return std::min((uint32)std::log2(texels_per_pixel), mip_count - 1);
+		}
+
+		uint64 ResidentBytes(StreamedTexture const& texture, uint32 top_mip)
+		{
+			uint64 bytes = 0;
+			for (uint32 mip = top_mip; mip < texture.mip_count; ++mip) bytes += texture.mip_bytes[mip];
+			return bytes;
+		}
+
+		TextureStreamingStatistics UpdateResidency(std::span<StreamedTexture const> textures, uint64 budget, uint64 frame, uint32 max_loads,
+			std::vector<ResidencyChange>& changes)
+		{
+			changes.clear();
+			TextureStreamingStatistics statistics{};
+			statistics.budget = budget;
+			statistics.texture_count = (uint32)textures.size();
+
+			auto InUse = [&](StreamedTexture const& texture) { return !texture.loading && texture.last_used_frame == frame; };
+			auto DesiredTarget = [&](StreamedTexture const& texture, uint32 bias) { return std::min(texture.desired_mip + bias, texture.tail_mip); };
+
+			std::vector<uint32> targets(textures.size());
+			uint64 resident_bytes = 0;
+			for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+			{
+				StreamedTexture const& texture = textures[i];
+				targets[i] = InUse(texture) ? DesiredTarget(texture, 0) : texture.resident_mip;
+				resident_bytes += ResidentBytes(texture, targets[i]);
+				if (InUse(texture)) statistics.desired_bytes += ResidentBytes(texture, targets[i]);
+			}
+
+			if (resident_bytes > budget)
+			{
+				std::vector<uint32> unused_textures;
+				for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+				{
+					if (!textures[i].loading && !InUse(textures[i]) && targets[i] < textures[i].tail_mip) unused_textures.push_back(i);
+				}
+				std::sort(std::begin(unused_textures), std::end(unused_textures), [&](uint32 a, uint32 b) { return textures[a].last_used_frame < textures[b].last_used_frame; });
+				for (uint32 i : unused_textures)
+				{
+					if (resident_bytes <= budget) break;
+					resident_bytes -= ResidentBytes(textures[i], targets[i]) - ResidentBytes(textures[i], textures[i].tail_mip);
+					targets[i] = textures[i].tail_mip;
+				}
+			}
+
+			while (resident_bytes > budget && statistics.mip_bias < STREAMING_MAX_MIPS)
+			{
+				++statistics.mip_bias;
+				for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+				{
+					if (!InUse(textures[i])) continue;
+					uint32 const target = DesiredTarget(textures[i], statistics.mip_bias);
+					resident_bytes -= ResidentBytes(textures[i], targets[i]) - ResidentBytes(textures[i], target);
+					targets[i] = target;
+				}
+			}
+
+			std::vector<ResidencyChange> loads;
+			for (uint32 i = 0; i < (uint32)textures.size(); ++i)
+			{
+				if (textures[i].loading || targets[i] == textures[i].resident_mip) continue;
+				if (targets[i] > textures[i].resident_mip)
+				{
+					changes.push_back(ResidencyChange{ .texture = i, .target_mip = targets[i] });
+					++statistics.eviction_count;
+				}
+				else loads.push_back(ResidencyChange{ .texture = i, .target_mip = targets[i] });
+			}
+
+			std::sort(std::begin(loads), std::end(loads), [&](ResidencyChange const& a, ResidencyChange const& b)
+				{
+					uint32 const missing_a = textures[a.texture].resident_mip - a.target_mip, missing_b = textures[b.texture].resident_mip - b.target_mip;
+					return missing_a != missing_b ? missing_a > missing_b : a.texture < b.texture;
+				});
+			for (uint32 i = 0; i < (uint32)loads.size(); ++i)
+			{
+				StreamedTexture const& texture = textures[loads[i].texture];
+				if (i < max_loads)
+				{
+					changes.push_back(loads[i]);
+					++statistics.load_count;
+				}
+				else resident_bytes -= ResidentBytes(texture, loads[i].target_mip) - ResidentBytes(texture, texture.resident_mip);
+			}
+			statistics.resident_bytes = resident_bytes;
+			return statistics;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	inline constexpr uint32 STREAMING_MAX_MIPS = 16;
+
+	//residency of one streamed texture, mips are counted from the most detailed one
+	struct StreamedTexture
+	{
+		uint32 mip_count = 0;
+		uint32 tail_mip = 0;			//the mips from here on are always resident
+		uint32 resident_mip = 0;		//most detailed resident mip
+		uint32 desired_mip = 0;			//most detailed mip requested in the last used frame
+		uint64 last_used_frame = 0;
+		bool loading = false;			//mips are being read, its residency doesn't change until they arrive
+		uint64 mip_bytes[STREAMING_MAX_MIPS]{};
+	};
+
+	struct ResidencyChange
+	{
+		uint32 texture;
+		uint32 target_mip;
+	};
+
+	struct TextureStreamingStatistics
+	{
+		uint64 budget = 0;
+		uint64 resident_bytes = 0;		//once the changes are applied
+		uint64 desired_bytes = 0;		//what the desired mips of the textures in use would take
+		uint32 texture_count = 0;
+		uint32 load_count = 0;
+		uint32 eviction_count = 0;
+		uint32 mip_bias = 0;			//mips dropped from every texture in use to fit the budget
+	};
+
+	//backend independent, so residency can be decided without a device
+	namespace TextureStreaming
+	{
+		inline constexpr uint32 TAIL_SIZE = 64;
+
+		//first mip no larger than TAIL_SIZE, or the last one whose size is a multiple of 4 so it can start a block compressed texture
+		uint32 TailMip(uint32 width, uint32 height, uint32 mip_count);
+		//most detailed mip worth sampling for a texture stretched over screen_size pixels
+		uint32 DesiredMip(uint32 width, uint32 height, uint32 mip_count, float screen_size);
+		uint64 ResidentBytes(StreamedTexture const& texture, uint32 top_mip);
+
+		/* Picks the mips every texture should have resident. Textures used in this frame get their desired mips, the others keep theirs.
+		   Over the budget, textures not used in this frame lose their streamed mips first, least recently used first, then the textures
+		   in use drop the same number of mips each until everything fits. The tail is never evicted.
+		   At most max_loads loads are issued per call, those missing the most mips first. */
+		TextureStreamingStatistics UpdateResidency(std::span<StreamedTexture const> textures, uint64 budget, uint64 frame, uint32 max_loads,
+			std::vector<ResidencyChange>& changes);
+	}
+}
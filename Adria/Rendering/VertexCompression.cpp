@@ -0,0 +1,150 @@
+#include <execution>
+#include <numeric>
+#include <DirectXPackedVector.h>
+#include "VertexCompression.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace adria
+{
+	namespace
+	{
+		//any unit vector orthogonal to n
+		XMVECTOR XM_CALLCONV OrthogonalVector(FXMVECTOR n)
+		{
+			XMVECTOR const axis = std::abs(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			return XMVector3Normalize(XMVector3Cross(n, axis));
+		}
+
+		//octahedral encoding of n and t side by side, returns (n.u, n.v, t.u, t.v), same mapping as OctahedralEncode in Math/Packing.h
+		XMVECTOR XM_CALLCONV OctahedralEncode2(FXMVECTOR n, FXMVECTOR t)
+		{
+			XMVECTOR const one = XMVectorSplatOne();
+			XMVECTOR const n_projected = XMVectorDivide(n, XMVector3Dot(XMVectorAbs(n), one));
+			XMVECTOR const t_projected = XMVectorDivide(t, XMVector3Dot(XMVectorAbs(t), one));
+			XMVECTOR const e = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1Y>(n_projected, t_projected);
+			XMVECTOR const z = XMVectorPermute<XM_PERMUTE_0Z, XM_PERMUTE_0Z, XM_PERMUTE_1Z, XM_PERMUTE_1Z>(n, t);
+
+			XMVECTOR const sign = XMVectorSelect(XMVectorNegate(one), one, XMVectorGreaterOrEqual(e, XMVectorZero()));
+			XMVECTOR const folded = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_W, XM_SWIZZLE_Z>(e))), sign);
+			return XMVectorSelect(e, folded, XMVectorLess(z, XMVectorZero()));
+		}
+
+		void XM_CALLCONV OctahedralDecode2(FXMVECTOR e, XMVECTOR& n, XMVECTOR& t)
+		{
+			XMVECTOR const abs_e = XMVectorAbs(e);
+			XMVECTOR const z = XMVectorSubtract(XMVectorSplatOne(), XMVectorAdd(abs_e, XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_W, XM_SWIZZLE_Z>(abs_e)));
+			XMVECTOR const fold = XMVectorMax(XMVectorNegate(z), XMVectorZero());
+			XMVECTOR const unfolded = XMVectorSelect(XMVectorAdd(e, fold), XMVectorSubtract(e, fold), XMVectorGreaterOrEqual(e, XMVectorZero()));
+			n = XMVector3Normalize(XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W>(unfolded, z));
+			t = XMVector3Normalize(XMVectorPermute<XM_PERMUTE_0Z, XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_1W>(unfolded, z));
+		}
+
+		CompressedVertex XM_CALLCONV CompressVertex(CompleteVertex const& vertex, FXMVECTOR offset, FXMVECTOR inv_scale)
+		{
+			XMVECTOR n = XMLoadFloat3(&vertex.normal);
+			if (XMVector3Equal(n, XMVectorZero())) n = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+			n = XMVector3Normalize(n);
+			XMVECTOR t = XMLoadFloat3(&vertex.tangent);
+			if (XMVector3Equal(t, XMVectorZero())) t = OrthogonalVector(n);
+			bool const negative_bitangent = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), XMLoadFloat3(&vertex.bitangent))) < 0.0f;
+
+			XMVECTOR position = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertex.position), offset), inv_scale);
+			position = XMVectorSetW(position, negative_bitangent ? 0.0f : 1.0f);
+
+			CompressedVertex compressed_vertex{};
+			XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(compressed_vertex.position), position);
+			XMBYTEN4 normal_tangent;
+			XMStoreByteN4(&normal_tangent, OctahedralEncode2(n, t));
+			compressed_vertex.normal[0] = normal_tangent.x;
+			compressed_vertex.normal[1] = normal_tangent.y;
+			compressed_vertex.tangent[0] = normal_tangent.z;
+			compressed_vertex.tangent[1] = normal_tangent.w;
+			XMStoreHalf2(reinterpret_cast<XMHALF2*>(compressed_vertex.uv), XMLoadFloat2(&vertex.uv));
+			return compressed_vertex;
+		}
+
+		CompleteVertex XM_CALLCONV DecompressVertex(CompressedVertex const& compressed_vertex, FXMVECTOR offset, FXMVECTOR scale)
+		{
+			XMVECTOR const position = XMLoadUShortN4(reinterpret_cast<XMUSHORTN4 const*>(compressed_vertex.position));
+			XMBYTEN4 const normal_tangent(compressed_vertex.normal[0], compressed_vertex.normal[1], compressed_vertex.tangent[0], compressed_vertex.tangent[1]);
+			XMVECTOR n, t;
+			OctahedralDecode2(XMLoadByteN4(&normal_tangent), n, t);
+			float const bitangent_sign = XMVectorGetW(position) > 0.5f ? 1.0f : -1.0f;
+
+			CompleteVertex vertex{};
+			XMStoreFloat3(&vertex.position, XMVectorMultiplyAdd(position, scale, offset));
+			XMStoreFloat3(&vertex.normal, n);
+			XMStoreFloat3(&vertex.tangent, t);
+			XMStoreFloat3(&vertex.bitangent, XMVectorScale(XMVector3Normalize(XMVector3Cross(n, t)), bitangent_sign));
+			XMStoreFloat2(&vertex.uv, XMLoadHalf2(reinterpret_cast<XMHALF2 const*>(compressed_vertex.uv)));
+			return vertex;
+		}
+
+		float XM_CALLCONV AngleInDegrees(FXMVECTOR original, FXMVECTOR decompressed)
+		{
+			if (XMVector3Equal(original, XMVectorZero())) return 0.0f;
+			return XMConvertToDegrees(XMVectorGetX(XMVector3AngleBetweenNormals(XMVector3Normalize(original), decompressed)));
+		}
+	}
+
+	namespace VertexCompression
+	{
+		VertexQuantization ComputeQuantization(BoundingBox const& bounds)
+		{
+			Vector3 const extents(bounds.Extents);
+			VertexQuantization quantization{};
+			quantization.offset = Vector3(bounds.Center) - extents;
+			quantization.scale = extents * 2.0f;
+			return quantization;
+		}
+
+		float PositionErrorBound(VertexQuantization const& quantization)
+		{
+			Vector3 const magnitude(std::abs(quantization.offset.x) + quantization.scale.x, std::abs(quantization.offset.y) + quantization.scale.y,
+				std::abs(quantization.offset.z) + quantization.scale.z);
+			return (quantization.scale * (0.5f / 65535.0f) + magnitude * std::numeric_limits<float>::epsilon()).Length();
+		}
+
+		void Compress(std::span<CompleteVertex const> vertices, VertexQuantization const& quantization, std::span<CompressedVertex> compressed_vertices)
+		{
+			ADRIA_ASSERT(vertices.size() == compressed_vertices.size());
+			XMVECTOR const offset = XMLoadFloat3(&quantization.offset);
+			XMVECTOR const scale = XMLoadFloat3(&quantization.scale);
+			//flat meshes have a zero scale on one axis, everything there decodes to the offset
+			XMVECTOR const inv_scale = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(scale), XMVectorGreater(scale, XMVectorZero()));
+			std::transform(std::execution::par_unseq, std::begin(vertices), std::end(vertices), std::begin(compressed_vertices),
+				[offset, inv_scale](CompleteVertex const& vertex) { return CompressVertex(vertex, offset, inv_scale); });
+		}
+
+		void Decompress(std::span<CompressedVertex const> compressed_vertices, VertexQuantization const& quantization, std::span<CompleteVertex> vertices)
+		{
+			ADRIA_ASSERT(vertices.size() == compressed_vertices.size());
+			XMVECTOR const offset = XMLoadFloat3(&quantization.offset);
+			XMVECTOR const scale = XMLoadFloat3(&quantization.scale);
+			std::transform(std::execution::par_unseq, std::begin(compressed_vertices), std::end(compressed_vertices), std::begin(vertices),
+				[offset, scale](CompressedVertex const& compressed_vertex) { return DecompressVertex(compressed_vertex, offset, scale); });
+		}
+
+		VertexCompressionError MeasureError(std::span<CompleteVertex const> vertices, std::span<CompressedVertex const> compressed_vertices,
+			VertexQuantization const& quantization)
+		{
+			std::vector<CompleteVertex> decompressed_vertices(compressed_vertices.size());
+			Decompress(compressed_vertices, quantization, decompressed_vertices);
+			return std::transform_reduce(std::execution::par, std::begin(vertices), std::end(vertices), std::begin(decompressed_vertices), VertexCompressionError{},
+				[](VertexCompressionError lhs, VertexCompressionError const& rhs) { return lhs += rhs; },
+				[](CompleteVertex const& vertex, CompleteVertex const& decompressed_vertex)
+				{
+					VertexCompressionError error{};
+					error.position = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&vertex.position), XMLoadFloat3(&decompressed_vertex.position))));
+					error.normal = AngleInDegrees(XMLoadFloat3(&vertex.normal), XMLoadFloat3(&decompressed_vertex.normal));
+					error.tangent = AngleInDegrees(XMLoadFloat3(&vertex.tangent), XMLoadFloat3(&decompressed_vertex.tangent));
+					error.bitangent = AngleInDegrees(XMLoadFloat3(&vertex.bitangent), XMLoadFloat3(&decompressed_vertex.bitangent));
+					XMVECTOR const uv_error = XMVectorAbs(XMVectorSubtract(XMLoadFloat2(&vertex.uv), XMLoadFloat2(&decompressed_vertex.uv)));
+					error.uv = std::max(XMVectorGetX(uv_error), XMVectorGetY(uv_error));
+					return error;
+				});
+		}
+	}
+}
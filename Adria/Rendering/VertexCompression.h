@@ -0,0 +1,51 @@
+#pragma once
+#include <span>
+#include "Core/CoreTypes.h"
+#include "Graphics/GfxVertexFormat.h"
+
+namespace adria
+{
+	//decoded position = unorm position * scale + offset
+	struct VertexQuantization
+	{
+		Vector3 offset = Vector3(0.0f, 0.0f, 0.0f);
+		Vector3 scale = Vector3(1.0f, 1.0f, 1.0f);
+	};
+
+	//largest differences between the original and the decompressed vertices
+	struct VertexCompressionError
+	{
+		float position = 0.0f;	//distance, in mesh units
+		float normal = 0.0f;	//angle, in degrees
+		float tangent = 0.0f;	//angle, in degrees
+		float bitangent = 0.0f; //angle, in degrees
+		float uv = 0.0f;		//per component
+
+		VertexCompressionError& operator+=(VertexCompressionError const& other)
+		{
+			position = std::max(position, other.position);
+			normal = std::max(normal, other.normal);
+			tangent = std::max(tangent, other.tangent);
+			bitangent = std::max(bitangent, other.bitangent);
+			uv = std::max(uv, other.uv);
+			return *this;
+		}
+	};
+
+	//backend independent, compresses CompleteVertex into CompressedVertex and back with DirectXMath, four components at a time
+	namespace VertexCompression
+	{
+		VertexQuantization ComputeQuantization(BoundingBox const& bounds);
+		//largest position error the quantization can introduce, half a step on every axis plus the rounding of the float decode
+		float PositionErrorBound(VertexQuantization const& quantization);
+
+		/* Missing normals and tangents are replaced by an arbitrary orthonormal frame. The bitangent is not stored, it is rebuilt as
+		   cross(normal, tangent) times the stored sign. */
+		void Compress(std::span<CompleteVertex const> vertices, VertexQuantization const& quantization, std::span<CompressedVertex> compressed_vertices);
+		void Decompress(std::span<CompressedVertex const> compressed_vertices, VertexQuantization const& quantization, std::span<CompleteVertex> vertices);
+
+		//vertices with a zero normal, tangent or bitangent are skipped for that attribute
+		VertexCompressionError MeasureError(std::span<CompleteVertex const> vertices, std::span<CompressedVertex const> compressed_vertices,
+			VertexQuantization const& quantization);
+	}
+}
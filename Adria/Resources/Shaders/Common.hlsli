@@ -80,6 +80,21 @@ static float ConvertZToLinearDepth(float depth)
     return (cameraNear * cameraFar) / (cameraFar - depth * (cameraFar - cameraNear));
 }
 
+//inverse of OctahedralEncode in Math/Packing.h
+static float3 OctahedralDecode(float2 e)
+{
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+//positions of compressed vertices are normalized to the bounds of the mesh
+static float3 DequantizePosition(float3 position)
+{
+    return position * objectData.positionScale + objectData.positionOffset;
+}
+
 
 inline bool IsSaturated(float value)
 {
@@ -1,5 +1,13 @@
 #include <Common.hlsli>
 
+#if COMPRESSED_VERTICES
+struct VSInput
+{
+    float4 Position      : POSITION;    //w is the bitangent sign
+    float4 NormalTangent : NORMAL;      //octahedral
+    float2 Uvs           : TEX;
+};
+#else
 struct VSInput
 {
     float3 Position : POSITION; 
@@ -8,6 +16,21 @@ struct VSInput
     float3 Tan      : TANGENT;
     float3 Bitan    : BITANGENT;
 };
+#endif
+
+#if INSTANCED
+//rows of the world matrix and of its inverse, the same layout as MeshInstance
+struct VSInstance
+{
+    float3 Model0   : INSTANCE_MODEL0;
+    float3 Model1   : INSTANCE_MODEL1;
+    float3 Model2   : INSTANCE_MODEL2;
+    float3 Model3   : INSTANCE_MODEL3;
+    float3 Inverse0 : INSTANCE_INVERSE0;
+    float3 Inverse1 : INSTANCE_INVERSE1;
+    float3 Inverse2 : INSTANCE_INVERSE2;
+};
+#endif
 
 struct VSToPS
 {
@@ -21,19 +44,43 @@ struct VSToPS
 };
 
 
+#if INSTANCED
+VSToPS GBufferVS(VSInput input, VSInstance instance)
+#else
 VSToPS GBufferVS(VSInput input)
+#endif
 {
     VSToPS Output = (VSToPS)0;
+
+#if COMPRESSED_VERTICES
+    float3 position = DequantizePosition(input.Position.xyz);
+    float3 normal = OctahedralDecode(input.NormalTangent.xy);
+    float3 tangent = OctahedralDecode(input.NormalTangent.zw);
+    float3 bitangent = cross(normal, tangent) * (input.Position.w > 0.5f ? 1.0f : -1.0f);
+#else
+    float3 position = input.Position;
+    float3 normal = input.Normal;
+    float3 tangent = input.Tan;
+    float3 bitangent = input.Bitan;
+#endif
+    
+#if INSTANCED
+    float4x4 model = float4x4(float4(instance.Model0, 0.0f), float4(instance.Model1, 0.0f), float4(instance.Model2, 0.0f), float4(instance.Model3, 1.0f));
+    float3x3 transposedInverseModel = float3x3(instance.Inverse0, instance.Inverse1, instance.Inverse2);
+#else
+    float4x4 model = objectData.model;
+    float3x3 transposedInverseModel = (float3x3) objectData.transposedInverseModel;
+#endif
     
-    float4 pos = mul(float4(input.Position, 1.0), objectData.model);
+    float4 pos = mul(float4(position, 1.0), model);
     Output.Position = mul(pos, frameData.viewprojection);
     Output.Position.xy += frameData.cameraJitter * Output.Position.w;
     Output.Uvs = input.Uvs;
 
-    float3 worldSpaceNormal = mul(input.Normal, (float3x3) objectData.transposedInverseModel);
+    float3 worldSpaceNormal = mul(normal, transposedInverseModel);
     Output.NormalVS = mul(worldSpaceNormal, (float3x3) transpose(frameData.inverseView));
-    Output.TangentWS = mul(input.Tan, (float3x3) objectData.model);
-    Output.BitangentWS = mul(input.Bitan, (float3x3) objectData.model);
+    Output.TangentWS = mul(tangent, (float3x3) model);
+    Output.BitangentWS = mul(bitangent, (float3x3) model);
     Output.NormalWS = worldSpaceNormal;
 
     return Output;
@@ -75,8 +122,9 @@ PSOutput GBufferPS(VSToPS input, bool IsFrontFace : SV_IsFrontFace)
     
     float3 tangent = normalize(input.TangentWS);
     float3 bitangent = normalize(input.BitangentWS); 
-    float3 bumpMapNormal = NormalTx.Sample( LinearWrapSampler, input.Uvs );
-    bumpMapNormal = 2.0f * bumpMapNormal - 1.0f;
+    //normal maps can be BC5 with only x and y, z is reconstructed for all of them
+    float2 bumpMapNormalXY = 2.0f * NormalTx.Sample( LinearWrapSampler, input.Uvs ).xy - 1.0f;
+    float3 bumpMapNormal = float3(bumpMapNormalXY, sqrt(saturate(1.0f - dot(bumpMapNormalXY, bumpMapNormalXY))));
     float3x3 TBN = float3x3(tangent, bitangent, normal);
     float3 newNormal = mul(bumpMapNormal, TBN);
     float3 viewSpaceNormal = normalize(mul(newNormal, (float3x3)frameData.view));
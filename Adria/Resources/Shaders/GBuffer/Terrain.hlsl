@@ -1,11 +1,50 @@
 #include <Common.hlsli>
 
+cbuffer TerrainCBuffer : register(b9)
+{
+    float2 textureScale;
+    int    oceanActive;
+    float  patchSize;
+    float2 terrainMin;      //world space xz of the first and the last height sample
+    float2 terrainMax;
+    float2 uvScale;
+    float2 heightmapSize;
+    float  heightScale;
+    float  heightBias;
+};
+
+#if CDLOD
+struct VSInput
+{
+    float2 Position         : POSITION;     //in [0, 1] over the patch
+    float2 Offset           : INSTANCE_OFFSET;
+    float2 Scale            : INSTANCE_SCALE;
+    uint   Lod              : INSTANCE_LOD;
+    uint   Quadrant         : INSTANCE_QUADRANT;
+    float2 MorphRange       : INSTANCE_MORPH_RANGE;
+};
+
+Texture2D<float>  HeightmapTx : register(t5);
+Texture2D<float2> NormalmapTx : register(t6);
+
+float2 HeightmapUV(float2 xz)
+{
+    float2 samplePosition = saturate((xz - terrainMin) / (terrainMax - terrainMin)) * (heightmapSize - 1.0f);
+    return (samplePosition + 0.5f) / heightmapSize;
+}
+
+float SampleHeight(float2 xz)
+{
+    return heightBias + heightScale * HeightmapTx.SampleLevel(LinearClampSampler, HeightmapUV(xz), 0);
+}
+#else
 struct VSInput
 {
     float3 Position : POSITION;
     float2 Uvs      : TEX;
     float3 Normal   : NORMAL;
 };
+#endif
 
 struct VSToPS
 {
@@ -20,25 +59,36 @@ struct VSToPS
 VSToPS TerrainVS(VSInput input)
 {
     VSToPS Output = (VSToPS)0;
-    
+
+#if CDLOD
+    //vertices move to the positions of the next lod as the distance goes over the morph range, so lods meet without cracks or popping
+    float2 xz = input.Offset + input.Position * input.Scale;
+    float distance = length(float3(xz.x, SampleHeight(xz), xz.y) - frameData.cameraPosition.xyz);
+    float morph = saturate((distance - input.MorphRange.x) / (input.MorphRange.y - input.MorphRange.x));
+    float2 morphOffset = frac(input.Position * patchSize * 0.5f) * 2.0f / patchSize;
+    xz -= morphOffset * input.Scale * morph;
+    xz = clamp(xz, terrainMin, terrainMax);
+
+    float4 pos = float4(xz.x, SampleHeight(xz), xz.y, 1.0f);
+    Output.PosWS = pos;
+    Output.Position = mul(pos, frameData.viewprojection);
+    Output.Uvs = (xz - terrainMin) * uvScale;
+
+    float3 worldSpaceNormal = OctahedralDecode(NormalmapTx.SampleLevel(LinearClampSampler, HeightmapUV(xz), 0));
+#else
     float4 pos = mul(float4(input.Position, 1.0), objectData.model);
     Output.PosWS = pos;
     Output.Position = mul(pos, frameData.viewprojection);
     Output.Uvs = input.Uvs;
 
 	float3 worldSpaceNormal = mul(input.Normal, (float3x3) objectData.transposedInverseModel);
+#endif
     Output.NormalVS = mul(worldSpaceNormal, (float3x3) transpose(frameData.inverseView));
     Output.NormalWS = worldSpaceNormal;
 
     return Output;
 }
 
-cbuffer TerrainCBuffer : register(b9)
-{
-    float2 textureScale;
-    int    oceanActive;
-};
-
 Texture2D GrassTx   : register(t0);
 Texture2D BaseTx    : register(t1);
 Texture2D RockTx    : register(t2);
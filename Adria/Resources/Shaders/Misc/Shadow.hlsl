@@ -4,10 +4,18 @@ Texture2D DiffuseTx : register(t0);
 
 struct VSInput
 {
+#if COMPRESSED_VERTICES
+    float4 Pos : POSITION;
+#else
     float3 Pos : POSITION;
+#endif
 #if TRANSPARENT
     float2 TexCoords : TEX;
 #endif
+#if FOLIAGE
+    float3 Offset : INSTANCE_OFFSET;
+    float  RotationY : INSTANCE_ROTATION;
+#endif
 };
 
 struct VSToPS
@@ -18,17 +26,39 @@ struct VSToPS
 #endif
 };
 
+#if FOLIAGE
+matrix RotationAroundYAxis(float angle)
+{
+    return float4x4(cos(angle), 0.0f, -sin(angle), 0.0f,
+             0.0f,       1.0f, 0.0f,       0.0f,
+             sin(angle), 0.0f, cos(angle), 0.0f,
+             0.0f,       0.0f, 0.0f,       1.0f);
+}
+#endif
 
 VSToPS ShadowVS(VSInput input)
 {
     VSToPS output;
+#if COMPRESSED_VERTICES
+    float4 pos = float4(DequantizePosition(input.Pos.xyz), 1.0f);
+#else
     float4 pos = float4(input.Pos, 1.0f);
+#endif
+#if FOLIAGE
+    matrix modelMatrix = mul(RotationAroundYAxis(input.RotationY), objectData.model);
+    modelMatrix[3].xyz += input.Offset;
+    pos = mul(pos, modelMatrix);
+#else
     pos = mul(pos, objectData.model);
+#endif
     pos = mul(pos, shadowData.lightViewProjection);
     output.Pos = pos;
     
 #if TRANSPARENT
     output.TexCoords = input.TexCoords;
+#endif
+#if FOLIAGE
+    output.TexCoords.y = 1.0f - output.TexCoords.y;
 #endif
     return output;
 }
@@ -13,7 +13,8 @@ namespace adria
 		explicit ThreadPool(uint32 pool_size = std::thread::hardware_concurrency() - 1) : done(false), task_queue{}
 		{
 			static const uint32 max_threads = std::thread::hardware_concurrency();
-			uint16 const num_threads = pool_size == 0 ? max_threads - 1 : (std::min)(max_threads - 1, pool_size);
+			//at least one worker, on a single core machine submitted tasks would never run
+			uint16 const num_threads = (std::max)(pool_size == 0 ? max_threads - 1 : (std::min)(max_threads - 1, pool_size), 1u);
 
 			threads.reserve(num_threads);
 			for (uint16 i = 0; i < num_threads; ++i)
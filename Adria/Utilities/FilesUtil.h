@@ -1,5 +1,8 @@
 #pragma once
 #include <filesystem>
+#include <string>
+#include <thread>
+#include <random>
 
 namespace fs = std::filesystem;
 
@@ -37,6 +40,14 @@ namespace adria
 		fs::path p(path);
 		return p.extension().string();
 	}
+	/* Next to path and unique to the calling thread and process. Cache files are written there and renamed into place,
+	   so concurrent writers of the same entry don't write over each other and readers never see a partial file. */
+	inline std::string GetTemporaryPath(std::string const& path)
+	{
+		static size_t const process_nonce = std::random_device{}();
+		size_t const writer = process_nonce ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+		return path + "." + std::to_string(writer) + ".tmp";
+	}
 	inline void NormalizePathInline(std::string& file_path)
 	{
 		for (char& c : file_path)
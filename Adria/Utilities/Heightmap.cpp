@@ -1,3 +1,5 @@
+#include <execution>
+#include <numeric>
 #include "Heightmap.h"
 #include "Cpp/FastNoiseLite.h"
 #include "Image.h"
@@ -49,7 +51,7 @@ namespace adria
 		return (distance > talus) ? (c * (max_diff - talus) * (distance / total_diff)) : 0.0f;
 	}
 
-	Heightmap::Heightmap(NoiseDesc const& desc)
+	static FastNoiseLite CreateNoise(NoiseDesc const& desc)
 	{
 		FastNoiseLite noise{};
 		noise.SetFractalType(GetFractalType(desc.fractal_type));
@@ -59,24 +61,113 @@ namespace adria
 		noise.SetFractalLacunarity(desc.lacunarity);
 		noise.SetFractalGain(desc.persistence);
 		noise.SetFrequency(desc.frequency);
-		hm.resize(desc.depth);
+		return noise;
+	}
 
-		float max_height_achieved = std::numeric_limits<float>::min();
-		float min_height_achieved = std::numeric_limits<float>::max();
+	std::function<float(uint64, uint64)> CreateNoiseHeightSource(NoiseDesc const& desc)
+	{
+		//GetNoise only modifies its arguments, so the captured noise can be shared between threads
+		return [noise = CreateNoise(desc), desc](uint64 x, uint64 z) mutable
+		{
+			float xf = x * desc.noise_scale / desc.width;
+			float zf = z * desc.noise_scale / desc.depth;
+			return noise.GetNoise(xf, zf) * desc.max_height;
+		};
+	}
 
-		for (uint32 z = 0; z < desc.depth; z++)
+	Heightmap::Heightmap(NoiseDesc const& desc) : hm(uint64(desc.width) * desc.depth), width(desc.width), depth(desc.depth)
+	{
+		FastNoiseLite noise = CreateNoise(desc);
+
+		/* FBM and Ridged fractals (with zero weighted strength) have amplitudes that don't depend on the sampled noise,
+		   so the octave loop can be turned inside out: each octave is sampled as a separate single-octave noise 
+		   for the whole row and accumulated into the row with a branchless, vectorizable loop. */
+		bool const octave_major = desc.fractal_type == FractalType::FBM || desc.fractal_type == FractalType::Ridged;
+		std::vector<FastNoiseLite> octave_noises;
+		std::vector<float> octave_amplitudes;
+		if (octave_major)
 		{
-			hm[z].resize(desc.width);
-			for (uint32 x = 0; x < desc.width; x++)
+			float amp = desc.persistence;
+			float amp_fractal = 1.0f;
+			for (int32 i = 1; i < desc.octaves; i++)
 			{
-				float xf = x * desc.noise_scale / desc.width;
-				float zf = z * desc.noise_scale / desc.depth;
-
-				float height = noise.GetNoise(xf, zf) * desc.max_height;
-				if (height > max_height_achieved) max_height_achieved = height;
-				if (height < min_height_achieved) min_height_achieved = height;
-				hm[z][x] = height;
+				amp_fractal += amp;
+				amp *= desc.persistence;
 			}
+			float octave_amplitude = 1.0f / amp_fractal;
+			float octave_frequency = desc.frequency;
+			for (int32 i = 0; i < desc.octaves; i++)
+			{
+				FastNoiseLite& octave_noise = octave_noises.emplace_back();
+				octave_noise.SetFractalType(FastNoiseLite::FractalType_None);
+				octave_noise.SetNoiseType(GetNoiseType(desc.noise_type));
+				octave_noise.SetSeed(desc.seed + i);
+				octave_noise.SetFrequency(octave_frequency);
+				octave_amplitudes.push_back(octave_amplitude);
+
+				octave_frequency *= desc.lacunarity;
+				octave_amplitude *= desc.persistence;
+			}
+		}
+
+		std::vector<uint32> rows(depth);
+		std::iota(std::begin(rows), std::end(rows), 0);
+		std::vector<std::pair<float, float>> row_min_max(depth);
+		std::for_each(std::execution::par, std::begin(rows), std::end(rows), [&](uint32 z)
+			{
+				float* row = hm.data() + uint64(z) * width;
+				float const zf = z * desc.noise_scale / desc.depth;
+				if (octave_major)
+				{
+					std::vector<float> octave_row(width);
+					std::fill_n(row, width, 0.0f);
+					for (size_t i = 0; i < octave_noises.size(); ++i)
+					{
+						FastNoiseLite octave_noise = octave_noises[i];
+						for (uint32 x = 0; x < width; x++)
+						{
+							float xf = x * desc.noise_scale / desc.width;
+							octave_row[x] = octave_noise.GetNoise(xf, zf);
+						}
+						float const amp = octave_amplitudes[i];
+						if (desc.fractal_type == FractalType::Ridged)
+						{
+							for (uint32 x = 0; x < width; x++) row[x] += (1.0f - 2.0f * std::abs(octave_row[x])) * amp;
+						}
+						else
+						{
+							for (uint32 x = 0; x < width; x++) row[x] += octave_row[x] * amp;
+						}
+					}
+				}
+				else
+				{
+					FastNoiseLite row_noise = noise;
+					for (uint32 x = 0; x < width; x++)
+					{
+						float xf = x * desc.noise_scale / desc.width;
+						row[x] = row_noise.GetNoise(xf, zf);
+					}
+				}
+
+				float const max_height = (float)desc.max_height;
+				float row_min = std::numeric_limits<float>::max();
+				float row_max = std::numeric_limits<float>::lowest();
+				for (uint32 x = 0; x < width; x++)
+				{
+					row[x] *= max_height;
+					row_min = std::min(row_min, row[x]);
+					row_max = std::max(row_max, row[x]);
+				}
+				row_min_max[z] = { row_min, row_max };
+			});
+
+		float min_height_achieved = std::numeric_limits<float>::max();
+		float max_height_achieved = std::numeric_limits<float>::lowest();
+		for (auto [row_min, row_max] : row_min_max)
+		{
+			min_height_achieved = std::min(min_height_achieved, row_min);
+			max_height_achieved = std::max(max_height_achieved, row_max);
 		}
 
 		auto scale = [=](float h) -> float
@@ -84,14 +175,7 @@ namespace adria
 			return (h - min_height_achieved) / (max_height_achieved - min_height_achieved)
 				* 2 * desc.max_height - desc.max_height;
 		};
-
-		for (uint32 z = 0; z < desc.depth; z++)
-		{
-			for (uint32 x = 0; x < desc.width; x++)
-			{
-				hm[z][x] = scale(hm[z][x]);
-			}
-		}
+		std::transform(std::execution::par_unseq, std::begin(hm), std::end(hm), std::begin(hm), scale);
 	}
 	Heightmap::Heightmap(std::string_view heightmap_path, uint32 max_height)
 	{
@@ -99,27 +183,34 @@ namespace adria
 
 		uint8 const* image_data = img.Data<uint8>();
 
-		hm.resize(img.Height());
-		for (uint64 z = 0; z < img.Height(); ++z)
+		width = img.Width();
+		depth = img.Height();
+		hm.resize(width * depth);
+		for (uint64 z = 0; z < depth; ++z)
 		{
-			hm[z].resize(img.Width());
-			for (uint64 x = 0; x < img.Width(); ++x)
+			for (uint64 x = 0; x < width; ++x)
 			{
-				hm[z][x] = image_data[z * img.Width() + x] / 255.0f * max_height;
+				At(x, z) = image_data[z * width + x] / 255.0f * max_height;
 			}
 		}
 	}
+	Heightmap::Heightmap(uint64 width, uint64 depth, float const* heights) : hm(heights, heights + width * depth), width(width), depth(depth)
+	{}
 	float Heightmap::HeightAt(uint64 x, uint64 z) const
 	{
-		return hm[z][x];
+		return At(x, z);
 	}
 	uint64 Heightmap::Width() const
 	{
-		return hm[0].size();
+		return width;
 	}
 	uint64 Heightmap::Depth() const
 	{
-		return hm.size();
+		return depth;
+	}
+	float const* Heightmap::Data() const
+	{
+		return hm.data();
 	}
 
 	void Heightmap::ApplyThermalErosion(ThermalErosionDesc const& desc)
@@ -129,11 +220,11 @@ namespace adria
 		float talus = desc.talus;//4.0f / resolution
 		float c = desc.c; //0.5f;					
 
-		for (size_t k = 0; k < desc.iterations; k++)
+		for (int32 k = 0; k < desc.iterations; k++)
 		{
-			for (size_t j = 0; j < hm.size(); j++)
+			for (size_t j = 0; j < depth; j++)
 			{
-				for (size_t i = 0; i < hm[j].size(); i++)
+				for (size_t i = 0; i < width; i++)
 				{
 
 					float max_diff = 0.0f;
@@ -148,43 +239,43 @@ namespace adria
 					d7 = 0.0f;
 					d8 = 0.0f;
 
-					v2 = hm[j][i];
+					v2 = At(i, j);
 
 					if (i == 0 && j == 0)
 					{
-						v3 = hm[j][i + 1l];
-						v5 = hm[j + 1l][i];
-						v6 = hm[j + 1l][i + 1l];
+						v3 = At(i + 1l, j);
+						v5 = At(i, j + 1l);
+						v6 = At(i + 1l, j + 1l);
 
 						d2 = v2 - v3;
 						d4 = v2 - v5;
 						d5 = v2 - v6;
 					}
-					else if (i == hm[j].size() - 1 && j == hm.size() - 1)
+					else if (i == width - 1 && j == depth - 1)
 					{
-						v1 = hm[j][i - 1l];
-						v7 = hm[j - 1l][i - 1l];
-						v8 = hm[j - 1l][i];
+						v1 = At(i - 1l, j);
+						v7 = At(i - 1l, j - 1l);
+						v8 = At(i, j - 1l);
 
 						d1 = v2 - v1;
 						d6 = v2 - v7;
 						d7 = v2 - v8;
 					}
-					else if (i == 0 && j == hm.size() - 1)
+					else if (i == 0 && j == depth - 1)
 					{
-						v3 = hm[j][i + 1l];
-						v8 = hm[j - 1l][i];
-						v9 = hm[j - 1l][i + 1l];
+						v3 = At(i + 1l, j);
+						v8 = At(i, j - 1l);
+						v9 = At(i + 1l, j - 1l);
 
 						d2 = v2 - v3;
 						d7 = v2 - v8;
 						d8 = v2 - v9;
 					}
-					else if (i == hm[j].size() - 1 && j == 0)
+					else if (i == width - 1 && j == 0)
 					{
-						v1 = hm[j][i - 1l];
-						v4 = hm[j + 1l][i - 1l];
-						v5 = hm[j + 1l][i];
+						v1 = At(i - 1l, j);
+						v4 = At(i - 1l, j + 1l);
+						v5 = At(i, j + 1l);
 
 						d1 = v2 - v1;
 						d3 = v2 - v4;
@@ -192,11 +283,11 @@ namespace adria
 					}
 					else if (j == 0)
 					{
-						v1 = hm[j][i - 1l];
-						v3 = hm[j][i + 1l];
-						v4 = hm[j + 1l][i - 1l];
-						v5 = hm[j + 1l][i];
-						v6 = hm[j + 1l][i + 1l];
+						v1 = At(i - 1l, j);
+						v3 = At(i + 1l, j);
+						v4 = At(i - 1l, j + 1l);
+						v5 = At(i, j + 1l);
+						v6 = At(i + 1l, j + 1l);
 
 						d1 = v2 - v1;
 						d2 = v2 - v3;
@@ -204,13 +295,13 @@ namespace adria
 						d4 = v2 - v5;
 						d5 = v2 - v6;
 					}
-					else if (j == hm.size() - 1)
+					else if (j == depth - 1)
 					{
-						v1 = hm[j][i - 1l];
-						v3 = hm[j][i + 1l];
-						v7 = hm[j - 1l][i - 1l];
-						v8 = hm[j - 1l][i];
-						v9 = hm[j - 1l][i + 1l];
+						v1 = At(i - 1l, j);
+						v3 = At(i + 1l, j);
+						v7 = At(i - 1l, j - 1l);
+						v8 = At(i, j - 1l);
+						v9 = At(i + 1l, j - 1l);
 
 						d1 = v2 - v1;
 						d2 = v2 - v3;
@@ -220,11 +311,11 @@ namespace adria
 					}
 					else if (i == 0)
 					{
-						v3 = hm[j][i + 1l];
-						v5 = hm[j + 1l][i];
-						v6 = hm[j + 1l][i + 1l];
-						v8 = hm[j - 1l][i];
-						v9 = hm[j - 1l][i + 1l];
+						v3 = At(i + 1l, j);
+						v5 = At(i, j + 1l);
+						v6 = At(i + 1l, j + 1l);
+						v8 = At(i, j - 1l);
+						v9 = At(i + 1l, j - 1l);
 
 						d2 = v2 - v3;
 						d4 = v2 - v5;
@@ -232,13 +323,13 @@ namespace adria
 						d7 = v2 - v8;
 						d8 = v2 - v9;
 					}
-					else if (i == hm[j].size() - 1)
+					else if (i == width - 1)
 					{
-						v1 = hm[j][i - 1l];
-						v4 = hm[j + 1l][i - 1l];
-						v5 = hm[j + 1l][i];
-						v7 = hm[j - 1l][i - 1l];
-						v8 = hm[j - 1l][i];
+						v1 = At(i - 1l, j);
+						v4 = At(i - 1l, j + 1l);
+						v5 = At(i, j + 1l);
+						v7 = At(i - 1l, j - 1l);
+						v8 = At(i, j - 1l);
 
 						d1 = v2 - v1;
 						d3 = v2 - v4;
@@ -248,14 +339,14 @@ namespace adria
 					}
 					else
 					{
-						v1 = hm[j][i - 1l];
-						v3 = hm[j][i + 1l];
-						v4 = hm[j + 1l][i - 1l];
-						v5 = hm[j + 1l][i];
-						v6 = hm[j + 1l][i + 1l];
-						v7 = hm[j - 1l][i - 1l];
-						v8 = hm[j - 1l][i];
-						v9 = hm[j - 1l][i + 1l];
+						v1 = At(i - 1l, j);
+						v3 = At(i + 1l, j);
+						v4 = At(i - 1l, j + 1l);
+						v5 = At(i, j + 1l);
+						v6 = At(i + 1l, j + 1l);
+						v7 = At(i - 1l, j - 1l);
+						v8 = At(i, j - 1l);
+						v9 = At(i + 1l, j - 1l);
 
 						d1 = v2 - v1;
 						d2 = v2 - v3;
@@ -279,223 +370,316 @@ namespace adria
 
 					if (i == 0 && j == 0)
 					{
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
-						hm[j + 1l][i + 1l] += DepositSediment(c, max_diff, talus, d5, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i + 1l, j + 1l) += DepositSediment(c, max_diff, talus, d5, total_diff);
 					}
-					else if (i == hm[j].size() - 1 && j == hm.size() - 1)
+					else if (i == width - 1 && j == depth - 1)
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j - 1l][i - 1l] += DepositSediment(c, max_diff, talus, d6, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i - 1l, j - 1l) += DepositSediment(c, max_diff, talus, d6, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
 					}
-					else if (i == 0 && j == hm.size() - 1)
+					else if (i == 0 && j == depth - 1)
 					{
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
-						hm[j - 1l][i + 1l] += DepositSediment(c, max_diff, talus, d8, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i + 1l, j - 1l) += DepositSediment(c, max_diff, talus, d8, total_diff);
 					}
-					else if (i == hm[j].size() - 1 && j == 0)
+					else if (i == width - 1 && j == 0)
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j + 1l][i - 1l] += DepositSediment(c, max_diff, talus, d3, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i - 1l, j + 1l) += DepositSediment(c, max_diff, talus, d3, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
 					}
 					else if (j == 0)
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j + 1l][i - 1l] += DepositSediment(c, max_diff, talus, d3, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
-						hm[j + 1l][i + 1l] += DepositSediment(c, max_diff, talus, d5, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i - 1l, j + 1l) += DepositSediment(c, max_diff, talus, d3, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i + 1l, j + 1l) += DepositSediment(c, max_diff, talus, d5, total_diff);
 					}
-					else if (j == hm.size() - 1)
+					else if (j == depth - 1)
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j - 1l][i - 1l] += DepositSediment(c, max_diff, talus, d6, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
-						hm[j - 1l][i + 1l] += DepositSediment(c, max_diff, talus, d8, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i - 1l, j - 1l) += DepositSediment(c, max_diff, talus, d6, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i + 1l, j - 1l) += DepositSediment(c, max_diff, talus, d8, total_diff);
 					}
 					else if (i == 0)
 					{
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
-						hm[j + 1l][i + 1l] += DepositSediment(c, max_diff, talus, d5, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
-						hm[j - 1l][i + 1l] += DepositSediment(c, max_diff, talus, d8, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i + 1l, j + 1l) += DepositSediment(c, max_diff, talus, d5, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i + 1l, j - 1l) += DepositSediment(c, max_diff, talus, d8, total_diff);
 					}
-					else if (i == hm[j].size() - 1)
+					else if (i == width - 1)
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j + 1l][i - 1l] += DepositSediment(c, max_diff, talus, d3, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
-						hm[j - 1l][i - 1l] += DepositSediment(c, max_diff, talus, d6, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i - 1l, j + 1l) += DepositSediment(c, max_diff, talus, d3, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i - 1l, j - 1l) += DepositSediment(c, max_diff, talus, d6, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
 					}
 					else
 					{
-						hm[j][i - 1l] += DepositSediment(c, max_diff, talus, d1, total_diff);
-						hm[j][i + 1l] += DepositSediment(c, max_diff, talus, d2, total_diff);
-						hm[j + 1l][i - 1l] += DepositSediment(c, max_diff, talus, d3, total_diff);
-						hm[j + 1l][i] += DepositSediment(c, max_diff, talus, d4, total_diff);
-						hm[j + 1l][i + 1l] += DepositSediment(c, max_diff, talus, d5, total_diff);
-						hm[j - 1l][i - 1l] += DepositSediment(c, max_diff, talus, d6, total_diff);
-						hm[j - 1l][i] += DepositSediment(c, max_diff, talus, d7, total_diff);
-						hm[j - 1l][i + 1l] += DepositSediment(c, max_diff, talus, d8, total_diff);
+						At(i - 1l, j) += DepositSediment(c, max_diff, talus, d1, total_diff);
+						At(i + 1l, j) += DepositSediment(c, max_diff, talus, d2, total_diff);
+						At(i - 1l, j + 1l) += DepositSediment(c, max_diff, talus, d3, total_diff);
+						At(i, j + 1l) += DepositSediment(c, max_diff, talus, d4, total_diff);
+						At(i + 1l, j + 1l) += DepositSediment(c, max_diff, talus, d5, total_diff);
+						At(i - 1l, j - 1l) += DepositSediment(c, max_diff, talus, d6, total_diff);
+						At(i, j - 1l) += DepositSediment(c, max_diff, talus, d7, total_diff);
+						At(i + 1l, j - 1l) += DepositSediment(c, max_diff, talus, d8, total_diff);
 					}
 				}
 			}
 		}
 	}
 	void Heightmap::ApplyHydraulicErosion(HydraulicErosionDesc const& desc)
+	{
+		if (desc.parallel) ApplyHydraulicErosionTiled(desc);
+		else ApplyHydraulicErosionSerial(desc);
+	}
+
+	void Heightmap::ApplyHydraulicErosionSerial(HydraulicErosionDesc const& desc)
 	{
 		uint64 drops = (uint64)desc.drops;
 
 		uint64 xresolution = Width();
 		uint64 yresolution = Depth();
 
-		IntRandomGenerator<uint64> x_random(0, xresolution - 1);
-		IntRandomGenerator<uint64> y_random(0, yresolution - 1);
-
+		CounterRandomGenerator random(desc.seed, 0);
 		for (uint64 drop = 0; drop < drops; drop++)
 		{
 			// Get random coordinates to drop the water droplet at
-			uint64 X = x_random();
-			uint64 Y = y_random();
+			uint64 X = random.NextInRange(0, xresolution - 1);
+			uint64 Y = random.NextInRange(0, yresolution - 1);
+			SimulateDrop(X, Y, desc);
+		}
+	}
 
-			float carryingAmount = 0.0f;
-			float minSlope = 1.15f;
+	/* Drops are batched per tile and tiles are split in 4 colors (2x2 pattern). Tiles of the same color
+	   are one full tile apart, and a drop can't travel further than desc.iterations cells from its tile,
+	   so all tiles of one color can be eroded concurrently without any synchronization. Every tile owns
+	   its own counter-based random stream, which makes the result independent of the thread count. */
+	void Heightmap::ApplyHydraulicErosionTiled(HydraulicErosionDesc const& desc)
+	{
+		uint64 const xresolution = Width();
+		uint64 const yresolution = Depth();
+		uint64 const min_tile_size = 2ull * (desc.iterations + 1) + 1;
+		uint64 const tile_size = std::max<uint64>(desc.tile_size, min_tile_size);
+
+		uint64 const tile_count_x = (xresolution + tile_size - 1) / tile_size;
+		uint64 const tile_count_y = (yresolution + tile_size - 1) / tile_size;
+		if (tile_count_x < 2 && tile_count_y < 2)
+		{
+			ApplyHydraulicErosionSerial(desc);
+			return;
+		}
 
-			if (hm[Y][X] > 0.0f)
+		struct ErosionTile
+		{
+			uint64 x_begin, x_end;
+			uint64 y_begin, y_end;
+			uint64 drops;
+			uint64 stream;
+		};
+		std::array<std::vector<ErosionTile>, 4> colored_tiles{};
+
+		uint64 const total_cells = xresolution * yresolution;
+		uint64 const total_drops = (uint64)desc.drops;
+		uint64 assigned_drops = 0;
+		for (uint64 ty = 0; ty < tile_count_y; ++ty)
+		{
+			for (uint64 tx = 0; tx < tile_count_x; ++tx)
+			{
+				ErosionTile tile{};
+				tile.x_begin = tx * tile_size;
+				tile.x_end = std::min(tile.x_begin + tile_size, xresolution);
+				tile.y_begin = ty * tile_size;
+				tile.y_end = std::min(tile.y_begin + tile_size, yresolution);
+				tile.stream = ty * tile_count_x + tx;
+
+				uint64 const tile_cells = (tile.x_end - tile.x_begin) * (tile.y_end - tile.y_begin);
+				tile.drops = total_drops * tile_cells / total_cells;
+				assigned_drops += tile.drops;
+
+				colored_tiles[(ty & 1) * 2 + (tx & 1)].push_back(tile);
+			}
+		}
+		//distribute the rounding remainder deterministically
+		for (uint64 i = 0; assigned_drops < total_drops; ++i, ++assigned_drops)
+		{
+			colored_tiles[0][i % colored_tiles[0].size()].drops++;
+		}
+
+		auto ErodeTile = [this, &desc](ErosionTile const& tile)
+		{
+			CounterRandomGenerator random(desc.seed, tile.stream);
+			for (uint64 drop = 0; drop < tile.drops; ++drop)
+			{
+				uint64 X = random.NextInRange(tile.x_begin, tile.x_end - 1);
+				uint64 Y = random.NextInRange(tile.y_begin, tile.y_end - 1);
+				SimulateDrop(X, Y, desc);
+			}
+		};
+		for (auto& tiles : colored_tiles)
+		{
+			if (desc.thread_count == 0)
 			{
-				for (int32 iter = 0; iter < desc.iterations; iter++)
+				std::for_each(std::execution::par, std::begin(tiles), std::end(tiles), ErodeTile);
+				continue;
+			}
+			//every worker erodes every thread_count-th tile of the color in turn
+			std::vector<uint64> workers(std::min<uint64>(desc.thread_count, tiles.size()));
+			std::iota(std::begin(workers), std::end(workers), 0);
+			std::for_each(std::execution::par, std::begin(workers), std::end(workers), [&](uint64 worker)
 				{
-					float val = hm[Y][X];
-					float left = 1000.0f;
-					float right = 1000.0f;
-					float up = 1000.0f;
-					float down = 1000.0f;
+					for (uint64 i = worker; i < tiles.size(); i += workers.size()) ErodeTile(tiles[i]);
+				});
+		}
+	}
 
-					if (X == 0 && Y == 0)
-					{
-						right = hm[Y][X + 1];
-						up = hm[Y + 1][X];
-					}
-					else if (X == xresolution - 1 && Y == yresolution - 1)
-					{
-						left = hm[Y][X - 1];
-						down = hm[Y - 1][X];
-					}
-					else if (X == 0 && Y == yresolution - 1)
-					{
-						down = hm[Y - 1][X];
-						right = hm[Y][X + 1];
-					}
-					else if (X == xresolution - 1 && Y == 0)
-					{
-						left = hm[Y][X - 1];
-						up = hm[Y + 1][X];
-					}
-					else if (Y == 0)
-					{
-						left = hm[Y][X - 1];
-						right = hm[Y][X + 1];
-						up = hm[Y + 1][X];
-					}
-					else if (Y == yresolution - 1)
-					{
-						left = hm[Y][X - 1];
-						right = hm[Y][X + 1];
-						down = hm[Y - 1][X];
-					}
-					else if (X == 0)
-					{
-						right = hm[Y][X + 1];
-						up = hm[Y + 1][X];
-						down = hm[Y - 1][X];
-					}
-					else if (X == xresolution - 1)
-					{
-						left = hm[Y][X - 1];
-						up = hm[Y + 1][X];
-						down = hm[Y - 1][X];
-					}
-					else
-					{
-						left = hm[Y][X - 1];
-						right = hm[Y][X + 1];
-						up = hm[Y + 1][X];
-						down = hm[Y - 1][X];
-					}
+	void Heightmap::SimulateDrop(uint64 X, uint64 Y, HydraulicErosionDesc const& desc)
+	{
+		uint64 const xresolution = Width();
+		uint64 const yresolution = Depth();
 
-					enum MIN_INDEX
-					{
-						CENTER = -1, LEFT, RIGHT, UP, DOWN
-					};
-					
-					float minHeight = val;
-					int32 minIndex = CENTER;
+		float carryingAmount = 0.0f;
+		float minSlope = 1.15f;
 
-					if (left < minHeight)
-					{
-						minHeight = left;
-						minIndex = LEFT;
-					}
-					if (right < minHeight)
-					{
-						minHeight = right;
-						minIndex = RIGHT;
-					}
-					if (up < minHeight)
-					{
-						minHeight = up;
-						minIndex = UP;
-					}
-					if (down < minHeight)
+		if (At(X, Y) > 0.0f)
+		{
+			for (int32 iter = 0; iter < desc.iterations; iter++)
+			{
+				float val = At(X, Y);
+				float left = 1000.0f;
+				float right = 1000.0f;
+				float up = 1000.0f;
+				float down = 1000.0f;
+
+				if (X == 0 && Y == 0)
+				{
+					right = At(X + 1, Y);
+					up = At(X, Y + 1);
+				}
+				else if (X == xresolution - 1 && Y == yresolution - 1)
+				{
+					left = At(X - 1, Y);
+					down = At(X, Y - 1);
+				}
+				else if (X == 0 && Y == yresolution - 1)
+				{
+					down = At(X, Y - 1);
+					right = At(X + 1, Y);
+				}
+				else if (X == xresolution - 1 && Y == 0)
+				{
+					left = At(X - 1, Y);
+					up = At(X, Y + 1);
+				}
+				else if (Y == 0)
+				{
+					left = At(X - 1, Y);
+					right = At(X + 1, Y);
+					up = At(X, Y + 1);
+				}
+				else if (Y == yresolution - 1)
+				{
+					left = At(X - 1, Y);
+					right = At(X + 1, Y);
+					down = At(X, Y - 1);
+				}
+				else if (X == 0)
+				{
+					right = At(X + 1, Y);
+					up = At(X, Y + 1);
+					down = At(X, Y - 1);
+				}
+				else if (X == xresolution - 1)
+				{
+					left = At(X - 1, Y);
+					up = At(X, Y + 1);
+					down = At(X, Y - 1);
+				}
+				else
+				{
+					left = At(X - 1, Y);
+					right = At(X + 1, Y);
+					up = At(X, Y + 1);
+					down = At(X, Y - 1);
+				}
+
+				enum MIN_INDEX
+				{
+					CENTER = -1, LEFT, RIGHT, UP, DOWN
+				};
+				
+				float minHeight = val;
+				int32 minIndex = CENTER;
+
+				if (left < minHeight)
+				{
+					minHeight = left;
+					minIndex = LEFT;
+				}
+				if (right < minHeight)
+				{
+					minHeight = right;
+					minIndex = RIGHT;
+				}
+				if (up < minHeight)
+				{
+					minHeight = up;
+					minIndex = UP;
+				}
+				if (down < minHeight)
+				{
+					minHeight = down;
+					minIndex = DOWN;
+				}
+				if (minHeight < val) 
+				{
+					float slope = std::min(minSlope, (val - minHeight));
+					float valueToSteal = desc.deposition_speed * slope;
+
+					if (carryingAmount > desc.carrying_capacity)
 					{
-						minHeight = down;
-						minIndex = DOWN;
+						carryingAmount -= valueToSteal;
+						At(X, Y) += valueToSteal;
 					}
-					if (minHeight < val) 
+					else 
 					{
-						float slope = std::min(minSlope, (val - minHeight));
-						float valueToSteal = desc.deposition_speed * slope;
-
-						if (carryingAmount > desc.carrying_capacity)
+						if (carryingAmount + valueToSteal > desc.carrying_capacity)
 						{
-							carryingAmount -= valueToSteal;
-							hm[Y][X] += valueToSteal;
+							float delta = carryingAmount + valueToSteal - desc.carrying_capacity;
+							carryingAmount += delta;
+							At(X, Y) -= delta;
 						}
-						else 
+						else
 						{
-							if (carryingAmount + valueToSteal > desc.carrying_capacity)
-							{
-								float delta = carryingAmount + valueToSteal - desc.carrying_capacity;
-								carryingAmount += delta;
-								hm[Y][X] -= delta;
-							}
-							else
-							{
-								carryingAmount += valueToSteal;
-								hm[Y][X] -= valueToSteal;
-							}
+							carryingAmount += valueToSteal;
+							At(X, Y) -= valueToSteal;
 						}
-
-						if (minIndex == LEFT) X -= 1;
-						else if (minIndex == RIGHT) X += 1;
-						else if (minIndex == UP) Y += 1;
-						else if (minIndex == DOWN) Y -= 1;
-
-						if (X > xresolution - 1) X = xresolution - 1;
-						if (Y > yresolution - 1) Y = yresolution - 1;
-						if (Y < 0) Y = 0;
-						if (X < 0) X = 0;
 					}
 
+					if (minIndex == LEFT) X -= 1;
+					else if (minIndex == RIGHT) X += 1;
+					else if (minIndex == UP) Y += 1;
+					else if (minIndex == DOWN) Y -= 1;
+
+					if (X > xresolution - 1) X = xresolution - 1;
+					if (Y > yresolution - 1) Y = yresolution - 1;
+					if (Y < 0) Y = 0;
+					if (X < 0) X = 0;
 				}
 
 			}
+
 		}
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string_view>
+#include <functional>
 
 namespace adria
 {
@@ -36,6 +37,10 @@ namespace adria
 	};
 
 
+	/* Evaluates the noise described by desc at heightmap sample (x, z) without building a heightmap.
+	   Heights are in [-max_height, max_height] but not normalized over the whole map like Heightmap(NoiseDesc) does. */
+	std::function<float(uint64 x, uint64 z)> CreateNoiseHeightSource(NoiseDesc const& desc);
+
 	struct ThermalErosionDesc
 	{
 		int32 iterations;
@@ -50,6 +55,10 @@ namespace adria
 		int32 drops;
 		float carrying_capacity;
 		float deposition_speed;
+		uint32 seed = 1337;
+		bool parallel = true;
+		uint32 tile_size = 128; //used only in parallel mode, clamped so that same-colored tiles never share cells
+		uint32 thread_count = 0; //used only in parallel mode, at most that many tiles are eroded at once, 0 leaves it to std::execution::par
 	};
 
 	class Heightmap
@@ -58,16 +67,28 @@ namespace adria
 		
 		explicit Heightmap(NoiseDesc const& desc);
 		Heightmap(std::string_view heightmap_path, uint32 max_height);
+		Heightmap(uint64 width, uint64 depth, float const* heights);
 
 		float HeightAt(uint64 x, uint64 z) const;
 		uint64 Width() const;
 		uint64 Depth() const;
+		float const* Data() const;
 
 		void ApplyThermalErosion(ThermalErosionDesc const& desc);
 		void ApplyHydraulicErosion(HydraulicErosionDesc const& desc);
 
 	private:
-		std::vector<std::vector<float>> hm;
+		std::vector<float> hm;
+		uint64 width = 0;
+		uint64 depth = 0;
+
+	private:
+		float& At(uint64 x, uint64 z) { return hm[z * width + x]; }
+		float At(uint64 x, uint64 z) const { return hm[z * width + x]; }
+
+		void ApplyHydraulicErosionSerial(HydraulicErosionDesc const& desc);
+		void ApplyHydraulicErosionTiled(HydraulicErosionDesc const& desc);
+		void SimulateDrop(uint64 x, uint64 y, HydraulicErosionDesc const& desc);
 	};
 }
 
@@ -0,0 +1,147 @@
+#include <cstring>
+#include "HeightmapCache.h"
+#include "MemoryMappedFile.h"
+#include "FilesUtil.h"
+#include "HashUtil.h"
+#include "Timer.h"
+#include "Logging/Logger.h"
+
+namespace adria
+{
+	namespace
+	{
+		inline static char const* heightmap_cache_directory = "Resources/HeightmapCache/";
+		static constexpr uint32 HEIGHTMAP_CACHE_MAGIC = 0x50414d48; //"HMAP"
+		static constexpr uint32 HEIGHTMAP_CACHE_VERSION = 1;
+
+		struct HeightmapCacheHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint64 key;
+			uint64 width;
+			uint64 depth;
+		};
+
+		class KeyBuilder
+		{
+		public:
+			template<typename T> requires std::is_trivially_copyable_v<T>
+			KeyBuilder& Add(T const& v)
+			{
+				char const* bytes = reinterpret_cast<char const*>(&v);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+				return *this;
+			}
+			uint64 Hash() const { return crc64(data.data(), data.size()); }
+		private:
+			std::vector<char> data;
+		};
+	}
+
+	namespace HeightmapCache
+	{
+		uint64 ComputeKey(NoiseDesc const& noise_desc, ThermalErosionDesc const* thermal_desc, HydraulicErosionDesc const* hydraulic_desc)
+		{
+			KeyBuilder key{};
+			key.Add(HEIGHTMAP_CACHE_VERSION)
+			   .Add(noise_desc.width).Add(noise_desc.depth).Add(noise_desc.max_height)
+			   .Add(noise_desc.fractal_type).Add(noise_desc.noise_type).Add(noise_desc.seed)
+			   .Add(noise_desc.frequency).Add(noise_desc.persistence).Add(noise_desc.lacunarity)
+			   .Add(noise_desc.octaves).Add(noise_desc.noise_scale);
+
+			key.Add(thermal_desc != nullptr);
+			if (thermal_desc)
+			{
+				key.Add(thermal_desc->iterations).Add(thermal_desc->c).Add(thermal_desc->talus);
+			}
+			key.Add(hydraulic_desc != nullptr);
+			if (hydraulic_desc)
+			{
+				key.Add(hydraulic_desc->iterations).Add(hydraulic_desc->drops)
+				   .Add(hydraulic_desc->carrying_capacity).Add(hydraulic_desc->deposition_speed)
+				   .Add(hydraulic_desc->seed).Add(hydraulic_desc->parallel);
+				if (hydraulic_desc->parallel) key.Add(hydraulic_desc->tile_size);
+			}
+			return key.Hash();
+		}
+
+		std::string GetCachePath(uint64 key, char const* extension)
+		{
+			char cache_path[256];
+			sprintf_s(cache_path, "%s%016llx%s", heightmap_cache_directory, (unsigned long long)key, extension);
+			return cache_path;
+		}
+
+		std::unique_ptr<Heightmap> LoadFromCache(std::string const& cache_path, uint64 key)
+		{
+			MemoryMappedFile file;
+			if (!file.Open(cache_path)) return nullptr;
+			if (file.Size() < sizeof(HeightmapCacheHeader)) return nullptr;
+
+			HeightmapCacheHeader const* header = file.As<HeightmapCacheHeader>();
+			if (header->magic != HEIGHTMAP_CACHE_MAGIC || header->version != HEIGHTMAP_CACHE_VERSION || header->key != key) return nullptr;
+			if (file.Size() != sizeof(HeightmapCacheHeader) + header->width * header->depth * sizeof(float)) return nullptr;
+
+			return std::make_unique<Heightmap>(header->width, header->depth, file.As<float>(sizeof(HeightmapCacheHeader)));
+		}
+
+		bool SaveToCache(std::string const& cache_path, uint64 key, Heightmap const& heightmap)
+		{
+			std::string const temporary_path = GetTemporaryPath(cache_path);
+			uint64 const heights_size = heightmap.Width() * heightmap.Depth() * sizeof(float);
+			{
+				MemoryMappedFile file;
+				if (!file.Create(temporary_path, sizeof(HeightmapCacheHeader) + heights_size)) return false;
+
+				HeightmapCacheHeader* header = file.As<HeightmapCacheHeader>();
+				header->magic = HEIGHTMAP_CACHE_MAGIC;
+				header->version = HEIGHTMAP_CACHE_VERSION;
+				header->key = key;
+				header->width = heightmap.Width();
+				header->depth = heightmap.Depth();
+				memcpy(file.As<float>(sizeof(HeightmapCacheHeader)), heightmap.Data(), heights_size);
+			}
+
+			std::error_code ec;
+			fs::rename(temporary_path, cache_path, ec);
+			if (ec)
+			{
+				ADRIA_LOG(WARNING, "Failed to write heightmap cache %s: %s", cache_path.c_str(), ec.message().c_str());
+				fs::remove(temporary_path, ec);
+				return false;
+			}
+			return true;
+		}
+
+		std::unique_ptr<Heightmap> GetOrGenerate(NoiseDesc const& noise_desc, ThermalErosionDesc const* thermal_desc, HydraulicErosionDesc const* hydraulic_desc)
+		{
+			Timer t;
+			uint64 const key = ComputeKey(noise_desc, thermal_desc, hydraulic_desc);
+			std::string const cache_path = GetCachePath(key, ".hmap");
+			if (std::unique_ptr<Heightmap> cached = LoadFromCache(cache_path, key))
+			{
+				ADRIA_LOG(INFO, "Heightmap %016llx loaded from cache in %f seconds", (unsigned long long)key, t.ElapsedInSeconds());
+				return cached;
+			}
+
+			std::unique_ptr<Heightmap> heightmap = std::make_unique<Heightmap>(noise_desc);
+			ADRIA_LOG(INFO, "Heightmap generated in %f seconds", t.MarkInSeconds());
+			if (thermal_desc)
+			{
+				heightmap->ApplyThermalErosion(*thermal_desc);
+				ADRIA_LOG(INFO, "Thermal erosion done in %f seconds", t.MarkInSeconds());
+			}
+			if (hydraulic_desc)
+			{
+				heightmap->ApplyHydraulicErosion(*hydraulic_desc);
+				ADRIA_LOG(INFO, "Hydraulic erosion (%s) done in %f seconds", hydraulic_desc->parallel ? "parallel" : "serial", t.MarkInSeconds());
+			}
+
+			std::error_code ec;
+			fs::create_directories(heightmap_cache_directory, ec);
+			SaveToCache(cache_path, key, *heightmap);
+			return heightmap;
+		}
+	}
+}
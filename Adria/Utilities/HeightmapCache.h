@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include "Heightmap.h"
+
+namespace adria
+{
+	/* Content-addressed cache of generated heightmaps. The key is a hash of the noise desc and the
+	   erosion descs that were applied, heights are stored as raw floats and read back through a file mapping. */
+	namespace HeightmapCache
+	{
+		uint64 ComputeKey(NoiseDesc const& noise_desc, ThermalErosionDesc const* thermal_desc, HydraulicErosionDesc const* hydraulic_desc);
+		std::string GetCachePath(uint64 key, char const* extension);
+
+		//null if the file is missing, truncated or was written for another key
+		std::unique_ptr<Heightmap> LoadFromCache(std::string const& cache_path, uint64 key);
+		//written next to cache_path and renamed once complete, so an interrupted write never leaves a file that loads
+		bool SaveToCache(std::string const& cache_path, uint64 key, Heightmap const& heightmap);
+
+		std::unique_ptr<Heightmap> GetOrGenerate(NoiseDesc const& noise_desc, 
+			ThermalErosionDesc const* thermal_desc = nullptr, 
+			HydraulicErosionDesc const* hydraulic_desc = nullptr);
+	}
+}
@@ -0,0 +1,174 @@
+#include "MemoryMappedFile.h"
+#include "Logging/Logger.h"
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace adria
+{
+
+	MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept
+	{
+		if (this == &other) return *this;
+		Close();
+		std::swap(file, other.file);
+#if defined(_WIN32)
+		std::swap(mapping, other.mapping);
+#endif
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+		return *this;
+	}
+
+	MemoryMappedFile::~MemoryMappedFile()
+	{
+		Close();
+	}
+
+#if defined(_WIN32)
+	bool MemoryMappedFile::Open(std::string const& path)
+	{
+		Close();
+		HANDLE file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) return false;
+		file = file_handle;
+
+		LARGE_INTEGER file_size{};
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		size = (uint64)file_size.QuadPart;
+
+		mapping = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			ADRIA_LOG(WARNING, "CreateFileMapping failed for %s", path.c_str());
+			Close();
+			return false;
+		}
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			ADRIA_LOG(WARNING, "MapViewOfFile failed for %s", path.c_str());
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool MemoryMappedFile::Create(std::string const& path, uint64 _size)
+	{
+		Close();
+		if (_size == 0) return false;
+		HANDLE file_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE)
+		{
+			ADRIA_LOG(WARNING, "Failed to create file %s", path.c_str());
+			return false;
+		}
+		file = file_handle;
+		size = _size;
+
+		mapping = CreateFileMappingA(file_handle, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xffffffff), nullptr);
+		if (!mapping)
+		{
+			ADRIA_LOG(WARNING, "CreateFileMapping failed for %s", path.c_str());
+			Close();
+			return false;
+		}
+		data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+		if (!data)
+		{
+			ADRIA_LOG(WARNING, "MapViewOfFile failed for %s", path.c_str());
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MemoryMappedFile::Close()
+	{
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file) CloseHandle(file);
+		data = nullptr;
+		mapping = nullptr;
+		file = nullptr;
+		size = 0;
+	}
+
+#else
+	bool MemoryMappedFile::Open(std::string const& path)
+	{
+		Close();
+		file = open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat file_stat{};
+		if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+		{
+			Close();
+			return false;
+		}
+		size = (uint64)file_stat.st_size;
+
+		data = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+		if (data == MAP_FAILED)
+		{
+			ADRIA_LOG(WARNING, "mmap failed for %s", path.c_str());
+			data = nullptr;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool MemoryMappedFile::Create(std::string const& path, uint64 _size)
+	{
+		Close();
+		if (_size == 0) return false;
+		file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file < 0)
+		{
+			ADRIA_LOG(WARNING, "Failed to create file %s", path.c_str());
+			return false;
+		}
+		size = _size;
+
+		if (ftruncate(file, (off_t)size) != 0)
+		{
+			ADRIA_LOG(WARNING, "Failed to resize file %s", path.c_str());
+			Close();
+			return false;
+		}
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (data == MAP_FAILED)
+		{
+			ADRIA_LOG(WARNING, "mmap failed for %s", path.c_str());
+			data = nullptr;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MemoryMappedFile::Close()
+	{
+		if (data) munmap(data, size);
+		if (file >= 0) close(file);
+		data = nullptr;
+		file = -1;
+		size = 0;
+	}
+#endif
+}
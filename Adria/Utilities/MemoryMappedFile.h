@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include "Core/CoreTypes.h"
+
+namespace adria
+{
+	class MemoryMappedFile
+	{
+	public:
+		MemoryMappedFile() = default;
+		MemoryMappedFile(MemoryMappedFile const&) = delete;
+		MemoryMappedFile(MemoryMappedFile&&) noexcept;
+		MemoryMappedFile& operator=(MemoryMappedFile const&) = delete;
+		MemoryMappedFile& operator=(MemoryMappedFile&&) noexcept;
+		~MemoryMappedFile();
+
+		//maps an existing file for reading
+		bool Open(std::string const& path);
+		//creates (or truncates) a file of the given size and maps it for writing
+		bool Create(std::string const& path, uint64 size);
+		void Close();
+
+		bool IsOpen() const { return data != nullptr; }
+		uint64 Size() const { return size; }
+		void* Data() const { return data; }
+
+		template<typename T>
+		T* As(uint64 offset = 0) const
+		{
+			return reinterpret_cast<T*>(static_cast<uint8*>(data) + offset);
+		}
+
+	private:
+#if defined(_WIN32)
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int file = -1;
+#endif
+		void* data = nullptr;
+		uint64 size = 0;
+	};
+}
@@ -82,4 +82,44 @@ namespace adria
         GeneratorType eng;
         DistributionType dist;
     };
-}
\ No newline at end of file
+
+    //stateless, counter-based generator: the n-th value depends only on (seed, stream, n),
+    //so independent streams can be consumed from any thread in any order with reproducible results
+    class CounterRandomGenerator
+    {
+    public:
+        using ResultType = uint64_t;
+
+    public:
+        CounterRandomGenerator(uint64_t seed, uint64_t stream)
+            : key(Mix(seed ^ Mix(stream + 0x9e3779b97f4a7c15ull))), counter(0) {}
+
+        ResultType operator()() { return Mix(key + (++counter) * 0x9e3779b97f4a7c15ull); }
+
+        //uniform integer in [min, max]
+        ResultType NextInRange(ResultType min, ResultType max)
+        {
+            return min + (*this)() % (max - min + 1);
+        }
+        //uniform float in [min, max)
+        float NextFloat(float min, float max)
+        {
+            return min + (max - min) * (float)(((*this)() >> 40) * (1.0 / 16777216.0));
+        }
+
+        void Seek(uint64_t _counter) { counter = _counter; }
+
+    private:
+        uint64_t key;
+        uint64_t counter;
+
+    private:
+        //SplitMix64 finalizer
+        static constexpr uint64_t Mix(uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+    };
+}
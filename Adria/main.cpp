@@ -7,6 +7,8 @@
 #include "Editor/Editor.h"
 #include "Utilities/MemoryDebugger.h"
 #include "Utilities/CLIParser.h"
+#include "Utilities/StringUtil.h"
+#include "Rendering/TextureManager.h"
 
 using namespace adria;
 
@@ -32,6 +34,7 @@ int APIENTRY wWinMain(
 	CLIArg& loglevel = parser.AddArg(true, "-loglvl", "--loglevel");
 	CLIArg& maximize = parser.AddArg(false, "-max", "--maximize");
 	CLIArg& vsync = parser.AddArg(false, "-vsync");
+	CLIArg& bake_ibl = parser.AddArg(true, "-bakeibl", "--bake-ibl");
 	//MemoryDebugger::SetAllocHook(MemoryAllocHook);
     //MemoryDebugger::SetBreak(275);
 	//MemoryDebugger::Checkpoint();
@@ -42,6 +45,9 @@ int APIENTRY wWinMain(
 		ADRIA_REGISTER_LOGGER(new FileLogger(log_file.c_str(), static_cast<ELogLevel>(log_level)));
 		ADRIA_REGISTER_LOGGER(new OutputDebugStringLogger(static_cast<ELogLevel>(log_level)));
 
+		//bakes the environment map into the ibl cache and exits without creating a window or a device
+		if (bake_ibl.IsPresent()) return g_TextureManager.BakeEnvironmentMap(ToWideString(bake_ibl.AsString())) ? 0 : 1;
+
 		WindowInit window_init{};
 		window_init.instance = hInstance;
 		window_init.width = width.AsIntOr(1080);
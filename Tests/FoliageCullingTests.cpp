@@ -0,0 +1,173 @@
+#include <random>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Rendering/FoliageCulling.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+using namespace DirectX;
+
+namespace
+{
+	//instances spread uniformly over a square of the given size, like the scatter on a flat terrain
+	std::vector<ScatterInstance> RandomInstances(uint64 count, float area_size, uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(0.0f, area_size);
+		std::uniform_real_distribution<float> rotation(0.0f, 6.2831853f);
+		std::vector<ScatterInstance> instances(count);
+		for (ScatterInstance& instance : instances)
+		{
+			instance.position = Vector3(position(rng), 0.0f, position(rng));
+			instance.rotation_y = rotation(rng);
+		}
+		return instances;
+	}
+
+	BoundingBox TestInstanceBounds()
+	{
+		return BoundingBox(Vector3(0.0f, 1.0f, 0.0f), Vector3(0.5f, 1.0f, 0.5f));
+	}
+
+	float DistanceToBox(Vector3 const& p, BoundingBox const& box)
+	{
+		Vector3 const closest = Vector3::Min(Vector3::Max(p, Vector3(box.Center) - Vector3(box.Extents)), Vector3(box.Center) + Vector3(box.Extents));
+		return Vector3::Distance(p, closest);
+	}
+
+	uint64 InstanceKey(ScatterInstance const& instance)
+	{
+		uint32 x, z;
+		memcpy(&x, &instance.position.x, sizeof(uint32));
+		memcpy(&z, &instance.position.z, sizeof(uint32));
+		return (uint64(x) << 32) | z;
+	}
+}
+
+//every instance lands in exactly one cell, inside its bounds
+ADRIA_TEST(FoliageCullingBuildCells)
+{
+	std::vector<ScatterInstance> const instances = RandomInstances(20000, 500.0f, 3);
+	FoliageCellGrid const grid = FoliageCulling::BuildCells(instances, TestInstanceBounds(), 25.0f, 11);
+	ADRIA_CHECK(grid.instances.size() == instances.size());
+
+	uint64 instance_count = 0;
+	for (FoliageCell const& cell : grid.cells)
+	{
+		ADRIA_CHECK(cell.instance_count > 0);
+		ADRIA_CHECK(cell.first_instance == instance_count);
+		instance_count += cell.instance_count;
+		for (uint32 i = cell.first_instance; i < cell.first_instance + cell.instance_count; ++i)
+		{
+			ADRIA_CHECK(cell.bounds.Contains(grid.instances[i].position) != DISJOINT);
+		}
+	}
+	ADRIA_CHECK(instance_count == instances.size());
+
+	std::vector<uint64> expected(instances.size()), binned(grid.instances.size());
+	std::transform(instances.begin(), instances.end(), expected.begin(), InstanceKey);
+	std::transform(grid.instances.begin(), grid.instances.end(), binned.begin(), InstanceKey);
+	std::sort(expected.begin(), expected.end());
+	std::sort(binned.begin(), binned.end());
+	ADRIA_CHECK(expected == binned);
+}
+
+//the compacted instances are the ones a brute force pass over the cells selects, grouped by the level of their cell
+ADRIA_TEST(FoliageCullingMatchesBruteForce)
+{
+	std::vector<ScatterInstance> const instances = RandomInstances(50000, 800.0f, 5);
+	FoliageCellGrid const grid = FoliageCulling::BuildCells(instances, TestInstanceBounds(), 20.0f, 17);
+
+	Vector3 const view_position(100.0f, 10.0f, 150.0f);
+	BoundingFrustum const frustum = test::TestFrustum(view_position, Vector3(500.0f, 0.0f, 600.0f), 1000.0f);
+	FoliageVisibilityTest const is_visible = [&frustum](BoundingBox const& box) { return frustum.Intersects(box); };
+	FoliageLod lod{};
+	lod.density_start = 100.0f;
+	lod.density_end = 400.0f;
+	lod.min_density = 0.2f;
+	lod.cull_distance = 600.0f;
+	std::array<float, 3> const level_distances = { 0.0f, 80.0f, 250.0f };
+
+	std::vector<ScatterInstance> output(grid.instances.size());
+	std::array<uint32, 3> level_counts{};
+	uint32 const instance_count = FoliageCulling::CullAndCompact(grid, is_visible, view_position, lod, level_distances, output, level_counts);
+	ADRIA_CHECK(level_counts[0] + level_counts[1] + level_counts[2] == instance_count);
+	ADRIA_CHECK(level_counts[0] > 0 && level_counts[1] > 0 && level_counts[2] > 0);
+
+	std::array<std::vector<uint64>, 3> expected;
+	for (FoliageCell const& cell : grid.cells)
+	{
+		float const distance = DistanceToBox(view_position, cell.bounds);
+		if (distance > lod.cull_distance || !frustum.Intersects(cell.bounds)) continue;
+		uint32 const count = std::min((uint32)std::ceil(FoliageCulling::CellDensity(lod, distance) * cell.instance_count), cell.instance_count);
+		uint32 const level = distance >= level_distances[2] ? 2 : distance >= level_distances[1] ? 1 : 0;
+		for (uint32 i = 0; i < count; ++i) expected[level].push_back(InstanceKey(grid.instances[cell.first_instance + i]));
+	}
+
+	uint32 first_instance = 0;
+	for (uint32 level = 0; level < 3; ++level)
+	{
+		ADRIA_CHECK(level_counts[level] == expected[level].size());
+		std::vector<uint64> compacted(level_counts[level]);
+		std::transform(output.begin() + first_instance, output.begin() + first_instance + level_counts[level], compacted.begin(), InstanceKey);
+		std::sort(compacted.begin(), compacted.end());
+		std::sort(expected[level].begin(), expected[level].end());
+		ADRIA_CHECK(compacted == expected[level]);
+		first_instance += level_counts[level];
+	}
+
+	//culling is conservative, an instance inside the frustum and in full density range is never dropped
+	std::vector<uint64> drawn(instance_count);
+	std::transform(output.begin(), output.begin() + instance_count, drawn.begin(), InstanceKey);
+	std::sort(drawn.begin(), drawn.end());
+	for (ScatterInstance const& instance : instances)
+	{
+		if (Vector3::Distance(view_position, instance.position) > lod.density_start - grid.cell_size * 1.5f) continue;
+		if (frustum.Contains(instance.position) == DISJOINT) continue;
+		ADRIA_CHECK(std::binary_search(drawn.begin(), drawn.end(), InstanceKey(instance)));
+	}
+}
+
+//without mesh levels everything goes to the first group
+ADRIA_TEST(FoliageCullingSingleLevel)
+{
+	std::vector<ScatterInstance> const instances = RandomInstances(5000, 200.0f, 7);
+	FoliageCellGrid const grid = FoliageCulling::BuildCells(instances, TestInstanceBounds(), 20.0f, 1);
+	FoliageLod lod{};
+	lod.density_start = lod.density_end = lod.cull_distance = 1e6f;
+
+	std::vector<ScatterInstance> output(grid.instances.size());
+	uint32 level_count = 0;
+	uint32 const instance_count = FoliageCulling::CullAndCompact(grid, [](BoundingBox const&) { return true; }, Vector3(0.0f, 0.0f, 0.0f), lod,
+		{}, output, std::span<uint32>(&level_count, 1));
+	ADRIA_CHECK(instance_count == instances.size());
+	ADRIA_CHECK(level_count == instance_count);
+}
+
+ADRIA_BENCHMARK(FoliageCulling2M)
+{
+	//2M instances over 2.8 km, about what the foliage of a large terrain holds
+	std::vector<ScatterInstance> const instances = RandomInstances(2000000, 2800.0f, 9);
+	Timer<std::chrono::milliseconds> timer;
+	FoliageCellGrid const grid = FoliageCulling::BuildCells(instances, TestInstanceBounds(), 48.0f, 23);
+	printf("  2M instances binned into %llu cells in %.3f s\n", (unsigned long long)grid.cells.size(), timer.ElapsedInSeconds());
+
+	FoliageLod const lod{};
+	std::array<float, 4> const level_distances = { 0.0f, 40.0f, 100.0f, 200.0f };
+	std::vector<ScatterInstance> output(grid.instances.size());
+	std::array<uint32, 4> level_counts{};
+
+	uint32 const frame_count = 200;
+	uint64 instance_count = 0;
+	Timer<std::chrono::microseconds> cull_timer;
+	for (uint32 frame = 0; frame < frame_count; ++frame)
+	{
+		float const t = frame / float(frame_count);
+		Vector3 const view_position(200.0f + 2400.0f * t, 20.0f, 300.0f + 2200.0f * t);
+		BoundingFrustum const frustum = test::TestFrustum(view_position, view_position + Vector3(1.0f, -0.1f, 0.8f), 1000.0f);
+		instance_count += FoliageCulling::CullAndCompact(grid, [&frustum](BoundingBox const& box) { return frustum.Intersects(box); },
+			view_position, lod, level_distances, output, level_counts);
+	}
+	printf("  cull and compact: %.3f ms per frame, %.1f instances per frame\n", cull_timer.ElapsedInSeconds() * 1000.0f / frame_count,
+		instance_count / double(frame_count));
+}
@@ -0,0 +1,105 @@
+#include <cstring>
+#include "Test.h"
+#include "Rendering/GridMesh.h"
+#include "Utilities/Heightmap.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	GridMeshDesc TestGridDesc(uint64 tile_count_x, uint64 tile_count_z, uint64 chunk_tiles_x, uint64 chunk_tiles_z)
+	{
+		return GridMeshDesc{ .tile_count_x = tile_count_x, .tile_count_z = tile_count_z, .tile_size_x = 2.0f, .tile_size_z = 0.5f,
+			.texture_scale_x = 4.0f, .texture_scale_z = 2.0f, .chunk_tiles_x = chunk_tiles_x, .chunk_tiles_z = chunk_tiles_z, .offset = Vector3(10.0f, -3.0f, 5.0f) };
+	}
+
+	//heights of a tilted plane, so the differences give the same normal everywhere, at the borders too
+	Heightmap PlaneHeightmap(uint64 width, uint64 depth, float slope_x, float slope_z)
+	{
+		std::vector<float> heights(width * depth);
+		for (uint64 j = 0; j < depth; ++j)
+			for (uint64 i = 0; i < width; ++i) heights[j * width + i] = slope_x * i + slope_z * j;
+		return Heightmap(width, depth, heights.data());
+	}
+}
+
+//chunks tile the grid with what is left at the far borders, each one a copy of its part of the grid in the pool
+ADRIA_TEST(GridMeshChunks)
+{
+	GridMeshDesc const desc = TestGridDesc(10, 7, 4, 3);
+	Heightmap const heightmap = PlaneHeightmap(11, 8, 1.0f, -0.5f);
+	GridMesh const mesh = GridMeshBuilder::Build(desc, &heightmap);
+	ADRIA_CHECK(mesh.vertices.size() == 11 * 8);
+	ADRIA_CHECK(mesh.chunks.size() == 3 * 3);
+
+	//dh/dx = 1 / 2 and dh/dz = -0.5 / 0.5 per world unit
+	Vector3 expected_normal(-0.5f, 1.0f, 1.0f);
+	expected_normal.Normalize();
+	for (uint64 j = 0; j < 8; ++j)
+	{
+		for (uint64 i = 0; i < 11; ++i)
+		{
+			TexturedNormalVertex const& vertex = mesh.vertices[j * 11 + i];
+			ADRIA_CHECK(Vector3::Distance(vertex.position, Vector3(10.0f + 2.0f * i, -3.0f + heightmap.HeightAt(i, j), 5.0f + 0.5f * j)) < 1e-5f);
+			ADRIA_CHECK(Vector3::Distance(vertex.normal, expected_normal) < 1e-5f);
+			ADRIA_CHECK(Vector2::Distance(vertex.uv, Vector2(i * 4.0f / 9.0f, j * 2.0f / 6.0f)) < 1e-5f);
+		}
+	}
+
+	uint64 tiles = 0, first_vertex = 0;
+	for (GridChunk const& chunk : mesh.chunks)
+	{
+		ADRIA_CHECK(chunk.tiles_x == std::min<uint64>(4, 10 - chunk.first_tile_x));
+		ADRIA_CHECK(chunk.tiles_z == std::min<uint64>(3, 7 - chunk.first_tile_z));
+		ADRIA_CHECK(chunk.first_vertex == first_vertex);
+		first_vertex += (chunk.tiles_x + 1) * (chunk.tiles_z + 1);
+		tiles += chunk.tiles_x * chunk.tiles_z;
+
+		for (uint64 k = 0; k <= chunk.tiles_z; ++k)
+		{
+			for (uint64 m = 0; m <= chunk.tiles_x; ++m)
+			{
+				TexturedNormalVertex const& pooled = mesh.ChunkVertices()[chunk.first_vertex + k * (chunk.tiles_x + 1) + m];
+				TexturedNormalVertex const& vertex = mesh.vertices[(chunk.first_tile_z + k) * 11 + chunk.first_tile_x + m];
+				ADRIA_CHECK(memcmp(&pooled, &vertex, sizeof(vertex)) == 0);
+				ADRIA_CHECK(chunk.bounding_box.Contains(vertex.position) != DirectX::DISJOINT);
+			}
+		}
+	}
+	ADRIA_CHECK(tiles == 10 * 7);
+	ADRIA_CHECK(mesh.pooled_vertices.size() == first_vertex);
+
+	//indices stay inside the chunk and cover every tile with two triangles
+	std::vector<uint16> indices;
+	GridMeshBuilder::BuildChunkIndices(4, 3, indices);
+	ADRIA_CHECK(indices.size() == 4 * 3 * 6);
+	ADRIA_CHECK(*std::max_element(indices.begin(), indices.end()) == 5 * 4 - 1);
+}
+
+//a single chunk draws the grid vertices as they are, a flat grid points up
+ADRIA_TEST(GridMeshSingleChunk)
+{
+	GridMesh const mesh = GridMeshBuilder::Build(TestGridDesc(16, 16, 16, 16), nullptr);
+	ADRIA_CHECK(mesh.chunks.size() == 1 && mesh.pooled_vertices.empty());
+	ADRIA_CHECK(&mesh.ChunkVertices() == &mesh.vertices);
+	for (TexturedNormalVertex const& vertex : mesh.vertices)
+	{
+		ADRIA_CHECK(vertex.position.y == -3.0f);
+		ADRIA_CHECK(vertex.normal == Vector3(0.0f, 1.0f, 0.0f));
+	}
+}
+
+ADRIA_BENCHMARK(GridMeshBuild)
+{
+	for (uint64 size : { 1024ull, 4096ull })
+	{
+		NoiseDesc const noise_desc{ .width = (uint32)size + 1, .depth = (uint32)size + 1, .max_height = 200, .fractal_type = FractalType::FBM,
+			.noise_type = NoiseType::Perlin, .seed = 33, .frequency = 0.1f, .persistence = 0.5f, .lacunarity = 2.0f, .octaves = 4, .noise_scale = 16.0f };
+		Heightmap const heightmap(noise_desc);
+		Timer<std::chrono::milliseconds> timer;
+		GridMesh const mesh = GridMeshBuilder::Build(TestGridDesc(size, size, 64, 64), &heightmap);
+		printf("  %llux%llu tiles: %.3f s, %llu chunks, %.1f MB of pooled vertices\n", (unsigned long long)size, (unsigned long long)size, timer.ElapsedInSeconds(),
+			(unsigned long long)mesh.chunks.size(), mesh.pooled_vertices.size() * sizeof(TexturedNormalVertex) / (1024.0 * 1024.0));
+	}
+}
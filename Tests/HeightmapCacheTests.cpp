@@ -0,0 +1,76 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Utilities/HeightmapCache.h"
+#include "Utilities/FilesUtil.h"
+
+using namespace adria;
+
+namespace
+{
+	std::string TestFilePath(char const* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	Heightmap TestHeightmap(uint64 width, uint64 depth)
+	{
+		std::vector<float> heights(width * depth);
+		for (uint64 i = 0; i < heights.size(); ++i) heights[i] = 0.25f * (float)(i % 97) - 3.0f;
+		return Heightmap(width, depth, heights.data());
+	}
+}
+
+ADRIA_TEST(HeightmapCacheRoundTrip)
+{
+	std::string const path = TestFilePath("adria_round_trip.hmap");
+	Heightmap const heightmap = TestHeightmap(37, 21);
+	uint64 const key = 0x0123456789abcdefull;
+	ADRIA_CHECK(HeightmapCache::SaveToCache(path, key, heightmap));
+	ADRIA_CHECK(!std::filesystem::exists(GetTemporaryPath(path)));
+
+	std::unique_ptr<Heightmap> const loaded = HeightmapCache::LoadFromCache(path, key);
+	ADRIA_CHECK(loaded != nullptr);
+	ADRIA_CHECK(loaded->Width() == 37 && loaded->Depth() == 21);
+	ADRIA_CHECK(memcmp(loaded->Data(), heightmap.Data(), 37 * 21 * sizeof(float)) == 0);
+
+	//saving again replaces the entry
+	Heightmap const smaller = TestHeightmap(8, 4);
+	ADRIA_CHECK(HeightmapCache::SaveToCache(path, key, smaller));
+	std::unique_ptr<Heightmap> const reloaded = HeightmapCache::LoadFromCache(path, key);
+	ADRIA_CHECK(reloaded && reloaded->Width() == 8 && reloaded->Depth() == 4);
+
+	std::filesystem::remove(path);
+}
+
+//files written for another key, cut short or never renamed into place don't load
+ADRIA_TEST(HeightmapCacheRejectsMismatches)
+{
+	std::string const path = TestFilePath("adria_mismatch.hmap");
+	uint64 const key = 42;
+	ADRIA_CHECK(HeightmapCache::SaveToCache(path, key, TestHeightmap(16, 16)));
+	ADRIA_CHECK(HeightmapCache::LoadFromCache(path, key + 1) == nullptr);
+
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - sizeof(float));
+	ADRIA_CHECK(HeightmapCache::LoadFromCache(path, key) == nullptr);
+	std::filesystem::resize_file(path, 8);
+	ADRIA_CHECK(HeightmapCache::LoadFromCache(path, key) == nullptr);
+	std::filesystem::remove(path);
+
+	//what an interrupted save leaves behind
+	std::ofstream(GetTemporaryPath(path), std::ios::binary) << "partial";
+	ADRIA_CHECK(HeightmapCache::LoadFromCache(path, key) == nullptr);
+	std::filesystem::remove(GetTemporaryPath(path));
+
+	//keys follow every parameter that changes the heights
+	NoiseDesc const noise_desc = test::TestNoiseDesc(64);
+	NoiseDesc reseeded = noise_desc;
+	reseeded.seed = 34;
+	ThermalErosionDesc const thermal_desc{ .iterations = 4, .c = 0.5f, .talus = 0.01f };
+	uint64 const noise_key = HeightmapCache::ComputeKey(noise_desc, nullptr, nullptr);
+	ADRIA_CHECK(noise_key == HeightmapCache::ComputeKey(test::TestNoiseDesc(64), nullptr, nullptr));
+	ADRIA_CHECK(noise_key != HeightmapCache::ComputeKey(reseeded, nullptr, nullptr));
+	ADRIA_CHECK(noise_key != HeightmapCache::ComputeKey(noise_desc, &thermal_desc, nullptr));
+}
@@ -0,0 +1,127 @@
+#include <cstring>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Utilities/Heightmap.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	struct TerrainStatistics
+	{
+		double mean;
+		double deviation;
+		double roughness;	//mean absolute difference between neighbouring samples
+	};
+
+	TerrainStatistics ComputeStatistics(Heightmap const& heightmap)
+	{
+		uint64 const width = heightmap.Width(), depth = heightmap.Depth();
+		double sum = 0.0, sum_squares = 0.0, roughness = 0.0;
+		for (uint64 z = 0; z < depth; ++z)
+		{
+			for (uint64 x = 0; x < width; ++x)
+			{
+				double const h = heightmap.HeightAt(x, z);
+				sum += h;
+				sum_squares += h * h;
+				if (x + 1 < width) roughness += std::abs(heightmap.HeightAt(x + 1, z) - h);
+				if (z + 1 < depth) roughness += std::abs(heightmap.HeightAt(x, z + 1) - h);
+			}
+		}
+		double const count = double(width * depth);
+		double const mean = sum / count;
+		return TerrainStatistics{ .mean = mean, .deviation = std::sqrt(std::max(sum_squares / count - mean * mean, 0.0)),
+			.roughness = roughness / (2.0 * count) };
+	}
+
+	HydraulicErosionDesc TestErosionDesc(uint32 size, bool parallel)
+	{
+		return HydraulicErosionDesc{ .iterations = 3, .drops = int32(size * size), .carrying_capacity = 1.5f,
+			.deposition_speed = 0.03f, .seed = 7, .parallel = parallel, .tile_size = 64 };
+	}
+
+	bool BitwiseEqual(Heightmap const& a, Heightmap const& b)
+	{
+		return a.Width() == b.Width() && a.Depth() == b.Depth() && memcmp(a.Data(), b.Data(), a.Width() * a.Depth() * sizeof(float)) == 0;
+	}
+}
+
+ADRIA_TEST(HydraulicErosionIsDeterministic)
+{
+	Heightmap first(test::TestNoiseDesc(512));
+	Heightmap second(test::TestNoiseDesc(512));
+	Heightmap reseeded(test::TestNoiseDesc(512));
+
+	HydraulicErosionDesc desc = TestErosionDesc(512, true);
+	first.ApplyHydraulicErosion(desc);
+	second.ApplyHydraulicErosion(desc);
+	desc.seed += 1;
+	reseeded.ApplyHydraulicErosion(desc);
+
+	ADRIA_CHECK(BitwiseEqual(first, second));
+	ADRIA_CHECK(!BitwiseEqual(first, reseeded));
+
+	//every tile has its own random stream, so how many tiles are eroded at once doesn't change the result
+	desc.seed -= 1;
+	for (uint32 thread_count : { 1u, 2u, 3u, 64u })
+	{
+		Heightmap limited(test::TestNoiseDesc(512));
+		desc.thread_count = thread_count;
+		limited.ApplyHydraulicErosion(desc);
+		ADRIA_CHECK(BitwiseEqual(first, limited));
+	}
+}
+
+//drops only move material they picked up, so erosion can't add height and the tiled erosion has to remove about as much as the serial one
+ADRIA_TEST(HydraulicErosionTerrainStatistics)
+{
+	Heightmap original(test::TestNoiseDesc(512));
+	Heightmap serial(test::TestNoiseDesc(512));
+	Heightmap tiled(test::TestNoiseDesc(512));
+	serial.ApplyHydraulicErosion(TestErosionDesc(512, false));
+	tiled.ApplyHydraulicErosion(TestErosionDesc(512, true));
+
+	TerrainStatistics const original_statistics = ComputeStatistics(original);
+	TerrainStatistics const serial_statistics = ComputeStatistics(serial);
+	TerrainStatistics const tiled_statistics = ComputeStatistics(tiled);
+
+	ADRIA_CHECK(!BitwiseEqual(original, tiled));
+	ADRIA_CHECK(serial_statistics.mean <= original_statistics.mean + 1e-4);
+	ADRIA_CHECK(tiled_statistics.mean <= original_statistics.mean + 1e-4);
+
+	double const serial_removed = original_statistics.mean - serial_statistics.mean;
+	double const tiled_removed = original_statistics.mean - tiled_statistics.mean;
+	ADRIA_CHECK(serial_removed > 0.0);
+	ADRIA_CHECK_NEAR(tiled_removed, serial_removed, 0.1 * serial_removed);
+	ADRIA_CHECK_NEAR(tiled_statistics.deviation, serial_statistics.deviation, 0.01 * serial_statistics.deviation);
+	ADRIA_CHECK_NEAR(tiled_statistics.roughness, serial_statistics.roughness, 0.05 * serial_statistics.roughness);
+}
+
+ADRIA_BENCHMARK(HydraulicErosionScaling)
+{
+	uint32 const hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint32> thread_counts = { 1u, 2u, 4u };
+	if (hardware_threads > 4) thread_counts.push_back(hardware_threads);
+	for (uint32 size : { 512u, 1024u, 2048u, 4096u })
+	{
+		Heightmap serial(test::TestNoiseDesc(size));
+		Timer<std::chrono::milliseconds> timer;
+		serial.ApplyHydraulicErosion(TestErosionDesc(size, false));
+		float const serial_time = timer.ElapsedInSeconds();
+		printf("  %4ux%-4u serial:      %.3f s for %u drops\n", size, size, serial_time, size * size);
+
+		for (uint32 thread_count : thread_counts)
+		{
+			Heightmap heightmap(test::TestNoiseDesc(size));
+			HydraulicErosionDesc desc = TestErosionDesc(size, true);
+			desc.thread_count = thread_count;
+			timer.Mark();
+			heightmap.ApplyHydraulicErosion(desc);
+			float const tiled_time = timer.ElapsedInSeconds();
+			printf("  %4ux%-4u %2u threads: %.3f s, %.2fx serial\n", size, size, thread_count, tiled_time, serial_time / tiled_time);
+		}
+	}
+	printf("  %u hardware threads\n", hardware_threads);
+}
@@ -0,0 +1,159 @@
+#include <cstring>
+#include "Test.h"
+#include "Rendering/IBLBaking.h"
+#include "Rendering/DDSFile.h"
+
+using namespace adria;
+
+namespace
+{
+	constexpr float PI = 3.14159265f;
+
+	//rgba float equirect whose texels hold the direction they stand for
+	std::vector<float> DirectionEquirect(uint32 width, uint32 height)
+	{
+		std::vector<float> equirect((size_t)width * height * 4);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			float const theta = (y + 0.5f) / height * PI;
+			for (uint32 x = 0; x < width; ++x)
+			{
+				float const phi = (x + 0.5f) / width * 2.0f * PI;
+				float* texel = &equirect[((size_t)y * width + x) * 4];
+				texel[0] = std::sin(theta) * std::cos(phi);
+				texel[1] = std::cos(theta);
+				texel[2] = std::sin(theta) * std::sin(phi);
+				texel[3] = 1.0f;
+			}
+		}
+		return equirect;
+	}
+
+	//cube face directions as the D3D documentation gives them, s and t go from -1 to 1 with t down
+	void D3DFaceDirection(uint32 face, float s, float t, float d[3])
+	{
+		float const directions[6][3] = { { 1.0f, -t, -s }, { -1.0f, -t, s }, { s, 1.0f, t }, { s, -1.0f, -t }, { s, -t, 1.0f }, { -s, -t, -1.0f } };
+		float const length = std::sqrt(1.0f + s * s + t * t);
+		for (uint32 c = 0; c < 3; ++c) d[c] = directions[face][c] / length;
+	}
+
+	float HalfToFloat(uint16 half)
+	{
+		uint32 const sign = (half >> 15) & 1, exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+		float const magnitude = exponent == 0 ? std::ldexp((float)mantissa, -24) : std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+		return sign ? -magnitude : magnitude;
+	}
+}
+
+//the faces are laid out and oriented as D3D samples them
+ADRIA_TEST(IBLBakingFaceOrientation)
+{
+	uint32 const size = 16;
+	std::vector<float> const equirect = DirectionEquirect(512, 256);
+	CubemapImage const environment = IBLBaking::EquirectToCubemap(equirect, 512, 256, size);
+	ADRIA_CHECK(environment.mip_count == 5 && environment.subresources.size() == 6 * 5);
+
+	float min_dot = 1.0f;
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		std::vector<float> const& texels = environment.Texels(face, 0);
+		for (uint32 y = 0; y < size; ++y)
+		{
+			for (uint32 x = 0; x < size; ++x)
+			{
+				float expected[3];
+				D3DFaceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, expected);
+				float const* texel = &texels[((size_t)y * size + x) * 4];
+				float const length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+				min_dot = std::min(min_dot, (texel[0] * expected[0] + texel[1] * expected[1] + texel[2] * expected[2]) / length);
+			}
+		}
+	}
+	ADRIA_CHECK(min_dot > 0.999f);
+
+	//sampling the cubemap at the directions of its own texels finds them again, the lookup is the inverse of the face directions
+	CubemapImage const sampled = IBLBaking::PrefilterSpecular(environment, size, 1, 1);
+	float max_error = 0.0f;
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		for (uint64 i = 0; i < sampled.Texels(face, 0).size(); ++i) max_error = std::max(max_error, std::abs(sampled.Texels(face, 0)[i] - environment.Texels(face, 0)[i]));
+	}
+	ADRIA_CHECK(max_error < 1e-4f);
+	printf("  %ux%u faces: directions within %.4f of the D3D ones, lookups within %g of the texels\n", size, size, std::acos(min_dot), max_error);
+}
+
+//under a constant white sky the irradiance divided by pi is 1 everywhere, the prefiltered mips stay white too
+ADRIA_TEST(IBLBakingConstantEnvironment)
+{
+	std::vector<float> const equirect((size_t)128 * 64 * 4, 1.0f);
+	CubemapImage const environment = IBLBaking::EquirectToCubemap(equirect, 128, 64, 64);
+	IrradianceSH const sh = IBLBaking::ProjectIrradiance(environment);
+	for (uint32 i = 1; i < 9; ++i)
+		for (uint32 c = 0; c < 3; ++c) ADRIA_CHECK(std::abs(sh.coefficients[i][c]) < 1e-3f);
+
+	CubemapImage const irradiance = IBLBaking::EvaluateIrradiance(sh, 8);
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		std::vector<float> const& texels = irradiance.Texels(face, 0);
+		for (uint64 i = 0; i < texels.size(); ++i) ADRIA_CHECK_NEAR(texels[i], 1.0f, 1e-3f);
+	}
+
+	CubemapImage const specular = IBLBaking::PrefilterSpecular(environment, 16, 5, 64);
+	for (uint32 face = 0; face < 6; ++face)
+		for (uint32 mip = 0; mip < specular.mip_count; ++mip)
+			for (float value : specular.Texels(face, mip)) ADRIA_CHECK_NEAR(value, 1.0f, 1e-4f);
+}
+
+ADRIA_TEST(IBLBakingIrradianceSHRoundTrip)
+{
+	IrradianceSH sh{};
+	for (uint32 i = 0; i < 9; ++i)
+		for (uint32 c = 0; c < 3; ++c) sh.coefficients[i][c] = 0.25f * i - 0.5f * c + 0.125f;
+
+	std::vector<uint8> data = IBLBaking::WriteIrradianceSH(sh);
+	std::optional<IrradianceSH> const read = IBLBaking::ReadIrradianceSH(data);
+	ADRIA_CHECK(read.has_value());
+	ADRIA_CHECK(memcmp(read->coefficients, sh.coefficients, sizeof(sh.coefficients)) == 0);
+
+	//truncated files and other versions are rejected
+	ADRIA_CHECK(!IBLBaking::ReadIrradianceSH(std::span(data.data(), data.size() - 1)));
+	data[4] ^= 0xFF;
+	ADRIA_CHECK(!IBLBaking::ReadIrradianceSH(data));
+}
+
+//every subresource comes back in D3D order as the half closest to its texels, brighter than a half can hold is clamped
+ADRIA_TEST(IBLBakingCubemapDDSRoundTrip)
+{
+	std::vector<float> equirect = DirectionEquirect(64, 32);
+	//a sun overhead
+	for (uint64 i = 0; i < 64 * 4 * 4; i += 4) equirect[i] = 1e6f;
+	CubemapImage const cubemap = IBLBaking::EquirectToCubemap(equirect, 64, 32, 8);
+	std::vector<uint8> const dds = IBLBaking::WriteCubemapDDS(cubemap);
+
+	std::optional<DDSFileDesc> const desc = DDSFile::ReadHeaders(dds);
+	ADRIA_CHECK(desc.has_value());
+	ADRIA_CHECK(desc->cubemap && desc->width == 8 && desc->height == 8 && desc->mip_count == 4);
+	ADRIA_CHECK(dds.size() == DDSFile::DATA_OFFSET + 6 * (64 + 16 + 4 + 1) * 4 * sizeof(uint16));
+	ADRIA_CHECK(DDSFile::DataSize(*desc) == dds.size() - DDSFile::DATA_OFFSET);
+
+	uint8 const* data = dds.data() + DDSFile::DATA_OFFSET;
+	float max_relative_error = 0.0f, max_value = 0.0f;
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		for (uint32 mip = 0; mip < cubemap.mip_count; ++mip)
+		{
+			for (float value : cubemap.Texels(face, mip))
+			{
+				uint16 half;
+				memcpy(&half, data, sizeof(half));
+				data += sizeof(half);
+				float const read = HalfToFloat(half);
+				max_value = std::max(max_value, read);
+				if (std::abs(value) > 1e-3f && value < 65504.0f) max_relative_error = std::max(max_relative_error, std::abs(read - value) / std::abs(value));
+			}
+		}
+	}
+	ADRIA_CHECK(data == dds.data() + dds.size());
+	ADRIA_CHECK(max_relative_error < 1e-3f);
+	ADRIA_CHECK(max_value == 65504.0f);
+}
@@ -0,0 +1,195 @@
+#include <filesystem>
+#include <fstream>
+#include "Test.h"
+#include "Rendering/MeshCache.h"
+
+using namespace adria;
+
+namespace
+{
+	constexpr uint64 TEST_KEY = 0x1234abcd5678ef00ull;
+
+	//offsets of the MeshCacheHeader fields the corruption tests patch
+	constexpr uint64 HEADER_INDEX_COUNT = 40;
+	constexpr uint64 HEADER_SUBMESH_COUNT = 48;
+	constexpr uint64 HEADER_SUBMESH_OFFSET = 104;
+	constexpr uint64 HEADER_STRING_OFFSET = 136;
+
+	struct TestMesh
+	{
+		std::vector<TexturedNormalVertex> vertices;
+		std::vector<uint32> indices;
+		MeshCacheData data;
+	};
+
+	TestMesh CreateTestMesh()
+	{
+		TestMesh mesh{};
+		for (uint32 i = 0; i < 10; ++i)
+		{
+			mesh.vertices.push_back(TexturedNormalVertex{ Vector3((float)i, 2.0f * i, -1.0f * i), Vector2(0.1f * i, 0.2f), Vector3(0.0f, 1.0f, 0.0f) });
+		}
+		for (uint32 i = 0; i + 2 < 10; ++i) mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + 2 });
+
+		MeshCacheData& data = mesh.data;
+		data.vertex_stride = sizeof(TexturedNormalVertex);
+		data.vertices = std::span<uint8 const>(reinterpret_cast<uint8 const*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(TexturedNormalVertex));
+		data.indices = mesh.indices;
+
+		MeshCacheSubmesh submesh{};
+		submesh.bounds = BoundingBox(Vector3(4.5f, 9.0f, -4.5f), Vector3(4.5f, 9.0f, 4.5f));
+		submesh.mesh = 0;
+		submesh.material = 1;
+		submesh.topology = 4;
+		submesh.index_count = (uint32)mesh.indices.size();
+		submesh.vertex_count = (uint32)mesh.vertices.size();
+		submesh.lod_count = 2;
+		submesh.lods[1] = MeshLodLevel{ 6, 12, 0.25f };
+		submesh.meshlet_count = 1;
+		data.submeshes.push_back(submesh);
+
+		data.meshlets.push_back(Meshlet{ Vector3(1.0f, 2.0f, 3.0f), 4.0f, Vector3(0.0f, 0.0f, 0.0f), 0.5f, Vector3(0.0f, 1.0f, 0.0f), 10, 0, 24 });
+
+		MeshCacheMaterial material{};
+		data.materials.push_back(material);
+		material.albedo_texture = 0;
+		material.normal_texture = 1;
+		material.roughness_factor = 0.3f;
+		data.materials.push_back(material);
+
+		data.nodes.push_back(MeshCacheNode{ Matrix::CreateTranslation(1.0f, 2.0f, 3.0f), MESH_CACHE_NONE, 0 });
+		data.strings = { "albedo.png", "textures/normal map.dds" };
+		return mesh;
+	}
+
+	template<typename T>
+	void Patch(std::vector<uint8>& image, uint64 offset, T value)
+	{
+		memcpy(image.data() + offset, &value, sizeof(T));
+	}
+
+	template<typename T>
+	T Read(std::vector<uint8> const& image, uint64 offset)
+	{
+		T value;
+		memcpy(&value, image.data() + offset, sizeof(T));
+		return value;
+	}
+
+	bool Opens(std::vector<uint8> image)
+	{
+		MeshCacheFile file;
+		return file.Open(std::move(image), TEST_KEY);
+	}
+
+	void WriteFile(std::filesystem::path const& path, std::string const& contents)
+	{
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+}
+
+//what is serialized comes back through the view, from memory and from the mapped file
+ADRIA_TEST(MeshCacheRoundTrip)
+{
+	TestMesh const mesh = CreateTestMesh();
+	std::vector<uint8> const image = MeshCache::Serialize(TEST_KEY, mesh.data);
+	std::string const path = (std::filesystem::temp_directory_path() / "adria_round_trip.amesh").string();
+	ADRIA_CHECK(MeshCache::Write(path, image));
+
+	for (bool mapped : { false, true })
+	{
+		MeshCacheFile file;
+		ADRIA_CHECK(mapped ? file.Open(path, TEST_KEY) : file.Open(std::vector<uint8>(image), TEST_KEY));
+		ADRIA_CHECK(file.VertexStride() == sizeof(TexturedNormalVertex));
+		ADRIA_CHECK(file.VertexCount() == mesh.vertices.size());
+		ADRIA_CHECK(memcmp(file.Vertices(), mesh.vertices.data(), mesh.vertices.size() * sizeof(TexturedNormalVertex)) == 0);
+		ADRIA_CHECK(file.IndexCount() == mesh.indices.size());
+		ADRIA_CHECK(std::equal(mesh.indices.begin(), mesh.indices.end(), file.Indices()));
+		ADRIA_CHECK(uint64(file.Vertices()) % 16 == 0 && uint64(file.Indices()) % 16 == 0);
+
+		ADRIA_CHECK(file.Submeshes().size() == 1);
+		ADRIA_CHECK(memcmp(&file.Submeshes()[0], &mesh.data.submeshes[0], sizeof(MeshCacheSubmesh)) == 0);
+		ADRIA_CHECK(file.Meshlets().size() == 1);
+		ADRIA_CHECK(memcmp(&file.Meshlets()[0], &mesh.data.meshlets[0], sizeof(Meshlet)) == 0);
+		ADRIA_CHECK(file.Materials().size() == 2);
+		ADRIA_CHECK(memcmp(file.Materials().data(), mesh.data.materials.data(), 2 * sizeof(MeshCacheMaterial)) == 0);
+		ADRIA_CHECK(file.Nodes().size() == 1);
+		ADRIA_CHECK(memcmp(&file.Nodes()[0], &mesh.data.nodes[0], sizeof(MeshCacheNode)) == 0);
+
+		ADRIA_CHECK(std::string(file.String(0)) == "albedo.png");
+		ADRIA_CHECK(std::string(file.String(1)) == "textures/normal map.dds");
+		ADRIA_CHECK(file.String(MESH_CACHE_NONE) == nullptr);
+		ADRIA_CHECK(file.String(2) == nullptr);
+	}
+	std::filesystem::remove(path);
+}
+
+ADRIA_TEST(MeshCacheRejectsCorruptFiles)
+{
+	TestMesh const mesh = CreateTestMesh();
+	std::vector<uint8> const image = MeshCache::Serialize(TEST_KEY, mesh.data);
+	ADRIA_CHECK(Opens(image));
+
+	MeshCacheFile file;
+	ADRIA_CHECK(!file.Open(std::vector<uint8>(image), TEST_KEY + 1));
+	ADRIA_CHECK(!Opens(std::vector<uint8>(image.begin(), image.end() - 1)));
+	ADRIA_CHECK(!Opens(std::vector<uint8>(image.begin(), image.begin() + 16)));
+
+	//counts that run past the end of the file, also ones whose byte size overflows
+	std::vector<uint8> corrupt = image;
+	Patch<uint64>(corrupt, HEADER_INDEX_COUNT, ~0ull / 2);
+	ADRIA_CHECK(!Opens(corrupt));
+	corrupt = image;
+	Patch<uint64>(corrupt, HEADER_SUBMESH_COUNT, 1000);
+	ADRIA_CHECK(!Opens(corrupt));
+
+	//misaligned or out of range section
+	corrupt = image;
+	Patch<uint64>(corrupt, HEADER_SUBMESH_OFFSET, Read<uint64>(image, HEADER_SUBMESH_OFFSET) + 4);
+	ADRIA_CHECK(!Opens(corrupt));
+	corrupt = image;
+	Patch<uint64>(corrupt, HEADER_SUBMESH_OFFSET, image.size() + 16);
+	ADRIA_CHECK(!Opens(corrupt));
+
+	//string offset past the end and a string that isn't terminated
+	uint64 const string_offset = Read<uint64>(image, HEADER_STRING_OFFSET);
+	corrupt = image;
+	Patch<uint64>(corrupt, string_offset + sizeof(uint64), image.size());
+	ADRIA_CHECK(!Opens(corrupt));
+	corrupt = image;
+	ADRIA_CHECK(corrupt.size() > string_offset);
+	corrupt[corrupt.size() - 1] = 'x';
+	ADRIA_CHECK(!Opens(corrupt));
+}
+
+//only the files a source references are part of its key
+ADRIA_TEST(MeshCacheKeyFollowsReferencedFiles)
+{
+	std::filesystem::path const directory = std::filesystem::temp_directory_path() / "adria_mesh_cache_key";
+	std::filesystem::create_directories(directory);
+	std::string const gltf_path = (directory / "model.gltf").string();
+	std::string const obj_path = (directory / "model.obj").string();
+	WriteFile(gltf_path, R"({ "asset": { "version": "2.0" }, "buffers": [ { "uri": "model%20data.bin", "byteLength": 4 }, { "uri": "data:application/octet-stream;base64,AAAA" } ] })");
+	WriteFile(obj_path, "# test\nmtllib model.mtl\nv 0 0 0\n");
+	WriteFile(directory / "model data.bin", "abcd");
+	WriteFile(directory / "model.mtl", "newmtl a\n");
+	WriteFile(directory / "unrelated.bin", "1");
+	WriteFile(directory / "unrelated.mtl", "1");
+
+	uint64 const gltf_key = MeshCache::ComputeKey(gltf_path);
+	uint64 const obj_key = MeshCache::ComputeKey(obj_path);
+	ADRIA_CHECK(gltf_key != obj_key);
+
+	WriteFile(directory / "unrelated.bin", "12345");
+	WriteFile(directory / "unrelated.mtl", "12345");
+	WriteFile(directory / "other.bin", "1");
+	ADRIA_CHECK(MeshCache::ComputeKey(gltf_path) == gltf_key);
+	ADRIA_CHECK(MeshCache::ComputeKey(obj_path) == obj_key);
+
+	WriteFile(directory / "model data.bin", "abcdef");
+	WriteFile(directory / "model.mtl", "newmtl a\nnewmtl b\n");
+	ADRIA_CHECK(MeshCache::ComputeKey(gltf_path) != gltf_key);
+	ADRIA_CHECK(MeshCache::ComputeKey(obj_path) != obj_key);
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,146 @@
+#include <map>
+#include <random>
+#include "Test.h"
+#include "Rendering/MeshInstancing.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	//mesh_count meshes with two materials each, items of a mesh are submitted in runs like the entities of a model
+	std::vector<MeshInstanceItem> RandomItems(uint64 item_count, uint32 mesh_count, uint32 seed)
+	{
+		static uint8 const buffers[2] = {};
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<uint32> mesh(0, mesh_count - 1);
+		std::uniform_int_distribution<uint32> run_length(1, 32);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+		std::vector<MeshInstanceItem> items;
+		items.reserve(item_count);
+		while (items.size() < item_count)
+		{
+			uint32 const m = mesh(rng);
+			MeshBatchKey key{};
+			key.shader_program = m % 3 == 0 ? ShaderProgram::GBufferPBR_Mask : ShaderProgram::GBufferPBR;
+			key.double_sided = m % 3 == 0;
+			key.vertex_buffer = &buffers[0];
+			key.index_buffer = &buffers[1];
+			key.start_index = m * 3000;
+			key.index_count = 3000;
+			key.textures[0] = m % 2 ? m + 1 : 0;
+			key.factors[0] = 1.0f;
+			key.factors[1] = (m % 4) * 0.25f;
+			for (uint32 i = run_length(rng); i > 0 && items.size() < item_count; --i)
+			{
+				Matrix const world = Matrix::CreateScale(scale(rng)) * Matrix::CreateRotationY(position(rng)) * Matrix::CreateTranslation(position(rng), position(rng), position(rng));
+				items.push_back(MeshInstanceItem{ key, world, (uint64)items.size() });
+			}
+		}
+		return items;
+	}
+}
+
+//batches are the distinct keys in key order, and hold their items in submission order
+ADRIA_TEST(MeshInstancingMatchesBruteForce)
+{
+	std::vector<MeshInstanceItem> const items = RandomItems(20000, 50, 41);
+	std::vector<MeshInstanceBatch> batches;
+	std::vector<MeshInstance> instances;
+	MeshInstancingStatistics const statistics = MeshInstancing::Batch(items, batches, instances);
+
+	std::map<MeshBatchKey, std::vector<uint64>> expected;
+	for (MeshInstanceItem const& item : items) expected[item.key].push_back(item.payload);
+	ADRIA_CHECK(statistics.item_count == items.size());
+	ADRIA_CHECK(statistics.batch_count == expected.size());
+	ADRIA_CHECK(batches.size() == expected.size());
+	ADRIA_CHECK(instances.size() == items.size());
+
+	uint32 first_instance = 0;
+	uint64 max_batch_size = 0;
+	auto expected_it = expected.begin();
+	for (MeshInstanceBatch const& batch : batches)
+	{
+		ADRIA_CHECK(batch.key == expected_it->first);
+		ADRIA_CHECK(batch.first_instance == first_instance);
+		ADRIA_CHECK(batch.instance_count == expected_it->second.size());
+		ADRIA_CHECK(batch.payload == expected_it->second[0]);
+		for (uint32 i = 0; i < batch.instance_count; ++i)
+		{
+			Matrix const& world = items[expected_it->second[i]].world;
+			MeshInstance const& instance = instances[batch.first_instance + i];
+			ADRIA_CHECK(instance.model[3] == Vector3(world._41, world._42, world._43));
+			ADRIA_CHECK(instance.model[0] == Vector3(world._11, world._12, world._13));
+			//rows of the inverse undo the rotation and scale of the world matrix
+			Matrix const inverse = world.Invert();
+			ADRIA_CHECK_NEAR(instance.inverse_model[1].x, inverse._21, 1e-5f);
+			ADRIA_CHECK_NEAR(instance.inverse_model[2].z, inverse._33, 1e-5f);
+		}
+		first_instance += batch.instance_count;
+		max_batch_size = std::max<uint64>(max_batch_size, batch.instance_count);
+		++expected_it;
+	}
+	ADRIA_CHECK(statistics.max_batch_size == max_batch_size);
+}
+
+ADRIA_TEST(MeshInstancingEmpty)
+{
+	std::vector<MeshInstanceBatch> batches(3);
+	std::vector<MeshInstance> instances(3);
+	MeshInstancingStatistics const statistics = MeshInstancing::Batch({}, batches, instances);
+	ADRIA_CHECK(batches.empty() && instances.empty());
+	ADRIA_CHECK(statistics.batch_count == 0 && statistics.item_count == 0);
+}
+
+//single instance batches the predicate accepts are drawn on their own, batches that share a draw stay instanced
+ADRIA_TEST(MeshInstancingExtractSingles)
+{
+	std::vector<MeshInstanceItem> items = RandomItems(2000, 50, 47);
+	MeshBatchKey extra_key = items[0].key;
+	extra_key.start_index = 1000000;
+	for (uint64 i = 0; i < 10; ++i) items.push_back(MeshInstanceItem{ extra_key, Matrix::Identity, items.size() });
+	extra_key.index_count = 300;
+	for (uint64 i = 0; i < 5; ++i, ++extra_key.start_index) items.push_back(MeshInstanceItem{ extra_key, Matrix::Identity, items.size() });
+
+	std::vector<MeshInstanceBatch> batches;
+	std::vector<MeshInstance> instances;
+	MeshInstancing::Batch(items, batches, instances);
+	std::vector<MeshInstanceBatch> const all_batches = batches;
+
+	//odd payloads have clusters, so of the five single instance batches the odd ones are extracted
+	std::vector<uint64> singles;
+	uint64 const extracted = MeshInstancing::ExtractSingles(batches, [](uint64 payload) { return payload % 2 == 1; }, singles);
+	ADRIA_CHECK(extracted == singles.size());
+	ADRIA_CHECK(batches.size() + extracted == all_batches.size());
+	std::vector<uint64> expected_singles;
+	auto batch_it = batches.begin();
+	for (MeshInstanceBatch const& batch : all_batches)
+	{
+		if (batch.instance_count == 1 && batch.payload % 2 == 1)
+		{
+			expected_singles.push_back(batch.payload);
+			continue;
+		}
+		ADRIA_CHECK(batch_it != batches.end() && batch_it->key == batch.key && batch_it->first_instance == batch.first_instance);
+		++batch_it;
+	}
+	ADRIA_CHECK(singles == expected_singles);
+	ADRIA_CHECK(!singles.empty());
+	for (MeshInstanceBatch const& batch : batches) ADRIA_CHECK(batch.instance_count > 1 || batch.payload % 2 == 0);
+}
+
+ADRIA_BENCHMARK(MeshInstancing100k)
+{
+	std::vector<MeshInstanceItem> const items = RandomItems(100000, 50, 43);
+	std::vector<MeshInstanceBatch> batches;
+	std::vector<MeshInstance> instances;
+
+	uint32 const frame_count = 100;
+	MeshInstancingStatistics statistics{};
+	Timer<std::chrono::microseconds> timer;
+	for (uint32 frame = 0; frame < frame_count; ++frame) statistics = MeshInstancing::Batch(items, batches, instances);
+	printf("  %llu instances of 50 meshes: %.3f ms per frame, %llu batches, largest %llu\n", (unsigned long long)statistics.item_count,
+		timer.ElapsedInSeconds() * 1000.0f / frame_count, (unsigned long long)statistics.batch_count, (unsigned long long)statistics.max_batch_size);
+}
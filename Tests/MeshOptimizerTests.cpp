@@ -0,0 +1,124 @@
+#include <random>
+#include <array>
+#include "Test.h"
+#include "Rendering/MeshOptimizer.h"
+
+using namespace adria;
+
+namespace
+{
+	struct GridVertex
+	{
+		Vector3 position;
+		Vector2 uv;
+	};
+
+	//triangle soup of a cells x cells grid, triangles shuffled so the input order is as bad for the cache as it gets
+	std::vector<GridVertex> CreateShuffledGridSoup(uint32 cells, uint32 seed)
+	{
+		std::vector<std::array<GridVertex, 3>> triangles;
+		auto Vertex = [cells](uint32 i, uint32 j) { return GridVertex{ Vector3((float)i, 0.0f, (float)j), Vector2(i / (float)cells, j / (float)cells) }; };
+		for (uint32 j = 0; j < cells; ++j)
+		{
+			for (uint32 i = 0; i < cells; ++i)
+			{
+				triangles.push_back({ Vertex(i, j), Vertex(i, j + 1), Vertex(i + 1, j) });
+				triangles.push_back({ Vertex(i + 1, j), Vertex(i, j + 1), Vertex(i + 1, j + 1) });
+			}
+		}
+		std::shuffle(std::begin(triangles), std::end(triangles), std::mt19937(seed));
+
+		std::vector<GridVertex> soup;
+		for (auto const& triangle : triangles) soup.insert(soup.end(), std::begin(triangle), std::end(triangle));
+		return soup;
+	}
+
+	using TriangleKey = std::array<float, 9>;
+
+	//positions of the triangle starting at its smallest vertex, so the same triangle gives the same key whatever vertex it starts at
+	std::vector<TriangleKey> SortedTriangles(std::vector<GridVertex> const& vertices, std::vector<uint32> const& indices)
+	{
+		std::vector<TriangleKey> triangles;
+		for (uint64 t = 0; t < indices.size(); t += 3)
+		{
+			std::array<Vector3, 3> corners{ vertices[indices[t]].position, vertices[indices[t + 1]].position, vertices[indices[t + 2]].position };
+			auto Less = [](Vector3 const& a, Vector3 const& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+			std::rotate(std::begin(corners), std::min_element(std::begin(corners), std::end(corners), Less), std::end(corners));
+
+			TriangleKey key{};
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				key[c * 3 + 0] = corners[c].x;
+				key[c * 3 + 1] = corners[c].y;
+				key[c * 3 + 2] = corners[c].z;
+			}
+			triangles.push_back(key);
+		}
+		std::sort(std::begin(triangles), std::end(triangles));
+		return triangles;
+	}
+}
+
+//misses counted by hand for a fifo of 3 entries, a hit doesn't move the vertex up in the fifo
+ADRIA_TEST(MeshOptimizerAnalyzeVertexCache)
+{
+	std::vector<uint32> const indices = { 0, 1, 2, 0, 1, 3, 0, 4, 5, 2, 1, 0 };
+	//0 1 2 miss, 0 1 hit, 3 miss and evicts 0, 0 4 5 miss, 2 1 0 miss since they were evicted by 0 4 5
+	VertexCacheStatistics const statistics = MeshOptimizer::AnalyzeVertexCache(indices, 8, 3);
+	ADRIA_CHECK(statistics.triangle_count == 4);
+	ADRIA_CHECK(statistics.vertex_count == 6);
+	ADRIA_CHECK(statistics.cache_misses == 10);
+	ADRIA_CHECK_NEAR(statistics.ACMR(), 2.5f, 1e-6f);
+	ADRIA_CHECK_NEAR(statistics.ATVR(), 10.0f / 6.0f, 1e-6f);
+
+	//with a cache large enough only the first use of each vertex misses
+	VertexCacheStatistics const large = MeshOptimizer::AnalyzeVertexCache(indices, 8, 16);
+	ADRIA_CHECK(large.cache_misses == 6);
+	ADRIA_CHECK_NEAR(large.ATVR(), 1.0f, 1e-6f);
+}
+
+//a shuffled soup is welded to the grid vertices and reordered, the surface it draws stays the same
+ADRIA_TEST(MeshOptimizerOptimizeMesh)
+{
+	uint32 const cells = 32;
+	std::vector<GridVertex> vertices = CreateShuffledGridSoup(cells, 7);
+	std::vector<uint32> indices;
+	std::vector<uint32> soup_indices(vertices.size());
+	std::iota(std::begin(soup_indices), std::end(soup_indices), 0u);
+	std::vector<TriangleKey> const triangles_before = SortedTriangles(vertices, soup_indices);
+
+	MeshOptimizationStatistics const statistics = MeshOptimizer::OptimizeMesh(vertices, indices);
+	ADRIA_CHECK(statistics.vertices_before == 6ull * cells * cells);
+	ADRIA_CHECK(statistics.vertices_after == (uint64)(cells + 1) * (cells + 1));
+	ADRIA_CHECK(vertices.size() == statistics.vertices_after);
+	ADRIA_CHECK(indices.size() == soup_indices.size());
+	ADRIA_CHECK(SortedTriangles(vertices, indices) == triangles_before);
+
+	//every vertex is used and in the order the indices first reference them
+	uint32 next_vertex = 0;
+	for (uint32 index : indices)
+	{
+		ADRIA_CHECK(index <= next_vertex);
+		if (index == next_vertex) ++next_vertex;
+	}
+	ADRIA_CHECK(next_vertex == vertices.size());
+
+	ADRIA_CHECK(statistics.before.ACMR() == 3.0f);
+	ADRIA_CHECK(statistics.after.ACMR() < statistics.before.ACMR());
+	ADRIA_CHECK(statistics.after.ACMR() < 1.0f);
+	ADRIA_CHECK(statistics.after.cache_misses == MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).cache_misses);
+	printf("  %ux%u grid soup: %llu to %llu vertices, ACMR %.3f to %.3f, ATVR %.3f\n", cells, cells, (unsigned long long)statistics.vertices_before,
+		(unsigned long long)statistics.vertices_after, statistics.before.ACMR(), statistics.after.ACMR(), statistics.after.ATVR());
+
+	//an indexed mesh keeps its vertex count and gets better again once shuffled
+	std::vector<uint32> shuffled = indices;
+	std::vector<uint32> order(shuffled.size() / 3);
+	std::iota(std::begin(order), std::end(order), 0u);
+	std::shuffle(std::begin(order), std::end(order), std::mt19937(11));
+	for (uint64 t = 0; t < order.size(); ++t) std::copy_n(&indices[order[t] * 3], 3, &shuffled[t * 3]);
+	std::vector<GridVertex> indexed_vertices = vertices;
+	MeshOptimizationStatistics const indexed = MeshOptimizer::OptimizeMesh(indexed_vertices, shuffled);
+	ADRIA_CHECK(indexed.vertices_after == indexed.vertices_before);
+	ADRIA_CHECK(indexed.after.ACMR() < indexed.before.ACMR());
+	ADRIA_CHECK(SortedTriangles(indexed_vertices, shuffled) == triangles_before);
+}
@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "Rendering/MeshSimplifier.h"
+
+using namespace adria;
+
+namespace
+{
+	constexpr uint32 GRID_CELLS = 64;
+
+	struct HeightfieldMesh
+	{
+		std::vector<Vector3> positions;
+		std::vector<uint32> indices;
+		float extent;
+	};
+
+	//square grid of size world units with gentle waves on top
+	HeightfieldMesh CreateHeightfield(float size)
+	{
+		HeightfieldMesh mesh{};
+		for (uint32 j = 0; j <= GRID_CELLS; ++j)
+		{
+			for (uint32 i = 0; i <= GRID_CELLS; ++i)
+			{
+				float const x = i / float(GRID_CELLS), z = j / float(GRID_CELLS);
+				mesh.positions.push_back(Vector3(x, 0.04f * std::sin(6.0f * x) * std::cos(4.0f * z), z) * size);
+			}
+		}
+		for (uint32 j = 0; j < GRID_CELLS; ++j)
+		{
+			for (uint32 i = 0; i < GRID_CELLS; ++i)
+			{
+				uint32 const v = j * (GRID_CELLS + 1) + i;
+				mesh.indices.insert(mesh.indices.end(), { v, v + GRID_CELLS + 1, v + 1, v + 1, v + GRID_CELLS + 1, v + GRID_CELLS + 2 });
+			}
+		}
+		mesh.extent = size;
+		return mesh;
+	}
+
+	//height of the simplified surface below the point, the heightfield stays one after simplification
+	float SurfaceHeight(HeightfieldMesh const& mesh, std::span<uint32 const> indices, float x, float z)
+	{
+		for (uint64 t = 0; t < indices.size(); t += 3)
+		{
+			Vector3 const& a = mesh.positions[indices[t]];
+			Vector3 const& b = mesh.positions[indices[t + 1]];
+			Vector3 const& c = mesh.positions[indices[t + 2]];
+			float const det = (b.z - c.z) * (a.x - c.x) + (c.x - b.x) * (a.z - c.z);
+			if (det == 0.0f) continue;
+			float const u = ((b.z - c.z) * (x - c.x) + (c.x - b.x) * (z - c.z)) / det;
+			float const v = ((c.z - a.z) * (x - c.x) + (a.x - c.x) * (z - c.z)) / det;
+			float const eps = -1e-4f;
+			if (u >= eps && v >= eps && 1.0f - u - v >= eps) return u * a.y + v * b.y + (1.0f - u - v) * c.y;
+		}
+		return std::numeric_limits<float>::quiet_NaN();
+	}
+}
+
+//level errors are distances relative to the extent: they follow how far the level strays from the source vertices at any scale
+ADRIA_TEST(MeshSimplifierLodErrors)
+{
+	for (float size : { 10.0f, 1000.0f })
+	{
+		HeightfieldMesh const mesh = CreateHeightfield(size);
+		std::vector<uint32> indices = mesh.indices;
+		MeshLodLevel levels[MESH_LOD_MAX_LEVELS];
+		uint32 const level_count = MeshSimplifier::GenerateLods(indices, mesh.positions.data(), mesh.positions.size(), sizeof(Vector3), levels);
+		ADRIA_CHECK(level_count >= 3);
+		ADRIA_CHECK(levels[0].error == 0.0f);
+
+		for (uint32 l = 1; l < level_count; ++l)
+		{
+			ADRIA_CHECK(levels[l].index_count < levels[l - 1].index_count);
+			ADRIA_CHECK(levels[l].error >= levels[l - 1].error);
+			ADRIA_CHECK(levels[l].error <= MeshLodDesc{}.max_error);
+
+			std::span<uint32 const> const level_indices(indices.data() + levels[l].start_index, levels[l].index_count);
+			float max_deviation = 0.0f;
+			for (Vector3 const& position : mesh.positions)
+			{
+				float const height = SurfaceHeight(mesh, level_indices, position.x, position.z);
+				ADRIA_CHECK(!std::isnan(height));
+				max_deviation = std::max(max_deviation, std::abs(height - position.y));
+			}
+			float const relative_deviation = max_deviation / mesh.extent;
+			printf("  size %.0f, level %u: %u triangles, error %.5f, largest deviation %.5f\n", size, l, levels[l].index_count / 3, levels[l].error, relative_deviation);
+			ADRIA_CHECK(levels[l].error > 0.0f);
+			ADRIA_CHECK(levels[l].error <= relative_deviation * 1.5f);
+			ADRIA_CHECK(levels[l].error >= relative_deviation * 0.25f);
+		}
+	}
+}
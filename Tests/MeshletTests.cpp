@@ -0,0 +1,158 @@
+#include <random>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Rendering/Meshlets.h"
+#include "Rendering/MeshOptimizer.h"
+#include "Math/Constants.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+using namespace DirectX;
+
+namespace
+{
+	//the sphere in vertex cache order like the importers leave it
+	test::SphereMesh CreateCacheOrderedSphere(uint32 rings, uint32 segments, float radius)
+	{
+		test::SphereMesh mesh = test::CreateSphere(rings, segments, radius);
+		std::vector<uint32> const indices = mesh.indices;
+		MeshOptimizer::OptimizeVertexCache(mesh.indices, indices, mesh.positions.size());
+		return mesh;
+	}
+
+	//the viewer is behind the plane of the triangle, which the normal cone of its meshlet tests for all triangles at once
+	bool IsBackfacing(test::SphereMesh const& mesh, uint64 first_index, Vector3 const& view_position)
+	{
+		Vector3 const& p0 = mesh.positions[mesh.indices[first_index]];
+		Vector3 const& p1 = mesh.positions[mesh.indices[first_index + 1]];
+		Vector3 const& p2 = mesh.positions[mesh.indices[first_index + 2]];
+		Vector3 const normal = (p1 - p0).Cross(p2 - p0);
+		return (p0 - view_position).Dot(normal) >= 0.0f;
+	}
+
+	bool IsDrawn(std::vector<MeshIndexRange> const& ranges, uint64 index)
+	{
+		return std::any_of(ranges.begin(), ranges.end(), [index](MeshIndexRange const& range) { return index >= range.start_index && index < range.start_index + range.index_count; });
+	}
+}
+
+ADRIA_TEST(MeshletsBuild)
+{
+	test::SphereMesh const mesh = CreateCacheOrderedSphere(64, 128, 1.0f);
+	std::vector<Meshlet> const meshlets = Meshlets::Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), sizeof(Vector3));
+	ADRIA_CHECK(!meshlets.empty());
+
+	uint64 next_index = 0;
+	for (Meshlet const& meshlet : meshlets)
+	{
+		ADRIA_CHECK(meshlet.start_index == next_index);
+		ADRIA_CHECK(meshlet.index_count > 0 && meshlet.index_count / 3 <= MESHLET_MAX_TRIANGLES);
+		next_index += meshlet.index_count;
+
+		std::vector<uint32> vertices(mesh.indices.begin() + meshlet.start_index, mesh.indices.begin() + meshlet.start_index + meshlet.index_count);
+		std::sort(vertices.begin(), vertices.end());
+		vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+		ADRIA_CHECK(meshlet.vertex_count == vertices.size());
+		ADRIA_CHECK(meshlet.vertex_count <= MESHLET_MAX_VERTICES);
+		for (uint32 vertex : vertices) ADRIA_CHECK(Vector3::Distance(mesh.positions[vertex], meshlet.center) <= meshlet.radius * 1.001f + 1e-5f);
+	}
+	ADRIA_CHECK(next_index == mesh.indices.size());
+}
+
+//cone culling only drops meshlets whose triangles are all backfacing, and on a closed sphere it drops a good part of the far side
+ADRIA_TEST(MeshletsConeCullingMatchesBruteForce)
+{
+	test::SphereMesh const mesh = CreateCacheOrderedSphere(64, 128, 1.0f);
+	std::vector<Meshlet> const meshlets = Meshlets::Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), sizeof(Vector3));
+
+	std::mt19937 rng(13);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> distance(1.5f, 20.0f);
+	uint64 backfacing_triangles = 0, cone_culled_triangles = 0;
+	for (uint32 view = 0; view < 64; ++view)
+	{
+		Vector3 view_direction(direction(rng), direction(rng), direction(rng));
+		if (view_direction.Length() < 1e-3f) continue;
+		view_direction.Normalize();
+		Vector3 const view_position = view_direction * distance(rng);
+		//the frustum holds the whole sphere, only the cones cull
+		BoundingFrustum const frustum = test::TestFrustum(view_position * 4.0f, Vector3(0.0f, 0.0f, 0.0f), 1000.0f);
+
+		std::vector<MeshIndexRange> ranges;
+		MeshletCullStatistics const statistics = Meshlets::Cull(meshlets, frustum, view_position, true, ranges, 0);
+		ADRIA_CHECK(statistics.meshlet_count == meshlets.size());
+		ADRIA_CHECK(statistics.drawn_triangle_count == statistics.visible_triangle_count);
+
+		for (Meshlet const& meshlet : meshlets)
+		{
+			bool const drawn = IsDrawn(ranges, meshlet.start_index);
+			bool all_backfacing = true;
+			for (uint64 i = meshlet.start_index; i < meshlet.start_index + meshlet.index_count; i += 3)
+			{
+				bool const backfacing = IsBackfacing(mesh, i, view_position);
+				backfacing_triangles += backfacing;
+				all_backfacing &= backfacing;
+				//every front facing triangle is drawn
+				if (!backfacing) ADRIA_CHECK(IsDrawn(ranges, i));
+			}
+			if (!drawn)
+			{
+				ADRIA_CHECK(all_backfacing);
+				cone_culled_triangles += meshlet.index_count / 3;
+			}
+		}
+	}
+	printf("  cone culling removed %.1f%% of the backfacing triangles\n", 100.0 * cone_culled_triangles / backfacing_triangles);
+	ADRIA_CHECK(cone_culled_triangles > backfacing_triangles / 4);
+}
+
+//frustum culling keeps every triangle with a corner inside the frustum, merged ranges stay sorted, disjoint and within max_ranges
+ADRIA_TEST(MeshletsFrustumCullingMatchesBruteForce)
+{
+	test::SphereMesh const mesh = CreateCacheOrderedSphere(64, 128, 10.0f);
+	std::vector<Meshlet> const meshlets = Meshlets::Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), sizeof(Vector3));
+
+	Vector3 const view_position(2.0f, 1.0f, -30.0f);
+	BoundingFrustum const frustum = test::TestFrustum(view_position, Vector3(6.0f, 3.0f, 0.0f), 100.0f);
+	for (uint32 max_ranges : { 0u, 32u, 4u })
+	{
+		std::vector<MeshIndexRange> ranges;
+		MeshletCullStatistics const statistics = Meshlets::Cull(meshlets, frustum, view_position, false, ranges, max_ranges);
+		ADRIA_CHECK(statistics.visible_meshlet_count > 0 && statistics.visible_meshlet_count < meshlets.size());
+		ADRIA_CHECK(statistics.drawn_triangle_count >= statistics.visible_triangle_count);
+		if (max_ranges > 0) ADRIA_CHECK(ranges.size() <= max_ranges);
+		for (uint64 i = 1; i < ranges.size(); ++i) ADRIA_CHECK(ranges[i].start_index > ranges[i - 1].start_index + ranges[i - 1].index_count);
+
+		for (uint64 i = 0; i < mesh.indices.size(); i += 3)
+		{
+			bool inside = false;
+			for (uint32 k = 0; k < 3; ++k) inside |= frustum.Contains(mesh.positions[mesh.indices[i + k]]) != DISJOINT;
+			if (inside) ADRIA_CHECK(IsDrawn(ranges, i));
+		}
+	}
+}
+
+ADRIA_BENCHMARK(MeshletsCull1M)
+{
+	//about a million triangles
+	test::SphereMesh const mesh = CreateCacheOrderedSphere(708, 708, 1.0f);
+	Timer<std::chrono::milliseconds> timer;
+	std::vector<Meshlet> const meshlets = Meshlets::Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), sizeof(Vector3));
+	printf("  %llu triangles split into %llu meshlets in %.3f s\n", (unsigned long long)mesh.indices.size() / 3, (unsigned long long)meshlets.size(), timer.ElapsedInSeconds());
+
+	uint32 const frame_count = 200;
+	MeshletCullStatistics statistics{};
+	std::vector<MeshIndexRange> ranges;
+	Timer<std::chrono::microseconds> cull_timer;
+	for (uint32 frame = 0; frame < frame_count; ++frame)
+	{
+		//circles the sphere close enough that part of it is outside the frustum
+		float const angle = 2.0f * pi<float> * frame / frame_count;
+		Vector3 const view_position(2.0f * std::cos(angle), 0.5f, 2.0f * std::sin(angle));
+		BoundingFrustum const frustum = test::TestFrustum(view_position, Vector3(0.3f, 0.0f, 0.0f), 100.0f);
+		statistics += Meshlets::Cull(meshlets, frustum, view_position, true, ranges);
+	}
+	printf("  cull: %.3f ms per frame, %.1f%% of the triangles visible, %.1f%% drawn in %.1f ranges per frame\n",
+		cull_timer.ElapsedInSeconds() * 1000.0f / frame_count, 100.0 * statistics.visible_triangle_count / statistics.triangle_count,
+		100.0 * statistics.drawn_triangle_count / statistics.triangle_count, statistics.range_count / double(frame_count));
+}
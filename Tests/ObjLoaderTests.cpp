@@ -0,0 +1,247 @@
+#include <filesystem>
+#include <fstream>
+#include "Test.h"
+#include "Rendering/ObjLoader.h"
+#include "Utilities/Timer.h"
+//compiled by ModelImporter.cpp in the engine
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+using namespace adria;
+
+namespace
+{
+	std::string TestFilePath(char const* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	char const* const OBJ_MATERIALS[] = { "stone", "grass", "bark" };
+
+	void WriteMaterialLibrary(std::string const& path)
+	{
+		std::string contents;
+		for (char const* material : OBJ_MATERIALS) contents += std::string("newmtl ") + material + "\nKd 1 1 1\nmap_Kd " + material + ".png\n\n";
+		std::ofstream(path, std::ios::binary) << contents;
+	}
+
+	/* Two grids of cells x cells quads split into triangles. The faces of the first grid come after all its vertices and reference
+	   them with negative indices, the faces of the second mix positive indices into the first with negative ones into the second.
+	   Faces are written several times over with o, g and usemtl lines every few dozen triangles, once a file is split into chunks
+	   the faces of a chunk reference vertices and use shapes and materials from the chunks before it. */
+	std::string GenerateObj(uint32 cells, uint32 passes)
+	{
+		std::string obj = "# generated\nmtllib adria_obj_loader.mtl\n";
+		char line[256];
+		uint32 const row = cells + 1, grid_vertices = row * row;
+		auto WriteGrid = [&](float height)
+			{
+				for (uint32 j = 0; j <= cells; ++j)
+				{
+					for (uint32 i = 0; i <= cells; ++i)
+					{
+						sprintf_s(line, "v %.4f %.4f %.4f\nvt %.4f %.4f\nvn 0 1 0\n", (float)i, height + 0.01f * ((i * 7 + j * 3) % 11), (float)j,
+							i / (float)cells, j / (float)cells);
+						obj += line;
+					}
+				}
+			};
+
+		uint32 triangle = 0, event = 0;
+		auto WriteEvent = [&]()
+			{
+				if (triangle++ % 37 != 0) return;
+				switch (event++ % 4)
+				{
+				case 0: sprintf_s(line, "o object_%u\n", event); break;
+				case 1: sprintf_s(line, "g group_%u\n", event); break;
+				default: sprintf_s(line, "usemtl %s\n", OBJ_MATERIALS[event % 3]); break;
+				}
+				obj += line;
+			};
+		//one of v, v/vt, v//vn and v/vt/vn, a / b / c are either all negative or all positive
+		auto WriteCorner = [&](int32 a, int32 b, int32 c, uint32 format)
+			{
+				switch (format % 4)
+				{
+				case 0: sprintf_s(line, " %d", a); break;
+				case 1: sprintf_s(line, " %d/%d", a, b); break;
+				case 2: sprintf_s(line, " %d//%d", a, c); break;
+				default: sprintf_s(line, " %d/%d/%d", a, b, c); break;
+				}
+				obj += line;
+			};
+		//vertex of grid g at (i, j), negative indices count back from the vertices written so far
+		auto WriteFaces = [&](uint32 pass, int32 vertex_count, auto&& Index)
+			{
+				for (uint32 j = 0; j < cells; ++j)
+				{
+					for (uint32 i = 0; i < cells; ++i)
+					{
+						int32 const quad[4] = { Index(i, j, vertex_count), Index(i, j + 1, vertex_count), Index(i + 1, j + 1, vertex_count), Index(i + 1, j, vertex_count) };
+						for (uint32 t = 0; t < 2; ++t)
+						{
+							WriteEvent();
+							uint32 const format = i + j + t + pass;
+							obj += "f";
+							for (uint32 k : { 0u, 1u + t, 2u + t }) WriteCorner(quad[k], quad[k], quad[k], format);
+							obj += "\n";
+						}
+					}
+				}
+			};
+
+		WriteGrid(0.0f);
+		for (uint32 pass = 0; pass < passes; ++pass)
+		{
+			WriteFaces(pass, (int32)grid_vertices, [row](uint32 i, uint32 j, int32 vertex_count) { return (int32)(j * row + i) - vertex_count; });
+		}
+		WriteGrid(1.0f);
+		for (uint32 pass = 0; pass < passes; ++pass)
+		{
+			WriteFaces(pass, 2 * (int32)grid_vertices, [row, grid_vertices](uint32 i, uint32 j, int32 vertex_count)
+				{
+					//odd rows come from the first grid with positive indices
+					return j % 2 ? (int32)(j * row + i) + 1 : (int32)(grid_vertices + j * row + i) - vertex_count;
+				});
+		}
+		return obj;
+	}
+
+	struct ObjTriangle
+	{
+		std::string shape;
+		std::string material;
+		TexturedNormalVertex corners[3];
+	};
+
+	std::vector<ObjTriangle> Triangles(ObjModel const& model)
+	{
+		std::vector<ObjTriangle> triangles;
+		for (ObjShape const& shape : model.shapes)
+		{
+			for (uint64 i = 0; i < shape.indices.size(); i += 3)
+			{
+				ObjTriangle& triangle = triangles.emplace_back();
+				triangle.shape = shape.name;
+				triangle.material = shape.material >= 0 ? model.materials[shape.material].name : "";
+				for (uint32 k = 0; k < 3; ++k) triangle.corners[k] = shape.vertices[shape.indices[i + k]];
+			}
+		}
+		return triangles;
+	}
+
+	std::vector<ObjTriangle> Triangles(tinyobj::attrib_t const& attrib, std::vector<tinyobj::shape_t> const& shapes, std::vector<tinyobj::material_t> const& materials)
+	{
+		std::vector<ObjTriangle> triangles;
+		for (tinyobj::shape_t const& shape : shapes)
+		{
+			for (uint64 f = 0; f < shape.mesh.num_face_vertices.size(); ++f)
+			{
+				ObjTriangle& triangle = triangles.emplace_back();
+				triangle.shape = shape.name;
+				int32 const material = shape.mesh.material_ids[f];
+				triangle.material = material >= 0 ? materials[material].name : "";
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					tinyobj::index_t const& index = shape.mesh.indices[f * 3 + k];
+					TexturedNormalVertex& vertex = triangle.corners[k];
+					vertex.position = Vector3(&attrib.vertices[index.vertex_index * 3]);
+					if (index.texcoord_index >= 0) vertex.uv = Vector2(&attrib.texcoords[index.texcoord_index * 2]);
+					if (index.normal_index >= 0) vertex.normal = Vector3(&attrib.normals[index.normal_index * 3]);
+				}
+			}
+		}
+		return triangles;
+	}
+
+	bool LoadWithTinyObj(std::string const& path, std::vector<ObjTriangle>& triangles)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warning, error;
+		std::string const directory = std::filesystem::path(path).parent_path().string() + "/";
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, path.c_str(), directory.c_str())) return false;
+		triangles = Triangles(attrib, shapes, materials);
+		return true;
+	}
+
+	bool SameVertex(TexturedNormalVertex const& a, TexturedNormalVertex const& b)
+	{
+		return Vector3::DistanceSquared(a.position, b.position) < 1e-10f && Vector2::DistanceSquared(a.uv, b.uv) < 1e-10f &&
+			Vector3::DistanceSquared(a.normal, b.normal) < 1e-10f;
+	}
+}
+
+//whatever the file is split into, the triangles come out as tinyobj reads them, in the same order and with the same shape and material
+ADRIA_TEST(ObjLoaderMatchesTinyObj)
+{
+	std::string const obj_path = TestFilePath("adria_obj_loader.obj");
+	std::string const mtl_path = TestFilePath("adria_obj_loader.mtl");
+	std::string const obj = GenerateObj(24, 3);
+	std::ofstream(obj_path, std::ios::binary) << obj;
+	WriteMaterialLibrary(mtl_path);
+
+	std::vector<ObjTriangle> expected;
+	ADRIA_CHECK(LoadWithTinyObj(obj_path, expected));
+	ADRIA_CHECK(expected.size() == 2 * 3 * 2 * 24 * 24);
+
+	uint64 max_chunk_count = 0;
+	for (uint64 min_chunk_size : { OBJ_MIN_CHUNK_SIZE, obj.size() / 2, obj.size() / 3, (uint64)1 })
+	{
+		ObjModel model{};
+		ADRIA_CHECK(ObjLoader::Load(obj_path, model, min_chunk_size));
+		max_chunk_count = std::max(max_chunk_count, model.chunk_count);
+		ADRIA_CHECK(model.materials.size() == 3);
+		ADRIA_CHECK(model.corner_count == expected.size() * 3);
+
+		std::vector<ObjTriangle> const triangles = Triangles(model);
+		ADRIA_CHECK(triangles.size() == expected.size());
+		uint64 mismatches = 0;
+		for (uint64 t = 0; t < std::min(triangles.size(), expected.size()); ++t)
+		{
+			bool same = triangles[t].shape == expected[t].shape && triangles[t].material == expected[t].material;
+			for (uint32 k = 0; k < 3; ++k) same = same && SameVertex(triangles[t].corners[k], expected[t].corners[k]);
+			mismatches += !same;
+		}
+		ADRIA_CHECK(mismatches == 0);
+
+		//vertices are shared within a shape, never across
+		for (ObjShape const& shape : model.shapes)
+		{
+			ADRIA_CHECK(shape.vertices.size() < shape.indices.size());
+			for (uint32 index : shape.indices) ADRIA_CHECK(index < shape.vertices.size());
+		}
+	}
+	ADRIA_CHECK(max_chunk_count > 1);
+
+	std::filesystem::remove(obj_path);
+	std::filesystem::remove(mtl_path);
+}
+
+ADRIA_BENCHMARK(ObjLoaderParse)
+{
+	std::string const obj_path = TestFilePath("adria_obj_loader_benchmark.obj");
+	std::string const mtl_path = TestFilePath("adria_obj_loader.mtl");
+	std::string const obj = GenerateObj(256, 4);
+	std::ofstream(obj_path, std::ios::binary) << obj;
+	WriteMaterialLibrary(mtl_path);
+
+	Timer<std::chrono::milliseconds> timer;
+	ObjModel model{};
+	ADRIA_CHECK(ObjLoader::Load(obj_path, model));
+	float const load_time = timer.MarkInSeconds();
+	std::vector<ObjTriangle> expected;
+	ADRIA_CHECK(LoadWithTinyObj(obj_path, expected));
+	float const tinyobj_time = timer.MarkInSeconds();
+
+	uint64 shared_vertices = 0;
+	for (ObjShape const& shape : model.shapes) shared_vertices += shape.vertices.size();
+	printf("  %.1f MB, %llu triangles: parsed in %.3f s over %llu chunks, tinyobj %.3f s, %llu soup vertices to %llu shared in %llu shapes\n",
+		obj.size() / (1024.0 * 1024.0), (unsigned long long)(model.corner_count / 3), load_time, (unsigned long long)model.chunk_count, tinyobj_time,
+		(unsigned long long)model.corner_count, (unsigned long long)shared_vertices, (unsigned long long)model.shapes.size());
+
+	std::filesystem::remove(obj_path);
+	std::filesystem::remove(mtl_path);
+}
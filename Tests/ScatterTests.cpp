@@ -0,0 +1,218 @@
+#include <filesystem>
+#include <cstring>
+#include "Test.h"
+#include "Rendering/Scatter.h"
+#include "Rendering/Terrain.h"
+#include "Rendering/TerrainLayers.h"
+#include "Utilities/Image.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	constexpr uint64 TERRAIN_CELLS = 64;
+	constexpr float TERRAIN_TILE_SIZE = 4.0f;
+	constexpr float TERRAIN_SIZE = TERRAIN_CELLS * TERRAIN_TILE_SIZE;
+
+	Terrain TestTerrain()
+	{
+		std::vector<TexturedNormalVertex> vertices((TERRAIN_CELLS + 1) * (TERRAIN_CELLS + 1));
+		for (uint64 j = 0; j <= TERRAIN_CELLS; ++j)
+		{
+			for (uint64 i = 0; i <= TERRAIN_CELLS; ++i)
+			{
+				TexturedNormalVertex& vertex = vertices[j * (TERRAIN_CELLS + 1) + i];
+				vertex.position = Vector3(i * TERRAIN_TILE_SIZE, 0.05f * i, j * TERRAIN_TILE_SIZE);
+				vertex.normal = Vector3(0.0f, 1.0f, 0.0f);
+			}
+		}
+		return Terrain(vertices, TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE, TERRAIN_CELLS, TERRAIN_CELLS);
+	}
+
+	//a layer texture like GenerateTerrainLayerTexture writes, one texel per terrain cell
+	std::vector<uint32> LayerTexels(std::function<uint32(uint32 i, uint32 j)> const& texel)
+	{
+		std::vector<uint32> texels(TERRAIN_CELLS * TERRAIN_CELLS);
+		for (uint32 j = 0; j < TERRAIN_CELLS; ++j) for (uint32 i = 0; i < TERRAIN_CELLS; ++i) texels[j * TERRAIN_CELLS + i] = texel(i, j);
+		return texels;
+	}
+
+	ScatterDesc TestScatterDesc(TerrainLayerMap const* layer_map, TerrainLayer layer)
+	{
+		ScatterDesc desc{};
+		desc.center = Vector2(TERRAIN_SIZE * 0.5f, TERRAIN_SIZE * 0.5f);
+		desc.extents = Vector2(TERRAIN_SIZE * 0.5f, TERRAIN_SIZE * 0.5f);
+		desc.min_distance = 2.0f;
+		if (layer_map)
+		{
+			desc.rules.density_mask = [layer_map, layer](Vector3 const& position, Vector3 const&)
+			{
+				return layer_map->Weight(layer, position.x, position.z);
+			};
+		}
+		return desc;
+	}
+}
+
+ADRIA_TEST(ScatterLayerMapWeights)
+{
+	//grass on the left half, sand on the right one
+	TerrainLayerMap const layer_map(LayerTexels([](uint32 i, uint32) { return i < TERRAIN_CELLS / 2 ? 0xff0000u : 0x00ff00u; }),
+		TERRAIN_CELLS, TERRAIN_CELLS, Vector2(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE));
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Grass, 10.0f, 50.0f), 1.0f, 1e-6f);
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Sand, 10.0f, 50.0f), 0.0f, 1e-6f);
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Sand, 200.0f, 50.0f), 1.0f, 1e-6f);
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Rock, 200.0f, 50.0f), 0.0f, 1e-6f);
+	//halfway between the last grass texel and the first sand one
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Grass, (TERRAIN_CELLS / 2 - 0.5f) * TERRAIN_TILE_SIZE, 50.0f), 0.5f, 1e-6f);
+	//clamped outside the terrain
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Grass, -100.0f, -100.0f), 1.0f, 1e-6f);
+	ADRIA_CHECK_NEAR(layer_map.Weight(TerrainLayer::Sand, 1e5f, 1e5f), 1.0f, 1e-6f);
+}
+
+//ModelImporter reads the layer texture back with Image, rows have to come back in the order they were written
+ADRIA_TEST(ScatterLayerMapFromTexture)
+{
+	std::vector<uint32> const texels = LayerTexels([](uint32 i, uint32 j) { return (i * 4) | ((j * 4) << 8) | 0xff000000u; });
+	std::vector<uint8> data(texels.size() * sizeof(uint32));
+	memcpy(data.data(), texels.data(), data.size());
+
+	std::string const path = (std::filesystem::temp_directory_path() / "adria_layer_map.tga").string();
+	WriteImageTGA(path.c_str(), data, (int)TERRAIN_CELLS, (int)TERRAIN_CELLS);
+	{
+		Image image(path, 4);
+		ADRIA_CHECK(image.Data<uint32>() != nullptr);
+		ADRIA_CHECK(image.Width() == TERRAIN_CELLS && image.Height() == TERRAIN_CELLS);
+		ADRIA_CHECK(std::equal(texels.begin(), texels.end(), image.Data<uint32>()));
+	}
+	std::filesystem::remove(path);
+}
+
+//instances only land where the layer of the mask is painted
+ADRIA_TEST(ScatterLayerDensityMask)
+{
+	Terrain const terrain = TestTerrain();
+	TerrainLayerMap const layer_map(LayerTexels([](uint32 i, uint32) { return i < TERRAIN_CELLS / 2 ? 0xff0000u : 0x00ff00u; }),
+		TERRAIN_CELLS, TERRAIN_CELLS, Vector2(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE));
+
+	std::vector<ScatterInstance> const unmasked = Scatter::Generate(&terrain, TestScatterDesc(nullptr, TerrainLayer::Grass));
+	std::vector<ScatterInstance> const grass = Scatter::Generate(&terrain, TestScatterDesc(&layer_map, TerrainLayer::Grass));
+	std::vector<ScatterInstance> const sand = Scatter::Generate(&terrain, TestScatterDesc(&layer_map, TerrainLayer::Sand));
+	ADRIA_CHECK(!grass.empty() && !sand.empty());
+
+	//the weight falls to zero over the texel after the last grass one
+	float const grass_end = (TERRAIN_CELLS / 2) * TERRAIN_TILE_SIZE;
+	float const sand_start = (TERRAIN_CELLS / 2 - 1) * TERRAIN_TILE_SIZE;
+	for (ScatterInstance const& instance : grass) ADRIA_CHECK(instance.position.x < grass_end);
+	for (ScatterInstance const& instance : sand) ADRIA_CHECK(instance.position.x > sand_start);
+
+	uint64 const unmasked_left = std::count_if(unmasked.begin(), unmasked.end(), [&](ScatterInstance const& instance) { return instance.position.x < sand_start; });
+	ADRIA_CHECK(grass.size() >= unmasked_left);
+	ADRIA_CHECK(grass.size() + sand.size() <= unmasked.size() + unmasked.size() / 20);
+	printf("  %llu instances without a mask, %llu on grass, %llu on sand\n", (unsigned long long)unmasked.size(),
+		(unsigned long long)grass.size(), (unsigned long long)sand.size());
+}
+
+//a partial weight keeps that fraction of the points
+ADRIA_TEST(ScatterLayerDensityFollowsWeight)
+{
+	Terrain const terrain = TestTerrain();
+	TerrainLayerMap const layer_map(LayerTexels([](uint32, uint32) { return 0x400000u; }), TERRAIN_CELLS, TERRAIN_CELLS, Vector2(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE));
+
+	std::vector<ScatterInstance> const unmasked = Scatter::Generate(&terrain, TestScatterDesc(nullptr, TerrainLayer::Grass));
+	std::vector<ScatterInstance> const masked = Scatter::Generate(&terrain, TestScatterDesc(&layer_map, TerrainLayer::Grass));
+	float const kept = masked.size() / float(unmasked.size());
+	ADRIA_CHECK_NEAR(kept, 0x40 / 255.0f, 0.03f);
+}
+
+//no two points closer than the min distance, also across the tiles and the parity phases they are filled in
+ADRIA_TEST(ScatterMinimumDistance)
+{
+	for (float tile_size : { 4.0f, 10.0f, 0.0f })
+	{
+		ScatterDesc desc{};
+		desc.center = Vector2(64.0f, 48.0f);
+		desc.extents = Vector2(64.0f, 48.0f);
+		desc.min_distance = 1.5f;
+		desc.tile_size = tile_size;
+		std::vector<ScatterInstance> const instances = Scatter::Generate(nullptr, desc);
+		ADRIA_CHECK(!instances.empty());
+
+		float min_distance_sq = std::numeric_limits<float>::max();
+		for (size_t i = 0; i < instances.size(); ++i)
+		{
+			Vector3 const& p = instances[i].position;
+			ADRIA_CHECK(p.x >= 0.0f && p.x <= 128.0f && p.z >= 0.0f && p.z <= 96.0f);
+			for (size_t j = i + 1; j < instances.size(); ++j)
+			{
+				Vector3 const& q = instances[j].position;
+				min_distance_sq = std::min(min_distance_sq, (p.x - q.x) * (p.x - q.x) + (p.z - q.z) * (p.z - q.z));
+			}
+		}
+		ADRIA_CHECK(min_distance_sq >= desc.min_distance * desc.min_distance);
+		printf("  tile size %.1f: %llu points, closest pair %.3f m apart\n", tile_size, (unsigned long long)instances.size(), std::sqrt(min_distance_sq));
+	}
+}
+
+//every tile has its own random streams, the result is the same bit for bit whatever thread fills which tile
+ADRIA_TEST(ScatterIsDeterministic)
+{
+	Terrain const terrain = TestTerrain();
+	TerrainLayerMap const layer_map(LayerTexels([](uint32 i, uint32 j) { return ((i * 7 + j * 3) % 256) << 16; }), TERRAIN_CELLS, TERRAIN_CELLS,
+		Vector2(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE));
+	ScatterDesc desc = TestScatterDesc(&layer_map, TerrainLayer::Grass);
+	desc.min_distance = 0.5f;
+	desc.tile_size = 6.0f;
+
+	std::vector<ScatterInstance> const first = Scatter::Generate(&terrain, desc);
+	ADRIA_CHECK(!first.empty());
+	for (uint32 run = 0; run < 4; ++run)
+	{
+		std::vector<ScatterInstance> const next = Scatter::Generate(&terrain, desc);
+		ADRIA_CHECK(next.size() == first.size() && memcmp(next.data(), first.data(), first.size() * sizeof(ScatterInstance)) == 0);
+	}
+
+	desc.seed += 1;
+	std::vector<ScatterInstance> const reseeded = Scatter::Generate(&terrain, desc);
+	ADRIA_CHECK(reseeded.size() != first.size() || memcmp(reseeded.data(), first.data(), first.size() * sizeof(ScatterInstance)) != 0);
+}
+
+//the min distance picked for a count gives about that many points
+ADRIA_TEST(ScatterCountForMinDistance)
+{
+	for (uint64 count : { 5000ull, 50000ull })
+	{
+		ScatterDesc desc{};
+		desc.center = Vector2(0.0f, 0.0f);
+		desc.extents = Vector2(200.0f, 100.0f);
+		desc.min_distance = Scatter::MinDistanceForCount(desc.extents, count);
+		uint64 const generated = Scatter::Generate(nullptr, desc).size();
+		ADRIA_CHECK(generated > count * 8 / 10 && generated < count * 12 / 10);
+		printf("  %llu points requested, %llu generated with a min distance of %.3f m\n", (unsigned long long)count, (unsigned long long)generated, desc.min_distance);
+	}
+}
+
+ADRIA_BENCHMARK(Scatter1M)
+{
+	Terrain const terrain = TestTerrain();
+	TerrainLayerMap const layer_map(LayerTexels([](uint32 i, uint32 j) { return ((i * 7 + j * 3) % 256) << 16; }), TERRAIN_CELLS, TERRAIN_CELLS,
+		Vector2(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE));
+	ScatterDesc desc = TestScatterDesc(&layer_map, TerrainLayer::Grass);
+	desc.min_distance = Scatter::MinDistanceForCount(desc.extents, 1000000);
+	float const area = 4.0f * desc.extents.x * desc.extents.y;
+
+	//the poisson points alone, then with the height, slope and mask rules on the terrain
+	ScatterDesc unruled = desc;
+	unruled.rules = ScatterRules{};
+	Timer<std::chrono::milliseconds> timer;
+	uint64 const point_count = Scatter::Generate(nullptr, unruled).size();
+	float const poisson_time = timer.MarkInSeconds();
+	uint64 const instance_count = Scatter::Generate(&terrain, desc).size();
+	float const total_time = timer.MarkInSeconds();
+
+	printf("  %llu points over %.0f m^2 with a min distance of %.3f m: %.2f points/m^2 in %.3f s\n", (unsigned long long)point_count, area,
+		desc.min_distance, point_count / area, poisson_time);
+	printf("  %llu instances after the rules (%.2f instances/m^2) in %.3f s, %.3f s of rules\n", (unsigned long long)instance_count,
+		instance_count / area, total_time, std::max(total_time - poisson_time, 0.0f));
+}
@@ -0,0 +1,158 @@
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Math/ComputeNormals.h"
+#include "Math/ComputeTangentFrame.h"
+#include "Math/Constants.h"
+#include "Graphics/GfxVertexFormat.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	//the bumpy sphere with its uvs plus a restart index that both paths skip, the noise makes the corner weights differ
+	void CreateSphere(uint32 rings, uint32 segments, std::vector<CompleteVertex>& vertices, std::vector<uint32>& indices)
+	{
+		test::SphereMesh const mesh = test::CreateSphere(rings, segments, 1.0f, 0.05f);
+		vertices.assign(mesh.positions.size(), CompleteVertex{});
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].position = mesh.positions[i];
+			vertices[i].uv = mesh.uvs[i];
+		}
+		indices = mesh.indices;
+		indices.insert(indices.end(), { uint32(-1), 0, 1 });
+	}
+}
+
+//the parallel path gathers the same weighted face normals in the same order as the serial reference
+ADRIA_TEST(ComputeNormalsParallelMatchesSerial)
+{
+	std::vector<CompleteVertex> vertices;
+	std::vector<uint32> indices;
+	CreateSphere(48, 96, vertices, indices);
+	for (ENormalCalculation normal_type : { ENormalCalculation::EqualWeight, ENormalCalculation::AngleWeight, ENormalCalculation::AreaWeight })
+	{
+		for (bool cw : { false, true })
+		{
+			std::vector<CompleteVertex> serial_vertices = vertices;
+			std::vector<CompleteVertex> parallel_vertices = vertices;
+			ComputeNormals(normal_type, serial_vertices, indices, cw);
+			ComputeNormals(std::execution::par, normal_type, parallel_vertices, indices, cw);
+			for (uint64 i = 0; i < vertices.size(); ++i)
+			{
+				ADRIA_CHECK_NEAR(parallel_vertices[i].normal.x, serial_vertices[i].normal.x, 1e-5f);
+				ADRIA_CHECK_NEAR(parallel_vertices[i].normal.y, serial_vertices[i].normal.y, 1e-5f);
+				ADRIA_CHECK_NEAR(parallel_vertices[i].normal.z, serial_vertices[i].normal.z, 1e-5f);
+				//outward on the sphere unless the winding is flipped, the first and the last vertex are not used by any face
+				if (i == 0 || i == vertices.size() - 1) continue;
+				float const outward = parallel_vertices[i].normal.Dot(vertices[i].position);
+				ADRIA_CHECK(cw ? outward < 0.0f : outward > 0.0f);
+			}
+		}
+	}
+}
+
+//Gram-Schmidt removes the component along the normal, and the handedness comes from the uv winding
+ADRIA_TEST(ComputeTangentFrameGramSchmidt)
+{
+	uint32 const indices[] = { 0, 1, 2 };
+	XMFLOAT3 const positions[] = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) };
+	float const s = std::sqrt(0.5f);
+	XMFLOAT3 const normals[] = { XMFLOAT3(s, 0.0f, s), XMFLOAT3(s, 0.0f, s), XMFLOAT3(s, 0.0f, s) };
+	XMFLOAT2 const uvs[] = { XMFLOAT2(0.0f, 0.0f), XMFLOAT2(1.0f, 0.0f), XMFLOAT2(0.0f, 1.0f) };
+	XMFLOAT2 const mirrored_uvs[] = { XMFLOAT2(0.0f, 0.0f), XMFLOAT2(1.0f, 0.0f), XMFLOAT2(0.0f, -1.0f) };
+
+	XMFLOAT3 tangents[3], bitangents[3];
+	ComputeTangentFrame(indices, 3, positions, normals, uvs, 3, tangents, bitangents);
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		ADRIA_CHECK_NEAR(tangents[i].x, s, 1e-6f);
+		ADRIA_CHECK_NEAR(tangents[i].y, 0.0f, 1e-6f);
+		ADRIA_CHECK_NEAR(tangents[i].z, -s, 1e-6f);
+		ADRIA_CHECK_NEAR(bitangents[i].x, 0.0f, 1e-6f);
+		ADRIA_CHECK_NEAR(bitangents[i].y, 1.0f, 1e-6f);
+		ADRIA_CHECK_NEAR(bitangents[i].z, 0.0f, 1e-6f);
+	}
+
+	ComputeTangentFrame(indices, 3, positions, normals, mirrored_uvs, 3, tangents, bitangents);
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		ADRIA_CHECK_NEAR(tangents[i].x, s, 1e-6f);
+		ADRIA_CHECK_NEAR(tangents[i].z, -s, 1e-6f);
+		ADRIA_CHECK_NEAR(bitangents[i].y, -1.0f, 1e-6f);
+	}
+}
+
+//on a smooth mesh the corner angle weighted frames stay close to the scalar reference, and are orthonormal with the same handedness
+ADRIA_TEST(ComputeTangentFrameParallelMatchesSerial)
+{
+	std::vector<CompleteVertex> vertices;
+	std::vector<uint32> indices;
+	CreateSphere(48, 96, vertices, indices);
+	ComputeNormals(ENormalCalculation::AngleWeight, vertices, indices);
+	//the scalar reference has no restart handling
+	std::vector<uint32> const reference_indices(indices.begin(), indices.end() - 3);
+
+	std::vector<XMFLOAT3> positions(vertices.size()), normals(vertices.size()), tangents(vertices.size()), bitangents(vertices.size());
+	std::vector<XMFLOAT2> uvs(vertices.size());
+	for (uint64 i = 0; i < vertices.size(); ++i)
+	{
+		positions[i] = vertices[i].position;
+		normals[i] = vertices[i].normal;
+		uvs[i] = vertices[i].uv;
+	}
+	ComputeTangentFrame(reference_indices.data(), reference_indices.size(), positions.data(), normals.data(), uvs.data(), vertices.size(), tangents.data(), bitangents.data());
+
+	std::vector<CompleteVertex> parallel_vertices = vertices;
+	std::vector<CompleteVertex> sequenced_vertices = vertices;
+	ComputeTangentFrame(std::execution::par, parallel_vertices, indices);
+	ComputeTangentFrame(std::execution::seq, sequenced_vertices, indices);
+
+	float max_angle = 0.0f;
+	for (uint64 i = 0; i < vertices.size(); ++i)
+	{
+		CompleteVertex const& vertex = parallel_vertices[i];
+		ADRIA_CHECK(memcmp(&vertex, &sequenced_vertices[i], sizeof(CompleteVertex)) == 0);
+		ADRIA_CHECK_NEAR(vertex.tangent.Length(), 1.0f, 1e-4f);
+		ADRIA_CHECK_NEAR(vertex.bitangent.Length(), 1.0f, 1e-4f);
+		ADRIA_CHECK(std::abs(vertex.tangent.Dot(vertex.normal)) < 1e-4f);
+		ADRIA_CHECK(std::abs(vertex.bitangent.Dot(vertex.tangent)) < 1e-4f);
+
+		//the poles collapse a whole uv row onto one point, neither frame means much there
+		if (i <= 96 || i >= vertices.size() - 97) continue;
+		float const angle = test::AngleInDegrees(vertex.tangent, tangents[i]);
+		max_angle = std::max(max_angle, angle);
+		ADRIA_CHECK(angle < 5.0f);
+		ADRIA_CHECK(vertex.bitangent.Dot(bitangents[i]) > 0.0f);
+	}
+	printf("  largest angle to the scalar tangents away from the poles: %.3f deg\n", max_angle);
+}
+
+ADRIA_BENCHMARK(TangentFrameScaling)
+{
+	std::vector<CompleteVertex> vertices;
+	std::vector<uint32> indices;
+	CreateSphere(500, 1000, vertices, indices);
+	printf("  %llu vertices, %llu triangles\n", (unsigned long long)vertices.size(), (unsigned long long)(indices.size() / 3));
+
+	for (ENormalCalculation normal_type : { ENormalCalculation::EqualWeight, ENormalCalculation::AngleWeight, ENormalCalculation::AreaWeight })
+	{
+		std::vector<CompleteVertex> normal_vertices = vertices;
+		Timer<std::chrono::milliseconds> timer;
+		ComputeNormals(normal_type, normal_vertices, indices);
+		float const serial_time = timer.MarkInSeconds();
+		ComputeNormals(std::execution::par, normal_type, normal_vertices, indices);
+		float const parallel_time = timer.MarkInSeconds();
+		printf("  ComputeNormals %-12s seq %.3f s, par %.3f s\n", normal_type == ENormalCalculation::EqualWeight ? "equal" :
+			normal_type == ENormalCalculation::AngleWeight ? "angle" : "area", serial_time, parallel_time);
+	}
+
+	ComputeNormals(std::execution::par, ENormalCalculation::AngleWeight, vertices, indices);
+	Timer<std::chrono::milliseconds> timer;
+	ComputeTangentFrame(std::execution::seq, vertices, indices);
+	float const serial_time = timer.MarkInSeconds();
+	ComputeTangentFrame(std::execution::par, vertices, indices);
+	float const parallel_time = timer.MarkInSeconds();
+	printf("  ComputeTangentFrame       seq %.3f s, par %.3f s\n", serial_time, parallel_time);
+}
@@ -0,0 +1,63 @@
+#include <random>
+#include "Test.h"
+#include "Rendering/TerrainLayers.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	std::vector<uint8> RandomLayerTexels(uint64 width, uint64 depth, uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint8> texels(width * depth * 4);
+		for (uint8& texel : texels) texel = (uint8)(rng() & 0xff);
+		return texels;
+	}
+
+	//the filter as it reads: the mean of the 5x5 texels around every interior texel, borders copied
+	std::vector<uint8> NaiveBoxBlur(std::vector<uint8> const& texels, uint64 width, uint64 depth)
+	{
+		int64 const radius = TERRAIN_LAYER_BLUR_RADIUS;
+		std::vector<uint8> blurred = texels;
+		for (int64 j = radius; j < (int64)depth - radius; ++j)
+		{
+			for (int64 i = radius; i < (int64)width - radius; ++i)
+			{
+				for (uint32 c = 0; c < 3; ++c)
+				{
+					uint32 sum = 0;
+					for (int64 y = j - radius; y <= j + radius; ++y)
+						for (int64 x = i - radius; x <= i + radius; ++x) sum += texels[(y * width + x) * 4 + c];
+					blurred[(j * width + i) * 4 + c] = (uint8)(sum / ((2 * radius + 1) * (2 * radius + 1)));
+				}
+			}
+		}
+		return blurred;
+	}
+}
+
+//sizes around the column strips and the filter size, down to textures with no interior texels at all
+ADRIA_TEST(TerrainLayersBlurMatchesBoxFilter)
+{
+	uint64 const sizes[][2] = { { 256, 256 }, { 131, 77 }, { 64, 5 }, { 5, 65 }, { 129, 6 }, { 4, 100 }, { 3, 3 } };
+	for (auto const& [width, depth] : sizes)
+	{
+		std::vector<uint8> texels = RandomLayerTexels(width, depth, (uint32)(width * 1000 + depth));
+		std::vector<uint8> const expected = NaiveBoxBlur(texels, width, depth);
+		BlurTerrainLayerWeights(texels, width, depth);
+		ADRIA_CHECK(texels == expected);
+	}
+}
+
+ADRIA_BENCHMARK(TerrainLayersBlur)
+{
+	for (uint64 size : { 2048ull, 8192ull })
+	{
+		std::vector<uint8> texels = RandomLayerTexels(size, size, 3);
+		Timer<std::chrono::milliseconds> timer;
+		BlurTerrainLayerWeights(texels, size, size);
+		float const blur_time = timer.ElapsedInSeconds();
+		printf("  %llux%llu: %.3f s, %.1f Mtexels/s\n", (unsigned long long)size, (unsigned long long)size, blur_time, size * size / 1e6 / std::max(blur_time, 1e-6f));
+	}
+}
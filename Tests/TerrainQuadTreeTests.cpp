@@ -0,0 +1,233 @@
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Rendering/TerrainQuadTree.h"
+#include "Utilities/Heightmap.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+using namespace DirectX;
+
+namespace
+{
+	float TestHeight(uint64 x, uint64 z)
+	{
+		return 40.0f * std::sin(x * 0.01f) * std::cos(z * 0.013f) + 10.0f * std::sin((x + z) * 0.05f);
+	}
+
+	struct InstanceRect
+	{
+		float min_x, min_z, max_x, max_z;
+	};
+
+	InstanceRect CoveredRect(TerrainLODInstance const& instance)
+	{
+		InstanceRect rect{ instance.offset.x, instance.offset.y, instance.offset.x + instance.scale.x, instance.offset.y + instance.scale.y };
+		if (instance.quadrant != TerrainNodeQuadrant_All)
+		{
+			float const half_x = instance.scale.x * 0.5f, half_z = instance.scale.y * 0.5f;
+			rect.min_x += (instance.quadrant & 1) * half_x;
+			rect.min_z += (instance.quadrant >> 1) * half_z;
+			rect.max_x = rect.min_x + half_x;
+			rect.max_z = rect.min_z + half_z;
+		}
+		return rect;
+	}
+
+	//shortest distance from the camera to the bounds of the node the instance was made from
+	float NodeDistance(TerrainQuadTree const& quadtree, TerrainLODInstance const& instance, Vector3 const& camera_position)
+	{
+		TerrainQuadTreeDesc const& desc = quadtree.Desc();
+		uint32 const node_size = desc.leaf_node_size << instance.lod;
+		uint32 const x = (uint32)std::lround((instance.offset.x - desc.offset.x) / (node_size * desc.tile_size_x));
+		uint32 const z = (uint32)std::lround((instance.offset.y - desc.offset.z) / (node_size * desc.tile_size_z));
+		BoundingBox const bounds = quadtree.NodeBounds(instance.lod, x, z);
+		Vector3 const closest = Vector3::Min(Vector3::Max(camera_position, Vector3(bounds.Center) - Vector3(bounds.Extents)), Vector3(bounds.Center) + Vector3(bounds.Extents));
+		return Vector3::Distance(camera_position, closest);
+	}
+
+	//what the terrain vertex shader does to a patch vertex
+	Vector2 MorphPatchVertex(Vector2 const& grid, float patch_size, float morph)
+	{
+		Vector2 const fraction(grid.x * patch_size * 0.5f - std::floor(grid.x * patch_size * 0.5f), grid.y * patch_size * 0.5f - std::floor(grid.y * patch_size * 0.5f));
+		return grid - fraction * 2.0f / patch_size * morph;
+	}
+}
+
+ADRIA_TEST(TerrainQuadTreePatchQuadrants)
+{
+	std::vector<Vector2> vertices;
+	std::vector<uint16> indices;
+	TerrainQuadTree::GeneratePatch(32, vertices, indices);
+	ADRIA_CHECK(vertices.size() == 33 * 33);
+	ADRIA_CHECK(indices.size() == 32 * 32 * 6);
+
+	size_t const quadrant_index_count = indices.size() / 4;
+	for (uint32 quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		float const min_x = (quadrant & 1) * 0.5f, min_z = (quadrant >> 1) * 0.5f;
+		for (size_t i = quadrant * quadrant_index_count; i < (quadrant + 1) * quadrant_index_count; ++i)
+		{
+			Vector2 const& vertex = vertices[indices[i]];
+			ADRIA_CHECK(vertex.x >= min_x && vertex.x <= min_x + 0.5f);
+			ADRIA_CHECK(vertex.y >= min_z && vertex.y <= min_z + 0.5f);
+		}
+	}
+}
+
+//every visible point of the terrain is drawn by exactly one instance and no point is drawn twice
+ADRIA_TEST(TerrainQuadTreeSelectionCoversVisibleTerrain)
+{
+	TerrainQuadTreeDesc desc{};
+	desc.tile_size_x = desc.tile_size_z = 2.0f;
+	desc.offset = Vector3(-1000.0f, 5.0f, -1000.0f);
+	desc.lod0_range = 50.0f;
+	TerrainQuadTree quadtree(1025, 1025, TestHeight, desc);
+
+	Vector3 const camera_position(-200.0f, 80.0f, 100.0f);
+	BoundingFrustum const frustum = test::TestFrustum(camera_position, Vector3(300.0f, 0.0f, 400.0f), 5000.0f);
+	std::vector<TerrainLODInstance> instances;
+	quadtree.Select(camera_position, frustum, instances);
+	ADRIA_CHECK(!instances.empty());
+
+	uint32 visible_points = 0;
+	for (uint64 z = 0; z < 1024; z += 3)
+	{
+		for (uint64 x = 0; x < 1024; x += 3)
+		{
+			float const px = desc.offset.x + (x + 0.5f) * desc.tile_size_x;
+			float const pz = desc.offset.z + (z + 0.5f) * desc.tile_size_z;
+			uint32 covered = 0;
+			for (TerrainLODInstance const& instance : instances)
+			{
+				InstanceRect const rect = CoveredRect(instance);
+				if (px >= rect.min_x && px < rect.max_x && pz >= rect.min_z && pz < rect.max_z) ++covered;
+			}
+			ADRIA_CHECK(covered <= 1);
+
+			Vector3 const point(px, desc.offset.y + TestHeight(x, z), pz);
+			if (frustum.Contains(point) != DISJOINT)
+			{
+				++visible_points;
+				ADRIA_CHECK(covered == 1);
+			}
+		}
+	}
+	ADRIA_CHECK(visible_points > 0);
+}
+
+ADRIA_TEST(TerrainQuadTreeLODFollowsDistance)
+{
+	TerrainQuadTreeDesc desc{};
+	desc.lod0_range = 80.0f;
+	TerrainQuadTree quadtree(4097, 4097, TestHeight, desc);
+
+	Vector3 const camera_position(900.0f, 60.0f, 1100.0f);
+	BoundingFrustum const frustum = test::TestFrustum(camera_position, Vector3(1200.0f, 0.0f, 1500.0f), 10000.0f);
+	std::vector<TerrainLODInstance> instances;
+	quadtree.Select(camera_position, frustum, instances);
+
+	uint32 const top_lod = quadtree.LODCount() - 1;
+	std::vector<uint32> lod_counts(quadtree.LODCount(), 0);
+	for (TerrainLODInstance const& instance : instances)
+	{
+		++lod_counts[instance.lod];
+		float const distance = NodeDistance(quadtree, instance, camera_position);
+		//in range of its own lod, or of the coarsest one that draws everything further away
+		if (instance.lod < top_lod) ADRIA_CHECK(distance <= quadtree.LODRange(instance.lod));
+		//a whole node is only drawn when none of it is in range of the finer lod
+		if (instance.lod > 0 && instance.quadrant == TerrainNodeQuadrant_All) ADRIA_CHECK(distance > quadtree.LODRange(instance.lod - 1));
+	}
+	ADRIA_CHECK(lod_counts[0] > 0);
+	ADRIA_CHECK(lod_counts[top_lod] > 0);
+}
+
+ADRIA_TEST(TerrainQuadTreeMorphRanges)
+{
+	TerrainQuadTreeDesc desc{};
+	TerrainQuadTree quadtree(1025, 1025, TestHeight, desc);
+
+	Vector3 const camera_position(500.0f, 50.0f, 500.0f);
+	BoundingFrustum const frustum = test::TestFrustum(camera_position, Vector3(600.0f, 0.0f, 700.0f), 5000.0f);
+	std::vector<TerrainLODInstance> instances;
+	quadtree.Select(camera_position, frustum, instances);
+	ADRIA_CHECK(!instances.empty());
+	for (TerrainLODInstance const& instance : instances)
+	{
+		float const previous_range = instance.lod > 0 ? quadtree.LODRange(instance.lod - 1) : 0.0f;
+		ADRIA_CHECK(instance.morph_range.y == quadtree.LODRange(instance.lod));
+		ADRIA_CHECK(instance.morph_range.x >= previous_range && instance.morph_range.x < instance.morph_range.y);
+	}
+
+	//fully morphed, the vertices of a patch land on the vertices of the patch of the next lod, half as dense
+	std::vector<Vector2> vertices;
+	std::vector<uint16> indices;
+	TerrainQuadTree::GeneratePatch(desc.leaf_node_size, vertices, indices);
+	float const patch_size = (float)desc.leaf_node_size;
+	for (Vector2 const& vertex : vertices)
+	{
+		Vector2 const unmorphed = MorphPatchVertex(vertex, patch_size, 0.0f);
+		ADRIA_CHECK_NEAR(unmorphed.x, vertex.x, 1e-6f);
+		ADRIA_CHECK_NEAR(unmorphed.y, vertex.y, 1e-6f);
+
+		Vector2 const morphed = MorphPatchVertex(vertex, patch_size, 1.0f) * patch_size * 0.5f;
+		ADRIA_CHECK_NEAR(morphed.x, std::round(morphed.x), 1e-4f);
+		ADRIA_CHECK_NEAR(morphed.y, std::round(morphed.y), 1e-4f);
+	}
+}
+
+ADRIA_TEST(TerrainQuadTreeFromHeightmap)
+{
+	std::vector<float> heights(129 * 129);
+	for (uint64 z = 0; z < 129; ++z) for (uint64 x = 0; x < 129; ++x) heights[z * 129 + x] = TestHeight(x, z);
+	Heightmap heightmap(129, 129, heights.data());
+
+	TerrainQuadTreeDesc desc{};
+	desc.lod_count = 3;
+	TerrainQuadTree quadtree(heightmap, desc);
+	ADRIA_CHECK(quadtree.LODCount() == 3);
+
+	//bounds of the nodes of lod 1, 64 cells wide, hold every sample below them
+	for (uint32 z = 0; z < 2; ++z)
+	{
+		for (uint32 x = 0; x < 2; ++x)
+		{
+			BoundingBox const bounds = quadtree.NodeBounds(1, x, z);
+			for (uint64 sz = z * 64; sz <= z * 64 + 64; ++sz)
+			{
+				for (uint64 sx = x * 64; sx <= x * 64 + 64; ++sx)
+				{
+					ADRIA_CHECK(heightmap.HeightAt(sx, sz) >= bounds.Center.y - bounds.Extents.y - 1e-3f);
+					ADRIA_CHECK(heightmap.HeightAt(sx, sz) <= bounds.Center.y + bounds.Extents.y + 1e-3f);
+				}
+			}
+		}
+	}
+}
+
+ADRIA_BENCHMARK(TerrainQuadTree16k)
+{
+	NoiseDesc const noise_desc{ .width = 16385, .depth = 16385, .max_height = 400, .fractal_type = FractalType::FBM, .noise_type = NoiseType::Perlin,
+		.seed = 33, .frequency = 0.1f, .persistence = 0.5f, .lacunarity = 2.0f, .octaves = 4, .noise_scale = 16.0f };
+
+	Timer<std::chrono::milliseconds> timer;
+	TerrainQuadTreeDesc desc{};
+	desc.lod_count = 9;
+	TerrainQuadTree quadtree(noise_desc.width, noise_desc.depth, CreateNoiseHeightSource(noise_desc), desc);
+	printf("  16385x16385 build: %.3f s, %.2f MB of node bounds\n", timer.ElapsedInSeconds(), quadtree.MemoryUsage() / (1024.0 * 1024.0));
+
+	uint32 const frame_count = 1000;
+	uint64 instance_count = 0;
+	std::vector<TerrainLODInstance> instances;
+	Timer<std::chrono::microseconds> select_timer;
+	for (uint32 frame = 0; frame < frame_count; ++frame)
+	{
+		//flies diagonally over the whole terrain
+		float const t = frame / float(frame_count);
+		Vector3 const camera_position(500.0f + 15000.0f * t, 150.0f, 800.0f + 14000.0f * t);
+		BoundingFrustum const frustum = test::TestFrustum(camera_position, camera_position + Vector3(1.0f, -0.2f, 0.7f), 20000.0f);
+		quadtree.Select(camera_position, frustum, instances);
+		instance_count += instances.size();
+	}
+	printf("  selection: %.3f ms per frame, %.1f instances per frame\n", select_timer.ElapsedInSeconds() * 1000.0f / frame_count,
+		instance_count / double(frame_count));
+}
@@ -0,0 +1,194 @@
+#include <filesystem>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Rendering/TerrainStreaming.h"
+#include "Rendering/TerrainLayers.h"
+#include "Rendering/Terrain.h"
+#include "Graphics/GfxVertexFormat.h"
+#include "Tasks/TaskManager.h"
+#include "Utilities/Heightmap.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	//64 km across with 32 m between samples, smooth enough that bilinear filtering of the samples stays within quantization
+	constexpr uint64 PAN_TERRAIN_SAMPLES = 2049;
+	constexpr float PAN_SAMPLE_SPACING = 32.0f;
+
+	float PanTerrainHeight(float x, float z)
+	{
+		return 300.0f * std::sin(x / 3000.0f) * std::cos(z / 2500.0f);
+	}
+
+	std::string TestFilePath(char const* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	//makes every mip 0 tile resident, the budget has to hold them
+	void MakeFinestMipResident(TerrainTileCache& cache, float terrain_size)
+	{
+		Vector3 const center(terrain_size * 0.5f, 0.0f, terrain_size * 0.5f);
+		cache.Update(center, terrain_size);
+		cache.WaitForPendingLoads();
+	}
+
+	//heights of mip 0 tiles are quantized to 16 bits over the height range of the terrain
+	void CheckMatchesHeightmap(TerrainTileCache const& cache, Heightmap const& heightmap)
+	{
+		float min_height = std::numeric_limits<float>::max(), max_height = std::numeric_limits<float>::lowest();
+		for (uint64 i = 0; i < heightmap.Width() * heightmap.Depth(); ++i)
+		{
+			min_height = std::min(min_height, heightmap.Data()[i]);
+			max_height = std::max(max_height, heightmap.Data()[i]);
+		}
+		float const tolerance = (max_height - min_height) / 65535.0f + 1e-3f;
+		for (uint64 z = 0; z < heightmap.Depth(); z += 5)
+		{
+			for (uint64 x = 0; x < heightmap.Width(); x += 5)
+			{
+				ADRIA_CHECK_NEAR(cache.HeightAt((float)x, (float)z), heightmap.HeightAt(x, z), tolerance);
+			}
+		}
+	}
+}
+
+//the exported height field is the normalized one Heightmap(NoiseDesc) makes, not the raw noise
+ADRIA_TEST(TerrainStreamingFromNoiseMatchesHeightmap)
+{
+	g_TaskManager.Initialize();
+	NoiseDesc const noise_desc = test::TestNoiseDesc(257, 7, 100);
+	TerrainTileGeneratorDesc desc{};
+	desc.output_path = TestFilePath("adria_from_noise.atrn");
+	desc.tile_resolution = 64;
+	ADRIA_CHECK(TerrainTileGenerator::FromNoise(noise_desc, nullptr, nullptr, TerrainTextureLayerParameters{}, desc));
+	{
+		TerrainTileCache cache(desc.output_path, 64ull << 20);
+		ADRIA_CHECK(cache.IsValid());
+		MakeFinestMipResident(cache, 256.0f);
+		CheckMatchesHeightmap(cache, Heightmap(noise_desc));
+	}
+	std::filesystem::remove(desc.output_path);
+}
+
+ADRIA_TEST(TerrainStreamingFromNoiseAppliesErosion)
+{
+	g_TaskManager.Initialize();
+	NoiseDesc const noise_desc = test::TestNoiseDesc(257, 7, 100);
+	ThermalErosionDesc const thermal_desc{ .iterations = 3, .c = 0.5f, .talus = 0.025f };
+	TerrainTileGeneratorDesc desc{};
+	desc.output_path = TestFilePath("adria_from_noise_eroded.atrn");
+	desc.tile_resolution = 64;
+	ADRIA_CHECK(TerrainTileGenerator::FromNoise(noise_desc, &thermal_desc, nullptr, TerrainTextureLayerParameters{}, desc));
+	{
+		TerrainTileCache cache(desc.output_path, 64ull << 20);
+		ADRIA_CHECK(cache.IsValid());
+		MakeFinestMipResident(cache, 256.0f);
+
+		Heightmap eroded(noise_desc);
+		eroded.ApplyThermalErosion(thermal_desc);
+		CheckMatchesHeightmap(cache, eroded);
+	}
+	std::filesystem::remove(desc.output_path);
+}
+
+//selected tiles cover every sample of the terrain exactly once, and their vertices are the queried heights
+ADRIA_TEST(TerrainStreamingSelectTiles)
+{
+	g_TaskManager.Initialize();
+	TerrainTileGeneratorDesc desc{};
+	desc.output_path = TestFilePath("adria_select_tiles.atrn");
+	desc.tile_resolution = 32;
+	desc.sample_spacing_x = desc.sample_spacing_z = 2.0f;
+	uint64 const samples = 300;
+	auto source = [](uint64 x, uint64 z) { return 20.0f * std::sin(x * 0.05f) + 10.0f * std::cos(z * 0.03f); };
+	ADRIA_CHECK(TerrainTileGenerator::Generate(samples, samples, -30.0f, 30.0f, source, TerrainTextureLayerParameters{}, desc));
+	{
+		TerrainTileCache cache(desc.output_path, 64ull << 20);
+		ADRIA_CHECK(cache.IsValid());
+		cache.Update(Vector3(100.0f, 0.0f, 100.0f), 40.0f);
+		cache.WaitForPendingLoads();
+
+		std::vector<TerrainTile const*> tiles;
+		cache.SelectTiles(tiles);
+		ADRIA_CHECK(!tiles.empty());
+
+		bool finest_mip_selected = false;
+		std::vector<uint32> coverage((samples - 1) * (samples - 1), 0);
+		std::vector<TexturedNormalVertex> vertices;
+		for (TerrainTile const* tile : tiles)
+		{
+			finest_mip_selected |= tile->mip == 0;
+			uint64 const cell_size = 1ull << tile->mip;
+			uint64 const first_x = tile->x * desc.tile_resolution * cell_size, first_z = tile->z * desc.tile_resolution * cell_size;
+			uint64 const last_x = std::min(first_x + desc.tile_resolution * cell_size, samples - 1);
+			uint64 const last_z = std::min(first_z + desc.tile_resolution * cell_size, samples - 1);
+			for (uint64 z = first_z; z < last_z; ++z) for (uint64 x = first_x; x < last_x; ++x) ++coverage[z * (samples - 1) + x];
+
+			cache.BuildTileVertices(*tile, Vector2(1.0f, 1.0f), vertices);
+			ADRIA_CHECK(vertices.size() == (desc.tile_resolution + 1) * (desc.tile_resolution + 1));
+			for (TexturedNormalVertex const& vertex : vertices)
+			{
+				float const expected = source((uint64)std::lround(vertex.position.x / 2.0f), (uint64)std::lround(vertex.position.z / 2.0f));
+				ADRIA_CHECK_NEAR(vertex.position.y, expected, 60.0f / 65535.0f + 1e-3f);
+			}
+		}
+		ADRIA_CHECK(finest_mip_selected);
+		ADRIA_CHECK(std::all_of(coverage.begin(), coverage.end(), [](uint32 c) { return c == 1; }));
+
+		//the terrain made from the cache answers its queries
+		Terrain terrain(cache);
+		ADRIA_CHECK(terrain.TileCounts().first == samples - 1);
+		ADRIA_CHECK_NEAR(terrain.HeightAt(100.0f, 100.0f), cache.HeightAt(100.0f, 100.0f), 1e-6f);
+		ADRIA_CHECK(terrain.ContentHash() == cache.ContentHash());
+	}
+	std::filesystem::remove(desc.output_path);
+}
+
+//flies diagonally over 64 km of terrain: resident memory stays within the budget and the tiles under the camera are the finest ones
+ADRIA_TEST(TerrainStreamingPan64km)
+{
+	g_TaskManager.Initialize();
+	TerrainTileGeneratorDesc desc{};
+	desc.output_path = TestFilePath("adria_pan_64km.atrn");
+	desc.tile_resolution = 64;
+	desc.sample_spacing_x = desc.sample_spacing_z = PAN_SAMPLE_SPACING;
+	auto source = [](uint64 x, uint64 z) { return PanTerrainHeight(x * PAN_SAMPLE_SPACING, z * PAN_SAMPLE_SPACING); };
+
+	Timer<std::chrono::milliseconds> timer;
+	ADRIA_CHECK(TerrainTileGenerator::Generate(PAN_TERRAIN_SAMPLES, PAN_TERRAIN_SAMPLES, -300.0f, 300.0f, source, TerrainTextureLayerParameters{}, desc));
+	float const generate_time = timer.MarkInSeconds();
+	{
+		uint64 const memory_budget = 4ull << 20;
+		float const terrain_size = (PAN_TERRAIN_SAMPLES - 1) * PAN_SAMPLE_SPACING;
+		ADRIA_CHECK(terrain_size >= 64000.0f);
+
+		TerrainTileCache cache(desc.output_path, memory_budget);
+		ADRIA_CHECK(cache.IsValid());
+
+		uint32 const step_count = 200;
+		uint64 peak_memory = 0;
+		for (uint32 step = 0; step <= step_count; ++step)
+		{
+			float const t = step / float(step_count);
+			Vector3 const camera_position(terrain_size * t, 200.0f, terrain_size * (0.1f + 0.8f * t));
+			cache.Update(camera_position, 1024.0f);
+			cache.WaitForPendingLoads();
+			cache.Update(camera_position, 1024.0f);
+			peak_memory = std::max(peak_memory, cache.MemoryUsage());
+			ADRIA_CHECK(cache.MemoryUsage() <= memory_budget);
+
+			float const tile_size = cache.TileWorldSizeX(0);
+			uint64 const tile_x = std::min<uint64>(uint64(camera_position.x / tile_size), cache.Mip(0).tile_count_x - 1);
+			uint64 const tile_z = std::min<uint64>(uint64(camera_position.z / tile_size), cache.Mip(0).tile_count_z - 1);
+			ADRIA_CHECK(cache.FindTile(0, tile_x, tile_z) != nullptr);
+			ADRIA_CHECK_NEAR(cache.HeightAt(camera_position.x, camera_position.z), PanTerrainHeight(camera_position.x, camera_position.z), 0.05f);
+		}
+		printf("  64 km terrain: generated in %.2f s, panned in %.2f s, peak resident memory %.2f MB of %.2f MB, file %.2f MB\n",
+			generate_time, timer.MarkInSeconds(), peak_memory / (1024.0 * 1024.0), memory_budget / (1024.0 * 1024.0),
+			std::filesystem::file_size(desc.output_path) / (1024.0 * 1024.0));
+	}
+	std::filesystem::remove(desc.output_path);
+}
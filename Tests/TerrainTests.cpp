@@ -0,0 +1,97 @@
+#include <random>
+#include "Test.h"
+#include "Rendering/Terrain.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	constexpr uint64 TERRAIN_CELLS_X = 37;
+	constexpr uint64 TERRAIN_CELLS_Z = 23;
+	constexpr float TERRAIN_TILE_SIZE_X = 2.0f;
+	constexpr float TERRAIN_TILE_SIZE_Z = 3.0f;
+
+	//rolling heights, normals in every direction so the octahedral decode folds the lower hemisphere too
+	Terrain TestTerrain(uint64 cells_x, uint64 cells_z)
+	{
+		std::mt19937 rng(5);
+		std::normal_distribution<float> normal_distribution;
+		std::vector<TexturedNormalVertex> vertices((cells_x + 1) * (cells_z + 1));
+		for (uint64 j = 0; j <= cells_z; ++j)
+		{
+			for (uint64 i = 0; i <= cells_x; ++i)
+			{
+				TexturedNormalVertex& vertex = vertices[j * (cells_x + 1) + i];
+				vertex.position = Vector3(i * TERRAIN_TILE_SIZE_X, 40.0f * std::sin(i * 0.3f) * std::cos(j * 0.2f), j * TERRAIN_TILE_SIZE_Z);
+				Vector3 normal(normal_distribution(rng), normal_distribution(rng), normal_distribution(rng));
+				normal.Normalize();
+				vertex.normal = normal;
+			}
+		}
+		return Terrain(vertices, TERRAIN_TILE_SIZE_X, TERRAIN_TILE_SIZE_Z, cells_x, cells_z);
+	}
+
+	//random positions with some outside the terrain, the corners and edges, and a count that leaves a tail of 3
+	std::vector<Vector2> TestPositions(uint32 random_count)
+	{
+		float const extent_x = TERRAIN_CELLS_X * TERRAIN_TILE_SIZE_X, extent_z = TERRAIN_CELLS_Z * TERRAIN_TILE_SIZE_Z;
+		std::vector<Vector2> positions = { Vector2(0.0f, 0.0f), Vector2(extent_x, extent_z), Vector2(extent_x, 0.0f), Vector2(0.0f, extent_z),
+			Vector2(-5.0f, 10.0f), Vector2(extent_x + 5.0f, 10.0f), Vector2(10.0f, -5.0f), Vector2(10.0f, extent_z + 5.0f) };
+		std::mt19937 rng(9);
+		std::uniform_real_distribution<float> x_distribution(-10.0f, extent_x + 10.0f), z_distribution(-10.0f, extent_z + 10.0f);
+		for (uint32 i = 0; i < random_count; ++i) positions.emplace_back(x_distribution(rng), z_distribution(rng));
+		positions.resize(positions.size() / 4 * 4 + 3, Vector2(extent_x, extent_z * 0.5f));
+		return positions;
+	}
+}
+
+//the vectorized batches give what the single queries give, on the tail and for positions clamped to the edges too
+ADRIA_TEST(TerrainBatchQueriesMatchSingle)
+{
+	Terrain const terrain = TestTerrain(TERRAIN_CELLS_X, TERRAIN_CELLS_Z);
+	std::vector<Vector2> const positions = TestPositions(1000);
+	ADRIA_CHECK(positions.size() % 4 == 3);
+
+	std::vector<float> heights(positions.size());
+	std::vector<Vector3> normals(positions.size());
+	terrain.HeightAtBatch(positions, heights);
+	terrain.NormalAtBatch(positions, normals);
+
+	float max_height_error = 0.0f, max_normal_error = 0.0f;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		max_height_error = std::max(max_height_error, std::abs(heights[i] - terrain.HeightAt(positions[i].x, positions[i].y)));
+		max_normal_error = std::max(max_normal_error, Vector3::Distance(normals[i], terrain.NormalAt(positions[i].x, positions[i].y)));
+	}
+	ADRIA_CHECK(max_height_error < 1e-3f);
+	ADRIA_CHECK(max_normal_error < 1e-5f);
+
+	//clamped positions take the values of the edge
+	ADRIA_CHECK_NEAR(heights[4], terrain.HeightAt(0.0f, 10.0f), 1e-3f);
+	ADRIA_CHECK(Vector3::Distance(normals[5], terrain.NormalAt(TERRAIN_CELLS_X * TERRAIN_TILE_SIZE_X, 10.0f)) < 1e-5f);
+	ADRIA_CHECK(Vector3::Distance(normals[7], terrain.NormalAt(10.0f, TERRAIN_CELLS_Z * TERRAIN_TILE_SIZE_Z)) < 1e-5f);
+}
+
+ADRIA_BENCHMARK(TerrainBatchQueries)
+{
+	Terrain const terrain = TestTerrain(1024, 1024);
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> x_distribution(0.0f, 1024 * TERRAIN_TILE_SIZE_X), z_distribution(0.0f, 1024 * TERRAIN_TILE_SIZE_Z);
+	std::vector<Vector2> positions(1 << 22);
+	for (Vector2& position : positions) position = Vector2(x_distribution(rng), z_distribution(rng));
+	std::vector<float> heights(positions.size());
+	std::vector<Vector3> normals(positions.size());
+
+	Timer<std::chrono::milliseconds> timer;
+	for (size_t i = 0; i < positions.size(); ++i) heights[i] = terrain.HeightAt(positions[i].x, positions[i].y);
+	float const height_time = timer.MarkInSeconds();
+	terrain.HeightAtBatch(positions, heights);
+	float const height_batch_time = timer.MarkInSeconds();
+	for (size_t i = 0; i < positions.size(); ++i) normals[i] = terrain.NormalAt(positions[i].x, positions[i].y);
+	float const normal_time = timer.MarkInSeconds();
+	terrain.NormalAtBatch(positions, normals);
+	float const normal_batch_time = timer.MarkInSeconds();
+	printf("  %zu random queries: heights %.3f s single, %.3f s batched, normals %.3f s single, %.3f s batched\n", positions.size(),
+		height_time, height_batch_time, normal_time, normal_batch_time);
+}
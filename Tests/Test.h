@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <cstdio>
+#include <cmath>
+
+namespace adria::test
+{
+	using TestFunction = void(*)();
+
+	struct TestCase
+	{
+		char const* name;
+		TestFunction function;
+		bool benchmark;
+	};
+
+	std::vector<TestCase>& Registry();
+	void ReportFailure(char const* expression, char const* file, int line);
+
+	struct TestRegistrar
+	{
+		TestRegistrar(char const* name, TestFunction function, bool benchmark)
+		{
+			Registry().push_back(TestCase{ name, function, benchmark });
+		}
+	};
+}
+
+//tests run by default, benchmarks only with --benchmark, both can be filtered by name: AdriaTests [--benchmark] [name filter]
+#define ADRIA_TEST(name) \
+	static void name(); \
+	static adria::test::TestRegistrar ADRIA_CONCAT(name, _registrar){ #name, &name, false }; \
+	static void name()
+
+#define ADRIA_BENCHMARK(name) \
+	static void name(); \
+	static adria::test::TestRegistrar ADRIA_CONCAT(name, _registrar){ #name, &name, true }; \
+	static void name()
+
+#define ADRIA_CHECK(expr) do { if (!(expr)) adria::test::ReportFailure(#expr, __FILE__, __LINE__); } while(0)
+#define ADRIA_CHECK_NEAR(a, b, epsilon) do { if (!(std::abs((a) - (b)) <= (epsilon))) adria::test::ReportFailure(#a " ~= " #b, __FILE__, __LINE__); } while(0)
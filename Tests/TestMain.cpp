@@ -0,0 +1,57 @@
+#include <cstring>
+#include <string_view>
+#include "Test.h"
+#include "Utilities/Timer.h"
+
+namespace adria::test
+{
+	namespace
+	{
+		uint64 failure_count = 0;
+	}
+
+	std::vector<TestCase>& Registry()
+	{
+		static std::vector<TestCase> registry;
+		return registry;
+	}
+
+	void ReportFailure(char const* expression, char const* file, int line)
+	{
+		++failure_count;
+		printf("  FAILED: %s (%s:%d)\n", expression, file, line);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace adria;
+
+	bool run_benchmarks = false;
+	std::string_view filter;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0) run_benchmarks = true;
+		else filter = argv[i];
+	}
+
+	uint64 run_count = 0, failed_count = 0;
+	for (test::TestCase const& test_case : test::Registry())
+	{
+		if (test_case.benchmark != run_benchmarks) continue;
+		if (!filter.empty() && std::string_view(test_case.name).find(filter) == std::string_view::npos) continue;
+
+		printf("[%s] %s\n", run_benchmarks ? "BENCHMARK" : "TEST", test_case.name);
+		fflush(stdout);
+		uint64 const failures_before = test::failure_count;
+		Timer<std::chrono::milliseconds> timer;
+		test_case.function();
+		printf("  %s in %.3f s\n", test::failure_count == failures_before ? "passed" : "failed", timer.ElapsedInSeconds());
+		fflush(stdout);
+
+		++run_count;
+		if (test::failure_count != failures_before) ++failed_count;
+	}
+	printf("%llu of %llu passed\n", (unsigned long long)(run_count - failed_count), (unsigned long long)run_count);
+	return failed_count == 0 ? 0 : 1;
+}
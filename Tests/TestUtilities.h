@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "Math/Constants.h"
+#include "Utilities/Heightmap.h"
+
+//fixtures shared by the tests, the ones with math types only by the math tests
+namespace adria::test
+{
+	//fbm perlin noise, smooth enough at the test sizes that erosion and quantization errors stay small
+	inline NoiseDesc TestNoiseDesc(uint32 size, int32 seed = 33, uint32 max_height = 200)
+	{
+		return NoiseDesc{ .width = size, .depth = size, .max_height = max_height, .fractal_type = FractalType::FBM, .noise_type = NoiseType::Perlin,
+			.seed = seed, .frequency = 0.1f, .persistence = 0.5f, .lacunarity = 2.0f, .octaves = 4, .noise_scale = 16.0f };
+	}
+
+#if ADRIA_TESTS_MATH
+	struct SphereMesh
+	{
+		std::vector<Vector3> positions;
+		std::vector<Vector2> uvs;
+		std::vector<uint32> indices;
+	};
+
+	/* closed uv sphere with outward facing triangles, shared vertices and a seam at phi = 0. A nonzero bumpiness adds
+	   some noise to the radius so neighbouring triangles differ in size and angles */
+	inline SphereMesh CreateSphere(uint32 rings, uint32 segments, float radius, float bumpiness = 0.0f)
+	{
+		SphereMesh mesh{};
+		mesh.positions.reserve((rings + 1) * (segments + 1));
+		mesh.uvs.reserve((rings + 1) * (segments + 1));
+		for (uint32 r = 0; r <= rings; ++r)
+		{
+			float const theta = pi<float> * r / rings;
+			for (uint32 s = 0; s <= segments; ++s)
+			{
+				float const phi = 2.0f * pi<float> * s / segments;
+				float const bumped_radius = radius * (1.0f + bumpiness * std::sin(7.0f * theta) * std::cos(5.0f * phi));
+				mesh.positions.push_back(Vector3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * bumped_radius);
+				mesh.uvs.push_back(Vector2(s / float(segments), r / float(rings)));
+			}
+		}
+		for (uint32 r = 0; r < rings; ++r)
+		{
+			for (uint32 s = 0; s < segments; ++s)
+			{
+				uint32 const v = r * (segments + 1) + s;
+				if (r > 0) mesh.indices.insert(mesh.indices.end(), { v, v + 1, v + segments + 1 });
+				if (r + 1 < rings) mesh.indices.insert(mesh.indices.end(), { v + 1, v + segments + 2, v + segments + 1 });
+			}
+		}
+		return mesh;
+	}
+
+	inline float AngleInDegrees(Vector3 const& a, Vector3 const& b)
+	{
+		return std::acos(std::clamp(a.Dot(b) / (a.Length() * b.Length()), -1.0f, 1.0f)) * 180.0f / pi<float>;
+	}
+
+	//16:9 perspective frustum with a 45 degree fov looking from position at target, in world space
+	inline BoundingFrustum TestFrustum(Vector3 const& position, Vector3 const& target, float far_plane)
+	{
+		BoundingFrustum frustum(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 16.0f / 9.0f, 0.1f, far_plane));
+		Matrix view = DirectX::XMMatrixLookAtLH(position, target, Vector3(0.0f, 1.0f, 0.0f));
+		frustum.Transform(frustum, view.Invert());
+		return frustum;
+	}
+#endif
+}
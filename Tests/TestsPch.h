@@ -0,0 +1,44 @@
+#pragma once
+//what pch.h gives the engine sources, without the win32/d3d11 parts, so the backend independent modules build on any platform
+#include <vector>
+#include <memory>
+#include <string>
+#include <array>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <functional>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdio>
+
+#include "Core/CoreTypes.h"
+#include "Core/Defines.h"
+#if ADRIA_TESTS_MATH
+#if !defined(_WIN32)
+//SimpleMath::Rectangle and Viewport use them
+using UINT = unsigned int;
+using LONG = long;
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+#endif
+#include "Math/MathTypes.h"
+#endif
+
+#if !defined(_MSC_VER)
+template<size_t N, typename... Args>
+inline int sprintf_s(char(&buffer)[N], char const* format, Args... args)
+{
+	return snprintf(buffer, N, format, args...);
+}
+#endif
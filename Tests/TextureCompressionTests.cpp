@@ -0,0 +1,202 @@
+#include <cstring>
+#include "Test.h"
+#include "Rendering/TextureCompression.h"
+#include "Rendering/DDSFile.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	//smooth gradients with some detail on top, what photographed material textures look like to the encoder
+	std::vector<uint8> TestImage(uint32 width, uint32 height, bool translucent)
+	{
+		std::vector<uint8> rgba((size_t)width * height * 4);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				float const detail = 20.0f * std::sin(x * 0.3f) * std::cos(y * 0.2f);
+				uint8* texel = &rgba[((size_t)y * width + x) * 4];
+				texel[0] = (uint8)std::clamp(x * 255.0f / width + detail, 0.0f, 255.0f);
+				texel[1] = (uint8)std::clamp(y * 255.0f / height - detail, 0.0f, 255.0f);
+				texel[2] = (uint8)std::clamp(128.0f + 2.0f * detail, 0.0f, 255.0f);
+				texel[3] = translucent ? (uint8)((x + y) * 255 / (width + height)) : 255;
+			}
+		}
+		return rgba;
+	}
+
+	//unit normals of a bumpy surface, in [0, 255]
+	std::vector<uint8> TestNormalMap(uint32 width, uint32 height)
+	{
+		std::vector<uint8> rgba((size_t)width * height * 4);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				float const nx = 0.4f * std::sin(x * 0.1f), ny = 0.4f * std::cos(y * 0.07f);
+				float const nz = std::sqrt(1.0f - nx * nx - ny * ny);
+				uint8* texel = &rgba[((size_t)y * width + x) * 4];
+				texel[0] = (uint8)((nx * 0.5f + 0.5f) * 255.0f + 0.5f);
+				texel[1] = (uint8)((ny * 0.5f + 0.5f) * 255.0f + 0.5f);
+				texel[2] = (uint8)((nz * 0.5f + 0.5f) * 255.0f + 0.5f);
+				texel[3] = 255;
+			}
+		}
+		return rgba;
+	}
+
+	//of the top mip over the channels the format keeps, decoded here rather than trusting CompressedTexture::psnr
+	float DecodedPSNR(std::vector<uint8> const& rgba, CompressedTexture const& texture, uint32 channels)
+	{
+		CompressedMip const& mip = texture.mips[0];
+		uint32 const block_size = TextureCompression::BlockSize(texture.format);
+		uint32 const blocks_x = (mip.width + 3) / 4, blocks_y = (mip.height + 3) / 4;
+		double error = 0.0;
+		for (uint32 block_y = 0; block_y < blocks_y; ++block_y)
+		{
+			for (uint32 block_x = 0; block_x < blocks_x; ++block_x)
+			{
+				uint8 decoded[64];
+				TextureCompression::DecodeBlock(texture.format, &mip.blocks[((size_t)block_y * blocks_x + block_x) * block_size], decoded);
+				for (uint32 j = 0; j < 4; ++j)
+				{
+					for (uint32 i = 0; i < 4; ++i)
+					{
+						uint8 const* texel = &rgba[((size_t)(block_y * 4 + j) * mip.width + block_x * 4 + i) * 4];
+						for (uint32 c = 0; c < channels; ++c)
+						{
+							double const difference = (double)texel[c] - decoded[(j * 4 + i) * 4 + c];
+							error += difference * difference;
+						}
+					}
+				}
+			}
+		}
+		double const mse = error / ((double)mip.width * mip.height * channels);
+		return mse > 0.0 ? (float)(10.0 * std::log10(255.0 * 255.0 / mse)) : 99.0f;
+	}
+
+	struct UsageCase
+	{
+		char const* name;
+		TextureUsage usage;
+		bool translucent;
+		BCFormat format;
+		uint32 channels;
+		float min_psnr;
+	};
+
+	constexpr UsageCase USAGE_CASES[] =
+	{
+		{ "albedo", TextureUsage::Albedo, false, BCFormat::BC1, 3, 32.0f },
+		{ "translucent albedo", TextureUsage::Albedo, true, BCFormat::BC3, 4, 32.0f },
+		{ "emissive", TextureUsage::Emissive, false, BCFormat::BC1, 3, 32.0f },
+		{ "normal", TextureUsage::Normal, false, BCFormat::BC5, 2, 40.0f },
+		{ "metallic roughness", TextureUsage::MetallicRoughness, false, BCFormat::BC7, 4, 38.0f },
+	};
+}
+
+ADRIA_TEST(TextureCompressionQuality)
+{
+	uint32 const size = 128;
+	for (UsageCase const& usage_case : USAGE_CASES)
+	{
+		std::vector<uint8> const rgba = usage_case.usage == TextureUsage::Normal ? TestNormalMap(size, size) : TestImage(size, size, usage_case.translucent);
+		CompressedTexture const texture = TextureCompression::Compress(rgba, size, size, usage_case.usage);
+		ADRIA_CHECK(texture.format == usage_case.format);
+
+		//full mip chain down to 1x1
+		ADRIA_CHECK(texture.mips.size() == 8);
+		for (uint32 mip = 0; mip < texture.mips.size(); ++mip)
+		{
+			ADRIA_CHECK(texture.mips[mip].width == size >> mip && texture.mips[mip].height == size >> mip);
+			ADRIA_CHECK(texture.mips[mip].blocks.size() == (size_t)TextureCompression::RowPitch(texture.format, size >> mip) * std::max((size >> mip) / 4, 1u));
+		}
+
+		float const psnr = DecodedPSNR(rgba, texture, usage_case.channels);
+		ADRIA_CHECK(psnr >= usage_case.min_psnr);
+		ADRIA_CHECK_NEAR(psnr, texture.psnr, 0.01f);
+		printf("  %s as %s: %.2f dB\n", usage_case.name, TextureCompression::FormatName(texture.format), psnr);
+	}
+}
+
+//a constant block decodes to its color, up to the precision of the endpoints
+ADRIA_TEST(TextureCompressionConstantBlocks)
+{
+	std::vector<uint8> rgba(16 * 16 * 4);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+	{
+		rgba[i + 0] = 200;
+		rgba[i + 1] = 100;
+		rgba[i + 2] = 50;
+		rgba[i + 3] = 255;
+	}
+	for (TextureUsage usage : { TextureUsage::Albedo, TextureUsage::MetallicRoughness })
+	{
+		CompressedTexture const texture = TextureCompression::Compress(rgba, 16, 16, usage);
+		for (CompressedMip const& mip : texture.mips)
+		{
+			uint8 decoded[64];
+			TextureCompression::DecodeBlock(texture.format, mip.blocks.data(), decoded);
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				ADRIA_CHECK(std::abs(decoded[i * 4 + 0] - 200) <= 4);
+				ADRIA_CHECK(std::abs(decoded[i * 4 + 1] - 100) <= 2);
+				ADRIA_CHECK(std::abs(decoded[i * 4 + 2] - 50) <= 4);
+			}
+		}
+	}
+}
+
+//sizes that are multiples of 4 but not powers of 2 end with mips smaller than a block
+ADRIA_TEST(TextureCompressionDDSRoundTrip)
+{
+	uint32 const width = 12, height = 20;
+	ADRIA_CHECK(TextureCompression::CanCompress(width, height));
+	ADRIA_CHECK(!TextureCompression::CanCompress(10, 20));
+
+	std::vector<uint8> const rgba = TestImage(width, height, false);
+	for (TextureUsage usage : { TextureUsage::Albedo, TextureUsage::Normal, TextureUsage::MetallicRoughness })
+	{
+		CompressedTexture const texture = TextureCompression::Compress(rgba, width, height, usage);
+		//12x20, 6x10, 3x5, 1x2, 1x1
+		uint32 const expected_blocks[][2] = { { 3, 5 }, { 2, 3 }, { 1, 2 }, { 1, 1 }, { 1, 1 } };
+		ADRIA_CHECK(texture.mips.size() == 5);
+
+		std::vector<uint8> const dds = TextureCompression::WriteDDS(texture);
+		std::optional<DDSLayout> const layout = TextureCompression::ReadDDSLayout(dds);
+		ADRIA_CHECK(layout.has_value());
+		ADRIA_CHECK(layout->format == texture.format && layout->width == width && layout->height == height && layout->mip_count == 5);
+
+		uint64 offset = DDSFile::DATA_OFFSET;
+		for (uint32 mip = 0; mip < 5; ++mip)
+		{
+			uint64 const mip_size = (uint64)expected_blocks[mip][0] * expected_blocks[mip][1] * TextureCompression::BlockSize(texture.format);
+			ADRIA_CHECK(layout->mip_sizes[mip] == mip_size);
+			ADRIA_CHECK(layout->mip_offsets[mip] == offset);
+			ADRIA_CHECK(texture.mips[mip].blocks.size() == mip_size);
+			ADRIA_CHECK(memcmp(&dds[offset], texture.mips[mip].blocks.data(), mip_size) == 0);
+			offset += mip_size;
+		}
+		ADRIA_CHECK(offset == dds.size());
+
+		//truncated files are rejected
+		ADRIA_CHECK(!TextureCompression::ReadDDSLayout(std::span(dds.data(), dds.size() - 1)));
+		ADRIA_CHECK(!TextureCompression::ReadDDSLayout(std::span(dds.data(), 16)));
+	}
+}
+
+ADRIA_BENCHMARK(TextureCompressionThroughput)
+{
+	uint32 const size = 1024;
+	double const megabytes = (double)size * size * 4 / (1024.0 * 1024.0);
+	for (UsageCase const& usage_case : USAGE_CASES)
+	{
+		std::vector<uint8> const rgba = usage_case.usage == TextureUsage::Normal ? TestNormalMap(size, size) : TestImage(size, size, usage_case.translucent);
+		CompressedTexture const texture = TextureCompression::Compress(rgba, size, size, usage_case.usage);
+		printf("  %ux%u %s as %s: %.3f s with mips, %.1f MB/s, PSNR %.2f dB\n", size, size, usage_case.name, TextureCompression::FormatName(texture.format),
+			texture.encode_time, megabytes / std::max(texture.encode_time, 1e-6f), texture.psnr);
+	}
+}
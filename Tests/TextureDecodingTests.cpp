@@ -0,0 +1,243 @@
+#include <cstring>
+#include <filesystem>
+#include "Test.h"
+#include "Rendering/TextureDecoding.h"
+#include "Rendering/DDSFile.h"
+#include "Tasks/TaskManager.h"
+#include "Utilities/Timer.h"
+
+using namespace adria;
+
+namespace
+{
+	std::string TestFilePath(char const* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	//rgba pixels, seed picks the pattern
+	std::vector<uint8> TestPixels(uint32 width, uint32 height, uint32 seed)
+	{
+		std::vector<uint8> pixels((size_t)width * height * 4);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				uint8* pixel = &pixels[((size_t)y * width + x) * 4];
+				pixel[0] = uint8(x * 3 + seed);
+				pixel[1] = uint8(y * 5 + seed * 7);
+				pixel[2] = uint8((x ^ y) + seed * 13);
+				pixel[3] = 255;
+			}
+		}
+		return pixels;
+	}
+}
+
+//what TextureManager does with the queue: every file is submitted at once, the frame loop drains it within an upload budget
+ADRIA_TEST(TextureDecodeQueueStress)
+{
+	g_TaskManager.Initialize();
+	uint32 const texture_count = 500, texture_size = 128;
+	uint64 const texture_bytes = (uint64)texture_size * texture_size * 4;
+	uint64 const upload_budget = 2ull << 20;
+
+	std::vector<std::string> paths(texture_count);
+	for (uint32 i = 0; i < texture_count; ++i)
+	{
+		char name[64];
+		sprintf_s(name, "adria_decode_stress_%u.png", i);
+		paths[i] = TestFilePath(name);
+		WriteImagePNG(paths[i].c_str(), TestPixels(texture_size, texture_size, i), texture_size, texture_size);
+	}
+
+	Timer<std::chrono::microseconds> timer;
+	TextureDecodeQueue queue;
+	for (uint32 i = 0; i < texture_count; ++i) queue.Submit(i, paths[i], TextureUsage::Generic, true);
+	//loading doesn't wait on any decode, the first frame can be drawn right after with the fallback textures
+	float const first_frame_time = timer.ElapsedInSeconds();
+	ADRIA_CHECK(queue.PendingCount() == texture_count);
+
+	std::vector<uint32> created(texture_count, 0);
+	std::vector<uint8> uploaded(texture_bytes);
+	float first_texture_time = 0.0f;
+	uint32 frame_count = 0;
+	uint64 max_frame_bytes = 0;
+	while (queue.PendingCount() > 0)
+	{
+		uint64 frame_bytes = 0;
+		uint32 const frame_created = queue.Drain(upload_budget, [&](DecodedTexture& decoded) -> uint64
+			{
+				ADRIA_CHECK(decoded.IsValid() && decoded.image->Width() == texture_size);
+				++created[decoded.id];
+				memcpy(uploaded.data(), decoded.image->Data<uint8>(), texture_bytes);
+				frame_bytes += texture_bytes;
+				return texture_bytes;
+			});
+		if (frame_created == 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if (frame_count++ == 0) first_texture_time = timer.ElapsedInSeconds();
+		max_frame_bytes = std::max(max_frame_bytes, frame_bytes);
+		//the budget is only overshot by the texture that crosses it
+		ADRIA_CHECK(frame_bytes < upload_budget + texture_bytes);
+	}
+	float const total_time = timer.ElapsedInSeconds();
+	ADRIA_CHECK(std::all_of(created.begin(), created.end(), [](uint32 c) { return c == 1; }));
+	ADRIA_CHECK(frame_count >= texture_count * texture_bytes / (upload_budget + texture_bytes));
+	printf("  %u textures of %ux%u: first frame after %.3f ms, first texture after %.3f ms, all created after %.3f ms over %u frames, at most %.2f MB per frame\n",
+		texture_count, texture_size, texture_size, first_frame_time * 1000.0f, first_texture_time * 1000.0f, total_time * 1000.0f, frame_count,
+		max_frame_bytes / (1024.0 * 1024.0));
+
+	for (std::string const& path : paths) std::filesystem::remove(path);
+}
+
+//files that can't be decoded come back invalid rather than not at all, so the queue still empties
+ADRIA_TEST(TextureDecodeQueueMissingFile)
+{
+	g_TaskManager.Initialize();
+	TextureDecodeQueue queue;
+	queue.Submit(7, TestFilePath("adria_missing_texture.png"), TextureUsage::Generic, true);
+	uint32 drained = 0;
+	while (queue.PendingCount() > 0)
+	{
+		drained += queue.Drain(1, [](DecodedTexture& decoded) -> uint64
+			{
+				ADRIA_CHECK(decoded.id == 7 && !decoded.IsValid());
+				return 0;
+			});
+	}
+	ADRIA_CHECK(drained == 1);
+}
+
+//the same pixels get the same key whatever file and format they come from, anything that changes the texture changes the key
+ADRIA_TEST(TextureContentKeys)
+{
+	std::vector<uint8> const pixels = TestPixels(64, 64, 1);
+	std::string const png_path = TestFilePath("adria_content_key.png");
+	std::string const copy_path = TestFilePath("adria_content_key_copy.png");
+	std::string const tga_path = TestFilePath("adria_content_key.tga");
+	std::string const other_path = TestFilePath("adria_content_key_other.png");
+	WriteImagePNG(png_path.c_str(), pixels, 64, 64);
+	WriteImagePNG(copy_path.c_str(), pixels, 64, 64);
+	WriteImageTGA(tga_path.c_str(), pixels, 64, 64);
+	WriteImagePNG(other_path.c_str(), TestPixels(64, 64, 2), 64, 64);
+
+	DecodedTexture const png = TextureDecoding::Decode(png_path, TextureUsage::Generic, true);
+	ADRIA_CHECK(png.IsValid());
+	ADRIA_CHECK(TextureDecoding::Decode(copy_path, TextureUsage::Generic, true).content_key == png.content_key);
+	ADRIA_CHECK(TextureDecoding::Decode(tga_path, TextureUsage::Generic, true).content_key == png.content_key);
+	ADRIA_CHECK(TextureDecoding::Decode(other_path, TextureUsage::Generic, true).content_key != png.content_key);
+	ADRIA_CHECK(TextureDecoding::Decode(png_path, TextureUsage::Generic, false).content_key != png.content_key);
+
+	//compressed textures are keyed by their dds, copies share their cache entry and so their key
+	DecodedTexture const albedo = TextureDecoding::Decode(png_path, TextureUsage::Albedo, true);
+	DecodedTexture const albedo_copy = TextureDecoding::Decode(copy_path, TextureUsage::Albedo, true);
+	ADRIA_CHECK(!albedo.dds.empty() && !albedo.cache_path.empty());
+	ADRIA_CHECK(albedo_copy.cache_path == albedo.cache_path);
+	ADRIA_CHECK(albedo_copy.content_key == albedo.content_key);
+	ADRIA_CHECK(albedo.content_key != png.content_key);
+	DecodedTexture const normal = TextureDecoding::Decode(png_path, TextureUsage::Normal, true);
+	ADRIA_CHECK(normal.content_key != albedo.content_key);
+
+	for (std::string const& path : { png_path, copy_path, tga_path, other_path, albedo.cache_path, normal.cache_path }) std::filesystem::remove(path);
+}
+
+//cache files are renamed into place, a truncated or padded dds is rejected rather than uploaded
+ADRIA_TEST(TextureCacheRejectsIncompleteFiles)
+{
+	CompressedTexture const texture = TextureCompression::Compress(TestPixels(64, 32, 6), 64, 32, TextureUsage::Albedo);
+	std::vector<uint8> const dds = TextureCompression::WriteDDS(texture);
+	std::string const path = TestFilePath("adria_cached_texture.dds");
+
+	ADRIA_CHECK(TextureDecoding::WriteCacheFile(path, dds));
+	ADRIA_CHECK(TextureDecoding::ReadCachedTexture(path) == dds);
+	for (auto const& entry : std::filesystem::directory_iterator(std::filesystem::path(path).parent_path()))
+	{
+		ADRIA_CHECK(entry.path().filename().string().find("adria_cached_texture.dds.") == std::string::npos);
+	}
+
+	std::vector<uint8> truncated(dds.begin(), dds.end() - 1);
+	ADRIA_CHECK(TextureDecoding::WriteCacheFile(path, truncated));
+	ADRIA_CHECK(TextureDecoding::ReadCachedTexture(path).empty());
+	std::vector<uint8> headers_only(dds.begin(), dds.begin() + DDSFile::DATA_OFFSET);
+	ADRIA_CHECK(TextureDecoding::WriteCacheFile(path, headers_only));
+	ADRIA_CHECK(TextureDecoding::ReadCachedTexture(path).empty());
+	std::vector<uint8> padded = dds;
+	padded.push_back(0);
+	ADRIA_CHECK(TextureDecoding::WriteCacheFile(path, padded));
+	ADRIA_CHECK(TextureDecoding::ReadCachedTexture(path).empty());
+
+	std::filesystem::remove(path);
+}
+
+//what TextureManager does with the decoded textures: duplicates collapse to one image that lives as long as a handle uses it
+ADRIA_TEST(TextureSharingCollapsesDuplicates)
+{
+	g_TaskManager.Initialize();
+	std::vector<uint8> const duplicated_pixels = TestPixels(32, 32, 3);
+	std::vector<std::string> paths;
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		char name[64];
+		sprintf_s(name, "adria_duplicated_%u.png", i);
+		paths.push_back(TestFilePath(name));
+		WriteImagePNG(paths.back().c_str(), duplicated_pixels, 32, 32);
+	}
+	paths.push_back(TestFilePath("adria_unique.png"));
+	WriteImagePNG(paths.back().c_str(), TestPixels(32, 32, 4), 32, 32);
+	paths.push_back(TestFilePath("adria_released_early.png"));
+	WriteImagePNG(paths.back().c_str(), TestPixels(32, 32, 5), 32, 32);
+
+	TextureSharing sharing;
+	TextureDecodeQueue queue;
+	for (uint64 handle = 0; handle < paths.size(); ++handle)
+	{
+		sharing.AddHandle(handle);
+		queue.Submit(handle, paths[handle], TextureUsage::Generic, true);
+	}
+	//released before its image is decoded, it's dropped when it comes out of the queue
+	std::optional<uint64> released_content;
+	uint64 const released_early = paths.size() - 1;
+	ADRIA_CHECK(sharing.Release(released_early, released_content) && !released_content);
+
+	uint32 created = 0;
+	while (queue.PendingCount() > 0)
+	{
+		queue.Drain(1ull << 20, [&](DecodedTexture& decoded) -> uint64
+			{
+				if (!sharing.Contains(decoded.id)) return 0;
+				ADRIA_CHECK(decoded.IsValid());
+				if (sharing.Share(decoded.id, decoded.content_key)) ++created;
+				return 0;
+			});
+	}
+	ADRIA_CHECK(created == 2);
+	ADRIA_CHECK(sharing.HandleCount() == 5 && sharing.ContentCount() == 2);
+	uint64 const duplicated_key = *sharing.ContentKey(0);
+	for (uint64 handle = 1; handle < 4; ++handle) ADRIA_CHECK(sharing.ContentKey(handle) == duplicated_key);
+	ADRIA_CHECK(sharing.ContentKey(4) != duplicated_key);
+	ADRIA_CHECK(sharing.ContentHandleCount(duplicated_key) == 4);
+
+	uint32 view_count = 0;
+	sharing.ForEachHandle(duplicated_key, [&](uint64) { ++view_count; });
+	ADRIA_CHECK(view_count == 4);
+
+	//a handle goes with its last reference, the image with the last handle using it
+	sharing.Acquire(0);
+	ADRIA_CHECK(!sharing.Release(0, released_content) && !released_content);
+	ADRIA_CHECK(sharing.Release(0, released_content) && !released_content);
+	ADRIA_CHECK(!sharing.Contains(0) && sharing.ContentHandleCount(duplicated_key) == 3);
+	ADRIA_CHECK(sharing.Release(1, released_content) && !released_content);
+	ADRIA_CHECK(sharing.Release(2, released_content) && !released_content);
+	ADRIA_CHECK(sharing.Release(3, released_content) && released_content == duplicated_key);
+	ADRIA_CHECK(sharing.ContentCount() == 1 && sharing.ContentHandleCount(duplicated_key) == 0);
+	//unknown and already released handles are ignored
+	ADRIA_CHECK(!sharing.Release(3, released_content) && !released_content);
+	sharing.Acquire(3);
+	ADRIA_CHECK(!sharing.Contains(3));
+
+	for (std::string const& path : paths) std::filesystem::remove(path);
+}
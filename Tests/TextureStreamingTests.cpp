@@ -0,0 +1,177 @@
+#include <random>
+#include "Test.h"
+#include "Rendering/TextureStreaming.h"
+
+using namespace adria;
+
+namespace
+{
+	//a square BC7 texture with a full mip chain, only its tail resident as after it's created
+	StreamedTexture TestTexture(uint32 size)
+	{
+		StreamedTexture texture{};
+		for (uint32 mip = 0; (size >> mip) > 0; ++mip)
+		{
+			uint64 const blocks = std::max((size >> mip) + 3, 4u) / 4;
+			texture.mip_bytes[mip] = blocks * blocks * 16;
+			++texture.mip_count;
+		}
+		texture.tail_mip = TextureStreaming::TailMip(size, size, texture.mip_count);
+		texture.resident_mip = texture.tail_mip;
+		return texture;
+	}
+
+	void UseTexture(StreamedTexture& texture, uint64 frame, uint32 desired_mip)
+	{
+		texture.last_used_frame = frame;
+		texture.desired_mip = desired_mip;
+	}
+
+	//what TextureManager does once the mips of the loads have arrived
+	void ApplyChanges(std::vector<StreamedTexture>& textures, std::vector<ResidencyChange> const& changes)
+	{
+		for (ResidencyChange const& change : changes) textures[change.texture].resident_mip = change.target_mip;
+	}
+
+	uint64 TotalResidentBytes(std::vector<StreamedTexture> const& textures)
+	{
+		uint64 bytes = 0;
+		for (StreamedTexture const& texture : textures) bytes += TextureStreaming::ResidentBytes(texture, texture.resident_mip);
+		return bytes;
+	}
+}
+
+ADRIA_TEST(TextureStreamingMips)
+{
+	//the tail starts at the first mip no larger than 64, unless a mip before it can't start a block compressed texture
+	ADRIA_CHECK(TextureStreaming::TailMip(1024, 1024, 11) == 4);
+	ADRIA_CHECK(TextureStreaming::TailMip(1024, 16, 11) == 2);
+	ADRIA_CHECK(TextureStreaming::TailMip(32, 32, 6) == 0);
+	ADRIA_CHECK(TextureStreaming::TailMip(1000, 1000, 10) == 1);
+
+	ADRIA_CHECK(TextureStreaming::DesiredMip(1024, 1024, 11, 2048.0f) == 0);
+	ADRIA_CHECK(TextureStreaming::DesiredMip(1024, 1024, 11, 1024.0f) == 0);
+	ADRIA_CHECK(TextureStreaming::DesiredMip(1024, 1024, 11, 256.0f) == 2);
+	ADRIA_CHECK(TextureStreaming::DesiredMip(1024, 1024, 11, 0.1f) == 10);
+}
+
+//loads are capped per update, those missing the most mips go first
+ADRIA_TEST(TextureStreamingLoadLimit)
+{
+	std::vector<StreamedTexture> textures{ TestTexture(256), TestTexture(1024), TestTexture(512), TestTexture(1024) };
+	for (StreamedTexture& texture : textures) UseTexture(texture, 1, 0);
+	std::vector<ResidencyChange> changes;
+	TextureStreamingStatistics statistics = TextureStreaming::UpdateResidency(textures, 1ull << 30, 1, 2, changes);
+	ADRIA_CHECK(statistics.load_count == 2 && statistics.eviction_count == 0 && statistics.mip_bias == 0);
+	ADRIA_CHECK(changes.size() == 2 && changes[0].texture == 1 && changes[1].texture == 3);
+	for (ResidencyChange const& change : changes) ADRIA_CHECK(change.target_mip == 0);
+	//loads that were put off don't count as resident
+	ApplyChanges(textures, changes);
+	ADRIA_CHECK(statistics.resident_bytes == TotalResidentBytes(textures));
+
+	statistics = TextureStreaming::UpdateResidency(textures, 1ull << 30, 1, 2, changes);
+	ADRIA_CHECK(statistics.load_count == 2 && changes[0].texture == 2 && changes[1].texture == 0);
+	ApplyChanges(textures, changes);
+	for (StreamedTexture const& texture : textures) ADRIA_CHECK(texture.resident_mip == 0);
+	ADRIA_CHECK(statistics.desired_bytes == TotalResidentBytes(textures));
+}
+
+//over the budget the least recently used textures lose their streamed mips first, the textures in use keep theirs
+ADRIA_TEST(TextureStreamingEvictsLeastRecentlyUsed)
+{
+	std::vector<StreamedTexture> textures(5, TestTexture(1024));
+	for (StreamedTexture& texture : textures) texture.resident_mip = 0;
+	UseTexture(textures[0], 10, 0);
+	UseTexture(textures[1], 10, 0);
+	textures[2].last_used_frame = 7;
+	textures[3].last_used_frame = 3;
+	textures[4].last_used_frame = 9;
+
+	uint64 const full_bytes = TextureStreaming::ResidentBytes(textures[0], 0);
+	uint64 const tail_bytes = TextureStreaming::ResidentBytes(textures[0], textures[0].tail_mip);
+	uint64 const budget = 3 * full_bytes + 2 * tail_bytes;
+	std::vector<ResidencyChange> changes;
+	TextureStreamingStatistics const statistics = TextureStreaming::UpdateResidency(textures, budget, 10, 4, changes);
+	ADRIA_CHECK(statistics.eviction_count == 2 && statistics.load_count == 0 && statistics.mip_bias == 0);
+	ADRIA_CHECK(statistics.resident_bytes <= budget);
+	ApplyChanges(textures, changes);
+	ADRIA_CHECK(textures[3].resident_mip == textures[3].tail_mip);
+	ADRIA_CHECK(textures[2].resident_mip == textures[2].tail_mip);
+	ADRIA_CHECK(textures[4].resident_mip == 0);
+	ADRIA_CHECK(textures[0].resident_mip == 0 && textures[1].resident_mip == 0);
+	ADRIA_CHECK(statistics.resident_bytes == TotalResidentBytes(textures));
+}
+
+//when the textures in use don't fit by themselves, all of them drop the same number of mips, never below their tail
+ADRIA_TEST(TextureStreamingMipBias)
+{
+	std::vector<StreamedTexture> textures(4, TestTexture(1024));
+	for (StreamedTexture& texture : textures) texture.resident_mip = 0;
+	UseTexture(textures[0], 5, 0);
+	UseTexture(textures[1], 5, 1);
+	UseTexture(textures[2], 5, 0);
+	textures[3].last_used_frame = 4;
+
+	uint64 const full_bytes = TextureStreaming::ResidentBytes(textures[0], 0);
+	std::vector<ResidencyChange> changes;
+	TextureStreamingStatistics statistics = TextureStreaming::UpdateResidency(textures, 2 * full_bytes, 5, 4, changes);
+	ADRIA_CHECK(statistics.mip_bias == 1 && statistics.resident_bytes <= 2 * full_bytes);
+	ApplyChanges(textures, changes);
+	ADRIA_CHECK(textures[0].resident_mip == 1 && textures[1].resident_mip == 2 && textures[2].resident_mip == 1);
+	ADRIA_CHECK(textures[3].resident_mip == textures[3].tail_mip);
+
+	//a budget too small for the tails leaves every texture on its tail, the tails stay resident
+	statistics = TextureStreaming::UpdateResidency(textures, 0, 5, 4, changes);
+	ApplyChanges(textures, changes);
+	for (StreamedTexture const& texture : textures) ADRIA_CHECK(texture.resident_mip == texture.tail_mip);
+	ADRIA_CHECK(statistics.resident_bytes == TotalResidentBytes(textures) && statistics.resident_bytes > 0);
+}
+
+//textures whose mips are being read keep their residency until they arrive
+ADRIA_TEST(TextureStreamingSkipsLoadingTextures)
+{
+	std::vector<StreamedTexture> textures(2, TestTexture(1024));
+	for (StreamedTexture& texture : textures)
+	{
+		texture.resident_mip = 0;
+		UseTexture(texture, 2, 0);
+	}
+	textures[0].loading = true;
+	std::vector<ResidencyChange> changes;
+	TextureStreaming::UpdateResidency(textures, 0, 2, 4, changes);
+	ADRIA_CHECK(!changes.empty());
+	for (ResidencyChange const& change : changes) ADRIA_CHECK(change.texture != 0);
+}
+
+//random textures used over many frames: once the changes are applied the resident mips always fit the budget
+ADRIA_TEST(TextureStreamingStaysWithinBudget)
+{
+	std::mt19937 rng(17);
+	uint32 const sizes[] = { 256, 512, 1024, 2048 };
+	std::vector<StreamedTexture> textures;
+	for (uint32 i = 0; i < 200; ++i) textures.push_back(TestTexture(sizes[rng() % 4]));
+	uint64 const tail_bytes = TotalResidentBytes(textures);
+	uint64 const budget = tail_bytes + (32ull << 20);
+
+	std::vector<ResidencyChange> changes;
+	uint32 biased_frames = 0;
+	for (uint64 frame = 1; frame <= 300; ++frame)
+	{
+		//a different part of the scene is in view every 50 frames
+		uint32 const first_used = uint32(frame / 50) * 30;
+		for (uint32 i = first_used; i < first_used + 60 && i < textures.size(); ++i)
+		{
+			UseTexture(textures[i], frame, rng() % 3);
+		}
+		TextureStreamingStatistics const statistics = TextureStreaming::UpdateResidency(textures, budget, frame, 8, changes);
+		ApplyChanges(textures, changes);
+		ADRIA_CHECK(statistics.load_count <= 8);
+		ADRIA_CHECK(statistics.resident_bytes == TotalResidentBytes(textures));
+		ADRIA_CHECK(TotalResidentBytes(textures) <= budget);
+		for (StreamedTexture const& texture : textures) ADRIA_CHECK(texture.resident_mip <= texture.tail_mip);
+		biased_frames += statistics.mip_bias > 0;
+	}
+	ADRIA_CHECK(biased_frames > 0);
+	printf("  200 textures, %.2f MB of tails and a %.2f MB budget: mips dropped to fit in %u of 300 frames\n",
+		tail_bytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0), biased_frames);
+}
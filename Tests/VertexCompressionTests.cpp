@@ -0,0 +1,140 @@
+#include <random>
+#include "Test.h"
+#include "TestUtilities.h"
+#include "Rendering/VertexCompression.h"
+
+using namespace adria;
+
+namespace
+{
+	//largest angle between a unit vector and its 8 bit octahedral encoding, half a step on both axes stretched by the projection
+	constexpr float OCTAHEDRAL_ANGLE_BOUND = 1.5f;
+	//largest relative error of a half, 11 significant bits
+	constexpr float HALF_RELATIVE_ERROR = 1.0f / 2048.0f;
+
+	Vector3 RandomUnitVector(std::mt19937& rng)
+	{
+		std::normal_distribution<float> normal(0.0f, 1.0f);
+		Vector3 v;
+		do { v = Vector3(normal(rng), normal(rng), normal(rng)); } while (v.Length() < 1e-3f);
+		v.Normalize();
+		return v;
+	}
+
+	//random orthonormal frames with both bitangent signs, uvs in the range of tiled textures
+	std::vector<CompleteVertex> RandomVertices(uint64 count, BoundingBox const& bounds, uint32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> uv(-8.0f, 8.0f);
+		std::vector<CompleteVertex> vertices(count);
+		for (CompleteVertex& vertex : vertices)
+		{
+			vertex.position = Vector3(bounds.Center) + Vector3(unit(rng), unit(rng), unit(rng)) * Vector3(bounds.Extents);
+			vertex.normal = RandomUnitVector(rng);
+			vertex.tangent = vertex.normal.Cross(RandomUnitVector(rng));
+			vertex.tangent.Normalize();
+			vertex.bitangent = vertex.normal.Cross(vertex.tangent) * (unit(rng) < 0.0f ? -1.0f : 1.0f);
+			vertex.uv = Vector2(uv(rng), uv(rng));
+		}
+		return vertices;
+	}
+
+	void CheckErrorBounds(std::vector<CompleteVertex> const& vertices, BoundingBox const& bounds)
+	{
+		VertexQuantization const quantization = VertexCompression::ComputeQuantization(bounds);
+		std::vector<CompressedVertex> compressed_vertices(vertices.size());
+		VertexCompression::Compress(vertices, quantization, compressed_vertices);
+		std::vector<CompleteVertex> decompressed_vertices(vertices.size());
+		VertexCompression::Decompress(compressed_vertices, quantization, decompressed_vertices);
+
+		float const position_bound = VertexCompression::PositionErrorBound(quantization);
+		VertexCompressionError max_error{};
+		for (uint64 i = 0; i < vertices.size(); ++i)
+		{
+			CompleteVertex const& vertex = vertices[i];
+			CompleteVertex const& decompressed_vertex = decompressed_vertices[i];
+			float const position_error = Vector3::Distance(vertex.position, decompressed_vertex.position);
+			ADRIA_CHECK(position_error <= position_bound);
+
+			float const normal_error = test::AngleInDegrees(vertex.normal, decompressed_vertex.normal);
+			float const tangent_error = test::AngleInDegrees(vertex.tangent, decompressed_vertex.tangent);
+			ADRIA_CHECK(normal_error <= OCTAHEDRAL_ANGLE_BOUND);
+			ADRIA_CHECK(tangent_error <= OCTAHEDRAL_ANGLE_BOUND);
+			//the rebuilt bitangent keeps its handedness and is off by no more than the normal and the tangent
+			ADRIA_CHECK(vertex.bitangent.Dot(decompressed_vertex.bitangent) > 0.0f);
+			ADRIA_CHECK(test::AngleInDegrees(vertex.bitangent, decompressed_vertex.bitangent) <= 2.0f * OCTAHEDRAL_ANGLE_BOUND);
+
+			for (uint32 k = 0; k < 2; ++k)
+			{
+				float const uv = k == 0 ? vertex.uv.x : vertex.uv.y;
+				float const decompressed_uv = k == 0 ? decompressed_vertex.uv.x : decompressed_vertex.uv.y;
+				ADRIA_CHECK(std::abs(uv - decompressed_uv) <= std::abs(uv) * HALF_RELATIVE_ERROR + 1e-7f);
+			}
+
+			max_error.position = std::max(max_error.position, position_error);
+			max_error.normal = std::max(max_error.normal, normal_error);
+			max_error.tangent = std::max(max_error.tangent, tangent_error);
+		}
+
+		//MeasureError reports the same largest errors
+		VertexCompressionError const measured = VertexCompression::MeasureError(vertices, compressed_vertices, quantization);
+		ADRIA_CHECK_NEAR(measured.position, max_error.position, max_error.position * 1e-3f + 1e-7f);
+		ADRIA_CHECK_NEAR(measured.normal, max_error.normal, 0.05f);
+		ADRIA_CHECK_NEAR(measured.tangent, max_error.tangent, 0.05f);
+		printf("  size %.1f: position %.6f (bound %.6f), normal %.3f deg, tangent %.3f deg, bitangent %.3f deg, uv %.6f\n", 2.0f * Vector3(bounds.Extents).Length(),
+			measured.position, position_bound, measured.normal, measured.tangent, measured.bitangent, measured.uv);
+	}
+}
+
+ADRIA_TEST(VertexCompressionErrorBounds)
+{
+	for (float extent : { 0.5f, 20.0f, 4000.0f })
+	{
+		BoundingBox const bounds(Vector3(extent * 0.3f, -extent, 7.0f), Vector3(extent, extent * 0.25f, extent * 2.0f));
+		CheckErrorBounds(RandomVertices(100000, bounds, 29), bounds);
+	}
+}
+
+//a flat mesh has zero scale on one axis, the other attributes are unaffected
+ADRIA_TEST(VertexCompressionFlatMesh)
+{
+	BoundingBox const bounds(Vector3(0.0f, 2.0f, 0.0f), Vector3(10.0f, 0.0f, 10.0f));
+	std::vector<CompleteVertex> const vertices = RandomVertices(1000, bounds, 31);
+	CheckErrorBounds(vertices, bounds);
+
+	VertexQuantization const quantization = VertexCompression::ComputeQuantization(bounds);
+	std::vector<CompressedVertex> compressed_vertices(vertices.size());
+	VertexCompression::Compress(vertices, quantization, compressed_vertices);
+	std::vector<CompleteVertex> decompressed_vertices(vertices.size());
+	VertexCompression::Decompress(compressed_vertices, quantization, decompressed_vertices);
+	for (CompleteVertex const& vertex : decompressed_vertices) ADRIA_CHECK(vertex.position.y == 2.0f);
+}
+
+//vertices without normals or tangents still decode to an orthonormal frame
+ADRIA_TEST(VertexCompressionMissingFrame)
+{
+	BoundingBox const bounds(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 1.0f, 1.0f));
+	std::vector<CompleteVertex> vertices = RandomVertices(1000, bounds, 37);
+	for (uint64 i = 0; i < vertices.size(); ++i)
+	{
+		vertices[i].tangent = Vector3::Zero;
+		vertices[i].bitangent = Vector3::Zero;
+		if (i % 2) vertices[i].normal = Vector3::Zero;
+	}
+	VertexQuantization const quantization = VertexCompression::ComputeQuantization(bounds);
+	std::vector<CompressedVertex> compressed_vertices(vertices.size());
+	VertexCompression::Compress(vertices, quantization, compressed_vertices);
+	std::vector<CompleteVertex> decompressed_vertices(vertices.size());
+	VertexCompression::Decompress(compressed_vertices, quantization, decompressed_vertices);
+	for (uint64 i = 0; i < vertices.size(); ++i)
+	{
+		CompleteVertex const& vertex = decompressed_vertices[i];
+		ADRIA_CHECK_NEAR(vertex.normal.Length(), 1.0f, 1e-3f);
+		ADRIA_CHECK_NEAR(vertex.tangent.Length(), 1.0f, 1e-3f);
+		ADRIA_CHECK(std::abs(vertex.normal.Dot(vertex.tangent)) < 0.05f);
+		if (i % 2 == 0) ADRIA_CHECK(test::AngleInDegrees(vertices[i].normal, vertex.normal) <= OCTAHEDRAL_ANGLE_BOUND);
+	}
+	VertexCompressionError const error = VertexCompression::MeasureError(vertices, compressed_vertices, quantization);
+	ADRIA_CHECK(error.tangent == 0.0f && error.bitangent == 0.0f);
+}